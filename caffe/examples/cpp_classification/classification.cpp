@@ -4,7 +4,11 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #endif  // USE_OPENCV
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 #include <algorithm>
+#include <cstdlib>
 #include <iosfwd>
 #include <memory>
 #include <string>
@@ -23,32 +27,53 @@ class Classifier {
   Classifier(const string& model_file,
              const string& trained_file,
              const string& mean_file,
-             const string& label_file);
+             const string& label_file,
+             int batch_size = 1);
 
   std::vector<Prediction> Classify(const cv::Mat& img, int N = 5);
 
+  /* Return the top N predictions for each of any number of images,
+   * classified batch_size() at a time. */
+  std::vector<std::vector<Prediction> > Classify(
+      const std::vector<cv::Mat>& imgs, int N = 5);
+
+  int batch_size() const { return batch_size_; }
+
  private:
   void SetMean(const string& mean_file);
 
-  std::vector<float> Predict(const cv::Mat& img);
+  /* Run a single forward pass over at most batch_size_ images. */
+  std::vector<std::vector<float> > Predict(const std::vector<cv::Mat>& imgs);
 
-  void WrapInputLayer(std::vector<cv::Mat>* input_channels);
+  void WrapInputLayer();
 
   void Preprocess(const cv::Mat& img,
                   std::vector<cv::Mat>* input_channels);
 
+  /* Preprocess the images begin, begin + stride, ... into their items of
+   * the input layer; one thread of the parallel preprocessing. */
+  void PreprocessStrided(const std::vector<cv::Mat>* imgs, int begin,
+                         int stride);
+
  private:
   shared_ptr<Net<float> > net_;
   cv::Size input_geometry_;
   int num_channels_;
+  int batch_size_;
+  int num_threads_;
   cv::Mat mean_;
   std::vector<string> labels_;
+  /* The channels of every item of the input layer, wrapped once. */
+  std::vector<std::vector<cv::Mat> > input_channels_;
 };
 
 Classifier::Classifier(const string& model_file,
                        const string& trained_file,
                        const string& mean_file,
-                       const string& label_file) {
+                       const string& label_file,
+                       int batch_size)
+    : batch_size_(batch_size),
+      num_threads_(std::max<int>(boost::thread::hardware_concurrency(), 1)) {
 #ifdef CPU_ONLY
   Caffe::set_mode(Caffe::CPU);
 #else
@@ -68,6 +93,15 @@ Classifier::Classifier(const string& model_file,
     << "Input layer should have 1 or 3 channels.";
   input_geometry_ = cv::Size(input_layer->width(), input_layer->height());
 
+  /* Fix the batch size once: reshaping per call would reallocate the
+   * buffers of every layer whenever the number of images changes. */
+  CHECK_GT(batch_size_, 0) << "Batch size must be positive.";
+  input_layer->Reshape(batch_size_, num_channels_,
+                       input_geometry_.height, input_geometry_.width);
+  /* Forward dimension change to all layers. */
+  net_->Reshape();
+  WrapInputLayer();
+
   /* Load the binaryproto mean file. */
   SetMean(mean_file);
 
@@ -103,14 +137,27 @@ static std::vector<int> Argmax(const std::vector<float>& v, int N) {
 
 /* Return the top N predictions. */
 std::vector<Prediction> Classifier::Classify(const cv::Mat& img, int N) {
-  std::vector<float> output = Predict(img);
+  return Classify(std::vector<cv::Mat>(1, img), N)[0];
+}
 
+std::vector<std::vector<Prediction> > Classifier::Classify(
+    const std::vector<cv::Mat>& imgs, int N) {
   N = std::min<int>(labels_.size(), N);
-  std::vector<int> maxN = Argmax(output, N);
-  std::vector<Prediction> predictions;
-  for (int i = 0; i < N; ++i) {
-    int idx = maxN[i];
-    predictions.push_back(std::make_pair(labels_[idx], output[idx]));
+  std::vector<std::vector<Prediction> > predictions;
+  for (size_t begin = 0; begin < imgs.size(); begin += batch_size_) {
+    size_t end = std::min(begin + batch_size_, imgs.size());
+    std::vector<cv::Mat> batch(imgs.begin() + begin, imgs.begin() + end);
+    std::vector<std::vector<float> > outputs = Predict(batch);
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      const std::vector<float>& output = outputs[i];
+      std::vector<int> maxN = Argmax(output, N);
+      predictions.push_back(std::vector<Prediction>());
+      for (int j = 0; j < N; ++j) {
+        int idx = maxN[j];
+        predictions.back().push_back(std::make_pair(labels_[idx],
+                                                    output[idx]));
+      }
+    }
   }
 
   return predictions;
@@ -147,45 +194,71 @@ void Classifier::SetMean(const string& mean_file) {
   mean_ = cv::Mat(input_geometry_, mean.type(), channel_mean);
 }
 
-std::vector<float> Classifier::Predict(const cv::Mat& img) {
+std::vector<std::vector<float> > Classifier::Predict(
+    const std::vector<cv::Mat>& imgs) {
+  CHECK_LE(imgs.size(), batch_size_) << "Too many images for one batch.";
   Blob<float>* input_layer = net_->input_blobs()[0];
-  input_layer->Reshape(1, num_channels_,
-                       input_geometry_.height, input_geometry_.width);
-  /* Forward dimension change to all layers. */
-  net_->Reshape();
-
-  std::vector<cv::Mat> input_channels;
-  WrapInputLayer(&input_channels);
+  /* The input layer keeps the memory wrapped by input_channels_, but it has
+   * to be told that the CPU is about to write to it. */
+  CHECK(reinterpret_cast<float*>(input_channels_[0][0].data)
+        == input_layer->mutable_cpu_data())
+    << "Input channels are not wrapping the input layer of the network.";
 
-  Preprocess(img, &input_channels);
+  /* Preprocess the images in parallel, each thread writing straight into
+   * the items of the input layer of its images. Items past the last image
+   * of a partial batch keep stale data; their outputs are ignored. */
+  int num_threads = std::min<int>(num_threads_, imgs.size());
+  if (num_threads <= 1) {
+    PreprocessStrided(&imgs, 0, 1);
+  } else {
+    boost::thread_group threads;
+    for (int i = 0; i < num_threads; ++i)
+      threads.create_thread(boost::bind(&Classifier::PreprocessStrided,
+                                        this, &imgs, i, num_threads));
+    threads.join_all();
+  }
 
   net_->ForwardPrefilled();
 
-  /* Copy the output layer to a std::vector */
+  /* Copy the output layer to a std::vector per image */
   Blob<float>* output_layer = net_->output_blobs()[0];
-  const float* begin = output_layer->cpu_data();
-  const float* end = begin + output_layer->channels();
-  return std::vector<float>(begin, end);
+  std::vector<std::vector<float> > outputs;
+  for (size_t i = 0; i < imgs.size(); ++i) {
+    const float* begin = output_layer->cpu_data() + i * output_layer->count(1);
+    const float* end = begin + output_layer->channels();
+    outputs.push_back(std::vector<float>(begin, end));
+  }
+  return outputs;
 }
 
-/* Wrap the input layer of the network in separate cv::Mat objects
- * (one per channel). This way we save one memcpy operation and we
- * don't need to rely on cudaMemcpy2D. The last preprocessing
+/* Wrap every item of the input layer of the network in separate cv::Mat
+ * objects (one per channel). This way we save one memcpy operation and
+ * we don't need to rely on cudaMemcpy2D. The last preprocessing
  * operation will write the separate channels directly to the input
- * layer. */
-void Classifier::WrapInputLayer(std::vector<cv::Mat>* input_channels) {
+ * layer. Since the batch size is fixed, the input layer is never
+ * reallocated and the wrappers stay valid. */
+void Classifier::WrapInputLayer() {
   Blob<float>* input_layer = net_->input_blobs()[0];
 
   int width = input_layer->width();
   int height = input_layer->height();
   float* input_data = input_layer->mutable_cpu_data();
-  for (int i = 0; i < input_layer->channels(); ++i) {
-    cv::Mat channel(height, width, CV_32FC1, input_data);
-    input_channels->push_back(channel);
-    input_data += width * height;
+  input_channels_.resize(input_layer->num());
+  for (int n = 0; n < input_layer->num(); ++n) {
+    for (int i = 0; i < input_layer->channels(); ++i) {
+      cv::Mat channel(height, width, CV_32FC1, input_data);
+      input_channels_[n].push_back(channel);
+      input_data += width * height;
+    }
   }
 }
 
+void Classifier::PreprocessStrided(const std::vector<cv::Mat>* imgs,
+                                   int begin, int stride) {
+  for (size_t i = begin; i < imgs->size(); i += stride)
+    Preprocess((*imgs)[i], &input_channels_[i]);
+}
+
 void Classifier::Preprocess(const cv::Mat& img,
                             std::vector<cv::Mat>* input_channels) {
   /* Convert the input image to the input image format of the network. */
@@ -220,17 +293,70 @@ void Classifier::Preprocess(const cv::Mat& img,
    * input layer of the network because it is wrapped by the cv::Mat
    * objects in input_channels. */
   cv::split(sample_normalized, *input_channels);
+}
 
-  CHECK(reinterpret_cast<float*>(input_channels->at(0).data)
-        == net_->input_blobs()[0]->cpu_data())
-    << "Input channels are not wrapping the input layer of the network.";
+/* Return the q-quantile of the sorted values v. */
+static double Percentile(const std::vector<double>& v, double q) {
+  size_t i = std::min<size_t>(v.size() - 1, q * v.size());
+  return v[i];
+}
+
+/* Classify every image of a directory batch after batch, and report the
+ * throughput and the latency of a batch. Images are decoded beforehand,
+ * so that only preprocessing and the forward passes are timed. */
+static void MeasureThroughput(Classifier* classifier, const string& dir) {
+  std::vector<cv::Mat> imgs;
+  boost::filesystem::directory_iterator end;
+  for (boost::filesystem::directory_iterator it(dir); it != end; ++it) {
+    if (!boost::filesystem::is_regular_file(it->status()))
+      continue;
+    cv::Mat img = cv::imread(it->path().string(), -1);
+    if (img.empty()) {
+      LOG(WARNING) << "Skipping " << it->path().string();
+      continue;
+    }
+    imgs.push_back(img);
+  }
+  CHECK(!imgs.empty()) << "No images found in " << dir;
+
+  /* Warm up: the first pass allocates memory and initializes libraries. */
+  size_t batch_size = classifier->batch_size();
+  classifier->Classify(std::vector<cv::Mat>(imgs.begin(),
+      imgs.begin() + std::min(batch_size, imgs.size())));
+
+  std::vector<double> latencies;
+  CPUTimer total_timer;
+  total_timer.Start();
+  for (size_t begin = 0; begin < imgs.size(); begin += batch_size) {
+    std::vector<cv::Mat> batch(imgs.begin() + begin,
+        imgs.begin() + std::min(begin + batch_size, imgs.size()));
+    CPUTimer timer;
+    timer.Start();
+    classifier->Classify(batch);
+    latencies.push_back(timer.MicroSeconds() / 1e3);
+  }
+  double seconds = total_timer.MicroSeconds() / 1e6;
+  std::sort(latencies.begin(), latencies.end());
+
+  std::cout << "---------- Throughput for " << imgs.size() << " images in "
+            << dir << " ----------" << std::endl;
+  std::cout << std::fixed << std::setprecision(2)
+            << imgs.size() / seconds << " images/s, batch size "
+            << batch_size << std::endl;
+  std::cout << "Batch latency: p50 " << Percentile(latencies, 0.5)
+            << " ms, p90 " << Percentile(latencies, 0.9)
+            << " ms, p99 " << Percentile(latencies, 0.99)
+            << " ms, max " << latencies.back() << " ms" << std::endl;
 }
 
 int main(int argc, char** argv) {
-  if (argc != 6) {
+  if (argc != 6 && argc != 7) {
     std::cerr << "Usage: " << argv[0]
               << " deploy.prototxt network.caffemodel"
-              << " mean.binaryproto labels.txt img.jpg" << std::endl;
+              << " mean.binaryproto labels.txt img.jpg|img_dir [batch_size]"
+              << std::endl
+              << "Given a directory, classify all of its images and report"
+              << " the throughput." << std::endl;
     return 1;
   }
 
@@ -240,9 +366,15 @@ int main(int argc, char** argv) {
   string trained_file = argv[2];
   string mean_file    = argv[3];
   string label_file   = argv[4];
-  Classifier classifier(model_file, trained_file, mean_file, label_file);
+  int batch_size      = argc == 7 ? atoi(argv[6]) : 1;
+  Classifier classifier(model_file, trained_file, mean_file, label_file,
+                        batch_size);
 
   string file = argv[5];
+  if (boost::filesystem::is_directory(file)) {
+    MeasureThroughput(&classifier, file);
+    return 0;
+  }
 
   std::cout << "---------- Prediction for "
             << file << " ----------" << std::endl;
@@ -89,6 +89,8 @@ using std::string;
 using std::stringstream;
 using std::vector;
 
+class ThreadPool;
+
 // A global initialization function that you should call in your main function.
 // Currently it initializes google flags and google logging.
 void GlobalInit(int* pargc, char*** pargv);
@@ -154,6 +156,56 @@ class Caffe {
   inline static void set_solver_count(int val) { Get().solver_count_ = val; }
   inline static bool root_solver() { return Get().root_solver_; }
   inline static void set_root_solver(bool val) { Get().root_solver_ = val; }
+  // Layer engine autotuning: when set, Net::Init times every compiled engine
+  // of layers left at engine DEFAULT and keeps the fastest (see
+  // util/autotune.hpp). Decisions persist in the autotune cache file if one
+  // is given.
+  inline static bool autotune() { return Get().autotune_; }
+  inline static void set_autotune(bool val) { Get().autotune_ = val; }
+  inline static const string& autotune_cache() {
+    return Get().autotune_cache_;
+  }
+  inline static void set_autotune_cache(const string& filename) {
+    Get().autotune_cache_ = filename;
+  }
+  // Memory for speed in training convolutions on the CPU: the bytes each
+  // convolution layer may spend keeping the im2col columns of its forward
+  // pass for the weight gradient, instead of unrolling the images again.
+  // 0, the default, keeps none. Read when layers are reshaped.
+  inline static size_t im2col_cache_bytes() {
+    return Get().im2col_cache_bytes_;
+  }
+  inline static void set_im2col_cache_bytes(size_t bytes) {
+    Get().im2col_cache_bytes_ = bytes;
+  }
+  // The bytes a convolution layer may spend unrolling several images into
+  // one wide matrix on the CPU, so each GEMM spans as many images as fit
+  // rather than one. 0, the default, multiplies one image at a time. Read
+  // when layers are reshaped.
+  inline static size_t conv_batch_bytes() {
+    return Get().conv_batch_bytes_;
+  }
+  inline static void set_conv_batch_bytes(size_t bytes) {
+    Get().conv_batch_bytes_ = bytes;
+  }
+  // Whether nets built in CPU mode replace chains of element-wise neuron
+  // layers by one FusedNeuron layer each (see util/fuse_neurons.hpp), so a
+  // chain sweeps its blobs once rather than once per layer. Off by default.
+  // Read when nets are initialized.
+  inline static bool fuse_neurons() { return Get().fuse_neurons_; }
+  inline static void set_fuse_neurons(bool val) { Get().fuse_neurons_ = val; }
+  // Intra-op parallelism. Unlike the settings above these are shared by every
+  // thread of the process: the threads of the pool parallel_for() splits
+  // loops between (0, the default, for one per core), the cores they are
+  // pinned to (none by default), and the pool itself, started on first use.
+  // Setting the number of threads also sets the threads BLAS uses outside
+  // parallel loops (see util/thread_pool.hpp). Changing either rebuilds the
+  // pool, which must not be running a loop.
+  static int num_threads();
+  static void set_num_threads(int num_threads);
+  static vector<int> thread_affinity();
+  static void set_thread_affinity(const vector<int>& cpus);
+  static ThreadPool& thread_pool();
 
  protected:
 #ifndef CPU_ONLY
@@ -165,6 +217,11 @@ class Caffe {
   Brew mode_;
   int solver_count_;
   bool root_solver_;
+  bool autotune_;
+  string autotune_cache_;
+  size_t im2col_cache_bytes_;
+  size_t conv_batch_bytes_;
+  bool fuse_neurons_;
 
  private:
   // The private constructor to avoid duplicate instantiation.
@@ -69,7 +69,8 @@ class DataTransformer {
    * transform_param block to a cv::Mat
    *
    * @param cv_img
-   *    cv::Mat containing the data to be transformed.
+   *    cv::Mat containing the data to be transformed, of unsigned bytes or
+   *    floats.
    * @param transformed_blob
    *    This is destination blob. It can be part of top blob's data if
    *    set_cpu_data() is used. See image_data_layer.cpp for an example.
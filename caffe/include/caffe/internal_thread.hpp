@@ -33,6 +33,9 @@ class InternalThread {
 
   bool is_started() const;
 
+  /** The internal threads of the process started and not yet stopped. */
+  static int num_started();
+
  protected:
   /* Implement this method in your subclass
       with the code you want your thread to run. */
@@ -42,8 +45,22 @@ class InternalThread {
   bool must_stop();
 
  private:
-  void entry(int device, Caffe::Brew mode, int rand_seed, int solver_count,
-      bool root_solver);
+  // The per-thread Caffe settings the thread inherits from its starter;
+  // more than boost::thread passes as separate arguments.
+  struct Settings {
+    int device;
+    Caffe::Brew mode;
+    int rand_seed;
+    int solver_count;
+    bool root_solver;
+    size_t im2col_cache_bytes;
+    size_t conv_batch_bytes;
+    bool fuse_neurons;
+    bool autotune;
+    string autotune_cache;
+  };
+
+  void entry(const Settings& settings);
 
   shared_ptr<boost::thread> thread_;
 };
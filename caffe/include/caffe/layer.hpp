@@ -19,6 +19,8 @@ namespace boost { class mutex; }
 
 namespace caffe {
 
+template <typename Dtype> class NetPlan;
+
 /**
  * @brief An interface for the units of computation which can be composed into a
  *        Net.
@@ -441,6 +443,9 @@ class Layer {
   /** Unlock forward_mutex_ if this layer is shared */
   void Unlock();
 
+  /** NetPlan calls Forward_cpu and Forward_gpu directly. */
+  friend class NetPlan<Dtype>;
+
   DISABLE_COPY_AND_ASSIGN(Layer);
 };  // class Layer
 
@@ -30,16 +30,28 @@ class BaseConvolutionLayer : public Layer<Dtype> {
 
  protected:
   // Helper functions that abstract away the column buffer and gemm arguments.
-  // The last argument in forward_cpu_gemm is so that we can skip the im2col if
-  // we just called weight_cpu_gemm with the same input.
+  // The skip_im2col argument in forward_cpu_gemm is so that we can skip the
+  // im2col if we just called weight_cpu_gemm with the same input.
+  // cache_index numbers the image among those of the pass: forward_cpu_gemm
+  // keeps its columns in the column cache if it has room for them, and
+  // weight_cpu_gemm reads them back once columns_cached_ is set.
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
-      Dtype* output, bool skip_im2col = false);
+      Dtype* output, bool skip_im2col = false, int cache_index = -1);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
-      weights);
+      weights, int cache_index = -1);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  // The same for num_images consecutive images at once, in one GEMM over
+  // their columns side by side; at most batch_images_ of them.
+  void forward_cpu_gemm_batch(const Dtype* input, const Dtype* weights,
+      Dtype* output, int num_images, bool skip_im2col = false,
+      int cache_index = -1);
+  void backward_cpu_gemm_batch(const Dtype* output, const Dtype* weights,
+      Dtype* input, int num_images);
+  void weight_cpu_gemm_batch(const Dtype* input, const Dtype* output,
+      Dtype* weights, int num_images, int cache_index = -1);
 
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -90,16 +102,33 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief Whether the column cache holds the columns of the current bottom.
+  bool columns_cached_;
+  /// @brief The images the *_cpu_gemm_batch functions may take at once.
+  int batch_images_;
 
  private:
+  // The columns of an image, from the column cache or unrolled into the
+  // column buffer; the forward pass fills the cache, the backward pass reads
+  // it if columns_cached_.
+  const Dtype* cpu_columns(const Dtype* input, int cache_index, bool forward);
+
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
   inline void conv_im2col_cpu(const Dtype* data, Dtype* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
-      im2col_cpu(data, conv_in_channels_,
+      im2col_cpu_func_(data, conv_in_channels_,
           conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
           kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
           pad_.cpu_data()[0], pad_.cpu_data()[1],
           stride_.cpu_data()[0], stride_.cpu_data()[1], col_buff);
+    } else if (!force_nd_im2col_ && num_spatial_axes_ == 3) {
+      const int* shape = conv_input_shape_.cpu_data();
+      const int* kernel = kernel_shape_.cpu_data();
+      const int* pad = pad_.cpu_data();
+      const int* stride = stride_.cpu_data();
+      im2col_3d_cpu(data, conv_in_channels_, shape[1], shape[2], shape[3],
+          kernel[0], kernel[1], kernel[2], pad[0], pad[1], pad[2],
+          stride[0], stride[1], stride[2], col_buff);
     } else {
       im2col_nd_cpu(data, num_spatial_axes_, conv_input_shape_.cpu_data(),
           col_buffer_shape_.data(), kernel_shape_.cpu_data(),
@@ -108,11 +137,19 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   }
   inline void conv_col2im_cpu(const Dtype* col_buff, Dtype* data) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
-      col2im_cpu(col_buff, conv_in_channels_,
+      col2im_cpu_func_(col_buff, conv_in_channels_,
           conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
           kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
           pad_.cpu_data()[0], pad_.cpu_data()[1],
           stride_.cpu_data()[0], stride_.cpu_data()[1], data);
+    } else if (!force_nd_im2col_ && num_spatial_axes_ == 3) {
+      const int* shape = conv_input_shape_.cpu_data();
+      const int* kernel = kernel_shape_.cpu_data();
+      const int* pad = pad_.cpu_data();
+      const int* stride = stride_.cpu_data();
+      col2im_3d_cpu(col_buff, conv_in_channels_, shape[1], shape[2], shape[3],
+          kernel[0], kernel[1], kernel[2], pad[0], pad[1], pad[2],
+          stride[0], stride[1], stride[2], data);
     } else {
       col2im_nd_cpu(col_buff, num_spatial_axes_, conv_input_shape_.cpu_data(),
           col_buffer_shape_.data(), kernel_shape_.cpu_data(),
@@ -152,6 +189,9 @@ class BaseConvolutionLayer : public Layer<Dtype> {
 
   int num_kernels_im2col_;
   int num_kernels_col2im_;
+  // im2col_cpu and col2im_cpu, or their versions for the layer's geometry.
+  typename Im2colCpuFunc<Dtype>::type im2col_cpu_func_;
+  typename Im2colCpuFunc<Dtype>::type col2im_cpu_func_;
   int conv_out_channels_;
   int conv_in_channels_;
   int conv_out_spatial_dim_;
@@ -161,6 +201,13 @@ class BaseConvolutionLayer : public Layer<Dtype> {
 
   Blob<Dtype> col_buffer_;
   Blob<Dtype> bias_multiplier_;
+  // The columns of the first num_cached_columns_ images of a training
+  // forward pass, within Caffe::im2col_cache_bytes().
+  Blob<Dtype> col_cache_;
+  int num_cached_columns_;
+  // The columns and outputs of batch_images_ images side by side.
+  Blob<Dtype> batch_col_buffer_;
+  Blob<Dtype> batch_output_buffer_;
 };
 
 }  // namespace caffe
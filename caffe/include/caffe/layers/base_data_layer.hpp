@@ -8,7 +8,7 @@
 #include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
-#include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/ring_queue.hpp"
 
 namespace caffe {
 
@@ -70,15 +70,21 @@ class BasePrefetchingDataLayer :
   // Prefetches batches (asynchronously if to GPU memory)
   static const int PREFETCH_COUNT = 3;
 
+  // Total time Forward spent waiting for the prefetch thread, in microseconds.
+  inline double prefetch_wait_us() const { return prefetch_wait_us_; }
+
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
+  // Pops the next full batch, timing the wait only when none is ready.
+  Batch<Dtype>* PopFullBatch();
 
   Batch<Dtype> prefetch_[PREFETCH_COUNT];
-  BlockingQueue<Batch<Dtype>*> prefetch_free_;
-  BlockingQueue<Batch<Dtype>*> prefetch_full_;
+  RingQueue<Batch<Dtype>*> prefetch_free_;
+  RingQueue<Batch<Dtype>*> prefetch_full_;
 
   Blob<Dtype> transformed_data_;
+  double prefetch_wait_us_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,93 @@
+#ifndef CAFFE_FUSED_NEURON_LAYER_HPP_
+#define CAFFE_FUSED_NEURON_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/neuron_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A chain of element-wise neuron layers (AbsVal, BNLL, Exp, Log,
+ *        Power, ReLU, Sigmoid, TanH and Threshold) computed as one: the
+ *        forward pass applies the composed function, and the backward pass
+ *        the product of the chained derivatives, in a single sweep over the
+ *        blobs.
+ *
+ * The net creates these for the chains found by FuseNeurons() (see
+ * util/fuse_neurons.hpp) when Caffe::fuse_neurons() is set. The sweep goes
+ * through blocks small enough for the cache, so each layer of the chain
+ * still runs its own tight loop over a block. In training the forward pass
+ * also keeps the product of the derivatives, the one blob the chain stores
+ * in place of its intermediate tops, and the backward pass only multiplies
+ * it in. Otherwise the backward pass recomputes the chain from the input,
+ * of which a chain computing in place keeps a copy.
+ */
+template <typename Dtype>
+class FusedNeuronLayer : public NeuronLayer<Dtype> {
+ public:
+  /**
+   * @param param the fused layer, with the bottom of the first layer of the
+   *     chain and the top of the last.
+   * @param chain the layers fused, in order.
+   */
+  FusedNeuronLayer(const LayerParameter& param,
+      const vector<LayerParameter>& chain)
+      : NeuronLayer<Dtype>(param), chain_(chain) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "FusedNeuron"; }
+
+  // Whether layers of this type may be part of a fused chain.
+  static bool CanFuse(const string& type);
+
+  /// @brief The layers fused, which Net::ToProto() saves in its place, as
+  ///        no layer of this type can be created from a LayerParameter.
+  const vector<LayerParameter>& chain() const { return chain_; }
+
+  // One layer of the chain, as a function of one element.
+  struct Op {
+    enum Kind { ABSVAL, BNLL, EXP, LOG, POWER, RELU, SIGMOID, TANH, THRESHOLD };
+    explicit Op(const LayerParameter& param);
+    // y = f(x) over n elements; y may be x.
+    void Forward(const int n, const Dtype* x, Dtype* y) const;
+    // d *= f'(x), given y = f(x).
+    void Derivative(const int n, const Dtype* x, const Dtype* y,
+        Dtype* d) const;
+
+    Kind kind;
+    // The parameters of the kinds that take any:
+    //   Exp:       y = shift * exp(scale * x)
+    //   Log:       y = power * log(scale * x + shift)
+    //   Power:     y = (scale * x + shift)^power
+    //   ReLU:      y = max(x, 0) + scale * min(x, 0)
+    //   Threshold: y = x > shift ? 1 : 0
+    Dtype scale, shift, power;
+  };
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  vector<LayerParameter> chain_;
+  vector<Op> ops_;
+  /// @brief Whether the chain has a derivative (has no Threshold layer).
+  bool differentiable_;
+  /// @brief The derivative of the chain at the input, kept in training.
+  Blob<Dtype> derivative_;
+  /// @brief A copy of the input, kept otherwise when computing in place.
+  Blob<Dtype> input_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_FUSED_NEURON_LAYER_HPP_
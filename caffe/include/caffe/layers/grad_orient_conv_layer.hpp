@@ -236,7 +236,6 @@ class GradOrientConvolutionLayer : public Layer<Dtype> {
   int output_offset_;
 
   Blob<Dtype> col_buffer_;
-  Blob<Dtype> bias_multiplier_;
 };
 
 }  // namespace caffe
@@ -102,7 +102,18 @@ class InfogainLossLayer : public LossLayer<Dtype> {
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  /// @brief Returns the loss and, if gradient is given, writes the gradient
+  ///        for a loss weight of 1 there.
+  Dtype ComputeLoss(const vector<Blob<Dtype>*>& bottom, Dtype* gradient);
+
   Blob<Dtype> infogain_;
+  /// The nonzero entries of infogain_ when most of it is zero, by row: row r
+  /// holds sparse_values_[k] in column sparse_columns_[k] for k in
+  /// [sparse_rows_[r], sparse_rows_[r + 1]). Empty otherwise, and for a
+  /// matrix given as bottom[2].
+  vector<int> sparse_rows_;
+  vector<int> sparse_columns_;
+  vector<Dtype> sparse_values_;
 };
 
 }  // namespace caffe
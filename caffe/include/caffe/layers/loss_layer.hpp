@@ -23,7 +23,7 @@ template <typename Dtype>
 class LossLayer : public Layer<Dtype> {
  public:
   explicit LossLayer(const LayerParameter& param)
-     : Layer<Dtype>(param) {}
+     : Layer<Dtype>(param), gradient_in_diff_(false) {}
   virtual void LayerSetUp(
       const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
   virtual void Reshape(
@@ -46,6 +46,23 @@ class LossLayer : public Layer<Dtype> {
   virtual inline bool AllowForceBackward(const int bottom_index) const {
     return bottom_index != 1;
   }
+
+ protected:
+  /**
+   * @brief Whether Forward_cpu should compute the gradient w.r.t. bottom[0]
+   *        along with the loss, as some layers do in the same sweep over
+   *        their inputs: in training, on the CPU.
+   *
+   * The gradient, for a loss weight of 1, goes in the diff of bottom[0],
+   * which nothing else writes before Backward_cpu; Backward_cpu then only
+   * scales it by top[0]->cpu_diff()[0] if gradient_in_diff_ is set, and
+   * computes it otherwise.
+   */
+  inline bool gradient_in_forward() const {
+    return this->phase_ == TRAIN && Caffe::mode() == Caffe::CPU;
+  }
+  /// Whether the diff of bottom[0] holds the gradient of the last forward.
+  bool gradient_in_diff_;
 };
 
 }  // namespace caffe
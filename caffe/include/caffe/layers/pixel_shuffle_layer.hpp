@@ -0,0 +1,76 @@
+#ifndef CAFFE_PIXEL_SHUFFLE_LAYER_HPP_
+#define CAFFE_PIXEL_SHUFFLE_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Rearranges channels into space, for sub-pixel upsampling:
+ *        @f$ N \times C r_h r_w \times H \times W @f$ inputs become
+ *        @f$ N \times C \times H r_h \times W r_w @f$ outputs, where
+ *        output pixel @f$ (h r_h + i, w r_w + j) @f$ of channel @f$ c @f$ is
+ *        input pixel @f$ (h, w) @f$ of channel @f$ (c r_h + i) r_w + j @f$.
+ *
+ * A convolution to @f$ C r_h r_w @f$ channels followed by this layer
+ * upsamples like a Deconvolution of stride @f$ r @f$, with a permutation in
+ * place of col2im. The factors @f$ r_h, r_w @f$ are given by the stride (or
+ * stride_h and stride_w) of the convolution_param. Forward and backward are
+ * both copies.
+ */
+template <typename Dtype>
+class PixelShuffleLayer : public Layer<Dtype> {
+ public:
+  explicit PixelShuffleLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "PixelShuffle"; }
+  virtual inline int ExactNumBottomBlobs() const { return 1; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // space_to_depth should return true iff this is the inverse layer, so the
+  // copies know which blob holds the channels.
+  virtual bool space_to_depth() const { return false; }
+
+  // Copies from the blob shaped like depth, the one with the channels, to
+  // the one with the pixels if to_space, or back.
+  void Shuffle(const Blob<Dtype>& depth, bool to_space, const Dtype* from,
+      Dtype* to);
+
+  int factor_h_, factor_w_;
+};
+
+/**
+ * @brief The inverse of PixelShuffleLayer, space to depth:
+ *        @f$ N \times C \times H r_h \times W r_w @f$ inputs become
+ *        @f$ N \times C r_h r_w \times H \times W @f$ outputs.
+ */
+template <typename Dtype>
+class PixelUnshuffleLayer : public PixelShuffleLayer<Dtype> {
+ public:
+  explicit PixelUnshuffleLayer(const LayerParameter& param)
+      : PixelShuffleLayer<Dtype>(param) {}
+
+  virtual inline const char* type() const { return "PixelUnshuffle"; }
+
+ protected:
+  virtual bool space_to_depth() const { return true; }
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_PIXEL_SHUFFLE_LAYER_HPP_
@@ -51,6 +51,15 @@ class PoolingLayer : public Layer<Dtype> {
   int height_, width_;
   int pooled_height_, pooled_width_;
   bool global_pooling_;
+  // Max and average pooling of one channel, compiled for the geometry of
+  // the layer, or NULL where no such version exists.
+  typedef void (*MaxPoolFunc)(const Dtype* bottom_data, int height,
+      int width, int pooled_height, int pooled_width, Dtype* top_data,
+      int* mask);
+  typedef void (*AvePoolFunc)(const Dtype* bottom_data, int height,
+      int width, int pooled_height, int pooled_width, Dtype* top_data);
+  MaxPoolFunc max_pool_func_;
+  AvePoolFunc ave_pool_func_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
 };
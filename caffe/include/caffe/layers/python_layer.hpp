@@ -10,6 +10,21 @@ namespace bp = boost::python;
 
 namespace caffe {
 
+/**
+ * @brief Holds the GIL while in scope. pycaffe releases the GIL around
+ *        forward, backward and solver calls, so Python layers take it back.
+ */
+class PythonGILLock {
+ public:
+  PythonGILLock() : state_(PyGILState_Ensure()) {}
+  ~PythonGILLock() { PyGILState_Release(state_); }
+
+ private:
+  PyGILState_STATE state_;
+
+  DISABLE_COPY_AND_ASSIGN(PythonGILLock);
+};
+
 template <typename Dtype>
 class PythonLayer : public Layer<Dtype> {
  public:
@@ -24,12 +39,14 @@ class PythonLayer : public Layer<Dtype> {
         && !ShareInParallel()) {
       LOG(FATAL) << "PythonLayer is not implemented in Multi-GPU training";
     }
+    PythonGILLock lock;
     self_.attr("param_str") = bp::str(
         this->layer_param_.python_param().param_str());
     self_.attr("setup")(bottom, top);
   }
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    PythonGILLock lock;
     self_.attr("reshape")(bottom, top);
   }
 
@@ -42,10 +59,12 @@ class PythonLayer : public Layer<Dtype> {
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    PythonGILLock lock;
     self_.attr("forward")(bottom, top);
   }
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    PythonGILLock lock;
     self_.attr("backward")(top, propagate_down, bottom);
   }
 
@@ -9,6 +9,12 @@
 
 namespace caffe {
 
+// The layers SPPLayer is built from; spp_layer.cpp includes them.
+template <typename Dtype> class ConcatLayer;
+template <typename Dtype> class FlattenLayer;
+template <typename Dtype> class PoolingLayer;
+template <typename Dtype> class SplitLayer;
+
 /**
  * @brief Does spatial pyramid pooling on the input image
  *        by taking the max, average, etc. within regions
@@ -29,6 +35,22 @@ class SPPLayer : public Layer<Dtype> {
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
+  /**
+   * @brief Pools windows of a feature map as an SPP layer with the given
+   *        parameters pools a feature map of each window alone, so that
+   *        the windows of an image share its convolutional features, as in
+   *        SPP-net.
+   *
+   * @param features a 1 x C x H x W feature map.
+   * @param windows (y1, x1, y2, x2), inclusive, in feature map pixels, for
+   *        each window; a window is widened where it has fewer pixels than
+   *        the finest level of the pyramid has bins.
+   * @param top reshaped to the SPP output with one item per window.
+   */
+  static void PoolWindows(const LayerParameter& param,
+      const Blob<Dtype>& features, const vector<int>& windows,
+      Blob<Dtype>* top);
+
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
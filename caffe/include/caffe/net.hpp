@@ -11,6 +11,10 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/ring_queue.hpp"
+#include "caffe/util/weight_compression.hpp"
+
+namespace boost { class thread_group; }
 
 namespace caffe {
 
@@ -108,16 +112,35 @@ class Net {
   // trained layers from another net parameter instance.
   /**
    * @brief For an already initialized net, copies the pre-trained layers from
-   *        another Net.
+   *        another Net. The layers are copied in parallel.
    */
   void CopyTrainedLayersFrom(const NetParameter& param);
   void CopyTrainedLayersFrom(const string trained_filename);
+  /**
+   * @brief Copies the pre-trained layers of a binary proto file, each while
+   *        the following ones are still being read.
+   */
   void CopyTrainedLayersFromBinaryProto(const string trained_filename);
   void CopyTrainedLayersFromHDF5(const string trained_filename);
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
   /// @brief Writes the net to an HDF5 file.
   void ToHDF5(const string& filename, bool write_diff = false) const;
+  /**
+   * @brief Writes the weights to an HDF5 file for deployment, with the params
+   *        of each layer named in encodings compressed by its encoding and
+   *        all others as floats. Blobs smaller than a codebook are kept as
+   *        floats. CopyTrainedLayersFromHDF5() decodes the file.
+   */
+  void ToCompressedHDF5(const string& filename,
+      const map<string, WeightEncoding>& encodings) const;
+  /**
+   * @brief Writes the weights to an HDF5 file as above, with the params
+   *        already encoded given by their index in params() and all others
+   *        as floats.
+   */
+  void ToCompressedHDF5(const string& filename,
+      const map<int, EncodedWeights>& encoded) const;
 
   /// @brief returns the network name.
   inline const string& name() const { return name_; }
@@ -226,6 +249,29 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /**
+   * @brief Starts threads that copy the source layers pushed to queue, until
+   *        they pop NULL, and returns their number.
+   */
+  int StartCopyingLayers(RingQueue<const LayerParameter*>* queue,
+      boost::thread_group* workers);
+  /**
+   * @brief Stops the workers once they have copied every layer of param, and
+   *        copies the params the target layers share from other layers.
+   */
+  void FinishCopyingLayers(const NetParameter& param, int num_workers,
+      RingQueue<const LayerParameter*>* queue,
+      boost::thread_group* workers);
+  /// @brief Copies the layers popped from queue on a worker thread.
+  void CopyLayersFromQueue(RingQueue<const LayerParameter*>* queue,
+      Caffe::Brew mode, int device);
+  /**
+   * @brief Copies the params of source_layer into the target layer of the same
+   *        name: those the target owns, or else those it shares from another
+   *        layer. Shared params are copied after all owners, on one thread.
+   */
+  void CopyTrainedLayer(const LayerParameter& source_layer, bool shared);
+
   /// @brief Helper for displaying debug info in Forward about input Blobs.
   void InputDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Forward.
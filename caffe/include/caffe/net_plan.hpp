@@ -0,0 +1,162 @@
+#ifndef CAFFE_NET_PLAN_HPP_
+#define CAFFE_NET_PLAN_HPP_
+
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A frozen inference plan compiled from a TEST phase Net, for
+ *        serving fixed-shape inputs with as little per-call work as possible.
+ *
+ * Building the plan
+ *   - drops layers that do no work at inference: Silence, Split, Flatten,
+ *     Reshape and Dropout, whose tops alias their bottoms instead;
+ *   - folds a BatchNorm using global statistics into the Convolution or
+ *     InnerProduct that feeds it;
+ *   - sets up and reshapes every layer once and runs a warm-up pass, so that
+ *     all internal buffers are allocated before the first Run();
+ *   - places all activations into a single arena, reusing the memory of
+ *     blobs whose lifetimes do not overlap.
+ *
+ * Run() then calls the layers' Forward_cpu / Forward_gpu directly as a flat
+ * list of steps, skipping the reshaping, locking, loss and debug handling of
+ * Net::Forward. The plan shares the weights of the Net it was built from,
+ * except for fused layers, which own a folded copy; it does not see later
+ * changes to the Net's shapes or to the weights of fused layers.
+ */
+template <typename Dtype>
+class NetPlan {
+ public:
+  explicit NetPlan(const Net<Dtype>& net);
+
+  /**
+   * @brief Copies the inputs in, runs the plan and copies the outputs out.
+   *
+   * inputs and outputs are host pointers in the order of the Net's
+   * input_blobs() and output_blobs(), with the shapes of input_blobs() and
+   * output_blobs() below.
+   */
+  void Run(const vector<const Dtype*>& inputs, const vector<Dtype*>& outputs);
+
+  inline const vector<Blob<Dtype>*>& input_blobs() const {
+    return input_blobs_;
+  }
+  inline const vector<Blob<Dtype>*>& output_blobs() const {
+    return output_blobs_;
+  }
+  /// @brief The number of layers executed per Run().
+  inline int num_steps() const { return steps_.size(); }
+  /// @brief The size of the activation arena.
+  inline size_t arena_bytes() const { return arena_bytes_; }
+  /**
+   * @brief Places the activations in arena, of at least arena_bytes(),
+   *        instead of the plan's own. Plans bound to one arena may not be
+   *        run in parallel, and only the last one bound keeps its values.
+   */
+  void BindArena(const shared_ptr<SyncedMemory>& arena);
+
+ protected:
+  struct Step {
+    Layer<Dtype>* layer;
+    vector<Blob<Dtype>*> bottom;
+    vector<Blob<Dtype>*> top;
+  };
+
+  /// @brief Returns the BatchNorm layer that can be folded into layer_id,
+  ///        or -1.
+  int FusableBatchNorm(const Net<Dtype>& net, int layer_id) const;
+  /// @brief Creates a copy of a Convolution or InnerProduct layer with the
+  ///        BatchNorm layer bn_id folded into its weights and bias.
+  shared_ptr<Layer<Dtype> > FoldBatchNorm(const Net<Dtype>& net,
+      int layer_id, int bn_id) const;
+  /// @brief Assigns the activations to offsets in a single arena and binds
+  ///        them to an arena of their own.
+  void PlanArena();
+  void Forward();
+
+  vector<shared_ptr<Layer<Dtype> > > layers_;
+  vector<shared_ptr<Blob<Dtype> > > blobs_;
+  vector<Step> steps_;
+  vector<Blob<Dtype>*> input_blobs_;
+  vector<Blob<Dtype>*> output_blobs_;
+  shared_ptr<SyncedMemory> arena_;
+  size_t arena_bytes_;
+  // The memory of the activations and its offset in the arena.
+  vector<SyncedMemory*> memories_;
+  vector<size_t> offsets_;
+
+  DISABLE_COPY_AND_ASSIGN(NetPlan);
+};
+
+/**
+ * @brief Keeps a NetPlan per distinct tuple of input shapes, for serving
+ *        inputs of a few recurring shapes.
+ *
+ * The Net's own layers keep the dims of their last Reshape(), so switching
+ * a Net between shapes redoes every layer's reshape and may reallocate its
+ * buffers. A NetPlan holds layers that are set up and buffers that are
+ * allocated for one shape, so switching between cached plans only rebinds
+ * the activations of the plan to the arena, which all plans share and which
+ * grows to the largest of them. Beyond capacity plans, the least recently
+ * used one is dropped.
+ */
+template <typename Dtype>
+class NetPlanCache {
+ public:
+  /**
+   * @param net the TEST phase net the plans are built from; its inputs are
+   *        reshaped to build each new plan.
+   * @param capacity the number of plans kept.
+   */
+  NetPlanCache(Net<Dtype>* net, int capacity);
+
+  /**
+   * @brief Returns the plan for inputs of the given shapes, in the order of
+   *        the Net's input_blobs(), building it the first time. The plans
+   *        share one arena: only the plan last returned may be run.
+   */
+  NetPlan<Dtype>* Get(const vector<vector<int> >& input_shapes);
+
+  inline int size() const { return plans_.size(); }
+  inline int capacity() const { return capacity_; }
+  /// @brief The number of Get() calls that found a cached plan.
+  inline int hits() const { return hits_; }
+  /// @brief The number of Get() calls that built a plan.
+  inline int misses() const { return misses_; }
+  /// @brief The size of the arena shared by the plans.
+  inline size_t arena_bytes() const { return arena_ ? arena_->size() : 0; }
+
+ protected:
+  typedef vector<vector<int> > Shapes;
+  typedef std::list<Shapes> UseList;
+  // A plan and its entry in uses_.
+  typedef std::pair<shared_ptr<NetPlan<Dtype> >, typename UseList::iterator>
+      Entry;
+
+  Net<Dtype>* net_;
+  int capacity_;
+  std::map<Shapes, Entry> plans_;
+  // The shapes of the plans, the most recently used first.
+  UseList uses_;
+  shared_ptr<SyncedMemory> arena_;
+  // The plan whose activations are bound to arena_, if any.
+  NetPlan<Dtype>* bound_;
+  int hits_;
+  int misses_;
+
+  DISABLE_COPY_AND_ASSIGN(NetPlanCache);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_NET_PLAN_HPP_
@@ -25,7 +25,7 @@ class SGDSolver : public Solver<Dtype> {
 
  protected:
   void PreSolve();
-  Dtype GetLearningRate();
+  virtual Dtype GetLearningRate();
   virtual void ApplyUpdate();
   virtual void Normalize(int param_id);
   virtual void Regularize(int param_id);
@@ -6,6 +6,7 @@
 
 #include "caffe/net.hpp"
 #include "caffe/solver_factory.hpp"
+#include "caffe/util/solver_metrics.hpp"
 
 namespace caffe {
 
@@ -52,6 +53,10 @@ class Solver {
   // exit training early).
   void SetActionFunction(ActionCallback func);
   SolverAction::Enum GetRequestedAction();
+  // Client of the Solver optionally may call this to have throughput, timing
+  // and memory metrics written to filename in the Prometheus text format
+  // every interval iterations (see util/solver_metrics.hpp).
+  void SetMetricsFile(const string& filename, int interval);
   // The main entry of the solver function. In default, iter will be zero. Pass
   // in a non-zero iter number to resume training for a pre-trained net.
   virtual void Solve(const char* resume_file = NULL);
@@ -107,6 +112,9 @@ class Solver {
   virtual void RestoreSolverStateFromHDF5(const string& state_file) = 0;
   virtual void RestoreSolverStateFromBinaryProto(const string& state_file) = 0;
   void DisplayOutputBlobs(const int net_id);
+  void WriteMetrics(Dtype smoothed_loss);
+  // The learning rate of the current iteration, for reporting.
+  virtual Dtype GetLearningRate() { return Dtype(0); }
 
   SolverParameter param_;
   int iter_;
@@ -126,6 +134,9 @@ class Solver {
   // True iff a request to stop early was received.
   bool requested_early_exit_;
 
+  // Set by SetMetricsFile; NULL if no metrics are exported.
+  shared_ptr<SolverMetrics> metrics_;
+
   DISABLE_COPY_AND_ASSIGN(Solver);
 };
 
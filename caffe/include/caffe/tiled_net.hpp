@@ -0,0 +1,114 @@
+#ifndef CAFFE_TILED_NET_HPP_
+#define CAFFE_TILED_NET_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief How the pixels of a blob map to the pixels of the input of a net,
+ *        along one spatial axis: pixel j of the blob depends on no input
+ *        pixels outside [offset + j * step, offset + j * step + extent).
+ */
+struct ReceptiveField {
+  ReceptiveField() : step(1), offset(0), extent(1) {}
+  double step;
+  double offset;
+  double extent;
+};
+
+/**
+ * @brief Runs a fully convolutional TEST phase net over inputs of any size
+ *        with bounded memory, by splitting them into overlapping tiles.
+ *
+ * The receptive field and stride of the output are computed from the
+ * parameters of the Convolution, Deconvolution, Pooling and LRN layers;
+ * every other layer must keep the spatial size of its bottoms and is taken
+ * to be pointwise. Tiles start on multiples of the largest stride in the
+ * net and overlap by enough of the receptive field that every output pixel
+ * is computed from the same input pixels as in a single pass over the
+ * whole input. Each output pixel is taken from exactly one tile, so the
+ * stitched output has no seams and equals that of the whole input.
+ *
+ * The tiles are run by num_workers nets of a fixed tile shape, each on
+ * its own thread, which share the weights of the given net. Only the tiles
+ * at the right and bottom edges of an input are smaller, so the nets are
+ * reshaped at most a few times per input and never grow.
+ */
+template <typename Dtype>
+class TiledNet {
+ public:
+  /**
+   * @param param the net, with one 4-d input and one 4-d output.
+   * @param weights a net of the same architecture holding the weights.
+   * @param memory_budget the bytes the activations and convolution buffers
+   *        of all workers together may take; sets the tile size.
+   * @param num_workers the number of tiles run in parallel.
+   */
+  TiledNet(const NetParameter& param, const Net<Dtype>& weights,
+      size_t memory_budget, int num_workers = 1);
+
+  /// @brief Overrides the tile size set by the memory budget.
+  void set_tile_size(int height, int width);
+
+  /**
+   * @brief Runs the net over input, of any spatial size, and reshapes output
+   *        to the output of the net over the whole of input.
+   */
+  void Forward(const Blob<Dtype>& input, Blob<Dtype>* output);
+
+  inline int tile_height() const { return tile_size_[0]; }
+  inline int tile_width() const { return tile_size_[1]; }
+  /// @brief The number of tiles per image of the last Forward().
+  inline int num_tiles() const {
+    return tiles_[0].start.size() * tiles_[1].start.size();
+  }
+  /// @brief The receptive field of the output along height (0) or width (1).
+  inline const ReceptiveField& receptive_field(int axis) const {
+    return field_[axis];
+  }
+  /// @brief Tiles start on multiples of this many input pixels.
+  inline int alignment() const { return alignment_; }
+
+ protected:
+  // The tiles along one spatial axis. Tile i covers the input pixels
+  // [start[i], start[i] + length[i]) and owns the output pixels
+  // [own_begin[i], own_end[i]), which it computes from its own input alone.
+  struct AxisTiles {
+    vector<int> start;
+    vector<int> length;
+    vector<int> own_begin;
+    vector<int> own_end;
+  };
+
+  /// @brief Computes field_ and alignment_ from the layers of net.
+  void ComputeReceptiveField(const Net<Dtype>& net);
+  /// @brief Splits an input axis of the given size into tiles.
+  void PlanAxis(int axis, int size);
+  /// @brief Estimates the bytes net takes per input pixel.
+  double BytesPerPixel(const Net<Dtype>& net) const;
+  /// @brief Reshapes the input of net to height x width.
+  void ReshapeNet(Net<Dtype>* net, int height, int width);
+  /// @brief Runs tiles worker, worker + num_workers, ... of all images of
+  ///        input_data into output_data, on the worker's net.
+  void RunTiles(int worker, Caffe::Brew mode, int device,
+      const vector<int>& input_shape, const Dtype* input_data,
+      const vector<int>& output_shape, Dtype* output_data);
+
+  vector<shared_ptr<Net<Dtype> > > nets_;
+  ReceptiveField field_[2];
+  int alignment_;
+  int tile_size_[2];
+  AxisTiles tiles_[2];
+
+  DISABLE_COPY_AND_ASSIGN(TiledNet);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_TILED_NET_HPP_
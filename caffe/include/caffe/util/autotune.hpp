@@ -0,0 +1,81 @@
+#ifndef CAFFE_UTIL_AUTOTUNE_HPP_
+#define CAFFE_UTIL_AUTOTUNE_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief The persistent store of autotuning decisions.
+ *
+ * Each entry maps a machine fingerprint and a layer key (type, bottom shapes
+ * and the engine-independent layer parameters) to the engine that won. The
+ * file holds one tab separated "fingerprint key engine" entry per line, so
+ * one cache can be shared by several machines.
+ */
+class AutotuneCache {
+ public:
+  // The process-wide cache backed by Caffe::autotune_cache().
+  static AutotuneCache& Get();
+
+  // Returns true and sets *engine if key has a decision for this machine.
+  bool Lookup(const string& key, int* engine);
+  // Records a decision for this machine and rewrites the backing file.
+  void Insert(const string& key, int engine);
+
+  // Replaces the contents by those of filename; a missing file is an empty
+  // cache.
+  void Load(const string& filename);
+  // Writes the contents to filename through a temporary file and a rename,
+  // so that concurrent readers never see a partial cache.
+  void Save(const string& filename) const;
+  void Clear() { entries_.clear(); }
+
+  // Identifies the CPU model and core count, and the GPU in GPU mode.
+  static string MachineFingerprint();
+
+ private:
+  AutotuneCache() {}
+
+  // fingerprint -> (layer key -> engine)
+  std::map<string, std::map<string, int> > entries_;
+  string loaded_filename_;
+
+  DISABLE_COPY_AND_ASSIGN(AutotuneCache);
+};
+
+/**
+ * @brief Chooses the engine of layers left at engine DEFAULT by timing every
+ *        engine compiled in at the actual bottom shapes.
+ *
+ * Used by Net::Init when Caffe::autotune() is set. Decisions are looked up in
+ * and added to AutotuneCache, so only the first run on a machine pays for the
+ * timing.
+ */
+template <typename Dtype>
+class LayerAutotuner {
+ public:
+  // Returns true and sets the engine in *param if the layer type has an
+  // engine choice and param leaves it at DEFAULT.
+  static bool Tune(const vector<Blob<Dtype>*>& bottom, int num_top,
+      LayerParameter* param);
+
+  // The key identifying param at these bottom shapes in the cache.
+  static string Key(const vector<Blob<Dtype>*>& bottom,
+      const LayerParameter& param);
+
+ private:
+  // Forward and backward time in microseconds of param on copies of bottom.
+  static double TimeEngine(const vector<Blob<Dtype>*>& bottom, int num_top,
+      const LayerParameter& param);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_AUTOTUNE_HPP_
@@ -0,0 +1,45 @@
+#ifndef CAFFE_UTIL_BROADCAST_FUNCTIONS_HPP_
+#define CAFFE_UTIL_BROADCAST_FUNCTIONS_HPP_
+
+namespace caffe {
+
+// Broadcasts and reductions along one axis, for what would otherwise be a
+// rank-1 GEMM or a GEMV against a vector of ones. Every function views its
+// arrays as outer x dim x inner, and its vector v, or reduction y, as having
+// one value for each of the dim indices of the middle axis. Long loops are
+// split between the threads of Caffe::thread_pool().
+//
+// For example, the bias of a convolution is added to one image with outer 1,
+// dim the channels and inner the pixels, and the bias of an inner product
+// with outer the batch size, dim the outputs and inner 1.
+
+// y[o][d][i] = x[o][d][i] + alpha * v[d]; y may be x.
+template <typename Dtype>
+void caffe_cpu_broadcast_add(const int outer, const int dim, const int inner,
+    const Dtype alpha, const Dtype* v, const Dtype* x, Dtype* y);
+
+// y[o][d][i] = x[o][d][i] * v[d]; y may be x.
+template <typename Dtype>
+void caffe_cpu_broadcast_mul(const int outer, const int dim, const int inner,
+    const Dtype* v, const Dtype* x, Dtype* y);
+
+// y[o][d][i] = x[o][d][i] / v[d]; y may be x.
+template <typename Dtype>
+void caffe_cpu_broadcast_div(const int outer, const int dim, const int inner,
+    const Dtype* v, const Dtype* x, Dtype* y);
+
+// y[d] = alpha * sum over o, i of x[o][d][i] + beta * y[d]. As with BLAS, y
+// is not read when beta is 0.
+template <typename Dtype>
+void caffe_cpu_axis_sum(const int outer, const int dim, const int inner,
+    const Dtype alpha, const Dtype* x, const Dtype beta, Dtype* y);
+
+// y[d] = alpha * sum over o, i of x[o][d][i] * z[o][d][i] + beta * y[d].
+template <typename Dtype>
+void caffe_cpu_axis_dot(const int outer, const int dim, const int inner,
+    const Dtype alpha, const Dtype* x, const Dtype* z, const Dtype beta,
+    Dtype* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_BROADCAST_FUNCTIONS_HPP_
@@ -0,0 +1,174 @@
+#ifndef CAFFE_UTIL_EXPRESSION_HPP_
+#define CAFFE_UTIL_EXPRESSION_HPP_
+
+#include <cmath>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Elementwise expressions over arrays, for what would otherwise be a chain
+// of caffe_add, caffe_mul, caffe_sqr, ... calls through temporary blobs.
+// The expression is only built by the operators and evaluated by caffe_eval
+// or caffe_sum, in one loop that reads each array once and writes nothing
+// in between. For example,
+//
+//   const expr::Array<Dtype> m(m_data), v(v_data);
+//   caffe_eval(n, rate * m / (expr::sqrt(v) + eps), update);
+//
+// Expressions keep pointers to the arrays, not copies; build them in the
+// statement that evaluates them.
+namespace expr {
+
+// The base of all expressions, so the operators only apply to them.
+template <typename E>
+class Expr {
+ public:
+  const E& self() const { return static_cast<const E&>(*this); }
+};
+
+template <typename T>
+class Array : public Expr<Array<T> > {
+ public:
+  typedef T Dtype;
+  explicit Array(const T* data) : data_(data) {}
+  T operator[](int i) const { return data_[i]; }
+
+ private:
+  const T* data_;
+};
+
+template <typename T>
+class Scalar : public Expr<Scalar<T> > {
+ public:
+  typedef T Dtype;
+  explicit Scalar(T value) : value_(value) {}
+  T operator[](int i) const { return value_; }
+
+ private:
+  const T value_;
+};
+
+template <typename Op, typename L, typename R>
+class Binary : public Expr<Binary<Op, L, R> > {
+ public:
+  typedef typename L::Dtype Dtype;
+  Binary(const L& l, const R& r) : l_(l), r_(r) {}
+  Dtype operator[](int i) const { return Op::Apply(l_[i], r_[i]); }
+
+ private:
+  const L l_;
+  const R r_;
+};
+
+template <typename Op, typename E>
+class Unary : public Expr<Unary<Op, E> > {
+ public:
+  typedef typename E::Dtype Dtype;
+  explicit Unary(const E& e) : e_(e) {}
+  Dtype operator[](int i) const { return Op::Apply(e_[i]); }
+
+ private:
+  const E e_;
+};
+
+template <typename T>
+inline Array<T> array(const T* data) { return Array<T>(data); }
+
+#define DEFINE_EXPR_BINARY_OP(name, op) \
+  struct name { \
+    template <typename T> \
+    static inline T Apply(T a, T b) { return a op b; } \
+  }; \
+  template <typename L, typename R> \
+  inline Binary<name, L, R> operator op(const Expr<L>& l, \
+      const Expr<R>& r) { \
+    return Binary<name, L, R>(l.self(), r.self()); \
+  } \
+  template <typename E> \
+  inline Binary<name, E, Scalar<typename E::Dtype> > operator op( \
+      const Expr<E>& e, typename E::Dtype s) { \
+    return Binary<name, E, Scalar<typename E::Dtype> >(e.self(), \
+        Scalar<typename E::Dtype>(s)); \
+  } \
+  template <typename E> \
+  inline Binary<name, Scalar<typename E::Dtype>, E> operator op( \
+      typename E::Dtype s, const Expr<E>& e) { \
+    return Binary<name, Scalar<typename E::Dtype>, E>( \
+        Scalar<typename E::Dtype>(s), e.self()); \
+  }
+
+DEFINE_EXPR_BINARY_OP(Add, +)
+DEFINE_EXPR_BINARY_OP(Sub, -)
+DEFINE_EXPR_BINARY_OP(Mul, *)
+DEFINE_EXPR_BINARY_OP(Div, /)
+
+#undef DEFINE_EXPR_BINARY_OP
+
+#define DEFINE_EXPR_UNARY_FUNC(name, func, operation) \
+  struct name { \
+    template <typename T> \
+    static inline T Apply(T a) { operation; } \
+  }; \
+  template <typename E> \
+  inline Unary<name, E> func(const Expr<E>& e) { \
+    return Unary<name, E>(e.self()); \
+  }
+
+DEFINE_EXPR_UNARY_FUNC(Neg, operator-, return -a)
+DEFINE_EXPR_UNARY_FUNC(Sqr, sqr, return a * a)
+DEFINE_EXPR_UNARY_FUNC(Sqrt, sqrt, return std::sqrt(a))
+DEFINE_EXPR_UNARY_FUNC(Exp, exp, return std::exp(a))
+DEFINE_EXPR_UNARY_FUNC(Abs, abs, return std::fabs(a))
+
+#undef DEFINE_EXPR_UNARY_FUNC
+
+// Writes e over [begin, end) of y.
+template <typename E>
+class Assign {
+ public:
+  Assign(const E& e, typename E::Dtype* y) : e_(e), y_(y) {}
+
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      y_[i] = e_[i];
+    }
+  }
+
+ private:
+  const E e_;
+  typename E::Dtype* y_;
+};
+
+// Loops shorter than this run on the calling thread alone.
+const int kParallelMinCount = 1 << 15;
+
+}  // namespace expr
+
+// y[i] = e[i] for i in [0, n). y may be one of the arrays of e, as each
+// element is only read at its own index; longer loops are split over
+// Caffe::thread_pool().
+template <typename E>
+void caffe_eval(const int n, const expr::Expr<E>& e, typename E::Dtype* y) {
+  expr::Assign<E> assign(e.self(), y);
+  if (n < expr::kParallelMinCount) {
+    assign(0, n);
+  } else {
+    parallel_for(0, n, assign, expr::kParallelMinCount);
+  }
+}
+
+// The sum of e[i] for i in [0, n).
+template <typename E>
+typename E::Dtype caffe_sum(const int n, const expr::Expr<E>& e) {
+  const E& self = e.self();
+  typename E::Dtype sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += self[i];
+  }
+  return sum;
+}
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_EXPRESSION_HPP_
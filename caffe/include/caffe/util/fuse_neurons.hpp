@@ -0,0 +1,20 @@
+#ifndef _CAFFE_UTIL_FUSE_NEURONS_HPP_
+#define _CAFFE_UTIL_FUSE_NEURONS_HPP_
+
+#include <vector>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy NetParameters with each chain of two or more consecutive element-wise
+// neuron layers, each feeding only the next, replaced by one FusedNeuron
+// layer. chains receives, for each layer of param_fused, the layers it
+// fuses, or none for the layers copied as they were. param must already
+// have its splits inserted, so each top has at most one consumer.
+void FuseNeurons(const NetParameter& param, NetParameter* param_fused,
+    vector<vector<LayerParameter> >* chains);
+
+}  // namespace caffe
+
+#endif  // _CAFFE_UTIL_FUSE_NEURONS_HPP_
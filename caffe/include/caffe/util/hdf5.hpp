@@ -7,6 +7,7 @@
 #include "hdf5_hl.h"
 
 #include "caffe/blob.hpp"
+#include "caffe/util/weight_compression.hpp"
 
 namespace caffe {
 
@@ -25,6 +26,17 @@ void hdf5_save_nd_dataset(
     const hid_t file_id, const string& dataset_name, const Blob<Dtype>& blob,
     bool write_diff = false);
 
+/**
+ * @brief Saves weights encoded by EncodeWeights() as a dataset of their
+ *        halves or codes, with the encoding and any codebook as attributes.
+ */
+void hdf5_save_encoded_weights(hid_t loc_id, const string& dataset_name,
+    const EncodedWeights& encoded);
+/// @brief Whether the dataset was saved by hdf5_save_encoded_weights().
+bool hdf5_is_encoded_weights(hid_t loc_id, const string& dataset_name);
+void hdf5_load_encoded_weights(hid_t loc_id, const string& dataset_name,
+    EncodedWeights* encoded);
+
 int hdf5_load_int(hid_t loc_id, const string& dataset_name);
 void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i);
 string hdf5_load_string(hid_t loc_id, const string& dataset_name);
@@ -0,0 +1,130 @@
+#ifndef CAFFE_UTIL_IMAGE_PREPROCESSOR_HPP_
+#define CAFFE_UTIL_IMAGE_PREPROCESSOR_HPP_
+
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Clips window (y1, x1, y2, x2), exclusive of y2 and x2 like the
+ *        windows of Detector, to an image of rows x cols pixels in place.
+ *        Returns false if no pixel of the window is in the image.
+ */
+bool ClipWindow(int rows, int cols, int* window);
+
+#ifdef USE_OPENCV
+/**
+ * @brief Where a window of an image lands in a square crop of an R-CNN
+ *        style detector: the window, widened by context_pad pixels of
+ *        context on each side of the crop, is clipped to the image and
+ *        warped to size, at (pad_h, pad_w) in the crop.
+ */
+struct WindowWarp {
+  cv::Rect roi;
+  cv::Size size;
+  int pad_h;
+  int pad_w;
+};
+
+/**
+ * @brief Computes the warp of window (x1, y1, x2, y2), inclusive, of an
+ *        image of rows x cols pixels into a crop_size x crop_size crop, as
+ *        WindowDataLayer does. use_square widens the window to a square;
+ *        mirror mirrors the horizontal padding.
+ */
+template <typename Dtype>
+WindowWarp ComputeWindowWarp(int x1, int y1, int x2, int y2, int rows,
+    int cols, int crop_size, int context_pad, bool use_square, bool mirror);
+
+/**
+ * @brief Turns a batch of HWC images into network input, in parallel: the
+ *        native counterpart of caffe.io.Transformer and Classifier's
+ *        resizing and oversampling.
+ *
+ * Each image is resized to the image dims, its channels are reordered by the
+ * channel swap, and it is cut into crops of the size of the destination
+ * blob: the center crop, or with oversampling the four corner crops, the
+ * center crop and their mirror images, in the order of caffe.io.oversample.
+ * Every crop is then written by a DataTransformer as
+ *   (raw_scale * pixel - mean) * input_scale
+ * into its own item of the blob.
+ */
+template <typename Dtype>
+class ImagePreprocessor {
+ public:
+  /// @param num_threads how many threads to use; 0 means one per core.
+  explicit ImagePreprocessor(int num_threads = 0);
+
+  /// @brief Sets the size images are resized to; 0 keeps their size.
+  void set_image_dims(int height, int width) {
+    image_height_ = height;
+    image_width_ = width;
+  }
+  /// @brief Output channel c is taken from input channel channel_swap[c].
+  void set_channel_swap(const vector<int>& channel_swap) {
+    channel_swap_ = channel_swap;
+  }
+  void set_raw_scale(Dtype raw_scale) { raw_scale_ = raw_scale; }
+  /// @brief Sets a per-channel mean, in the raw scaled range.
+  void set_mean(const vector<Dtype>& mean) { mean_ = mean; }
+  void set_input_scale(Dtype input_scale) { input_scale_ = input_scale; }
+  void set_oversample(bool oversample) { oversample_ = oversample; }
+  /// @brief Sets the context padding of PreprocessWindows().
+  void set_context_pad(int context_pad) { context_pad_ = context_pad; }
+
+  /// @brief The number of blob items written per image.
+  inline int crops_per_image() const { return oversample_ ? 10 : 1; }
+
+  /**
+   * @brief Preprocesses images (CV_8U or CV_32F, all with the same number
+   *        of channels) into the first images.size() * crops_per_image()
+   *        items of blob, whose height and width give the crop size.
+   */
+  void Preprocess(const vector<cv::Mat>& images, Blob<Dtype>* blob) const;
+
+  /**
+   * @brief Warps windows of one image into the first windows.size() / 4
+   *        items of blob, whose height and width give the square crop size,
+   *        as ComputeWindowWarp() places them. Windows are given as
+   *        (y1, x1, y2, x2), exclusive of y2 and x2 like the windows of
+   *        Detector, and are clipped to the image; each must keep at least
+   *        one pixel. The image dims are ignored, and crops are never
+   *        oversampled; the context padding holds the mean, i.e. 0 after
+   *        preprocessing.
+   */
+  void PreprocessWindows(const cv::Mat& image, const vector<int>& windows,
+      Blob<Dtype>* blob) const;
+
+ protected:
+  // Preprocesses images [begin, end) into data, which has blob's shape.
+  void PreprocessRange(const vector<cv::Mat>& images, int begin, int end,
+      const Blob<Dtype>* blob, Dtype* data) const;
+  // Warps the clipped windows [begin, end) of image into data, which has
+  // blob's shape.
+  void PreprocessWindowRange(const cv::Mat& image, const vector<int>& windows,
+      int begin, int end, const Blob<Dtype>* blob, Dtype* data) const;
+  // Reorders the channels of image by the channel swap.
+  cv::Mat SwapChannels(const cv::Mat& image) const;
+
+  int num_threads_;
+  int image_height_;
+  int image_width_;
+  vector<int> channel_swap_;
+  Dtype raw_scale_;
+  vector<Dtype> mean_;
+  Dtype input_scale_;
+  bool oversample_;
+  int context_pad_;
+};
+#endif  // USE_OPENCV
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_IMAGE_PREPROCESSOR_HPP_
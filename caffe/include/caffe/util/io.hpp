@@ -10,6 +10,7 @@
 
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/ring_queue.hpp"
 #include "caffe/util/format.hpp"
 
 #ifndef CAFFE_TMP_DIR_RETRIES
@@ -83,6 +84,15 @@ inline void ReadProtoFromBinaryFileOrDie(const string& filename,
   ReadProtoFromBinaryFileOrDie(filename.c_str(), proto);
 }
 
+/**
+ * @brief Reads the layers of a binary NetParameter file into param, pushing
+ *        each to layers as soon as it is read.
+ * @return false if the file cannot be parsed or holds deprecated V0 or V1
+ *         layers, which can only be read whole by
+ *         ReadNetParamsFromBinaryFileOrDie() to upgrade them.
+ */
+bool ReadNetLayersFromBinaryFile(const string& filename, NetParameter* param,
+    RingQueue<const LayerParameter*>* layers);
 
 void WriteProtoToBinaryFile(const Message& proto, const char* filename);
 inline void WriteProtoToBinaryFile(
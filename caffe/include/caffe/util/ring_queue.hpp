@@ -0,0 +1,69 @@
+#ifndef CAFFE_UTIL_RING_QUEUE_HPP_
+#define CAFFE_UTIL_RING_QUEUE_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A bounded lock-free queue on a ring buffer, for handing items
+ *        between threads without a lock per item.
+ *
+ * A push or pop claims its slot with a single atomic operation, or with
+ * plain loads and stores when there is only one producer and one consumer.
+ * A pop from an empty queue, or a push to a full one, spins briefly and then
+ * parks the thread on a condition variable, so waiting threads can still be
+ * interrupted like those waiting on a BlockingQueue.
+ */
+template<typename T>
+class RingQueue {
+ public:
+  enum Sharing {
+    // Exactly one thread pushes and one thread pops at a time.
+    SINGLE_PRODUCER_CONSUMER,
+    MULTIPLE_PRODUCERS_CONSUMERS
+  };
+
+  // The capacity is rounded up to a power of two.
+  RingQueue(int capacity, Sharing sharing);
+
+  // Blocks while the queue is full.
+  void push(const T& t);
+
+  bool try_push(const T& t);
+
+  bool try_pop(T* t);
+
+  // This logs a message if the threads needs to be blocked
+  // useful for detecting e.g. when data feeding is too slow
+  T pop(const string& log_on_wait = "");
+
+  // Peeking is only safe while no other thread pops the queue, as it could
+  // pop the item as it is read.
+  bool try_peek(T* t);
+
+  // Return element without removing it
+  T peek();
+
+  size_t size() const;
+
+  size_t capacity() const;
+
+ protected:
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX. Also fails on
+   Linux CUDA 7.0.18.
+   */
+  class sync;
+
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(RingQueue);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_RING_QUEUE_HPP_
@@ -0,0 +1,70 @@
+#ifndef CAFFE_UTIL_SOLVER_METRICS_HPP_
+#define CAFFE_UTIL_SOLVER_METRICS_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Exports solver throughput, timing and memory metrics as a
+ *        Prometheus text file, e.g. for the node exporter textfile collector.
+ *
+ * The Solver times the phases of every iteration with Start() / Stop(),
+ * which costs two clock reads per phase, and calls Write() every interval()
+ * iterations. Write() reports per-iteration averages over the iterations
+ * since the previous Write() and replaces the file atomically through a
+ * rename, so scrapers never read a partial file.
+ */
+class SolverMetrics {
+ public:
+  enum Phase { FORWARD, BACKWARD, UPDATE, NUM_PHASES };
+
+  SolverMetrics(const string& filename, int interval);
+
+  inline const string& filename() const { return filename_; }
+  inline int interval() const { return interval_; }
+
+  inline void Start() { timer_.Start(); }
+  inline void Stop(Phase phase) {
+    phase_us_[phase] += timer_.MicroSeconds();
+    if (phase == UPDATE) {
+      ++iterations_;
+    }
+  }
+
+  /**
+   * @brief Writes the metrics file.
+   *
+   * @param iter the current solver iteration
+   * @param samples_per_iter the number of training samples per iteration
+   * @param data_wait_us the total time data layers have waited for their
+   *        prefetch threads so far, in microseconds
+   * @param blob_bytes the current size of the net's blobs (data and diff)
+   */
+  void Write(int iter, int samples_per_iter, double smoothed_loss,
+      double learning_rate, double data_wait_us, size_t blob_bytes);
+
+  // Resident set size of this process and its peak, in bytes.
+  static size_t ResidentBytes();
+  static size_t PeakResidentBytes();
+
+ private:
+  string filename_;
+  int interval_;
+  Timer timer_;
+  // Wall clock time since the previous Write().
+  CPUTimer wall_timer_;
+  double phase_us_[NUM_PHASES];
+  int iterations_;
+  double last_data_wait_us_;
+  size_t peak_blob_bytes_;
+
+  DISABLE_COPY_AND_ASSIGN(SolverMetrics);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SOLVER_METRICS_HPP_
@@ -0,0 +1,70 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of threads that split loops between them.
+ *
+ * A pool of n threads starts n - 1 workers; the thread calling Run() does
+ * its share of the loop as the last. Workers are pinned, in order, to the
+ * cores of the affinity list given, repeating it if it is shorter, and run
+ * in CPU mode.
+ *
+ * The pool runs one loop at a time. A loop started while another runs,
+ * from another thread or from inside the body of the running loop, runs
+ * serially on the thread that started it, so pools never oversubscribe the
+ * cores and nested loops cannot deadlock.
+ */
+class ThreadPool {
+ public:
+  ThreadPool(int num_threads, const vector<int>& cpus);
+  ~ThreadPool();
+
+  int num_threads() const { return num_threads_; }
+
+  /**
+   * @brief Calls body(chunk_begin, chunk_end) over consecutive chunks that
+   *        split [begin, end), each at least grain long and one per thread
+   *        at most, and returns once all have run. The chunks only depend
+   *        on the range, the grain and the number of threads, so results
+   *        kept per chunk are reproducible.
+   *
+   * Inside the loop BLAS is limited to one thread, to not multiply the
+   * threads of the pool by its own.
+   */
+  void Run(int begin, int end, int grain,
+      const boost::function<void(int, int)>& body);
+
+ private:
+  class sync;
+
+  const int num_threads_;
+  shared_ptr<sync> sync_;
+
+  DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+/**
+ * @brief Splits [begin, end) between the threads of the pool of the process,
+ *        Caffe::thread_pool(); see ThreadPool::Run().
+ */
+void parallel_for(int begin, int end,
+    const boost::function<void(int, int)>& body, int grain = 1);
+
+/**
+ * @brief Sets how many threads BLAS uses, with MKL or OpenBLAS. Other
+ *        libraries fix it when they are built, and this does nothing.
+ */
+void SetBlasThreads(int num_threads);
+/// @brief The threads BLAS uses, or 0 if the library is not controlled.
+int BlasThreads();
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
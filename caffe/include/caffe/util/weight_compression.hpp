@@ -0,0 +1,64 @@
+#ifndef CAFFE_UTIL_WEIGHT_COMPRESSION_HPP_
+#define CAFFE_UTIL_WEIGHT_COMPRESSION_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief How the weights of a layer are stored by Net::ToCompressedHDF5():
+ *        as floats, as IEEE half floats, or as 8-bit indices into a codebook
+ *        of 256 values, spaced evenly between the extremes of the weights
+ *        (LINEAR8) or fit to them by k-means (KMEANS8).
+ */
+enum WeightEncoding {
+  WEIGHT_FLOAT,
+  WEIGHT_FP16,
+  WEIGHT_LINEAR8,
+  WEIGHT_KMEANS8
+};
+
+/// @brief The number of values in the codebook of an 8-bit encoding.
+const int kWeightCodebookSize = 256;
+
+/// @brief Parses "float", "fp16", "linear8" or "kmeans8".
+WeightEncoding WeightEncodingFromName(const string& name);
+string WeightEncodingName(WeightEncoding encoding);
+
+/// @brief The weights of a blob encoded by EncodeWeights().
+struct EncodedWeights {
+  WeightEncoding encoding;
+  vector<int> shape;
+  // The weights as half floats, for WEIGHT_FP16.
+  vector<uint16_t> halves;
+  // The weights as indices into the codebook, for the 8-bit encodings.
+  vector<uint8_t> codes;
+  vector<float> codebook;
+};
+
+/// @brief Converts to the nearest IEEE half float, rounding ties to even.
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t half);
+
+/**
+ * @brief Encodes the data of blob, which must not be WEIGHT_FLOAT.
+ * @return the root mean square error of the encoded weights relative to the
+ *         root mean square of the weights, or 0 if they are all 0.
+ */
+template <typename Dtype>
+double EncodeWeights(const Blob<Dtype>& blob, WeightEncoding encoding,
+    EncodedWeights* encoded);
+
+/// @brief Reshapes blob to the encoded weights and decodes them into it.
+template <typename Dtype>
+void DecodeWeights(const EncodedWeights& encoded, Blob<Dtype>* blob);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_WEIGHT_COMPRESSION_HPP_
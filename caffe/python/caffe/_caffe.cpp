@@ -9,15 +9,23 @@
 #include <boost/python/suite/indexing/vector_indexing_suite.hpp>
 #include <numpy/arrayobject.h>
 
+#include <boost/thread.hpp>
+
 // these need to be included after boost on OS X
+#include <algorithm>  // NOLINT(build/include_order)
+#include <cmath>  // NOLINT(build/include_order)
+#include <deque>  // NOLINT(build/include_order)
 #include <string>  // NOLINT(build/include_order)
 #include <vector>  // NOLINT(build/include_order)
 #include <fstream>  // NOLINT
 
 #include "caffe/caffe.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/layers/memory_data_layer.hpp"
 #include "caffe/layers/python_layer.hpp"
+#include "caffe/layers/spp_layer.hpp"
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/util/image_preprocessor.hpp"
 
 // Temporary solution for numpy < 1.7 versions: old macro, no promises.
 // You're strongly advised to upgrade to >= 1.7.
@@ -73,6 +81,51 @@ void CheckContiguousArray(PyArrayObject* arr, string name,
   }
 }
 
+// Releases the GIL while in scope, so that other Python threads can run while
+// Caffe computes. Python layers take the GIL back themselves.
+class ScopedGILRelease {
+ public:
+  ScopedGILRelease() : state_(PyEval_SaveThread()) {}
+  ~ScopedGILRelease() { PyEval_RestoreThread(state_); }
+
+ private:
+  PyThreadState* state_;
+
+  DISABLE_COPY_AND_ASSIGN(ScopedGILRelease);
+};
+
+Dtype Net_ForwardFromTo(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease release;
+  return net->ForwardFromTo(start, end);
+}
+
+void Net_BackwardFromTo(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease release;
+  net->BackwardFromTo(start, end);
+}
+
+void Net_Reshape(Net<Dtype>* net) {
+  ScopedGILRelease release;
+  net->Reshape();
+}
+
+void Net_CopyFrom(Net<Dtype>* net, string filename) {
+  ScopedGILRelease release;
+  net->CopyTrainedLayersFrom(filename);
+}
+
+void Solver_Step(Solver<Dtype>* solver, int iters) {
+  ScopedGILRelease release;
+  solver->Step(iters);
+}
+
+void Solver_Solve(Solver<Dtype>* solver, const char* resume_file = NULL) {
+  ScopedGILRelease release;
+  solver->Solve(resume_file);
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS(SolveOverloads, Solver_Solve, 1, 2);
+
 // Net constructor for passing phase as int
 shared_ptr<Net<Dtype> > Net_Init(
     string param_file, int phase) {
@@ -91,10 +144,436 @@ shared_ptr<Net<Dtype> > Net_Init_Load(
 
   shared_ptr<Net<Dtype> > net(new Net<Dtype>(param_file,
       static_cast<Phase>(phase)));
-  net->CopyTrainedLayersFrom(pretrained_param_file);
+  Net_CopyFrom(net.get(), pretrained_param_file);
   return net;
 }
 
+// The result of a forward pass run by a NetForwardWorker.
+class NetForwardFuture {
+ public:
+  NetForwardFuture(int start, int end)
+      : start_(start), end_(end), loss_(0), done_(false) {}
+
+  bool done() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return done_;
+  }
+  // Waits for the pass to finish and returns its loss.
+  Dtype wait() {
+    ScopedGILRelease release;
+    boost::mutex::scoped_lock lock(mutex_);
+    while (!done_) {
+      condition_.wait(lock);
+    }
+    return loss_;
+  }
+
+ protected:
+  friend class NetForwardWorker;
+
+  void Run(Net<Dtype>* net) {
+    const Dtype loss = net->ForwardFromTo(start_, end_);
+    boost::mutex::scoped_lock lock(mutex_);
+    loss_ = loss;
+    done_ = true;
+    condition_.notify_all();
+  }
+
+  const int start_;
+  const int end_;
+  Dtype loss_;
+  bool done_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+
+  DISABLE_COPY_AND_ASSIGN(NetForwardFuture);
+};
+
+// Runs the forward passes of one net, in submission order, on a thread that
+// does not hold the GIL; backs Net.forward_async.
+class NetForwardWorker : public InternalThread {
+ public:
+  explicit NetForwardWorker(shared_ptr<Net<Dtype> > net)
+      : net_(net), mode_(Caffe::mode()) {}
+  // Shares the net with its Python object rather than referencing that
+  // object, so that the net, which keeps its worker, can be collected; the
+  // worker then stops, after any running pass, and releases the net.
+  static shared_ptr<NetForwardWorker> Init(bp::object net) {
+    return shared_ptr<NetForwardWorker>(new NetForwardWorker(
+        bp::extract<shared_ptr<Net<Dtype> >&>(net)()));
+  }
+  virtual ~NetForwardWorker() {
+    ScopedGILRelease release;
+    StopInternalThread();
+  }
+
+  shared_ptr<NetForwardFuture> Submit(int start, int end) {
+    if (is_started() && mode_ != Caffe::mode()) {
+      // The thread runs in the mode it was started in.
+      ScopedGILRelease release;
+      StopInternalThread();
+    }
+    if (!is_started()) {
+      mode_ = Caffe::mode();
+      StartInternalThread();
+    }
+    shared_ptr<NetForwardFuture> future(new NetForwardFuture(start, end));
+    boost::mutex::scoped_lock lock(mutex_);
+    queue_.push_back(future);
+    condition_.notify_one();
+    return future;
+  }
+
+ protected:
+  virtual void InternalThreadEntry() {
+    try {
+      while (!must_stop()) {
+        shared_ptr<NetForwardFuture> future;
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          while (queue_.empty()) {
+            // An interruption point, through which StopInternalThread ends
+            // the wait.
+            condition_.wait(lock);
+          }
+          future = queue_.front();
+          queue_.pop_front();
+        }
+        future->Run(net_.get());
+      }
+    } catch (boost::thread_interrupted&) {
+      // Interrupted exception is expected on shutdown
+    }
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+  Caffe::Brew mode_;
+  std::deque<shared_ptr<NetForwardFuture> > queue_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+};
+
+// Copies rows [begin, begin + num) of source into the first num rows of a
+// batch of batch_size rows of dim values each, and zeroes the rest.
+static void FillBatch(const Dtype* source, int begin, int num, int batch_size,
+    int dim, Dtype* batch) {
+  std::copy(source + begin * dim, source + (begin + num) * dim, batch);
+  std::fill(batch + num * dim, batch + batch_size * dim, Dtype(0));
+}
+
+// Fills the next batch of every input while the current one is computed.
+static void FillBatches(const vector<const Dtype*>& sources, int begin,
+    int num, int batch_size, const vector<int>& dims,
+    const vector<Dtype*>& batches) {
+  for (int i = 0; i < sources.size(); ++i) {
+    FillBatch(sources[i], begin, num, batch_size, dims[i], batches[i]);
+  }
+}
+
+// Keeps the input blobs of Net_ForwardAll while they point at its batch
+// buffers, and the thread filling the next batch: when it goes out of scope,
+// also by an exception, it joins the thread and points the blobs back at
+// their own memory.
+class ForwardAllGuard {
+ public:
+  explicit ForwardAllGuard(const vector<Blob<Dtype>*>& input_blobs)
+      : input_blobs_(input_blobs), own_(input_blobs.size()) {
+    for (int i = 0; i < input_blobs_.size(); ++i) {
+      own_[i].reset(new Blob<Dtype>());
+      own_[i]->ReshapeLike(*input_blobs_[i]);
+      own_[i]->ShareData(*input_blobs_[i]);
+    }
+  }
+  ~ForwardAllGuard() {
+    JoinFiller();
+    for (int i = 0; i < input_blobs_.size(); ++i) {
+      input_blobs_[i]->ShareData(*own_[i]);
+    }
+  }
+
+  void StartFiller(boost::thread* filler) { filler_.reset(filler); }
+  void JoinFiller() {
+    if (filler_) {
+      filler_->join();
+      filler_.reset();
+    }
+  }
+
+ private:
+  const vector<Blob<Dtype>*>& input_blobs_;
+  vector<shared_ptr<Blob<Dtype> > > own_;
+  shared_ptr<boost::thread> filler_;
+
+  DISABLE_COPY_AND_ASSIGN(ForwardAllGuard);
+};
+
+// Runs the net forward over inputs of any length in batches of the net's
+// batch size, writing straight into preallocated output arrays. The next
+// batch is gathered into a second buffer while the current one is computed,
+// and the final partial batch is zero padded in that buffer.
+bp::object Net_ForwardAll(Net<Dtype>* net, bp::dict inputs,
+    bp::list output_names) {
+  const vector<Blob<Dtype>*>& input_blobs = net->input_blobs();
+  const vector<string>& blob_names = net->blob_names();
+  const vector<int>& input_indices = net->input_blob_indices();
+  if (input_blobs.empty()) {
+    throw std::runtime_error("The net has no inputs to forward.");
+  }
+  if (bp::len(inputs) != input_blobs.size()) {
+    throw std::runtime_error("Input blob arguments do not match net inputs.");
+  }
+  const int batch_size = input_blobs[0]->shape(0);
+  int num = -1;
+  vector<bp::object> arrays;
+  vector<const Dtype*> sources;
+  vector<int> dims;
+  for (int i = 0; i < input_blobs.size(); ++i) {
+    const string& name = blob_names[input_indices[i]];
+    if (!inputs.has_key(name)) {
+      throw std::runtime_error("Missing input " + name);
+    }
+    // Converts only if the input is not already C contiguous float32.
+    arrays.push_back(bp::object(bp::handle<>(PyArray_FROM_OTF(
+        bp::object(inputs[name]).ptr(), NPY_DTYPE,
+        NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST))));
+    PyArrayObject* arr = reinterpret_cast<PyArrayObject*>(arrays.back().ptr());
+    const Blob<Dtype>& blob = *input_blobs[i];
+    if (PyArray_NDIM(arr) != blob.num_axes()) {
+      throw std::runtime_error(name + " has the wrong number of axes");
+    }
+    for (int j = 1; j < blob.num_axes(); ++j) {
+      if (PyArray_DIMS(arr)[j] != blob.shape(j)) {
+        throw std::runtime_error(name + " does not match the input shape");
+      }
+    }
+    if (num >= 0 && PyArray_DIMS(arr)[0] != num) {
+      throw std::runtime_error("Inputs differ in length");
+    }
+    if (blob.shape(0) != batch_size) {
+      throw std::runtime_error("Inputs differ in batch size");
+    }
+    num = PyArray_DIMS(arr)[0];
+    sources.push_back(static_cast<const Dtype*>(PyArray_DATA(arr)));
+    dims.push_back(blob.count(1));
+  }
+  // Preallocate the outputs.
+  bp::dict outs;
+  vector<const Blob<Dtype>*> output_blobs;
+  vector<Dtype*> output_data;
+  for (int i = 0; i < bp::len(output_names); ++i) {
+    const string name = bp::extract<string>(output_names[i]);
+    if (!net->has_blob(name)) {
+      throw std::runtime_error("Unknown blob " + name);
+    }
+    const Blob<Dtype>* blob = net->blob_by_name(name).get();
+    if (blob->num_axes() == 0 || blob->shape(0) != batch_size) {
+      throw std::runtime_error(name + " is not batch sized");
+    }
+    vector<npy_intp> shape(blob->shape().begin(), blob->shape().end());
+    shape[0] = num;
+    PyObject* arr = PyArray_SimpleNew(shape.size(), &shape[0], NPY_DTYPE);
+    outs[name] = bp::object(bp::handle<>(arr));
+    output_blobs.push_back(blob);
+    output_data.push_back(static_cast<Dtype*>(
+        PyArray_DATA(reinterpret_cast<PyArrayObject*>(arr))));
+  }
+  {
+    ScopedGILRelease release;
+    // Point the input blobs at one of two buffers per input in turn; the
+    // guard restores their own memory afterwards.
+    ForwardAllGuard guard(input_blobs);
+    vector<shared_ptr<Blob<Dtype> > > buffers[2];
+    for (int i = 0; i < input_blobs.size(); ++i) {
+      for (int k = 0; k < 2; ++k) {
+        buffers[k].push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+        buffers[k].back()->ReshapeLike(*input_blobs[i]);
+      }
+    }
+    const int last_layer = net->layers().size() - 1;
+    for (int begin = 0, k = 0; begin < num; begin += batch_size, k = 1 - k) {
+      if (begin == 0) {
+        for (int i = 0; i < input_blobs.size(); ++i) {
+          FillBatch(sources[i], 0, std::min(batch_size, num), batch_size,
+              dims[i], buffers[k][i]->mutable_cpu_data());
+        }
+      }
+      for (int i = 0; i < input_blobs.size(); ++i) {
+        input_blobs[i]->ShareData(*buffers[k][i]);
+      }
+      const int next = begin + batch_size;
+      if (next < num) {
+        // Buffer pointers are taken here, so that the thread only copies.
+        vector<Dtype*> next_batches;
+        for (int i = 0; i < input_blobs.size(); ++i) {
+          next_batches.push_back(buffers[1 - k][i]->mutable_cpu_data());
+        }
+        guard.StartFiller(new boost::thread(&FillBatches, sources, next,
+            std::min(batch_size, num - next), batch_size, dims,
+            next_batches));
+      }
+      net->ForwardFromTo(0, last_layer);
+      const int rows = std::min(batch_size, num - begin);
+      for (int i = 0; i < output_blobs.size(); ++i) {
+        const int dim = output_blobs[i]->count(1);
+        const Dtype* data = output_blobs[i]->cpu_data();
+        std::copy(data, data + rows * dim, output_data[i] + begin * dim);
+      }
+      guard.JoinFiller();
+    }
+  }
+  return outs;
+}
+
+#ifdef USE_OPENCV
+// Wraps a HWC uint8 or float32 image as a cv::Mat without copying; images
+// of any other type are converted to float32. arrays keeps the converted
+// images alive.
+static cv::Mat WrapImage(bp::object image, vector<bp::object>* arrays) {
+  const int type = PyArray_Check(image.ptr()) ? PyArray_TYPE(
+      reinterpret_cast<PyArrayObject*>(image.ptr())) : NPY_DTYPE;
+  arrays->push_back(bp::object(bp::handle<>(PyArray_FROM_OTF(image.ptr(),
+      type == NPY_UINT8 ? NPY_UINT8 : NPY_FLOAT32,
+      NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST))));
+  PyArrayObject* arr = reinterpret_cast<PyArrayObject*>(arrays->back().ptr());
+  if (PyArray_NDIM(arr) != 3) {
+    throw std::runtime_error("Images must be H x W x K arrays");
+  }
+  const int depth = type == NPY_UINT8 ? CV_8U : CV_32F;
+  return cv::Mat(PyArray_DIMS(arr)[0], PyArray_DIMS(arr)[1],
+      CV_MAKETYPE(depth, PyArray_DIMS(arr)[2]), PyArray_DATA(arr));
+}
+
+// Points blob at out, which must be a C contiguous 4-d float32 array.
+static void WrapOutput(bp::object out, Blob<Dtype>* blob) {
+  PyArrayObject* out_arr = reinterpret_cast<PyArrayObject*>(out.ptr());
+  if (!PyArray_Check(out.ptr()) || PyArray_NDIM(out_arr) != 4 ||
+      PyArray_TYPE(out_arr) != NPY_DTYPE ||
+      !(PyArray_FLAGS(out_arr) & NPY_ARRAY_C_CONTIGUOUS)) {
+    throw std::runtime_error("out must be a C contiguous 4-d float32 array");
+  }
+  npy_intp* dims = PyArray_DIMS(out_arr);
+  blob->Reshape(dims[0], dims[1], dims[2], dims[3]);
+  blob->set_cpu_data(static_cast<Dtype*>(PyArray_DATA(out_arr)));
+}
+
+// Configures the preprocessing shared by images and windows.
+static void ConfigurePreprocessor(bp::list channel_swap, float raw_scale,
+    bp::list mean, float input_scale, ImagePreprocessor<Dtype>* preprocessor) {
+  vector<int> swap;
+  for (int c = 0; c < bp::len(channel_swap); ++c) {
+    swap.push_back(bp::extract<int>(channel_swap[c]));
+  }
+  preprocessor->set_channel_swap(swap);
+  preprocessor->set_raw_scale(raw_scale);
+  vector<Dtype> mean_values;
+  for (int c = 0; c < bp::len(mean); ++c) {
+    mean_values.push_back(bp::extract<Dtype>(mean[c]));
+  }
+  preprocessor->set_mean(mean_values);
+  preprocessor->set_input_scale(input_scale);
+}
+
+// Preprocesses a list of HWC images into out, a C contiguous float32 NCHW
+// array, with an ImagePreprocessor; see Classifier.predict.
+void PreprocessBatch(bp::object out, bp::list images, bp::tuple image_dims,
+    bp::list channel_swap, float raw_scale, bp::list mean, float input_scale,
+    bool oversample, int num_threads) {
+  Blob<Dtype> blob;
+  WrapOutput(out, &blob);
+  ImagePreprocessor<Dtype> preprocessor(num_threads);
+  preprocessor.set_image_dims(bp::extract<int>(image_dims[0]),
+      bp::extract<int>(image_dims[1]));
+  ConfigurePreprocessor(channel_swap, raw_scale, mean, input_scale,
+      &preprocessor);
+  preprocessor.set_oversample(oversample);
+  vector<bp::object> arrays;
+  vector<cv::Mat> mats;
+  for (int i = 0; i < bp::len(images); ++i) {
+    mats.push_back(WrapImage(images[i], &arrays));
+  }
+  if (blob.num() < mats.size() * preprocessor.crops_per_image()) {
+    throw std::runtime_error("out is too small for the crops of all images");
+  }
+  ScopedGILRelease release;
+  preprocessor.Preprocess(mats, &blob);
+}
+
+// Warps the windows (an N x 4 array of ymin, xmin, ymax, xmax, exclusive of
+// ymax and xmax) of one HWC image, clipped to it, into out, as
+// WindowDataLayer does; see Detector.detect_windows.
+void PreprocessWindows(bp::object out, bp::object image, bp::object windows,
+    bp::list channel_swap, float raw_scale, bp::list mean, float input_scale,
+    int context_pad, int num_threads) {
+  Blob<Dtype> blob;
+  WrapOutput(out, &blob);
+  ImagePreprocessor<Dtype> preprocessor(num_threads);
+  ConfigurePreprocessor(channel_swap, raw_scale, mean, input_scale,
+      &preprocessor);
+  preprocessor.set_context_pad(context_pad);
+  vector<bp::object> arrays;
+  const cv::Mat mat = WrapImage(image, &arrays);
+  bp::object coords(bp::handle<>(PyArray_FROM_OTF(windows.ptr(), NPY_INT,
+      NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST)));
+  PyArrayObject* coords_arr = reinterpret_cast<PyArrayObject*>(coords.ptr());
+  if (PyArray_NDIM(coords_arr) != 2 || PyArray_DIMS(coords_arr)[1] != 4) {
+    throw std::runtime_error("windows must be an N x 4 array");
+  }
+  const int* coords_data = static_cast<int*>(PyArray_DATA(coords_arr));
+  vector<int> window_vec(coords_data, coords_data + PyArray_SIZE(coords_arr));
+  if (blob.num() < window_vec.size() / 4) {
+    throw std::runtime_error("out is too small for all windows");
+  }
+  for (int i = 0; i < window_vec.size(); i += 4) {
+    if (!ClipWindow(mat.rows, mat.cols, &window_vec[i])) {
+      throw std::runtime_error("windows must overlap the image");
+    }
+  }
+  ScopedGILRelease release;
+  preprocessor.PreprocessWindows(mat, window_vec, &blob);
+}
+#endif  // USE_OPENCV
+
+// Pools the windows (an N x 4 array of ymin, xmin, ymax, xmax in input
+// pixels, exclusive of ymax and xmax) of the features at the bottom of the
+// SPP layer layer_id into its top, with one item per window; see
+// Detector.detect_windows.
+void Net_PoolWindows(Net<Dtype>* net, int layer_id, bp::object windows) {
+  const Layer<Dtype>& layer = *net->layers()[layer_id];
+  if (string(layer.type()) != "SPP") {
+    throw std::runtime_error("Windows are pooled by an SPP layer");
+  }
+  const Blob<Dtype>& input = *net->input_blobs()[0];
+  const Blob<Dtype>& features = *net->bottom_vecs()[layer_id][0];
+  bp::object coords(bp::handle<>(PyArray_FROM_OTF(windows.ptr(), NPY_INT,
+      NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST)));
+  PyArrayObject* coords_arr = reinterpret_cast<PyArrayObject*>(coords.ptr());
+  if (PyArray_NDIM(coords_arr) != 2 || PyArray_DIMS(coords_arr)[1] != 4) {
+    throw std::runtime_error("windows must be an N x 4 array");
+  }
+  // Map the windows from input to feature map pixels.
+  const double scale_y = features.height() / static_cast<double>(
+      input.height());
+  const double scale_x = features.width() / static_cast<double>(
+      input.width());
+  const int* coords_data = static_cast<int*>(PyArray_DATA(coords_arr));
+  vector<int> feature_windows(coords_data,
+      coords_data + PyArray_SIZE(coords_arr));
+  for (int i = 0; i < feature_windows.size(); i += 4) {
+    int* window = &feature_windows[i];
+    if (!ClipWindow(input.height(), input.width(), window)) {
+      throw std::runtime_error("windows must overlap the input");
+    }
+    // PoolWindows() takes inclusive windows.
+    window[0] = std::floor(window[0] * scale_y);
+    window[1] = std::floor(window[1] * scale_x);
+    window[2] = std::ceil(window[2] * scale_y) - 1;
+    window[3] = std::ceil(window[3] * scale_x) - 1;
+  }
+  ScopedGILRelease release;
+  SPPLayer<Dtype>::PoolWindows(layer.layer_param(), features, feature_windows,
+      net->top_vecs()[layer_id][0]);
+}
+
 void Net_Save(const Net<Dtype>& net, string filename) {
   NetParameter net_param;
   net.ToProto(&net_param, false);
@@ -207,8 +686,6 @@ bp::object BlobVec_add_blob(bp::tuple args, bp::dict kwargs) {
   return bp::object();
 }
 
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SolveOverloads, Solve, 0, 1);
-
 BOOST_PYTHON_MODULE(_caffe) {
   // below, we prepend an underscore to methods that will be replaced
   // in Python
@@ -218,17 +695,21 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::def("set_device", &Caffe::SetDevice);
 
   bp::def("layer_type_list", &LayerRegistry<Dtype>::LayerTypeList);
+#ifdef USE_OPENCV
+  bp::def("_preprocess_batch", &PreprocessBatch);
+  bp::def("_preprocess_windows", &PreprocessWindows);
+#endif  // USE_OPENCV
 
   bp::class_<Net<Dtype>, shared_ptr<Net<Dtype> >, boost::noncopyable >("Net",
     bp::no_init)
     .def("__init__", bp::make_constructor(&Net_Init))
     .def("__init__", bp::make_constructor(&Net_Init_Load))
-    .def("_forward", &Net<Dtype>::ForwardFromTo)
-    .def("_backward", &Net<Dtype>::BackwardFromTo)
-    .def("reshape", &Net<Dtype>::Reshape)
-    // The cast is to select a particular overload.
-    .def("copy_from", static_cast<void (Net<Dtype>::*)(const string)>(
-        &Net<Dtype>::CopyTrainedLayersFrom))
+    .def("_forward", &Net_ForwardFromTo)
+    .def("_backward", &Net_BackwardFromTo)
+    .def("_forward_all", &Net_ForwardAll)
+    .def("_pool_windows", &Net_PoolWindows)
+    .def("reshape", &Net_Reshape)
+    .def("copy_from", &Net_CopyFrom)
     .def("share_with", &Net<Dtype>::ShareTrainedLayersWith)
     .add_property("_blob_loss_weights", bp::make_function(
         &Net<Dtype>::blob_loss_weights, bp::return_internal_reference<>()))
@@ -249,6 +730,15 @@ BOOST_PYTHON_MODULE(_caffe) {
         bp::with_custodian_and_ward<1, 2, bp::with_custodian_and_ward<1, 3> >())
     .def("save", &Net_Save);
 
+  bp::class_<NetForwardWorker, shared_ptr<NetForwardWorker>,
+    boost::noncopyable>("_NetForwardWorker", bp::no_init)
+    .def("__init__", bp::make_constructor(&NetForwardWorker::Init))
+    .def("submit", &NetForwardWorker::Submit);
+  bp::class_<NetForwardFuture, shared_ptr<NetForwardFuture>,
+    boost::noncopyable>("_NetForwardFuture", bp::no_init)
+    .def("done", &NetForwardFuture::done)
+    .def("wait", &NetForwardFuture::wait);
+
   bp::class_<Blob<Dtype>, shared_ptr<Blob<Dtype> >, boost::noncopyable>(
     "Blob", bp::no_init)
     .add_property("shape",
@@ -285,9 +775,8 @@ BOOST_PYTHON_MODULE(_caffe) {
     .add_property("test_nets", bp::make_function(&Solver<Dtype>::test_nets,
           bp::return_internal_reference<>()))
     .add_property("iter", &Solver<Dtype>::iter)
-    .def("solve", static_cast<void (Solver<Dtype>::*)(const char*)>(
-          &Solver<Dtype>::Solve), SolveOverloads())
-    .def("step", &Solver<Dtype>::Step)
+    .def("solve", &Solver_Solve, SolveOverloads())
+    .def("step", &Solver_Step)
     .def("restore", &Solver<Dtype>::Restore)
     .def("snapshot", &Solver<Dtype>::Snapshot);
 
@@ -332,6 +821,12 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::class_<vector<bool> >("BoolVec")
     .def(bp::vector_indexing_suite<vector<bool> >());
 
+#if PY_VERSION_HEX < 0x03070000
+  // Set up the GIL, which the worker threads of forward_async and Python
+  // layers called from GIL-free code take.
+  PyEval_InitThreads();
+#endif
+
   // boost python expects a void (missing) return value, while import_array
   // returns NULL for python3. import_array1() forces a void return value.
   import_array1();
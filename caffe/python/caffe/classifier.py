@@ -44,6 +44,12 @@ class Classifier(caffe.Net):
             image_dims = self.crop_dims
         self.image_dims = image_dims
 
+        # the same options for the native preprocessing of predict
+        self.mean = None if mean is None else np.asarray(mean)
+        self.input_scale = 1. if input_scale is None else input_scale
+        self.raw_scale = 1. if raw_scale is None else raw_scale
+        self.channel_swap = [] if channel_swap is None else list(channel_swap)
+
     def predict(self, inputs, oversample=True):
         """
         Predict classification probabilities of inputs.
@@ -60,6 +66,46 @@ class Classifier(caffe.Net):
         predictions: (N x C) ndarray of class probabilities for N images and C
             classes.
         """
+        if hasattr(caffe._caffe, '_preprocess_batch'):
+            caffe_in = self._preprocess_native(inputs, oversample)
+        else:
+            caffe_in = self._preprocess(inputs, oversample)
+
+        # Classify
+        out = self.forward_all(**{self.inputs[0]: caffe_in})
+        predictions = out[self.outputs[0]]
+
+        # For oversampling, average predictions across crops.
+        if oversample:
+            predictions = predictions.reshape((len(predictions) // 10, 10, -1))
+            predictions = predictions.mean(1)
+
+        return predictions
+
+    def _preprocess_native(self, inputs, oversample):
+        """
+        Resize, crop and transform inputs in C++, on all cores, into the
+        (N x K x H x W) net input.
+        """
+        crops = 10 if oversample else 1
+        caffe_in = np.empty((len(inputs) * crops, inputs[0].shape[2])
+                            + tuple(self.crop_dims), dtype=np.float32)
+        # a per-channel mean is subtracted in C++, a full one afterwards
+        channel_mean = self.mean is not None and self.mean.ndim == 1
+        caffe._caffe._preprocess_batch(
+            caffe_in, list(inputs), tuple(int(d) for d in self.image_dims),
+            self.channel_swap, float(self.raw_scale),
+            list(self.mean) if channel_mean else [],
+            float(self.input_scale), oversample, 0)
+        if self.mean is not None and not channel_mean:
+            caffe_in -= self.mean * self.input_scale
+        return caffe_in
+
+    def _preprocess(self, inputs, oversample):
+        """
+        Resize, crop and transform inputs with caffe.io into the
+        (N x K x H x W) net input.
+        """
         # Scale to standardize input dimensions.
         input_ = np.zeros((len(inputs),
                            self.image_dims[0],
@@ -81,17 +127,8 @@ class Classifier(caffe.Net):
             ])
             input_ = input_[:, crop[0]:crop[2], crop[1]:crop[3], :]
 
-        # Classify
         caffe_in = np.zeros(np.array(input_.shape)[[0, 3, 1, 2]],
                             dtype=np.float32)
         for ix, in_ in enumerate(input_):
             caffe_in[ix] = self.transformer.preprocess(self.inputs[0], in_)
-        out = self.forward_all(**{self.inputs[0]: caffe_in})
-        predictions = out[self.outputs[0]]
-
-        # For oversampling, average predictions across crops.
-        if oversample:
-            predictions = predictions.reshape((len(predictions) / 10, 10, -1))
-            predictions = predictions.mean(1)
-
-        return predictions
+        return caffe_in
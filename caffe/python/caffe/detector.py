@@ -53,21 +53,54 @@ class Detector(caffe.Net):
 
         self.configure_crop(context_pad)
 
-    def detect_windows(self, images_windows):
+    def detect_windows(self, images_windows, shared_features=False):
         """
         Do windowed detection over given images and windows. Windows are
-        extracted then warped to the input dimensions of the net.
+        extracted then warped to the input dimensions of the net. Windows
+        are ymin, xmin, ymax, xmax, exclusive of ymax and xmax as in `crop`.
 
         Parameters
         ----------
         images_windows: (image filename, window list) iterable.
-        context_crop: size of context border to crop in pixels.
+        shared_features: compute the convolutional features once per image
+            and pool each window from them by the net's SPP layer, as in
+            SPP-net, instead of running the whole net on every window.
 
         Returns
         -------
         detections: list of {filename: image filename, window: crop coordinates,
             predictions: prediction vector} dicts.
         """
+        images_windows = list(images_windows)
+        if shared_features:
+            predictions = self._predict_shared_features(images_windows)
+        else:
+            native = self._native_preprocessing()
+            if native is not None:
+                # Crop, warp and preprocess the windows in parallel in C++.
+                caffe_in = self._crop_windows_native(images_windows, native)
+            else:
+                caffe_in = self._crop_windows(images_windows)
+            out = self.forward_all(**{self.inputs[0]: caffe_in})
+            predictions = out[self.outputs[0]].squeeze(axis=(2, 3))
+
+        # Package predictions with images and windows.
+        detections = []
+        ix = 0
+        for image_fname, windows in images_windows:
+            for window in windows:
+                detections.append({
+                    'window': window,
+                    'prediction': predictions[ix],
+                    'filename': image_fname
+                })
+                ix += 1
+        return detections
+
+    def _crop_windows(self, images_windows):
+        """
+        Crop and preprocess windows window by window in Python.
+        """
         # Extract windows.
         window_inputs = []
         for image_fname, windows in images_windows:
@@ -75,28 +108,97 @@ class Detector(caffe.Net):
             for window in windows:
                 window_inputs.append(self.crop(image, window))
 
-        # Run through the net (warping windows to input dimensions).
+        # Preprocess (warping windows to input dimensions).
         in_ = self.inputs[0]
         caffe_in = np.zeros((len(window_inputs), window_inputs[0].shape[2])
                             + self.blobs[in_].data.shape[2:],
                             dtype=np.float32)
         for ix, window_in in enumerate(window_inputs):
             caffe_in[ix] = self.transformer.preprocess(in_, window_in)
-        out = self.forward_all(**{in_: caffe_in})
-        predictions = out[self.outputs[0]].squeeze(axis=(2, 3))
+        return caffe_in
 
-        # Package predictions with images and windows.
-        detections = []
+    def _native_preprocessing(self):
+        """
+        Return the preprocessing as (channel_swap, raw_scale, mean,
+        input_scale) arguments of the native routines, or None if pycaffe is
+        built without them or the mean is not per channel.
+        """
+        if not hasattr(caffe._caffe, '_preprocess_windows'):
+            return None
+        in_ = self.inputs[0]
+        mean = self.transformer.mean.get(in_)
+        if mean is None:
+            mean = []
+        elif mean.shape[1:] == (1, 1):
+            mean = [float(m) for m in mean.ravel()]
+        else:
+            return None
+        channel_swap = self.transformer.channel_swap.get(in_)
+        raw_scale = self.transformer.raw_scale.get(in_)
+        input_scale = self.transformer.input_scale.get(in_)
+        return (list(channel_swap) if channel_swap is not None else [],
+                float(raw_scale) if raw_scale is not None else 1.,
+                mean,
+                float(input_scale) if input_scale is not None else 1.)
+
+    def _crop_windows_native(self, images_windows, native):
+        """
+        Crop, warp and preprocess the windows of each image straight into
+        the net input, with the context padding of WindowDataLayer.
+        """
+        channel_swap, raw_scale, mean, input_scale = native
+        in_ = self.inputs[0]
+        num = sum(len(windows) for _, windows in images_windows)
+        caffe_in = np.empty((num,) + self.blobs[in_].data.shape[1:],
+                            dtype=np.float32)
         ix = 0
         for image_fname, windows in images_windows:
-            for window in windows:
-                detections.append({
-                    'window': window,
-                    'prediction': predictions[ix],
-                    'filename': image_fname
-                })
-                ix += 1
-        return detections
+            image = caffe.io.load_image(image_fname)
+            windows = np.asarray(windows, dtype=np.int32).reshape(-1, 4)
+            caffe._caffe._preprocess_windows(
+                caffe_in[ix:ix + len(windows)], image, windows, channel_swap,
+                raw_scale, mean, input_scale, self.context_pad or 0, 0)
+            ix += len(windows)
+        return caffe_in
+
+    def _predict_shared_features(self, images_windows):
+        """
+        Run the layers below the SPP layer once per whole image, pool every
+        window from their features and run the layers above on the windows.
+        """
+        types = [layer.type for layer in self.layers]
+        if 'SPP' not in types:
+            raise ValueError('Sharing features needs a net with an SPP layer.')
+        spp = types.index('SPP')
+        in_ = self.inputs[0]
+        channel_swap = self.transformer.channel_swap.get(in_)
+        raw_scale = self.transformer.raw_scale.get(in_)
+        input_scale = self.transformer.input_scale.get(in_)
+        mean = self.transformer.mean.get(in_)
+        if mean is not None:
+            # Whole images take the mean of each channel.
+            mean = mean.reshape(mean.shape[0], -1).mean(1)[:, None, None]
+        predictions = []
+        for image_fname, windows in images_windows:
+            image = caffe.io.load_image(image_fname).astype(np.float32)
+            caffe_in = image.transpose((2, 0, 1))
+            if channel_swap is not None:
+                caffe_in = caffe_in[channel_swap, :, :]
+            if raw_scale is not None:
+                caffe_in = caffe_in * raw_scale
+            if mean is not None:
+                caffe_in = caffe_in - mean
+            if input_scale is not None:
+                caffe_in = caffe_in * input_scale
+            self.blobs[in_].reshape(1, *caffe_in.shape)
+            self.reshape()
+            self.blobs[in_].data[...] = caffe_in
+            self._forward(0, spp - 1)
+            self._pool_windows(spp, np.asarray(windows).reshape(-1, 4))
+            self._forward(spp + 1, len(self.layers) - 1)
+            out = self.blobs[self.outputs[0]].data
+            predictions.append(out.reshape(len(windows), -1).copy())
+        return np.concatenate(predictions)
 
     def detect_selective_search(self, image_fnames):
         """
@@ -130,7 +232,8 @@ class Detector(caffe.Net):
         Parameters
         ----------
         im: H x W x K image ndarray to crop.
-        window: bounding box coordinates as ymin, xmin, ymax, xmax.
+        window: bounding box coordinates as ymin, xmin, ymax, xmax,
+            exclusive of ymax and xmax like slice bounds.
 
         Returns
         -------
@@ -8,10 +8,11 @@ try:
     from itertools import izip_longest
 except:
     from itertools import zip_longest as izip_longest
+import weakref
 import numpy as np
 
 from ._caffe import Net, SGDSolver, NesterovSolver, AdaGradSolver, \
-        RMSPropSolver, AdaDeltaSolver, AdamSolver
+        RMSPropSolver, AdaDeltaSolver, AdamSolver, _NetForwardWorker
 import caffe.io
 
 # We directly update methods from Net here (rather than using composition or
@@ -59,23 +60,10 @@ def _Net_outputs(self):
     return [list(self.blobs.keys())[i] for i in self._outputs]
 
 
-def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
+def _Net_forward_setup(self, blobs, start, end, kwargs):
     """
-    Forward pass: prepare inputs and run the net forward.
-
-    Parameters
-    ----------
-    blobs : list of blobs to return in addition to output blobs.
-    kwargs : Keys are input blob names and values are blob ndarrays.
-             For formatting inputs for Caffe, see Net.preprocess().
-             If None, input is taken from data layers.
-    start : optional name of layer at which to begin the forward pass
-    end : optional name of layer at which to finish the forward pass
-          (inclusive)
-
-    Returns
-    -------
-    outs : {blob name: blob ndarray} dict.
+    Set the inputs of a forward pass and return its layer range and outputs
+    as (start_ind, end_ind, outputs); see forward() for the arguments.
     """
     if blobs is None:
         blobs = []
@@ -102,12 +90,102 @@ def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
                 raise Exception('Input is not batch sized')
             self.blobs[in_].data[...] = blob
 
+    return start_ind, end_ind, outputs
+
+
+def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
+    """
+    Forward pass: prepare inputs and run the net forward.
+
+    Parameters
+    ----------
+    blobs : list of blobs to return in addition to output blobs.
+    kwargs : Keys are input blob names and values are blob ndarrays.
+             For formatting inputs for Caffe, see Net.preprocess().
+             If None, input is taken from data layers.
+    start : optional name of layer at which to begin the forward pass
+    end : optional name of layer at which to finish the forward pass
+          (inclusive)
+
+    Returns
+    -------
+    outs : {blob name: blob ndarray} dict.
+    """
+    start_ind, end_ind, outputs = self._forward_setup(blobs, start, end,
+                                                      kwargs)
+
     self._forward(start_ind, end_ind)
 
     # Unpack blobs to extract
     return {out: self.blobs[out].data for out in outputs}
 
 
+class NetFuture(object):
+    """
+    The pending result of Net.forward_async().
+    """
+    def __init__(self, net, future, outputs):
+        self._net = net
+        self._future = future
+        self._outputs = outputs
+        self._result = None
+
+    def done(self):
+        """Whether the forward pass has finished."""
+        return self._result is not None or self._future.done()
+
+    def result(self):
+        """
+        Wait for the forward pass to finish.
+
+        Returns
+        -------
+        outs : {blob name: blob ndarray} dict, as returned by forward(), but
+               of copies that later passes leave alone.
+        """
+        if self._result is None:
+            self._future.wait()
+            self._result = {out: self._net.blobs[out].data.copy()
+                            for out in self._outputs}
+            self._net = None
+        return self._result
+
+
+def _Net_forward_async(self, blobs=None, start=None, end=None, **kwargs):
+    """
+    Forward pass on a background thread: prepare inputs, start the forward
+    pass and return without waiting for it, so that Python can go on, e.g.
+    preprocessing the next batch. Arguments are as for forward().
+
+    The net's blobs must not be read or written, and the net must not be run
+    otherwise, until the returned future is done. The next forward_async()
+    waits for the pending pass, and keeps its outputs for its future, before
+    setting its own inputs, so one pass runs at a time.
+
+    Returns
+    -------
+    future : NetFuture whose result() is the {blob name: blob ndarray} dict.
+    """
+    pending = getattr(self, '_forward_pending', None)
+    if pending is not None:
+        future, net_future = pending
+        net_future = net_future()
+        if net_future is not None:
+            net_future.result()
+        else:
+            future.wait()
+        self._forward_pending = None
+    start_ind, end_ind, outputs = self._forward_setup(blobs, start, end,
+                                                      kwargs)
+    if not hasattr(self, '_forward_worker'):
+        self._forward_worker = _NetForwardWorker(self)
+    future = self._forward_worker.submit(start_ind, end_ind)
+    net_future = NetFuture(self, future, outputs)
+    # Hold the future weakly: it holds the net.
+    self._forward_pending = (future, weakref.ref(net_future))
+    return net_future
+
+
 def _Net_backward(self, diffs=None, start=None, end=None, **kwargs):
     """
     Backward pass: prepare diffs and run the net backward.
@@ -168,23 +246,13 @@ def _Net_forward_all(self, blobs=None, **kwargs):
 
     Returns
     -------
-    all_outs : {blob name: list of blobs} dict.
+    all_outs : {blob name: blob ndarray} dict, with one entry per input item.
     """
-    # Collect outputs from batches
-    all_outs = {out: [] for out in set(self.outputs + (blobs or []))}
-    for batch in self._batch(kwargs):
-        outs = self.forward(blobs=blobs, **batch)
-        for out, out_blob in outs.iteritems():
-            all_outs[out].extend(out_blob.copy())
-    # Package in ndarray.
-    for out in all_outs:
-        all_outs[out] = np.asarray(all_outs[out])
-    # Discard padding.
-    pad = len(all_outs.itervalues().next()) - len(kwargs.itervalues().next())
-    if pad:
-        for out in all_outs:
-            all_outs[out] = all_outs[out][:-pad]
-    return all_outs
+    if set(kwargs.keys()) != set(self.inputs):
+        raise Exception('Input blob arguments do not match net inputs.')
+    # The batches run in C++, which writes the outputs into arrays allocated
+    # once and prepares the next batch while the net computes the current.
+    return self._forward_all(kwargs, list(set(self.outputs + (blobs or []))))
 
 
 def _Net_forward_backward_all(self, blobs=None, diffs=None, **kwargs):
@@ -281,6 +349,8 @@ Net.blobs = _Net_blobs
 Net.blob_loss_weights = _Net_blob_loss_weights
 Net.params = _Net_params
 Net.forward = _Net_forward
+Net.forward_async = _Net_forward_async
+Net._forward_setup = _Net_forward_setup
 Net.backward = _Net_backward
 Net.forward_all = _Net_forward_all
 Net.forward_backward_all = _Net_forward_backward_all
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <climits>
 #include <vector>
 
@@ -465,31 +466,24 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
   } else {
     CHECK(ShapeEquals(proto)) << "shape mismatch (reshape not set)";
   }
-  // copy data
+  // copy data: the repeated fields are contiguous arrays, so this is a bulk
+  // memcpy when their type is Dtype and a converting copy otherwise.
   Dtype* data_vec = mutable_cpu_data();
   if (proto.double_data_size() > 0) {
     CHECK_EQ(count_, proto.double_data_size());
-    for (int i = 0; i < count_; ++i) {
-      data_vec[i] = proto.double_data(i);
-    }
+    std::copy(proto.double_data().begin(), proto.double_data().end(),
+        data_vec);
   } else {
     CHECK_EQ(count_, proto.data_size());
-    for (int i = 0; i < count_; ++i) {
-      data_vec[i] = proto.data(i);
-    }
+    std::copy(proto.data().begin(), proto.data().end(), data_vec);
   }
   if (proto.double_diff_size() > 0) {
     CHECK_EQ(count_, proto.double_diff_size());
-    Dtype* diff_vec = mutable_cpu_diff();
-    for (int i = 0; i < count_; ++i) {
-      diff_vec[i] = proto.double_diff(i);
-    }
+    std::copy(proto.double_diff().begin(), proto.double_diff().end(),
+        mutable_cpu_diff());
   } else if (proto.diff_size() > 0) {
     CHECK_EQ(count_, proto.diff_size());
-    Dtype* diff_vec = mutable_cpu_diff();
-    for (int i = 0; i < count_; ++i) {
-      diff_vec[i] = proto.diff(i);
-    }
+    std::copy(proto.diff().begin(), proto.diff().end(), mutable_cpu_diff());
   }
 }
 
@@ -1,11 +1,13 @@
 #include <boost/thread.hpp>
 #include <glog/logging.h>
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <ctime>
 
 #include "caffe/common.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -40,6 +42,52 @@ int64_t cluster_seedgen(void) {
 }
 
 
+// The intra-op thread pool of the process and its settings.
+static boost::mutex thread_pool_mutex_;
+static shared_ptr<ThreadPool> thread_pool_;
+static int num_threads_ = 0;
+static vector<int> thread_affinity_;
+
+// The threads of the pool, with 0 resolved to one per core.
+static int PoolThreads() {
+  return num_threads_ > 0 ? num_threads_ :
+      std::max<int>(boost::thread::hardware_concurrency(), 1);
+}
+
+int Caffe::num_threads() {
+  boost::mutex::scoped_lock lock(thread_pool_mutex_);
+  return PoolThreads();
+}
+
+void Caffe::set_num_threads(int num_threads) {
+  CHECK_GE(num_threads, 0);
+  {
+    boost::mutex::scoped_lock lock(thread_pool_mutex_);
+    num_threads_ = num_threads;
+    thread_pool_.reset();
+  }
+  SetBlasThreads(Caffe::num_threads());
+}
+
+vector<int> Caffe::thread_affinity() {
+  boost::mutex::scoped_lock lock(thread_pool_mutex_);
+  return thread_affinity_;
+}
+
+void Caffe::set_thread_affinity(const vector<int>& cpus) {
+  boost::mutex::scoped_lock lock(thread_pool_mutex_);
+  thread_affinity_ = cpus;
+  thread_pool_.reset();
+}
+
+ThreadPool& Caffe::thread_pool() {
+  boost::mutex::scoped_lock lock(thread_pool_mutex_);
+  if (!thread_pool_) {
+    thread_pool_.reset(new ThreadPool(PoolThreads(), thread_affinity_));
+  }
+  return *thread_pool_;
+}
+
 void GlobalInit(int* pargc, char*** pargv) {
   // Google flags.
   ::gflags::ParseCommandLineFlags(pargc, pargv, true);
@@ -53,7 +101,8 @@ void GlobalInit(int* pargc, char*** pargv) {
 
 Caffe::Caffe()
     : random_generator_(), mode_(Caffe::CPU),
-      solver_count_(1), root_solver_(true) { }
+      solver_count_(1), root_solver_(true), autotune_(false),
+      im2col_cache_bytes_(0), conv_batch_bytes_(0), fuse_neurons_(false) { }
 
 Caffe::~Caffe() { }
 
@@ -97,7 +146,9 @@ void* Caffe::RNG::generator() {
 
 Caffe::Caffe()
     : cublas_handle_(NULL), curand_generator_(NULL), random_generator_(),
-    mode_(Caffe::CPU), solver_count_(1), root_solver_(true) {
+    mode_(Caffe::CPU), solver_count_(1), root_solver_(true),
+    autotune_(false), im2col_cache_bytes_(0), conv_batch_bytes_(0),
+    fuse_neurons_(false) {
   // Try to create a cublas handler, and report an error if failed (but we will
   // keep the program running as one might just want to run CPU code).
   if (cublasCreate(&cublas_handle_) != CUBLAS_STATUS_SUCCESS) {
@@ -41,7 +41,11 @@ DataReader::~DataReader() {
 
 //
 
-DataReader::QueuePair::QueuePair(int size) {
+// Each queue is pushed and popped by the reading thread on one side and the
+// prefetch thread of the data layer on the other.
+DataReader::QueuePair::QueuePair(int size)
+    : free_(size, RingQueue<Datum*>::SINGLE_PRODUCER_CONSUMER),
+      full_(size, RingQueue<Datum*>::SINGLE_PRODUCER_CONSUMER) {
   // Initialize the free queue with requested number of datums
   for (int i = 0; i < size; ++i) {
     free_.push(new Datum());
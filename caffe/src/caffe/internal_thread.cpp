@@ -1,3 +1,4 @@
+#include <boost/atomic.hpp>
 #include <boost/thread.hpp>
 #include <exception>
 
@@ -6,6 +7,8 @@
 
 namespace caffe {
 
+static boost::atomic<int> num_started_(0);
+
 InternalThread::~InternalThread() {
   StopInternalThread();
 }
@@ -14,6 +17,10 @@ bool InternalThread::is_started() const {
   return thread_ && thread_->joinable();
 }
 
+int InternalThread::num_started() {
+  return num_started_.load();
+}
+
 bool InternalThread::must_stop() {
   return thread_ && thread_->interruption_requested();
 }
@@ -21,32 +28,42 @@ bool InternalThread::must_stop() {
 void InternalThread::StartInternalThread() {
   CHECK(!is_started()) << "Threads should persist and not be restarted.";
 
-  int device = 0;
+  Settings settings;
+  settings.device = 0;
 #ifndef CPU_ONLY
-  CUDA_CHECK(cudaGetDevice(&device));
+  CUDA_CHECK(cudaGetDevice(&settings.device));
 #endif
-  Caffe::Brew mode = Caffe::mode();
-  int rand_seed = caffe_rng_rand();
-  int solver_count = Caffe::solver_count();
-  bool root_solver = Caffe::root_solver();
+  settings.mode = Caffe::mode();
+  settings.rand_seed = caffe_rng_rand();
+  settings.solver_count = Caffe::solver_count();
+  settings.root_solver = Caffe::root_solver();
+  settings.im2col_cache_bytes = Caffe::im2col_cache_bytes();
+  settings.conv_batch_bytes = Caffe::conv_batch_bytes();
+  settings.fuse_neurons = Caffe::fuse_neurons();
+  settings.autotune = Caffe::autotune();
+  settings.autotune_cache = Caffe::autotune_cache();
 
   try {
-    thread_.reset(new boost::thread(&InternalThread::entry, this, device, mode,
-          rand_seed, solver_count, root_solver));
+    thread_.reset(new boost::thread(&InternalThread::entry, this, settings));
+    ++num_started_;
   } catch (std::exception& e) {
     LOG(FATAL) << "Thread exception: " << e.what();
   }
 }
 
-void InternalThread::entry(int device, Caffe::Brew mode, int rand_seed,
-    int solver_count, bool root_solver) {
+void InternalThread::entry(const Settings& settings) {
 #ifndef CPU_ONLY
-  CUDA_CHECK(cudaSetDevice(device));
+  CUDA_CHECK(cudaSetDevice(settings.device));
 #endif
-  Caffe::set_mode(mode);
-  Caffe::set_random_seed(rand_seed);
-  Caffe::set_solver_count(solver_count);
-  Caffe::set_root_solver(root_solver);
+  Caffe::set_mode(settings.mode);
+  Caffe::set_random_seed(settings.rand_seed);
+  Caffe::set_solver_count(settings.solver_count);
+  Caffe::set_root_solver(settings.root_solver);
+  Caffe::set_im2col_cache_bytes(settings.im2col_cache_bytes);
+  Caffe::set_conv_batch_bytes(settings.conv_batch_bytes);
+  Caffe::set_fuse_neurons(settings.fuse_neurons);
+  Caffe::set_autotune(settings.autotune);
+  Caffe::set_autotune_cache(settings.autotune_cache);
 
   InternalThreadEntry();
 }
@@ -60,6 +77,7 @@ void InternalThread::StopInternalThread() {
     } catch (std::exception& e) {
       LOG(FATAL) << "Thread exception: " << e.what();
     }
+    --num_started_;
   }
 }
 
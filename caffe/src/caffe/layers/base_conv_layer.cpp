@@ -3,6 +3,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/broadcast_functions.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -100,6 +101,17 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
         kernel_shape_data[i] == 1 && stride_data[i] == 1 && pad_data[i] == 0;
     if (!is_1x1_) { break; }
   }
+  // Pick the 2D im2col/col2im, compiled for the geometry where one is.
+  im2col_cpu_func_ = &im2col_cpu<Dtype>;
+  col2im_cpu_func_ = &col2im_cpu<Dtype>;
+  if (num_spatial_axes_ == 2) {
+    im2col_cpu_func_ = im2col_cpu_func<Dtype>(kernel_shape_data[0],
+        kernel_shape_data[1], pad_data[0], pad_data[1], stride_data[0],
+        stride_data[1]);
+    col2im_cpu_func_ = col2im_cpu_func<Dtype>(kernel_shape_data[0],
+        kernel_shape_data[1], pad_data[0], pad_data[1], stride_data[0],
+        stride_data[1]);
+  }
   // Configure output channels and groups.
   channels_ = bottom[0]->shape(channel_axis_);
   num_output_ = this->layer_param_.convolution_param().num_output();
@@ -225,29 +237,58 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     }
   }
   col_buffer_.Reshape(col_buffer_shape_);
+  // Columns of the forward pass are cached for training alone, as long as
+  // they fit the budget.
+  num_cached_columns_ = 0;
+  const size_t col_bytes = col_buffer_.count() * sizeof(Dtype);
+  if (!is_1x1_ && this->phase_ == TRAIN && col_bytes > 0) {
+    num_cached_columns_ = std::min<size_t>(bottom.size() * num_,
+        Caffe::im2col_cache_bytes() / col_bytes);
+  }
+  vector<int> col_cache_shape(1, num_cached_columns_ * col_buffer_.count());
+  col_cache_.Reshape(col_cache_shape);
+  columns_cached_ = false;
+  // Several images are multiplied at once if the columns and outputs of at
+  // least two fit the batch budget.
+  const size_t image_bytes = (col_buffer_.count()
+      + conv_out_channels_ * conv_out_spatial_dim_) * sizeof(Dtype);
+  batch_images_ = 1;
+  if (image_bytes > 0) {
+    batch_images_ = std::max<size_t>(1, std::min<size_t>(num_,
+        Caffe::conv_batch_bytes() / image_bytes));
+  }
+  const int batch_width = batch_images_ > 1 ? batch_images_ : 0;
+  vector<int> batch_shape(1, batch_width * col_buffer_.count());
+  batch_col_buffer_.Reshape(batch_shape);
+  batch_shape[0] = batch_width * conv_out_channels_ * conv_out_spatial_dim_;
+  batch_output_buffer_.Reshape(batch_shape);
   bottom_dim_ = bottom[0]->count(channel_axis_);
   top_dim_ = top[0]->count(channel_axis_);
   num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
   num_kernels_col2im_ = reverse_dimensions() ? top_dim_ : bottom_dim_;
-  // Set up the all ones "bias multiplier" for adding biases by BLAS
   out_spatial_dim_ = top[0]->count(first_spatial_axis);
+#ifndef CPU_ONLY
+  // Set up the all ones "bias multiplier" for adding biases by BLAS on the
+  // GPU; the CPU broadcasts them directly.
   if (bias_term_) {
     vector<int> bias_multiplier_shape(1, out_spatial_dim_);
     bias_multiplier_.Reshape(bias_multiplier_shape);
     caffe_set(bias_multiplier_.count(), Dtype(1),
         bias_multiplier_.mutable_cpu_data());
   }
+#endif
 }
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
-    const Dtype* weights, Dtype* output, bool skip_im2col) {
+    const Dtype* weights, Dtype* output, bool skip_im2col, int cache_index) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    if (!skip_im2col) {
-      conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+    if (skip_im2col) {
+      col_buff = col_buffer_.cpu_data();
+    } else {
+      col_buff = cpu_columns(input, cache_index, true);
     }
-    col_buff = col_buffer_.cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
@@ -260,9 +301,8 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_output_,
-      out_spatial_dim_, 1, (Dtype)1., bias, bias_multiplier_.cpu_data(),
-      (Dtype)1., output);
+  caffe_cpu_broadcast_add(1, num_output_, out_spatial_dim_, Dtype(1), bias,
+      output, output);
 }
 
 template <typename Dtype>
@@ -285,11 +325,10 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
-    const Dtype* output, Dtype* weights) {
+    const Dtype* output, Dtype* weights, int cache_index) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
-    col_buff = col_buffer_.cpu_data();
+    col_buff = cpu_columns(input, cache_index, false);
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
@@ -302,8 +341,147 @@ void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
     const Dtype* input) {
-  caffe_cpu_gemv<Dtype>(CblasNoTrans, num_output_, out_spatial_dim_, 1.,
-      input, bias_multiplier_.cpu_data(), 1., bias);
+  caffe_cpu_axis_sum(1, num_output_, out_spatial_dim_, Dtype(1), input,
+      Dtype(1), bias);
+}
+
+template <typename Dtype>
+const Dtype* BaseConvolutionLayer<Dtype>::cpu_columns(const Dtype* input,
+    int cache_index, bool forward) {
+  if (cache_index >= 0 && cache_index < num_cached_columns_) {
+    const int offset = cache_index * col_buffer_.count();
+    if (forward) {
+      Dtype* cached = col_cache_.mutable_cpu_data() + offset;
+      conv_im2col_cpu(input, cached);
+      return cached;
+    } else if (columns_cached_) {
+      return col_cache_.cpu_data() + offset;
+    }
+  }
+  conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+  return col_buffer_.cpu_data();
+}
+
+// Copies a rows x cols block to cols columns of a matrix width wide, or back.
+template <typename Dtype>
+static void block_to_matrix(const Dtype* block, int rows, int cols,
+    int width, Dtype* matrix) {
+  for (int r = 0; r < rows; ++r) {
+    caffe_copy(cols, block + r * cols, matrix + r * width);
+  }
+}
+
+template <typename Dtype>
+static void matrix_to_block(const Dtype* matrix, int rows, int cols,
+    int width, Dtype* block) {
+  for (int r = 0; r < rows; ++r) {
+    caffe_copy(cols, matrix + r * width, block + r * cols);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_batch(const Dtype* input,
+    const Dtype* weights, Dtype* output, int num_images, bool skip_im2col,
+    int cache_index) {
+  if (num_images == 1) {
+    forward_cpu_gemm(input, weights, output, skip_im2col, cache_index);
+    return;
+  }
+  CHECK_LE(num_images, batch_images_);
+  const int input_dim = reverse_dimensions() ? top_dim_ : bottom_dim_;
+  const int output_dim = conv_out_channels_ * conv_out_spatial_dim_;
+  const int width = num_images * conv_out_spatial_dim_;
+  Dtype* col_buff = batch_col_buffer_.mutable_cpu_data();
+  Dtype* output_buff = batch_output_buffer_.mutable_cpu_data();
+  for (int n = 0; n < num_images && !skip_im2col; ++n) {
+    const Dtype* columns = input + n * input_dim;
+    if (!is_1x1_) {
+      columns = cpu_columns(columns, cache_index < 0 ? -1 : cache_index + n,
+          true);
+    }
+    block_to_matrix(columns, kernel_dim_ * group_, conv_out_spatial_dim_,
+        width, col_buff + n * conv_out_spatial_dim_);
+  }
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
+        group_, width, kernel_dim_,
+        (Dtype)1., weights + weight_offset_ * g,
+        col_buff + col_offset_ * num_images * g,
+        (Dtype)0., output_buff + output_offset_ * num_images * g);
+  }
+  for (int n = 0; n < num_images; ++n) {
+    matrix_to_block(output_buff + n * conv_out_spatial_dim_,
+        conv_out_channels_, conv_out_spatial_dim_, width,
+        output + n * output_dim);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_gemm_batch(const Dtype* output,
+    const Dtype* weights, Dtype* input, int num_images) {
+  if (num_images == 1) {
+    backward_cpu_gemm(output, weights, input);
+    return;
+  }
+  CHECK_LE(num_images, batch_images_);
+  const int input_dim = reverse_dimensions() ? top_dim_ : bottom_dim_;
+  const int output_dim = conv_out_channels_ * conv_out_spatial_dim_;
+  const int width = num_images * conv_out_spatial_dim_;
+  Dtype* col_buff = batch_col_buffer_.mutable_cpu_data();
+  Dtype* output_buff = batch_output_buffer_.mutable_cpu_data();
+  for (int n = 0; n < num_images; ++n) {
+    block_to_matrix(output + n * output_dim, conv_out_channels_,
+        conv_out_spatial_dim_, width, output_buff + n * conv_out_spatial_dim_);
+  }
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
+        width, conv_out_channels_ / group_,
+        (Dtype)1., weights + weight_offset_ * g,
+        output_buff + output_offset_ * num_images * g,
+        (Dtype)0., col_buff + col_offset_ * num_images * g);
+  }
+  for (int n = 0; n < num_images; ++n) {
+    Dtype* columns = is_1x1_ ? input + n * input_dim
+        : col_buffer_.mutable_cpu_data();
+    matrix_to_block(col_buff + n * conv_out_spatial_dim_, kernel_dim_ * group_,
+        conv_out_spatial_dim_, width, columns);
+    if (!is_1x1_) {
+      conv_col2im_cpu(columns, input + n * input_dim);
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_gemm_batch(const Dtype* input,
+    const Dtype* output, Dtype* weights, int num_images, int cache_index) {
+  if (num_images == 1) {
+    weight_cpu_gemm(input, output, weights, cache_index);
+    return;
+  }
+  CHECK_LE(num_images, batch_images_);
+  const int input_dim = reverse_dimensions() ? top_dim_ : bottom_dim_;
+  const int output_dim = conv_out_channels_ * conv_out_spatial_dim_;
+  const int width = num_images * conv_out_spatial_dim_;
+  Dtype* col_buff = batch_col_buffer_.mutable_cpu_data();
+  Dtype* output_buff = batch_output_buffer_.mutable_cpu_data();
+  for (int n = 0; n < num_images; ++n) {
+    const Dtype* columns = input + n * input_dim;
+    if (!is_1x1_) {
+      columns = cpu_columns(columns, cache_index < 0 ? -1 : cache_index + n,
+          false);
+    }
+    block_to_matrix(columns, kernel_dim_ * group_, conv_out_spatial_dim_,
+        width, col_buff + n * conv_out_spatial_dim_);
+    block_to_matrix(output + n * output_dim, conv_out_channels_,
+        conv_out_spatial_dim_, width, output_buff + n * conv_out_spatial_dim_);
+  }
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
+        kernel_dim_, width,
+        (Dtype)1., output_buff + output_offset_ * num_images * g,
+        col_buff + col_offset_ * num_images * g,
+        (Dtype)1., weights + weight_offset_ * g);
+  }
 }
 
 #ifndef CPU_ONLY
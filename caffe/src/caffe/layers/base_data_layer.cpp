@@ -7,7 +7,8 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
-#include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/ring_queue.hpp"
 
 namespace caffe {
 
@@ -36,7 +37,11 @@ template <typename Dtype>
 BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
     const LayerParameter& param)
     : BaseDataLayer<Dtype>(param),
-      prefetch_free_(), prefetch_full_() {
+      prefetch_free_(PREFETCH_COUNT,
+          RingQueue<Batch<Dtype>*>::SINGLE_PRODUCER_CONSUMER),
+      prefetch_full_(PREFETCH_COUNT,
+          RingQueue<Batch<Dtype>*>::SINGLE_PRODUCER_CONSUMER),
+      prefetch_wait_us_(0) {
   for (int i = 0; i < PREFETCH_COUNT; ++i) {
     prefetch_free_.push(&prefetch_[i]);
   }
@@ -103,10 +108,22 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 #endif
 }
 
+template <typename Dtype>
+Batch<Dtype>* BasePrefetchingDataLayer<Dtype>::PopFullBatch() {
+  Batch<Dtype>* batch;
+  if (!prefetch_full_.try_pop(&batch)) {
+    CPUTimer timer;
+    timer.Start();
+    batch = prefetch_full_.pop("Data layer prefetch queue empty");
+    prefetch_wait_us_ += timer.MicroSeconds();
+  }
+  return batch;
+}
+
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  Batch<Dtype>* batch = PopFullBatch();
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
   // Copy the data
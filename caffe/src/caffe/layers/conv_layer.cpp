@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
@@ -26,15 +27,18 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
-    for (int n = 0; n < this->num_; ++n) {
-      this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
-      if (this->bias_term_) {
+    for (int n = 0; n < this->num_; n += this->batch_images_) {
+      const int num_images = std::min(this->batch_images_, this->num_ - n);
+      this->forward_cpu_gemm_batch(bottom_data + n * this->bottom_dim_, weight,
+          top_data + n * this->top_dim_, num_images, false,
+          i * this->num_ + n);
+      for (int j = n; j < n + num_images && this->bias_term_; ++j) {
         const Dtype* bias = this->blobs_[1]->cpu_data();
-        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+        this->forward_cpu_bias(top_data + j * this->top_dim_, bias);
       }
     }
   }
+  this->columns_cached_ = true;
 }
 
 template <typename Dtype>
@@ -54,20 +58,24 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       }
     }
     if (this->param_propagate_down_[0] || propagate_down[i]) {
-      for (int n = 0; n < this->num_; ++n) {
+      for (int n = 0; n < this->num_; n += this->batch_images_) {
+        const int num_images = std::min(this->batch_images_, this->num_ - n);
         // gradient w.r.t. weight. Note that we will accumulate diffs.
         if (this->param_propagate_down_[0]) {
-          this->weight_cpu_gemm(bottom_data + n * this->bottom_dim_,
-              top_diff + n * this->top_dim_, weight_diff);
+          this->weight_cpu_gemm_batch(bottom_data + n * this->bottom_dim_,
+              top_diff + n * this->top_dim_, weight_diff, num_images,
+              i * this->num_ + n);
         }
         // gradient w.r.t. bottom data, if necessary.
         if (propagate_down[i]) {
-          this->backward_cpu_gemm(top_diff + n * this->top_dim_, weight,
-              bottom_diff + n * this->bottom_dim_);
+          this->backward_cpu_gemm_batch(top_diff + n * this->top_dim_, weight,
+              bottom_diff + n * this->bottom_dim_, num_images);
         }
       }
     }
   }
+  // The next pass may follow a change to the bottom.
+  this->columns_cached_ = false;
 }
 
 #ifdef CPU_ONLY
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/deconv_layer.hpp"
@@ -26,12 +27,13 @@ void DeconvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
-    for (int n = 0; n < this->num_; ++n) {
-      this->backward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
-      if (this->bias_term_) {
+    for (int n = 0; n < this->num_; n += this->batch_images_) {
+      const int num_images = std::min(this->batch_images_, this->num_ - n);
+      this->backward_cpu_gemm_batch(bottom_data + n * this->bottom_dim_, weight,
+          top_data + n * this->top_dim_, num_images);
+      for (int j = n; j < n + num_images && this->bias_term_; ++j) {
         const Dtype* bias = this->blobs_[1]->cpu_data();
-        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+        this->forward_cpu_bias(top_data + j * this->top_dim_, bias);
       }
     }
   }
@@ -54,17 +56,18 @@ void DeconvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       }
     }
     if (this->param_propagate_down_[0] || propagate_down[i]) {
-      for (int n = 0; n < this->num_; ++n) {
+      for (int n = 0; n < this->num_; n += this->batch_images_) {
+        const int num_images = std::min(this->batch_images_, this->num_ - n);
         // Gradient w.r.t. weight. Note that we will accumulate diffs.
         if (this->param_propagate_down_[0]) {
-          this->weight_cpu_gemm(top_diff + n * this->top_dim_,
-              bottom_data + n * this->bottom_dim_, weight_diff);
+          this->weight_cpu_gemm_batch(top_diff + n * this->top_dim_,
+              bottom_data + n * this->bottom_dim_, weight_diff, num_images);
         }
         // Gradient w.r.t. bottom data, if necessary, reusing the column buffer
         // we might have just computed above.
         if (propagate_down[i]) {
-          this->forward_cpu_gemm(top_diff + n * this->top_dim_, weight,
-              bottom_diff + n * this->bottom_dim_,
+          this->forward_cpu_gemm_batch(top_diff + n * this->top_dim_, weight,
+              bottom_diff + n * this->bottom_dim_, num_images,
               this->param_propagate_down_[0]);
         }
       }
@@ -2,6 +2,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/embed_layer.hpp"
+#include "caffe/util/broadcast_functions.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -53,12 +54,14 @@ void EmbedLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   vector<int> top_shape = bottom[0]->shape();
   top_shape.push_back(N_);
   top[0]->Reshape(top_shape);
-  // Set up the bias multiplier
+#ifndef CPU_ONLY
+  // Set up the bias multiplier, for the GPU only
   if (bias_term_) {
     vector<int> bias_shape(1, M_);
     bias_multiplier_.Reshape(bias_shape);
     caffe_set(M_, Dtype(1), bias_multiplier_.mutable_cpu_data());
   }
+#endif
 }
 
 template <typename Dtype>
@@ -77,8 +80,7 @@ void EmbedLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
   if (bias_term_) {
     const Dtype* bias = this->blobs_[1]->cpu_data();
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, Dtype(1),
-        bias_multiplier_.cpu_data(), bias, Dtype(1), top_data);
+    caffe_cpu_broadcast_add(M_, N_, 1, Dtype(1), bias, top_data, top_data);
   }
 }
 
@@ -104,8 +106,7 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   if (bias_term_ && this->param_propagate_down_[1]) {
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
-    caffe_cpu_gemv<Dtype>(CblasTrans, M_, N_, Dtype(1), top_diff,
-        bias_multiplier_.cpu_data(), Dtype(1), bias_diff);
+    caffe_cpu_axis_sum(M_, N_, 1, Dtype(1), top_diff, Dtype(1), bias_diff);
   }
 }
 
@@ -1,10 +1,45 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/euclidean_loss_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// The sum of squares is kept for each block of this many elements, and the
+// blocks split between threads; a single block runs on the calling thread.
+static const int kBlockSize = 1 << 15;
+
+// Computes diff = a - b and the sum of its squares, for each of the blocks
+// [begin, end).
+template <typename Dtype>
+class SubtractSquare {
+ public:
+  SubtractSquare(int count, const Dtype* a, const Dtype* b, Dtype* diff,
+      Dtype* sums) : count_(count), a_(a), b_(b), diff_(diff), sums_(sums) {}
+
+  void operator()(int begin, int end) const {
+    for (int block = begin; block < end; ++block) {
+      const int block_end = std::min(count_, (block + 1) * kBlockSize);
+      Dtype sum = 0;
+      for (int i = block * kBlockSize; i < block_end; ++i) {
+        const Dtype diff = a_[i] - b_[i];
+        diff_[i] = diff;
+        sum += diff * diff;
+      }
+      sums_[block] = sum;
+    }
+  }
+
+ private:
+  const int count_;
+  const Dtype* a_;
+  const Dtype* b_;
+  Dtype* diff_;
+  Dtype* sums_;
+};
+
 template <typename Dtype>
 void EuclideanLossLayer<Dtype>::Reshape(
   const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
@@ -17,13 +52,22 @@ void EuclideanLossLayer<Dtype>::Reshape(
 template <typename Dtype>
 void EuclideanLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  // The difference, which the backward pass only scales, and its squared
+  // norm in one sweep.
   int count = bottom[0]->count();
-  caffe_sub(
-      count,
-      bottom[0]->cpu_data(),
-      bottom[1]->cpu_data(),
-      diff_.mutable_cpu_data());
-  Dtype dot = caffe_cpu_dot(count, diff_.cpu_data(), diff_.cpu_data());
+  const int num_blocks = (count + kBlockSize - 1) / kBlockSize;
+  vector<Dtype> sums(num_blocks);
+  SubtractSquare<Dtype> body(count, bottom[0]->cpu_data(),
+      bottom[1]->cpu_data(), diff_.mutable_cpu_data(), &sums[0]);
+  if (num_blocks == 1) {
+    body(0, 1);
+  } else {
+    parallel_for(0, num_blocks, body);
+  }
+  Dtype dot = 0;
+  for (int block = 0; block < num_blocks; ++block) {
+    dot += sums[block];
+  }
   Dtype loss = dot / bottom[0]->num() / Dtype(2);
   top[0]->mutable_cpu_data()[0] = loss;
 }
@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/layers/fused_neuron_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// The elements each layer of the chain goes through before the next: small
+// enough that the block and the buffers of the backward pass stay in cache.
+static const int kBlockSize = 1024;
+// Loops over fewer elements than this run on the calling thread alone.
+static const int kParallelMinCount = 1 << 15;
+// As in BNLLLayer.
+static const float kBNLLThreshold = 50.;
+
+template <typename Dtype>
+bool FusedNeuronLayer<Dtype>::CanFuse(const string& type) {
+  return type == "AbsVal" || type == "BNLL" || type == "Exp" || type == "Log"
+      || type == "Power" || type == "ReLU" || type == "Sigmoid"
+      || type == "TanH" || type == "Threshold";
+}
+
+// The natural log of the base of an ExpParameter or LogParameter, checked
+// as those layers do.
+template <typename Dtype>
+static Dtype checked_log_base(const Dtype base) {
+  if (base != Dtype(-1)) {
+    CHECK_GT(base, 0) << "base must be strictly positive.";
+  }
+  const Dtype log_base = (base == Dtype(-1)) ? Dtype(1) : log(base);
+  CHECK(!isnan(log_base))
+      << "NaN result: log(base) = log(" << base << ") = " << log_base;
+  CHECK(!isinf(log_base))
+      << "Inf result: log(base) = log(" << base << ") = " << log_base;
+  return log_base;
+}
+
+template <typename Dtype>
+FusedNeuronLayer<Dtype>::Op::Op(const LayerParameter& param)
+    : scale(1), shift(0), power(1) {
+  const string& type = param.type();
+  if (type == "AbsVal") {
+    kind = ABSVAL;
+  } else if (type == "BNLL") {
+    kind = BNLL;
+  } else if (type == "Exp") {
+    kind = EXP;
+    const Dtype base = param.exp_param().base();
+    scale = checked_log_base(base) * param.exp_param().scale();
+    const Dtype input_shift = param.exp_param().shift();
+    shift = (input_shift == Dtype(0)) ? Dtype(1) : pow(base, input_shift);
+  } else if (type == "Log") {
+    kind = LOG;
+    scale = param.log_param().scale();
+    shift = param.log_param().shift();
+    power = Dtype(1) / checked_log_base(Dtype(param.log_param().base()));
+  } else if (type == "Power") {
+    kind = POWER;
+    scale = param.power_param().scale();
+    shift = param.power_param().shift();
+    power = param.power_param().power();
+  } else if (type == "ReLU") {
+    kind = RELU;
+    scale = param.relu_param().negative_slope();
+  } else if (type == "Sigmoid") {
+    kind = SIGMOID;
+  } else if (type == "TanH") {
+    kind = TANH;
+  } else if (type == "Threshold") {
+    kind = THRESHOLD;
+    shift = param.threshold_param().threshold();
+  } else {
+    LOG(FATAL) << "Layer " << param.name() << " of type " << type
+        << " cannot be fused.";
+  }
+}
+
+template <typename Dtype>
+void FusedNeuronLayer<Dtype>::Op::Forward(const int n, const Dtype* x,
+    Dtype* y) const {
+  switch (kind) {
+  case ABSVAL:
+    for (int i = 0; i < n; ++i) {
+      y[i] = std::fabs(x[i]);
+    }
+    break;
+  case BNLL:
+    for (int i = 0; i < n; ++i) {
+      y[i] = x[i] > 0 ? x[i] + log(1. + exp(-x[i])) : log(1. + exp(x[i]));
+    }
+    break;
+  case EXP:
+    for (int i = 0; i < n; ++i) {
+      y[i] = shift * exp(scale * x[i]);
+    }
+    break;
+  case LOG:
+    for (int i = 0; i < n; ++i) {
+      y[i] = power * log(scale * x[i] + shift);
+    }
+    break;
+  case POWER:
+    if (power * scale == Dtype(0)) {
+      // The input is ignored: scale or power is 0.
+      const Dtype value = (power == 0) ? Dtype(1) : pow(shift, power);
+      for (int i = 0; i < n; ++i) {
+        y[i] = value;
+      }
+    } else if (power == Dtype(1)) {
+      for (int i = 0; i < n; ++i) {
+        y[i] = scale * x[i] + shift;
+      }
+    } else {
+      for (int i = 0; i < n; ++i) {
+        y[i] = pow(scale * x[i] + shift, power);
+      }
+    }
+    break;
+  case RELU:
+    for (int i = 0; i < n; ++i) {
+      y[i] = std::max(x[i], Dtype(0)) + scale * std::min(x[i], Dtype(0));
+    }
+    break;
+  case SIGMOID:
+    for (int i = 0; i < n; ++i) {
+      y[i] = 1. / (1. + exp(-x[i]));
+    }
+    break;
+  case TANH:
+    for (int i = 0; i < n; ++i) {
+      y[i] = tanh(x[i]);
+    }
+    break;
+  case THRESHOLD:
+    for (int i = 0; i < n; ++i) {
+      y[i] = (x[i] > shift) ? Dtype(1) : Dtype(0);
+    }
+    break;
+  }
+}
+
+template <typename Dtype>
+void FusedNeuronLayer<Dtype>::Op::Derivative(const int n, const Dtype* x,
+    const Dtype* y, Dtype* d) const {
+  switch (kind) {
+  case ABSVAL:
+    for (int i = 0; i < n; ++i) {
+      d[i] *= caffe_sign(x[i]);
+    }
+    break;
+  case BNLL:
+    for (int i = 0; i < n; ++i) {
+      const Dtype expval = exp(std::min(x[i], Dtype(kBNLLThreshold)));
+      d[i] *= expval / (expval + 1.);
+    }
+    break;
+  case EXP:
+    for (int i = 0; i < n; ++i) {
+      d[i] *= scale * y[i];
+    }
+    break;
+  case LOG:
+    for (int i = 0; i < n; ++i) {
+      d[i] *= scale * power / (scale * x[i] + shift);
+    }
+    break;
+  case POWER: {
+    // dy/dx = scale * power * (scale * x + shift)^(power - 1)
+    const Dtype diff_scale = power * scale;
+    if (diff_scale == Dtype(0) || power == Dtype(1)) {
+      for (int i = 0; i < n; ++i) {
+        d[i] *= diff_scale;
+      }
+    } else if (power == Dtype(2)) {
+      for (int i = 0; i < n; ++i) {
+        d[i] *= diff_scale * (scale * x[i] + shift);
+      }
+    } else {
+      for (int i = 0; i < n; ++i) {
+        d[i] *= diff_scale * y[i] / (scale * x[i] + shift);
+      }
+    }
+    break;
+  }
+  case RELU:
+    for (int i = 0; i < n; ++i) {
+      d[i] *= (x[i] > 0) + scale * (x[i] <= 0);
+    }
+    break;
+  case SIGMOID:
+    for (int i = 0; i < n; ++i) {
+      d[i] *= y[i] * (1. - y[i]);
+    }
+    break;
+  case TANH:
+    for (int i = 0; i < n; ++i) {
+      d[i] *= 1 - y[i] * y[i];
+    }
+    break;
+  case THRESHOLD:
+    // Not differentiable, as in ThresholdLayer.
+    NOT_IMPLEMENTED;
+    break;
+  }
+}
+
+// Runs the chain forward over the blocks [begin, end) of x into y. With
+// derivative given it also multiplies the derivatives of the layers into
+// it, going through buffers so each layer still sees its input; otherwise
+// it computes in y, keeping a copy of x in saved first if that is given.
+template <typename Dtype>
+class FuseForward {
+ public:
+  typedef typename FusedNeuronLayer<Dtype>::Op Op;
+
+  FuseForward(const vector<Op>& ops, int count, const Dtype* x, Dtype* saved,
+      Dtype* y, Dtype* derivative) : ops_(ops), count_(count), x_(x),
+      saved_(saved), y_(y), derivative_(derivative) {}
+
+  void operator()(int begin, int end) const {
+    Dtype buffers[2][kBlockSize];
+    for (int block = begin; block < end; ++block) {
+      const int offset = block * kBlockSize;
+      const int n = std::min(kBlockSize, count_ - offset);
+      if (derivative_) {
+        Dtype* d = derivative_ + offset;
+        std::fill(d, d + n, Dtype(1));
+        const Dtype* input = x_ + offset;
+        for (int k = 0; k < ops_.size(); ++k) {
+          Dtype* output = buffers[k % 2];
+          ops_[k].Forward(n, input, output);
+          ops_[k].Derivative(n, input, output, d);
+          input = output;
+        }
+        caffe_copy(n, input, y_ + offset);
+      } else {
+        if (saved_) {
+          caffe_copy(n, x_ + offset, saved_ + offset);
+        }
+        ops_[0].Forward(n, x_ + offset, y_ + offset);
+        for (int k = 1; k < ops_.size(); ++k) {
+          ops_[k].Forward(n, y_ + offset, y_ + offset);
+        }
+      }
+    }
+  }
+
+ private:
+  const vector<Op>& ops_;
+  const int count_;
+  const Dtype* x_;
+  Dtype* saved_;
+  Dtype* y_;
+  Dtype* derivative_;
+};
+
+// Runs the chain backward over the blocks [begin, end) when the forward
+// pass kept no derivative: recomputes the inputs of each layer from x,
+// multiplies their derivatives together and applies the product to the top
+// diff. The last layer takes its output from y rather than computing it
+// again.
+template <typename Dtype>
+class FuseBackward {
+ public:
+  typedef typename FusedNeuronLayer<Dtype>::Op Op;
+
+  FuseBackward(const vector<Op>& ops, int count, const Dtype* x,
+      const Dtype* y, const Dtype* top_diff, Dtype* bottom_diff) : ops_(ops),
+      count_(count), x_(x), y_(y), top_diff_(top_diff),
+      bottom_diff_(bottom_diff) {}
+
+  void operator()(int begin, int end) const {
+    Dtype buffers[2][kBlockSize];
+    Dtype d[kBlockSize];
+    for (int block = begin; block < end; ++block) {
+      const int offset = block * kBlockSize;
+      const int n = std::min(kBlockSize, count_ - offset);
+      const Dtype* input = x_ + offset;
+      std::fill(d, d + n, Dtype(1));
+      for (int k = 0; k < ops_.size(); ++k) {
+        const Dtype* output = y_ + offset;
+        if (k + 1 < ops_.size()) {
+          Dtype* buffer = buffers[k % 2];
+          ops_[k].Forward(n, input, buffer);
+          output = buffer;
+        }
+        ops_[k].Derivative(n, input, output, d);
+        input = output;
+      }
+      caffe_mul(n, top_diff_ + offset, d, bottom_diff_ + offset);
+    }
+  }
+
+ private:
+  const vector<Op>& ops_;
+  const int count_;
+  const Dtype* x_;
+  const Dtype* y_;
+  const Dtype* top_diff_;
+  Dtype* bottom_diff_;
+};
+
+// Runs body over the blocks of count elements, in parallel if there are
+// enough of them.
+template <typename Body>
+static void run_blocks(const int count, const Body& body) {
+  const int num_blocks = (count + kBlockSize - 1) / kBlockSize;
+  if (count < kParallelMinCount) {
+    body(0, num_blocks);
+  } else {
+    parallel_for(0, num_blocks, body, kParallelMinCount / kBlockSize);
+  }
+}
+
+template <typename Dtype>
+void FusedNeuronLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  NeuronLayer<Dtype>::LayerSetUp(bottom, top);
+  CHECK(!chain_.empty()) << "A fused layer needs layers to fuse.";
+  ops_.clear();
+  differentiable_ = true;
+  for (int k = 0; k < chain_.size(); ++k) {
+    ops_.push_back(Op(chain_[k]));
+    differentiable_ &= ops_.back().kind != Op::THRESHOLD;
+  }
+}
+
+template <typename Dtype>
+void FusedNeuronLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  NeuronLayer<Dtype>::Reshape(bottom, top);
+  if (this->phase_ == TRAIN && differentiable_) {
+    derivative_.ReshapeLike(*bottom[0]);
+  } else if (bottom[0] == top[0]) {
+    input_.ReshapeLike(*bottom[0]);
+  }
+}
+
+template <typename Dtype>
+void FusedNeuronLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  Dtype* derivative = NULL;
+  Dtype* saved = NULL;
+  if (this->phase_ == TRAIN && differentiable_) {
+    derivative = derivative_.mutable_cpu_data();
+  } else if (bottom[0] == top[0]) {
+    saved = input_.mutable_cpu_data();
+  }
+  FuseForward<Dtype> body(ops_, bottom[0]->count(), bottom[0]->cpu_data(),
+      saved, top[0]->mutable_cpu_data(), derivative);
+  run_blocks(bottom[0]->count(), body);
+}
+
+template <typename Dtype>
+void FusedNeuronLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) { return; }
+  if (this->phase_ == TRAIN && differentiable_) {
+    caffe_mul(bottom[0]->count(), top[0]->cpu_diff(), derivative_.cpu_data(),
+        bottom[0]->mutable_cpu_diff());
+    return;
+  }
+  const Dtype* input = bottom[0] == top[0] ?
+      input_.cpu_data() : bottom[0]->cpu_data();
+  FuseBackward<Dtype> body(ops_, bottom[0]->count(), input,
+      top[0]->cpu_data(), top[0]->cpu_diff(), bottom[0]->mutable_cpu_diff());
+  run_blocks(bottom[0]->count(), body);
+}
+
+INSTANTIATE_CLASS(FusedNeuronLayer);
+
+}  // namespace caffe
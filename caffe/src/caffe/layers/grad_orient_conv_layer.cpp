@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "caffe/filler.hpp"
+#include "caffe/util/broadcast_functions.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/layers/grad_orient_conv_layer.hpp"
@@ -304,14 +305,7 @@ void GradOrientConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bott
   top_dim_ = top[0]->count(channel_axis_);
   num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
   num_kernels_col2im_ = reverse_dimensions() ? top_dim_ : bottom_dim_;
-  // Set up the all ones "bias multiplier" for adding biases by BLAS
   out_spatial_dim_ = top[0]->count(first_spatial_axis);
-  if (bias_term_) {
-    vector<int> bias_multiplier_shape(1, out_spatial_dim_);
-    bias_multiplier_.Reshape(bias_multiplier_shape);
-    caffe_set(bias_multiplier_.count(), Dtype(1),
-        bias_multiplier_.mutable_cpu_data());
-  }
   //orientation map would be top sized in n, h and w
   top_shape[1] = 1;
   orientation_map_.Reshape(top_shape);
@@ -771,16 +765,15 @@ void GradOrientConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
 template <typename Dtype>
 void GradOrientConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_output_,
-      out_spatial_dim_, 1, (Dtype)1., bias, bias_multiplier_.cpu_data(),
-      (Dtype)1., output);
+  caffe_cpu_broadcast_add(1, num_output_, out_spatial_dim_, Dtype(1), bias,
+      output, output);
 }
 
 template <typename Dtype>
 void GradOrientConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
     const Dtype* input) {
-  caffe_cpu_gemv<Dtype>(CblasNoTrans, num_output_, out_spatial_dim_, 1.,
-      input, bias_multiplier_.cpu_data(), 1., bias);
+  caffe_cpu_axis_sum(1, num_output_, out_spatial_dim_, Dtype(1), input,
+      Dtype(1), bias);
 }
 #ifdef CPU_ONLY
 STUB_GPU(GradOrientConvolutionLayer);
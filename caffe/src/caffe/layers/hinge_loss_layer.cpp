@@ -3,40 +3,94 @@
 
 #include "caffe/layers/hinge_loss_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Loops over fewer elements than this run on the calling thread alone.
+static const int kParallelMinCount = 1 << 15;
+
+// Computes the loss of each of the samples [begin, end) and, if gradient is
+// given, its gradient times scale. With the margin
+// m = max(0, 1 + delta * x), where delta is -1 for the label and 1 for the
+// other classes, the loss is the sum of m or of m^2, and the gradient
+// delta * (m > 0) or 2 * delta * m.
 template <typename Dtype>
-void HingeLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-    const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  const Dtype* label = bottom[1]->cpu_data();
-  int num = bottom[0]->num();
-  int count = bottom[0]->count();
-  int dim = count / num;
+class Hinge {
+ public:
+  Hinge(int dim, bool l2, const Dtype* data, const Dtype* label, Dtype scale,
+      Dtype* gradient, Dtype* losses) : dim_(dim), l2_(l2), data_(data),
+      label_(label), scale_(scale), gradient_(gradient), losses_(losses) {}
 
-  caffe_copy(count, bottom_data, bottom_diff);
-  for (int i = 0; i < num; ++i) {
-    bottom_diff[i * dim + static_cast<int>(label[i])] *= -1;
-  }
-  for (int i = 0; i < num; ++i) {
-    for (int j = 0; j < dim; ++j) {
-      bottom_diff[i * dim + j] = std::max(
-        Dtype(0), 1 + bottom_diff[i * dim + j]);
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      const Dtype* data = data_ + i * dim_;
+      const int label = static_cast<int>(label_[i]);
+      Dtype loss = 0;
+      for (int j = 0; j < dim_; ++j) {
+        const Dtype delta = j == label ? -1 : 1;
+        const Dtype margin = std::max(Dtype(0), 1 + delta * data[j]);
+        loss += l2_ ? margin * margin : margin;
+        if (gradient_) {
+          gradient_[i * dim_ + j] = l2_ ? 2 * scale_ * delta * margin :
+              scale_ * delta * (margin > 0);
+        }
+      }
+      losses_[i] = loss;
     }
   }
-  Dtype* loss = top[0]->mutable_cpu_data();
-  switch (this->layer_param_.hinge_loss_param().norm()) {
+
+ private:
+  const int dim_;
+  const bool l2_;
+  const Dtype* data_;
+  const Dtype* label_;
+  const Dtype scale_;
+  Dtype* gradient_;
+  Dtype* losses_;
+};
+
+// Returns the loss and, if gradient is given, writes its gradient there,
+// splitting the samples between threads if there are enough of them.
+template <typename Dtype>
+static Dtype hinge_loss(const vector<Blob<Dtype>*>& bottom,
+    const HingeLossParameter& param, Dtype* gradient) {
+  bool l2 = false;
+  switch (param.norm()) {
   case HingeLossParameter_Norm_L1:
-    loss[0] = caffe_cpu_asum(count, bottom_diff) / num;
     break;
   case HingeLossParameter_Norm_L2:
-    loss[0] = caffe_cpu_dot(count, bottom_diff, bottom_diff) / num;
+    l2 = true;
     break;
   default:
     LOG(FATAL) << "Unknown Norm";
   }
+  const int num = bottom[0]->num();
+  const int count = bottom[0]->count();
+  const int dim = count / num;
+  vector<Dtype> losses(num);
+  Hinge<Dtype> body(dim, l2, bottom[0]->cpu_data(), bottom[1]->cpu_data(),
+      Dtype(1) / num, gradient, &losses[0]);
+  if (count < kParallelMinCount) {
+    body(0, num);
+  } else {
+    parallel_for(0, num, body, std::max(1, kParallelMinCount / dim));
+  }
+  Dtype loss = 0;
+  for (int i = 0; i < num; ++i) {
+    loss += losses[i];
+  }
+  return loss / num;
+}
+
+template <typename Dtype>
+void HingeLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  // In training the gradient comes with the loss, in the same sweep.
+  this->gradient_in_diff_ = this->gradient_in_forward();
+  top[0]->mutable_cpu_data()[0] = hinge_loss(bottom,
+      this->layer_param_.hinge_loss_param(),
+      this->gradient_in_diff_ ? bottom[0]->mutable_cpu_diff() : NULL);
 }
 
 template <typename Dtype>
@@ -48,28 +102,15 @@ void HingeLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
   if (propagate_down[0]) {
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    const Dtype* label = bottom[1]->cpu_data();
-    int num = bottom[0]->num();
-    int count = bottom[0]->count();
-    int dim = count / num;
-
-    for (int i = 0; i < num; ++i) {
-      bottom_diff[i * dim + static_cast<int>(label[i])] *= -1;
+    if (!this->gradient_in_diff_) {
+      hinge_loss(bottom, this->layer_param_.hinge_loss_param(), bottom_diff);
     }
-
     const Dtype loss_weight = top[0]->cpu_diff()[0];
-    switch (this->layer_param_.hinge_loss_param().norm()) {
-    case HingeLossParameter_Norm_L1:
-      caffe_cpu_sign(count, bottom_diff, bottom_diff);
-      caffe_scal(count, loss_weight / num, bottom_diff);
-      break;
-    case HingeLossParameter_Norm_L2:
-      caffe_scal(count, loss_weight * 2 / num, bottom_diff);
-      break;
-    default:
-      LOG(FATAL) << "Unknown Norm";
+    if (loss_weight != Dtype(1)) {
+      caffe_scal(bottom[0]->count(), loss_weight, bottom_diff);
     }
   }
+  this->gradient_in_diff_ = false;
 }
 
 INSTANTIATE_CLASS(HingeLossLayer);
@@ -4,9 +4,17 @@
 
 #include "caffe/layers/infogain_loss_layer.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Loops over fewer elements than this run on the calling thread alone.
+static const int kParallelMinCount = 1 << 15;
+// An infogain matrix with at most this fraction of nonzero entries is kept
+// sparse.
+static const float kMaxSparseDensity = 0.25;
+
 template <typename Dtype>
 void InfogainLossLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
@@ -18,6 +26,29 @@ void InfogainLossLayer<Dtype>::LayerSetUp(
     ReadProtoFromBinaryFile(
       this->layer_param_.infogain_loss_param().source(), &blob_proto);
     infogain_.FromProto(blob_proto);
+    // Keep the nonzero entries of a mostly zero matrix, to visit only them.
+    const int dim = infogain_.height();
+    const Dtype* infogain_mat = infogain_.cpu_data();
+    int nonzeros = 0;
+    for (int i = 0; i < infogain_.count(); ++i) {
+      nonzeros += infogain_mat[i] != Dtype(0);
+    }
+    sparse_rows_.clear();
+    sparse_columns_.clear();
+    sparse_values_.clear();
+    if (nonzeros > 0 && nonzeros <= kMaxSparseDensity * infogain_.count()) {
+      sparse_rows_.push_back(0);
+      for (int r = 0; r < dim; ++r) {
+        for (int c = 0; c < infogain_.width(); ++c) {
+          const Dtype value = infogain_mat[r * infogain_.width() + c];
+          if (value != Dtype(0)) {
+            sparse_columns_.push_back(c);
+            sparse_values_.push_back(value);
+          }
+        }
+        sparse_rows_.push_back(sparse_columns_.size());
+      }
+    }
   }
 }
 
@@ -43,28 +74,104 @@ void InfogainLossLayer<Dtype>::Reshape(
 }
 
 
+// Computes the loss of each of the samples [begin, end) and, if gradient is
+// given, its gradient times scale, from the row of the infogain matrix for
+// the label: dense, skipping its zeros, or sparse.
 template <typename Dtype>
-void InfogainLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-    const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  const Dtype* bottom_label = bottom[1]->cpu_data();
+class Infogain {
+ public:
+  Infogain(int dim, const Dtype* data, const Dtype* label,
+      const Dtype* infogain, const int* sparse_rows, const int* sparse_columns,
+      const Dtype* sparse_values, Dtype scale, Dtype* gradient, Dtype* losses)
+      : dim_(dim), data_(data), label_(label), infogain_(infogain),
+      sparse_rows_(sparse_rows), sparse_columns_(sparse_columns),
+      sparse_values_(sparse_values), scale_(scale), gradient_(gradient),
+      losses_(losses) {}
+
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      const Dtype* data = data_ + i * dim_;
+      Dtype* gradient = gradient_ ? gradient_ + i * dim_ : NULL;
+      const int label = static_cast<int>(label_[i]);
+      Dtype loss = 0;
+      if (gradient) {
+        std::fill(gradient, gradient + dim_, Dtype(0));
+      }
+      if (infogain_) {
+        const Dtype* row = infogain_ + label * dim_;
+        for (int j = 0; j < dim_; ++j) {
+          if (row[j] != Dtype(0)) {
+            Term(row[j], data[j], &loss, gradient ? gradient + j : NULL);
+          }
+        }
+      } else {
+        for (int k = sparse_rows_[label]; k < sparse_rows_[label + 1]; ++k) {
+          const int j = sparse_columns_[k];
+          Term(sparse_values_[k], data[j], &loss,
+              gradient ? gradient + j : NULL);
+        }
+      }
+      losses_[i] = loss;
+    }
+  }
+
+ private:
+  inline void Term(Dtype h, Dtype data, Dtype* loss, Dtype* gradient) const {
+    const Dtype prob = std::max(data, Dtype(kLOG_THRESHOLD));
+    *loss -= h * log(prob);
+    if (gradient) {
+      *gradient = scale_ * h / prob;
+    }
+  }
+
+  const int dim_;
+  const Dtype* data_;
+  const Dtype* label_;
+  const Dtype* infogain_;
+  const int* sparse_rows_;
+  const int* sparse_columns_;
+  const Dtype* sparse_values_;
+  const Dtype scale_;
+  Dtype* gradient_;
+  Dtype* losses_;
+};
+
+template <typename Dtype>
+Dtype InfogainLossLayer<Dtype>::ComputeLoss(
+    const vector<Blob<Dtype>*>& bottom, Dtype* gradient) {
   const Dtype* infogain_mat = NULL;
-  if (bottom.size() < 3) {
-    infogain_mat = infogain_.cpu_data();
-  } else {
+  if (bottom.size() >= 3) {
     infogain_mat = bottom[2]->cpu_data();
+  } else if (sparse_rows_.empty()) {
+    infogain_mat = infogain_.cpu_data();
   }
   int num = bottom[0]->num();
   int dim = bottom[0]->count() / bottom[0]->num();
+  vector<Dtype> losses(num);
+  Infogain<Dtype> body(dim, bottom[0]->cpu_data(), bottom[1]->cpu_data(),
+      infogain_mat, infogain_mat ? NULL : &sparse_rows_[0],
+      infogain_mat ? NULL : &sparse_columns_[0],
+      infogain_mat ? NULL : &sparse_values_[0], Dtype(-1) / num, gradient,
+      &losses[0]);
+  if (bottom[0]->count() < kParallelMinCount) {
+    body(0, num);
+  } else {
+    parallel_for(0, num, body, std::max(1, kParallelMinCount / dim));
+  }
   Dtype loss = 0;
   for (int i = 0; i < num; ++i) {
-    int label = static_cast<int>(bottom_label[i]);
-    for (int j = 0; j < dim; ++j) {
-      Dtype prob = std::max(bottom_data[i * dim + j], Dtype(kLOG_THRESHOLD));
-      loss -= infogain_mat[label * dim + j] * log(prob);
-    }
+    loss += losses[i];
   }
-  top[0]->mutable_cpu_data()[0] = loss / num;
+  return loss / num;
+}
+
+template <typename Dtype>
+void InfogainLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  // In training the gradient comes with the loss, in the same sweep.
+  this->gradient_in_diff_ = this->gradient_in_forward();
+  top[0]->mutable_cpu_data()[0] = ComputeLoss(bottom,
+      this->gradient_in_diff_ ? bottom[0]->mutable_cpu_diff() : NULL);
 }
 
 template <typename Dtype>
@@ -80,26 +187,16 @@ void InfogainLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                << " Layer cannot backpropagate to infogain inputs.";
   }
   if (propagate_down[0]) {
-    const Dtype* bottom_data = bottom[0]->cpu_data();
-    const Dtype* bottom_label = bottom[1]->cpu_data();
-    const Dtype* infogain_mat = NULL;
-    if (bottom.size() < 3) {
-      infogain_mat = infogain_.cpu_data();
-    } else {
-      infogain_mat = bottom[2]->cpu_data();
-    }
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    int num = bottom[0]->num();
-    int dim = bottom[0]->count() / bottom[0]->num();
-    const Dtype scale = - top[0]->cpu_diff()[0] / num;
-    for (int i = 0; i < num; ++i) {
-      const int label = static_cast<int>(bottom_label[i]);
-      for (int j = 0; j < dim; ++j) {
-        Dtype prob = std::max(bottom_data[i * dim + j], Dtype(kLOG_THRESHOLD));
-        bottom_diff[i * dim + j] = scale * infogain_mat[label * dim + j] / prob;
-      }
+    if (!this->gradient_in_diff_) {
+      ComputeLoss(bottom, bottom_diff);
+    }
+    const Dtype loss_weight = top[0]->cpu_diff()[0];
+    if (loss_weight != Dtype(1)) {
+      caffe_scal(bottom[0]->count(), loss_weight, bottom_diff);
     }
   }
+  this->gradient_in_diff_ = false;
 }
 
 INSTANTIATE_CLASS(InfogainLossLayer);
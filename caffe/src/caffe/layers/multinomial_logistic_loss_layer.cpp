@@ -16,21 +16,39 @@ void MultinomialLogisticLossLayer<Dtype>::Reshape(
   CHECK_EQ(bottom[1]->width(), 1);
 }
 
+// Returns the loss and, if gradient is given, writes its gradient there for
+// a loss weight of 1; it is 0 but at the labels.
 template <typename Dtype>
-void MultinomialLogisticLossLayer<Dtype>::Forward_cpu(
-    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+static Dtype multinomial_logistic_loss(const vector<Blob<Dtype>*>& bottom,
+    Dtype* gradient) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   const Dtype* bottom_label = bottom[1]->cpu_data();
   int num = bottom[0]->num();
   int dim = bottom[0]->count() / bottom[0]->num();
+  if (gradient) {
+    caffe_set(bottom[0]->count(), Dtype(0), gradient);
+  }
+  const Dtype scale = Dtype(-1) / num;
   Dtype loss = 0;
   for (int i = 0; i < num; ++i) {
     int label = static_cast<int>(bottom_label[i]);
     Dtype prob = std::max(
         bottom_data[i * dim + label], Dtype(kLOG_THRESHOLD));
     loss -= log(prob);
+    if (gradient) {
+      gradient[i * dim + label] = scale / prob;
+    }
   }
-  top[0]->mutable_cpu_data()[0] = loss / num;
+  return loss / num;
+}
+
+template <typename Dtype>
+void MultinomialLogisticLossLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  // In training the gradient comes with the loss, in the same sweep.
+  this->gradient_in_diff_ = this->gradient_in_forward();
+  top[0]->mutable_cpu_data()[0] = multinomial_logistic_loss(bottom,
+      this->gradient_in_diff_ ? bottom[0]->mutable_cpu_diff() : NULL);
 }
 
 template <typename Dtype>
@@ -42,20 +60,23 @@ void MultinomialLogisticLossLayer<Dtype>::Backward_cpu(
                << " Layer cannot backpropagate to label inputs.";
   }
   if (propagate_down[0]) {
-    const Dtype* bottom_data = bottom[0]->cpu_data();
     const Dtype* bottom_label = bottom[1]->cpu_data();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     int num = bottom[0]->num();
     int dim = bottom[0]->count() / bottom[0]->num();
-    caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
-    const Dtype scale = - top[0]->cpu_diff()[0] / num;
-    for (int i = 0; i < num; ++i) {
-      int label = static_cast<int>(bottom_label[i]);
-      Dtype prob = std::max(
-          bottom_data[i * dim + label], Dtype(kLOG_THRESHOLD));
-      bottom_diff[i * dim + label] = scale / prob;
+    if (!this->gradient_in_diff_) {
+      multinomial_logistic_loss(bottom, bottom_diff);
+    }
+    // Only the labels have a gradient to scale.
+    const Dtype loss_weight = top[0]->cpu_diff()[0];
+    if (loss_weight != Dtype(1)) {
+      for (int i = 0; i < num; ++i) {
+        bottom_diff[i * dim + static_cast<int>(bottom_label[i])] *=
+            loss_weight;
+      }
     }
   }
+  this->gradient_in_diff_ = false;
 }
 
 INSTANTIATE_CLASS(MultinomialLogisticLossLayer);
@@ -1,6 +1,8 @@
 #include <vector>
 
 #include "caffe/layers/mvn_layer.hpp"
+#include "caffe/util/broadcast_functions.hpp"
+#include "caffe/util/expression.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -16,6 +18,8 @@ void MVNLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       1, 1);
   temp_.Reshape(bottom[0]->num(), bottom[0]->channels(),
       bottom[0]->height(), bottom[0]->width());
+#ifndef CPU_ONLY
+  // The multiplier sums and broadcasts with BLAS on the GPU only.
   if ( this->layer_param_.mvn_param().across_channels() ) {
     sum_multiplier_.Reshape(1, bottom[0]->channels(), bottom[0]->height(),
                             bottom[0]->width());
@@ -24,6 +28,7 @@ void MVNLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
   Dtype* multiplier_data = sum_multiplier_.mutable_cpu_data();
   caffe_set(sum_multiplier_.count(), Dtype(1), multiplier_data);
+#endif
   eps_ = this->layer_param_.mvn_param().eps();
 }
 
@@ -41,32 +46,23 @@ void MVNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int dim = bottom[0]->count() / num;
 
   // subtract mean
-  caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1. / dim, bottom_data,
-      sum_multiplier_.cpu_data(), 0., mean_.mutable_cpu_data());  // EX
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, -1.,
-      mean_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-      temp_.mutable_cpu_data());
-  caffe_add(temp_.count(), bottom_data, temp_.cpu_data(), top_data);  // X-EX
+  caffe_cpu_axis_sum(1, num, dim, Dtype(1. / dim), bottom_data, Dtype(0),
+      mean_.mutable_cpu_data());  // EX
+  caffe_cpu_broadcast_add(1, num, dim, Dtype(-1), mean_.cpu_data(),
+      bottom_data, top_data);  // X-EX
 
   if (this->layer_param_.mvn_param().normalize_variance()) {
     // compute variance using var(X) = E((X-EX)^2)
-    caffe_powx(bottom[0]->count(), top_data, Dtype(2),
-        temp_.mutable_cpu_data());  // (X-EX)^2
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1. / dim, temp_.cpu_data(),
-        sum_multiplier_.cpu_data(), 0.,
-        variance_.mutable_cpu_data());  // E((X-EX)^2)
+    caffe_cpu_axis_dot(1, num, dim, Dtype(1. / dim), top_data, top_data,
+        Dtype(0), variance_.mutable_cpu_data());  // E((X-EX)^2)
 
     // normalize variance
-    caffe_powx(variance_.count(), variance_.cpu_data(), Dtype(0.5),
-          variance_.mutable_cpu_data());
-
-    caffe_add_scalar(variance_.count(), eps_, variance_.mutable_cpu_data());
+    caffe_eval(variance_.count(),
+        sqrt(expr::Array<Dtype>(variance_.cpu_data())) + eps_,
+        variance_.mutable_cpu_data());
 
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, 1.,
-          variance_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-          temp_.mutable_cpu_data());
-
-    caffe_div(temp_.count(), top_data, temp_.cpu_data(), top_data);
+    caffe_cpu_broadcast_div(1, num, dim, variance_.cpu_data(), top_data,
+        top_data);
   }
 }
 
@@ -76,7 +72,6 @@ void MVNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<Blob<Dtype>*>& bottom) {
   const Dtype* top_diff = top[0]->cpu_diff();
   const Dtype* top_data = top[0]->cpu_data();
-  const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
 
   int num;
@@ -88,38 +83,26 @@ void MVNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   int dim = bottom[0]->count() / num;
 
   if (this->layer_param_.mvn_param().normalize_variance()) {
-    caffe_mul(temp_.count(), top_data, top_diff, bottom_diff);
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1., bottom_diff,
-          sum_multiplier_.cpu_data(), 0., mean_.mutable_cpu_data());
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, 1.,
-          mean_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-          bottom_diff);
-    caffe_mul(temp_.count(), top_data, bottom_diff, bottom_diff);
-
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1., top_diff,
-            sum_multiplier_.cpu_data(), 0., mean_.mutable_cpu_data());
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, 1.,
-            mean_.cpu_data(), sum_multiplier_.cpu_data(), 1.,
-            bottom_diff);
+    caffe_cpu_axis_dot(1, num, dim, Dtype(1), top_data, top_diff, Dtype(0),
+        mean_.mutable_cpu_data());
+    caffe_cpu_broadcast_mul(1, num, dim, mean_.cpu_data(), top_data,
+        bottom_diff);
+
+    caffe_cpu_axis_sum(1, num, dim, Dtype(1), top_diff, Dtype(0),
+        mean_.mutable_cpu_data());
+    caffe_cpu_broadcast_add(1, num, dim, Dtype(1), mean_.cpu_data(),
+        bottom_diff, bottom_diff);
 
     caffe_cpu_axpby(temp_.count(), Dtype(1), top_diff, Dtype(-1. / dim),
         bottom_diff);
 
-    // put the squares of bottom into temp_
-    caffe_powx(temp_.count(), bottom_data, Dtype(2),
-        temp_.mutable_cpu_data());
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, 1.,
-        variance_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-        temp_.mutable_cpu_data());
-
-    caffe_div(temp_.count(), bottom_diff, temp_.cpu_data(), bottom_diff);
+    caffe_cpu_broadcast_div(1, num, dim, variance_.cpu_data(), bottom_diff,
+        bottom_diff);
   } else {
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1. / dim, top_diff,
-      sum_multiplier_.cpu_data(), 0., mean_.mutable_cpu_data());
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, -1.,
-      mean_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-      temp_.mutable_cpu_data());
-    caffe_add(temp_.count(), top_diff, temp_.cpu_data(), bottom_diff);
+    caffe_cpu_axis_sum(1, num, dim, Dtype(1. / dim), top_diff, Dtype(0),
+        mean_.mutable_cpu_data());
+    caffe_cpu_broadcast_add(1, num, dim, Dtype(-1), mean_.cpu_data(),
+        top_diff, bottom_diff);
   }
 }
 
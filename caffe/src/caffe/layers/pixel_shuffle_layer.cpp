@@ -0,0 +1,151 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/pixel_shuffle_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Loops over fewer elements than this run on the calling thread alone.
+static const int kParallelMinCount = 1 << 15;
+
+// Copies the channel planes [begin, end) of the blob with the channels,
+// height x width each, to their strided place in the blob with the pixels,
+// or back. Plane p holds offset (i, j) = (p / factor_w % factor_h,
+// p % factor_w) of channel p / (factor_h * factor_w) of the pixel blob,
+// counting over the whole batch.
+template <typename Dtype>
+class ShufflePlanes {
+ public:
+  ShufflePlanes(int height, int width, int factor_h, int factor_w,
+      bool to_space, const Dtype* from, Dtype* to) : height_(height),
+      width_(width), factor_h_(factor_h), factor_w_(factor_w),
+      to_space_(to_space), from_(from), to_(to) {}
+
+  void operator()(int begin, int end) const {
+    const int plane = height_ * width_;
+    const int factor = factor_h_ * factor_w_;
+    const int space_width = width_ * factor_w_;
+    for (int p = begin; p < end; ++p) {
+      const int i = p / factor_w_ % factor_h_;
+      const int j = p % factor_w_;
+      const int space = p / factor * plane * factor + i * space_width + j;
+      for (int h = 0; h < height_; ++h) {
+        const int depth_row = p * plane + h * width_;
+        const int space_row = space + h * factor_h_ * space_width;
+        if (to_space_) {
+          for (int w = 0; w < width_; ++w) {
+            to_[space_row + w * factor_w_] = from_[depth_row + w];
+          }
+        } else {
+          for (int w = 0; w < width_; ++w) {
+            to_[depth_row + w] = from_[space_row + w * factor_w_];
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  const int height_, width_;
+  const int factor_h_, factor_w_;
+  const bool to_space_;
+  const Dtype* from_;
+  Dtype* to_;
+};
+
+template <typename Dtype>
+void PixelShuffleLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const ConvolutionParameter& conv_param =
+      this->layer_param_.convolution_param();
+  if (conv_param.has_stride_h() || conv_param.has_stride_w()) {
+    CHECK_EQ(0, conv_param.stride_size())
+        << "Either stride or stride_h/w should be specified; not both.";
+    factor_h_ = conv_param.stride_h();
+    factor_w_ = conv_param.stride_w();
+  } else {
+    const int num_stride_dims = conv_param.stride_size();
+    CHECK_LE(num_stride_dims, 2)
+        << "stride must be specified once, or once per spatial dimension.";
+    factor_h_ = num_stride_dims == 0 ? 1 : conv_param.stride(0);
+    factor_w_ = num_stride_dims == 2 ? conv_param.stride(1) : factor_h_;
+  }
+  CHECK_GT(factor_h_, 0) << "Shuffle factors must be positive.";
+  CHECK_GT(factor_w_, 0) << "Shuffle factors must be positive.";
+}
+
+template <typename Dtype>
+void PixelShuffleLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  CHECK_EQ(4, bottom[0]->num_axes()) << "Input must have 4 axes, "
+      << "corresponding to (num, channels, height, width)";
+  vector<int> top_shape = bottom[0]->shape();
+  const int factor = factor_h_ * factor_w_;
+  if (space_to_depth()) {
+    CHECK_EQ(0, top_shape[2] % factor_h_)
+        << "Height must be a multiple of the shuffle factor.";
+    CHECK_EQ(0, top_shape[3] % factor_w_)
+        << "Width must be a multiple of the shuffle factor.";
+    top_shape[1] *= factor;
+    top_shape[2] /= factor_h_;
+    top_shape[3] /= factor_w_;
+  } else {
+    CHECK_EQ(0, top_shape[1] % factor)
+        << "Channels must be a multiple of the product of shuffle factors.";
+    top_shape[1] /= factor;
+    top_shape[2] *= factor_h_;
+    top_shape[3] *= factor_w_;
+  }
+  top[0]->Reshape(top_shape);
+}
+
+template <typename Dtype>
+void PixelShuffleLayer<Dtype>::Shuffle(const Blob<Dtype>& depth,
+    bool to_space, const Dtype* from, Dtype* to) {
+  const int height = depth.height();
+  const int width = depth.width();
+  const int num_planes = depth.num() * depth.channels();
+  ShufflePlanes<Dtype> body(height, width, factor_h_, factor_w_, to_space,
+      from, to);
+  if (static_cast<int64_t>(num_planes) * height * width < kParallelMinCount) {
+    body(0, num_planes);
+  } else {
+    parallel_for(0, num_planes, body,
+        std::max(1, kParallelMinCount / std::max(height * width, 1)));
+  }
+}
+
+template <typename Dtype>
+void PixelShuffleLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  if (space_to_depth()) {
+    Shuffle(*top[0], false, bottom[0]->cpu_data(),
+        top[0]->mutable_cpu_data());
+  } else {
+    Shuffle(*bottom[0], true, bottom[0]->cpu_data(),
+        top[0]->mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void PixelShuffleLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) { return; }
+  if (space_to_depth()) {
+    Shuffle(*top[0], true, top[0]->cpu_diff(),
+        bottom[0]->mutable_cpu_diff());
+  } else {
+    Shuffle(*bottom[0], false, top[0]->cpu_diff(),
+        bottom[0]->mutable_cpu_diff());
+  }
+}
+
+INSTANTIATE_CLASS(PixelShuffleLayer);
+INSTANTIATE_CLASS(PixelUnshuffleLayer);
+REGISTER_LAYER_CLASS(PixelShuffle);
+REGISTER_LAYER_CLASS(PixelUnshuffle);
+
+}  // namespace caffe
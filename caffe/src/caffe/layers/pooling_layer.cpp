@@ -10,6 +10,124 @@ namespace caffe {
 using std::min;
 using std::max;
 
+// Max and average pooling of one channel by a square kernel of K with
+// stride S and pad P. The windows that lie inside the image are pooled by
+// fully unrolled loops without bounds checks; only those on the border are
+// clipped. Results match the generic loops of Forward_cpu exactly.
+template <typename Dtype, int K, int S, int P>
+class FixedPooling {
+ public:
+  static void Max(const Dtype* bottom_data, int height, int width,
+      int pooled_height, int pooled_width, Dtype* top_data, int* mask) {
+    int ph_begin, ph_end, pw_begin, pw_end;
+    Interior(height, pooled_height, &ph_begin, &ph_end);
+    Interior(width, pooled_width, &pw_begin, &pw_end);
+    for (int ph = 0; ph < pooled_height; ++ph) {
+      const int hstart = ph * S - P;
+      int pw = 0;
+      if (ph >= ph_begin && ph < ph_end) {
+        for (; pw < pw_begin; ++pw) {
+          MaxBorder(bottom_data, height, width, hstart, pw * S - P,
+              top_data++, mask++);
+        }
+        for (; pw < pw_end; ++pw) {
+          const int wstart = pw * S - P;
+          Dtype value = -FLT_MAX;
+          int max_index = -1;
+          for (int h = 0; h < K; ++h) {
+            for (int w = 0; w < K; ++w) {
+              const int index = (hstart + h) * width + wstart + w;
+              if (bottom_data[index] > value) {
+                value = bottom_data[index];
+                max_index = index;
+              }
+            }
+          }
+          *top_data++ = value;
+          *mask++ = max_index;
+        }
+      }
+      for (; pw < pooled_width; ++pw) {
+        MaxBorder(bottom_data, height, width, hstart, pw * S - P,
+            top_data++, mask++);
+      }
+    }
+  }
+
+  static void Ave(const Dtype* bottom_data, int height, int width,
+      int pooled_height, int pooled_width, Dtype* top_data) {
+    int ph_begin, ph_end, pw_begin, pw_end;
+    Interior(height, pooled_height, &ph_begin, &ph_end);
+    Interior(width, pooled_width, &pw_begin, &pw_end);
+    for (int ph = 0; ph < pooled_height; ++ph) {
+      const int hstart = ph * S - P;
+      int pw = 0;
+      if (ph >= ph_begin && ph < ph_end) {
+        for (; pw < pw_begin; ++pw) {
+          AveBorder(bottom_data, height, width, hstart, pw * S - P,
+              top_data++);
+        }
+        for (; pw < pw_end; ++pw) {
+          const Dtype* window = bottom_data + hstart * width + pw * S - P;
+          Dtype sum = 0;
+          for (int h = 0; h < K; ++h) {
+            for (int w = 0; w < K; ++w) {
+              sum += window[h * width + w];
+            }
+          }
+          *top_data++ = sum / (K * K);
+        }
+      }
+      for (; pw < pooled_width; ++pw) {
+        AveBorder(bottom_data, height, width, hstart, pw * S - P,
+            top_data++);
+      }
+    }
+  }
+
+ private:
+  // The outputs [*begin, *end) of an axis whose windows lie inside it.
+  static void Interior(int size, int pooled_size, int* begin, int* end) {
+    *begin = min((P + S - 1) / S, pooled_size);
+    *end = size - K + P >= 0 ? min((size - K + P) / S + 1, pooled_size) : 0;
+    *end = max(*end, *begin);
+  }
+
+  static void MaxBorder(const Dtype* bottom_data, int height, int width,
+      int hstart, int wstart, Dtype* top_data, int* mask) {
+    const int hend = min(hstart + K, height);
+    const int wend = min(wstart + K, width);
+    Dtype value = -FLT_MAX;
+    int max_index = -1;
+    for (int h = max(hstart, 0); h < hend; ++h) {
+      for (int w = max(wstart, 0); w < wend; ++w) {
+        const int index = h * width + w;
+        if (bottom_data[index] > value) {
+          value = bottom_data[index];
+          max_index = index;
+        }
+      }
+    }
+    *top_data = value;
+    *mask = max_index;
+  }
+
+  static void AveBorder(const Dtype* bottom_data, int height, int width,
+      int hstart, int wstart, Dtype* top_data) {
+    const int pool_size = (min(hstart + K, height + P) - hstart) *
+        (min(wstart + K, width + P) - wstart);
+    const int hend = min(hstart + K, height);
+    const int wend = min(wstart + K, width);
+    Dtype sum = 0;
+    for (int h = max(hstart, 0); h < hend; ++h) {
+      for (int w = max(wstart, 0); w < wend; ++w) {
+        sum += bottom_data[h * width + w];
+      }
+    }
+    *top_data = sum / pool_size;
+  }
+};
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -73,6 +191,22 @@ void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     CHECK_LT(pad_h_, kernel_h_);
     CHECK_LT(pad_w_, kernel_w_);
   }
+  // Pick the pooling compiled for the geometry, if there is one.
+  max_pool_func_ = NULL;
+  ave_pool_func_ = NULL;
+  if (!global_pooling_ && kernel_h_ == kernel_w_ && stride_h_ == stride_w_
+      && pad_h_ == pad_w_) {
+#define SET_IF_FIXED(K, S, P) \
+    if (kernel_h_ == K && stride_h_ == S && pad_h_ == P) { \
+      max_pool_func_ = &FixedPooling<Dtype, K, S, P>::Max; \
+      ave_pool_func_ = &FixedPooling<Dtype, K, S, P>::Ave; \
+    }
+    SET_IF_FIXED(2, 2, 0)
+    SET_IF_FIXED(3, 2, 0)
+    SET_IF_FIXED(3, 2, 1)
+    SET_IF_FIXED(3, 1, 1)
+#undef SET_IF_FIXED
+  }
 }
 
 template <typename Dtype>
@@ -138,6 +272,16 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   // loop to save time, although this results in more code.
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
+    if (max_pool_func_ && !use_top_mask) {
+      mask = max_idx_.mutable_cpu_data();
+      for (int i = 0; i < bottom[0]->num() * channels_; ++i) {
+        max_pool_func_(bottom_data + i * height_ * width_, height_, width_,
+            pooled_height_, pooled_width_,
+            top_data + i * pooled_height_ * pooled_width_,
+            mask + i * pooled_height_ * pooled_width_);
+      }
+      break;
+    }
     // Initialize
     if (use_top_mask) {
       top_mask = top[1]->mutable_cpu_data();
@@ -186,6 +330,14 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     }
     break;
   case PoolingParameter_PoolMethod_AVE:
+    if (ave_pool_func_) {
+      for (int i = 0; i < bottom[0]->num() * channels_; ++i) {
+        ave_pool_func_(bottom_data + i * height_ * width_, height_, width_,
+            pooled_height_, pooled_width_,
+            top_data + i * pooled_height_ * pooled_width_);
+      }
+      break;
+    }
     for (int i = 0; i < top_count; ++i) {
       top_data[i] = 0;
     }
@@ -1,10 +1,59 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/sigmoid_cross_entropy_loss_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// The loss is summed for each block of this many elements, and the blocks
+// split between threads; a single block runs on the calling thread.
+static const int kBlockSize = 1 << 15;
+
+// Computes the sigmoid of the input, the loss and, if gradient is given,
+// (sigmoid - target) * scale, for each of the blocks [begin, end). All of
+// them come from e = exp(-|x|): the stable loss is
+// x * (target - (x >= 0)) - log(1 + e), and the sigmoid 1 / (1 + e) or
+// e / (1 + e) for x below 0.
+template <typename Dtype>
+class SigmoidCrossEntropy {
+ public:
+  SigmoidCrossEntropy(int count, const Dtype* input, const Dtype* target,
+      Dtype scale, Dtype* sigmoid, Dtype* gradient, Dtype* losses)
+      : count_(count), input_(input), target_(target), scale_(scale),
+      sigmoid_(sigmoid), gradient_(gradient), losses_(losses) {}
+
+  void operator()(int begin, int end) const {
+    for (int block = begin; block < end; ++block) {
+      const int block_end = std::min(count_, (block + 1) * kBlockSize);
+      Dtype loss = 0;
+      for (int i = block * kBlockSize; i < block_end; ++i) {
+        const Dtype x = input_[i];
+        const Dtype e = exp(-std::fabs(x));
+        loss -= x * (target_[i] - (x >= 0)) - log(1 + e);
+        sigmoid_[i] = (x >= 0 ? Dtype(1) : e) / (1 + e);
+      }
+      if (gradient_) {
+        for (int i = block * kBlockSize; i < block_end; ++i) {
+          gradient_[i] = scale_ * (sigmoid_[i] - target_[i]);
+        }
+      }
+      losses_[block] = loss;
+    }
+  }
+
+ private:
+  const int count_;
+  const Dtype* input_;
+  const Dtype* target_;
+  const Dtype scale_;
+  Dtype* sigmoid_;
+  Dtype* gradient_;
+  Dtype* losses_;
+};
+
 template <typename Dtype>
 void SigmoidCrossEntropyLossLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
@@ -28,19 +77,26 @@ void SigmoidCrossEntropyLossLayer<Dtype>::Reshape(
 template <typename Dtype>
 void SigmoidCrossEntropyLossLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  // The forward pass computes the sigmoid outputs.
-  sigmoid_bottom_vec_[0] = bottom[0];
-  sigmoid_layer_->Forward(sigmoid_bottom_vec_, sigmoid_top_vec_);
-  // Compute the loss (negative log likelihood)
+  // The forward pass computes the sigmoid outputs and the loss (negative log
+  // likelihood) in one sweep, and in training the gradient as well.
   const int count = bottom[0]->count();
   const int num = bottom[0]->num();
-  // Stable version of loss computation from input data
-  const Dtype* input_data = bottom[0]->cpu_data();
-  const Dtype* target = bottom[1]->cpu_data();
+  const int num_blocks = (count + kBlockSize - 1) / kBlockSize;
+  vector<Dtype> losses(num_blocks);
+  this->gradient_in_diff_ = this->gradient_in_forward();
+  SigmoidCrossEntropy<Dtype> body(count, bottom[0]->cpu_data(),
+      bottom[1]->cpu_data(), Dtype(1) / num,
+      sigmoid_output_->mutable_cpu_data(),
+      this->gradient_in_diff_ ? bottom[0]->mutable_cpu_diff() : NULL,
+      &losses[0]);
+  if (num_blocks == 1) {
+    body(0, 1);
+  } else {
+    parallel_for(0, num_blocks, body);
+  }
   Dtype loss = 0;
-  for (int i = 0; i < count; ++i) {
-    loss -= input_data[i] * (target[i] - (input_data[i] >= 0)) -
-        log(1 + exp(input_data[i] - 2 * input_data[i] * (input_data[i] >= 0)));
+  for (int block = 0; block < num_blocks; ++block) {
+    loss += losses[block];
   }
   top[0]->mutable_cpu_data()[0] = loss / num;
 }
@@ -54,17 +110,25 @@ void SigmoidCrossEntropyLossLayer<Dtype>::Backward_cpu(
                << " Layer cannot backpropagate to label inputs.";
   }
   if (propagate_down[0]) {
-    // First, compute the diff
     const int count = bottom[0]->count();
     const int num = bottom[0]->num();
-    const Dtype* sigmoid_output_data = sigmoid_output_->cpu_data();
-    const Dtype* target = bottom[1]->cpu_data();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    caffe_sub(count, sigmoid_output_data, target, bottom_diff);
-    // Scale down gradient
     const Dtype loss_weight = top[0]->cpu_diff()[0];
-    caffe_scal(count, loss_weight / num, bottom_diff);
+    if (this->gradient_in_diff_) {
+      // The forward pass left the gradient for a loss weight of 1.
+      if (loss_weight != Dtype(1)) {
+        caffe_scal(count, loss_weight, bottom_diff);
+      }
+    } else {
+      // First, compute the diff
+      const Dtype* sigmoid_output_data = sigmoid_output_->cpu_data();
+      const Dtype* target = bottom[1]->cpu_data();
+      caffe_sub(count, sigmoid_output_data, target, bottom_diff);
+      // Scale down gradient
+      caffe_scal(count, loss_weight / num, bottom_diff);
+    }
   }
+  this->gradient_in_diff_ = false;
 }
 
 #ifdef CPU_ONLY
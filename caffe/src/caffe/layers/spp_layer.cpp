@@ -222,6 +222,81 @@ void SPPLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   split_layer_->Backward(split_top_vec_, propagate_down, bottom);
 }
 
+// Whether every level of a pyramid of the given height can pool a feature
+// map of the given size, with less padding than its kernel size as
+// GetPoolingParam() computes them.
+static bool FitsPyramid(int size, int pyramid_height) {
+  for (int i = 0; i < pyramid_height; ++i) {
+    const int num_bins = 1 << i;
+    const int kernel = (size + num_bins - 1) / num_bins;
+    if ((kernel * num_bins - size + 1) / 2 >= kernel) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Widens [*begin, *end] within [0, size) until the pyramid can pool it.
+static void WidenToFitPyramid(int size, int pyramid_height, int* begin,
+    int* end) {
+  *begin = min(max(*begin, 0), size - 1);
+  *end = min(max(*end, *begin), size - 1);
+  while (!FitsPyramid(*end - *begin + 1, pyramid_height) &&
+      *end - *begin + 1 < size) {
+    if (*end < size - 1) {
+      ++*end;
+    } else {
+      --*begin;
+    }
+  }
+}
+
+template <typename Dtype>
+void SPPLayer<Dtype>::PoolWindows(const LayerParameter& param,
+    const Blob<Dtype>& features, const vector<int>& windows,
+    Blob<Dtype>* top) {
+  CHECK_EQ(features.num_axes(), 4);
+  CHECK_EQ(features.num(), 1) << "Windows are pooled from one feature map.";
+  CHECK_EQ(windows.size() % 4, 0) << "Windows take 4 coordinates each.";
+  const int num_windows = windows.size() / 4;
+  CHECK_GT(num_windows, 0);
+  const int pyramid_height = param.spp_param().pyramid_height();
+  const int channels = features.channels();
+  const int height = features.height();
+  const int width = features.width();
+  SPPLayer<Dtype> layer(param);
+  Blob<Dtype> window;
+  Blob<Dtype> pooled;
+  vector<Blob<Dtype>*> window_vec(1, &window);
+  vector<Blob<Dtype>*> pooled_vec(1, &pooled);
+  for (int i = 0; i < num_windows; ++i) {
+    int y1 = windows[4 * i];
+    int x1 = windows[4 * i + 1];
+    int y2 = windows[4 * i + 2];
+    int x2 = windows[4 * i + 3];
+    WidenToFitPyramid(height, pyramid_height, &y1, &y2);
+    WidenToFitPyramid(width, pyramid_height, &x1, &x2);
+    window.Reshape(1, channels, y2 - y1 + 1, x2 - x1 + 1);
+    Dtype* window_data = window.mutable_cpu_data();
+    for (int c = 0; c < channels; ++c) {
+      for (int h = y1; h <= y2; ++h) {
+        caffe_copy(window.width(), features.cpu_data() + features.offset(
+            0, c, h, x1), window_data + window.offset(0, c, h - y1));
+      }
+    }
+    // Forward() reshapes the pyramid to the size of each window.
+    if (i == 0) {
+      layer.SetUp(window_vec, pooled_vec);
+      vector<int> shape = pooled.shape();
+      shape[0] = num_windows;
+      top->Reshape(shape);
+    }
+    layer.Forward(window_vec, pooled_vec);
+    caffe_copy(pooled.count(), pooled.cpu_data(),
+        top->mutable_cpu_data() + i * pooled.count());
+  }
+}
+
 INSTANTIATE_CLASS(SPPLayer);
 REGISTER_LAYER_CLASS(SPP);
 
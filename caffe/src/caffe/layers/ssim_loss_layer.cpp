@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "caffe/layers/ssim_loss_layer.hpp"
+#include "caffe/util/expression.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -112,7 +113,7 @@ void SSIMLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   GaussConvolveHelper(*bottom[0],ux_);
   GaussConvolveHelper(*bottom[1],uy_);
 
-  Blob<Dtype> tempContainer1, tempContainer2;
+  Blob<Dtype> tempContainer1;
   tempContainer1.ReshapeLike(*bottom[0]);
   caffe_sqr(count, bottom[0]->cpu_data(), tempContainer1.mutable_cpu_data()); 
   GaussConvolveHelper(tempContainer1,sx2_);
@@ -121,35 +122,28 @@ void SSIMLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   caffe_mul(count, bottom[0]->cpu_data(), bottom[1]->cpu_data(), tempContainer1.mutable_cpu_data()); 
   GaussConvolveHelper(tempContainer1,sxy_);
 
-  tempContainer1.ReshapeLike(ux_);
-  tempContainer2.ReshapeLike(uy_);
-  count = tempContainer1.count();
+  count = ux_.count();
+  const expr::Array<Dtype> ux(ux_.cpu_data());
+  const expr::Array<Dtype> uy(uy_.cpu_data());
+  const expr::Array<Dtype> sx2(sx2_.cpu_data());
+  const expr::Array<Dtype> sy2(sy2_.cpu_data());
+  const expr::Array<Dtype> sxy(sxy_.cpu_data());
+  const expr::Array<Dtype> lp(lp_.cpu_data());
+  const expr::Array<Dtype> cs(cs_.cpu_data());
 
-  //Compute ux^2 and uy^2 and collect ux^2+uy^2 for later use
-  caffe_sqr(count, ux_.cpu_data(), tempContainer1.mutable_cpu_data());
-  caffe_sub(count, sx2_.cpu_data(), tempContainer1.cpu_data(), sx2_.mutable_cpu_data());
-  caffe_sqr(count, uy_.cpu_data(), tempContainer2.mutable_cpu_data());
-  caffe_sub(count, sy2_.cpu_data(), tempContainer2.cpu_data(), sy2_.mutable_cpu_data());
-  caffe_add(count, tempContainer1.cpu_data(), tempContainer2.cpu_data(), tempContainer2.mutable_cpu_data());
+  // Turn the moments into variances and covariance
+  caffe_eval(count, sx2 - sqr(ux), sx2_.mutable_cpu_data());
+  caffe_eval(count, sy2 - sqr(uy), sy2_.mutable_cpu_data());
+  caffe_eval(count, sxy - ux * uy, sxy_.mutable_cpu_data());
 
-  caffe_mul(count, ux_.cpu_data(), uy_.cpu_data(), tempContainer1.mutable_cpu_data());
-  caffe_sub(count, sxy_.cpu_data(), tempContainer1.cpu_data(), sxy_.mutable_cpu_data());
-  
   const Dtype C1 = c1_;
-  caffe_cpu_scale(count, Dtype(2), tempContainer1.cpu_data(), tempContainer1.mutable_cpu_data());
-  caffe_add_scalar(count, C1, tempContainer1.mutable_cpu_data());
-  caffe_add_scalar(count, C1, tempContainer2.mutable_cpu_data());
-  caffe_div(count, tempContainer1.cpu_data(), tempContainer2.cpu_data(), lp_.mutable_cpu_data());
+  caffe_eval(count, (2 * ux * uy + C1) / (sqr(ux) + sqr(uy) + C1),
+      lp_.mutable_cpu_data());
 
   const Dtype C2 = c2_;
-  caffe_add(count, sx2_.cpu_data(), sy2_.cpu_data(), tempContainer2.mutable_cpu_data()); 
-  caffe_add_scalar(count, C2, tempContainer2.mutable_cpu_data());
-  caffe_cpu_scale(count, Dtype(2), sxy_.cpu_data(), tempContainer1.mutable_cpu_data());
-//  caffe_cpu_axpby(count, Dtype(2), sxy_.cpu_data(), Dtype(0), tempContainer1.mutable_cpu_data());
-  caffe_add_scalar(count, C2, tempContainer1.mutable_cpu_data());
-  caffe_div(count, tempContainer1.cpu_data(), tempContainer2.cpu_data(), cs_.mutable_cpu_data());
-  
-  Dtype ssim = caffe_cpu_dot(count, lp_.cpu_data(),cs_.cpu_data()) ;
+  caffe_eval(count, (2 * sxy + C2) / (sx2 + sy2 + C2), cs_.mutable_cpu_data());
+
+  Dtype ssim = caffe_sum(count, lp * cs);
   //Dtype ssim = caffe_cpu_dot(count, lp_.cpu_data(),cs_.cpu_data()) / ux_.count();
   Dtype loss = (Dtype(count)-ssim)/ bottom[0]->num();
   top[0]->mutable_cpu_data()[0] = loss;
@@ -171,7 +165,7 @@ void SSIMLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const Dtype* sx2 = sx2_.cpu_data();
   const Dtype* sy2 = sy2_.cpu_data();
   const Dtype* sxy = sxy_.cpu_data();
-  const double* gaussian = gauss_kernel.cpu_data();
+  const double* gaussian = gauss_kernel_.cpu_data();
 
   caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
   const Dtype alpha = -top[0]->cpu_diff()[0] / bottom[0]->num();
@@ -211,11 +205,9 @@ void SSIMLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
 	cs+= ux_.offset(0,1);
     }
   }
-  caffe_cpu_scale(
-          bottom[0]->count(),              // count
-          alpha,                              // alpha
-          bottom[0]->cpu_diff(),              // x
-          bottom_diff);  // y
+  // bottom_diff has been advanced past the end of the blob by the loop above,
+  // so scale through the blob itself.
+  caffe_scal(bottom[0]->count(), alpha, bottom[0]->mutable_cpu_diff());
 }
 
 #ifdef CPU_ONLY
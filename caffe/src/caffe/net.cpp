@@ -1,3 +1,4 @@
+#include <boost/thread.hpp>
 #include <algorithm>
 #include <map>
 #include <set>
@@ -9,11 +10,15 @@
 
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/layers/fused_neuron_layer.hpp"
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/autotune.hpp"
+#include "caffe/util/fuse_neurons.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
+#include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
@@ -21,6 +26,9 @@
 
 namespace caffe {
 
+// Layers read ahead of the workers copying them wait in a queue this long.
+static const int kCopyQueueCapacity = 64;
+
 template <typename Dtype>
 Net<Dtype>::Net(const NetParameter& param, const Net* root_net)
     : root_net_(root_net) {
@@ -52,6 +60,14 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // Create a copy of filtered_param with splits added where necessary.
   NetParameter param;
   InsertSplits(filtered_param, &param);
+  // Replace chains of neuron layers by fused ones if asked to; the layers of
+  // the chain replacing each layer of param, or none.
+  vector<vector<LayerParameter> > fused_chains(param.layer_size());
+  if (Caffe::fuse_neurons() && Caffe::mode() == Caffe::CPU) {
+    NetParameter split_param;
+    split_param.Swap(&param);
+    FuseNeurons(split_param, &param, &fused_chains);
+  }
   // Basically, build all the layers and set up their connections.
   name_ = param.name();
   map<string, int> blob_name_to_idx;
@@ -99,6 +115,9 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       LOG(INFO) << "Sharing layer " << layer_param.name() << " from root net";
       layers_.push_back(root_net_->layers_[layer_id]);
       layers_[layer_id]->SetShared(true);
+    } else if (!fused_chains[layer_id].empty()) {
+      layers_.push_back(shared_ptr<Layer<Dtype> >(
+          new FusedNeuronLayer<Dtype>(layer_param, fused_chains[layer_id])));
     } else {
       layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
     }
@@ -133,6 +152,17 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
         AppendTop(param, layer_id, num_top, NULL, NULL);
       }
     }
+    // With autotuning on, recreate the layer with the engine that is fastest
+    // at its actual bottom shapes.
+    if (Caffe::autotune() && !share_from_root
+        && fused_chains[layer_id].empty()) {
+      LayerParameter tuned_param(layer_param);
+      if (LayerAutotuner<Dtype>::Tune(bottom_vecs_[layer_id],
+          top_vecs_[layer_id].size(), &tuned_param)) {
+        layers_[layer_id] = LayerRegistry<Dtype>::CreateLayer(tuned_param);
+        layer = layers_[layer_id].get();
+      }
+    }
     // After this layer is connected, set it up.
     if (share_from_root) {
       // Set up size of top blobs using root_net_
@@ -803,39 +833,104 @@ void Net<Dtype>::Reshape() {
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
-  int num_source_layers = param.layer_size();
-  for (int i = 0; i < num_source_layers; ++i) {
-    const LayerParameter& source_layer = param.layer(i);
-    const string& source_layer_name = source_layer.name();
-    int target_layer_id = 0;
-    while (target_layer_id != layer_names_.size() &&
-        layer_names_[target_layer_id] != source_layer_name) {
-      ++target_layer_id;
-    }
-    if (target_layer_id == layer_names_.size()) {
+  RingQueue<const LayerParameter*> queue(kCopyQueueCapacity,
+      RingQueue<const LayerParameter*>::MULTIPLE_PRODUCERS_CONSUMERS);
+  boost::thread_group workers;
+  const int num_workers = StartCopyingLayers(&queue, &workers);
+  for (int i = 0; i < param.layer_size(); ++i) {
+    queue.push(&param.layer(i));
+  }
+  FinishCopyingLayers(param, num_workers, &queue, &workers);
+}
+
+template <typename Dtype>
+int Net<Dtype>::StartCopyingLayers(RingQueue<const LayerParameter*>* queue,
+    boost::thread_group* workers) {
+  // Copying is bound by memory bandwidth, which a few threads saturate.
+  const int kMaxWorkers = 8;
+  const int num_workers = std::max(1, std::min<int>(kMaxWorkers,
+      boost::thread::hardware_concurrency()));
+  int device = 0;
+#ifndef CPU_ONLY
+  if (Caffe::mode() == Caffe::GPU) {
+    CUDA_CHECK(cudaGetDevice(&device));
+  }
+#endif
+  for (int i = 0; i < num_workers; ++i) {
+    workers->create_thread(boost::bind(&Net<Dtype>::CopyLayersFromQueue, this,
+        queue, Caffe::mode(), device));
+  }
+  return num_workers;
+}
+
+template <typename Dtype>
+void Net<Dtype>::FinishCopyingLayers(const NetParameter& param,
+    int num_workers, RingQueue<const LayerParameter*>* queue,
+    boost::thread_group* workers) {
+  for (int i = 0; i < num_workers; ++i) {
+    queue->push(NULL);
+  }
+  workers->join_all();
+  for (int i = 0; i < param.layer_size(); ++i) {
+    CopyTrainedLayer(param.layer(i), true);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyLayersFromQueue(
+    RingQueue<const LayerParameter*>* queue, Caffe::Brew mode,
+    int device) {
+  // The Caffe mode is per thread.
+#ifndef CPU_ONLY
+  if (mode == Caffe::GPU) {
+    CUDA_CHECK(cudaSetDevice(device));
+  }
+#endif
+  Caffe::set_mode(mode);
+  for (const LayerParameter* layer = queue->pop(); layer != NULL;
+       layer = queue->pop()) {
+    CopyTrainedLayer(*layer, false);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayer(const LayerParameter& source_layer,
+    bool shared) {
+  const string& source_layer_name = source_layer.name();
+  map<string, int>::const_iterator target = layer_names_index_.find(
+      source_layer_name);
+  if (target == layer_names_index_.end()) {
+    if (!shared) {
       LOG(INFO) << "Ignoring source layer " << source_layer_name;
-      continue;
     }
+    return;
+  }
+  const int target_layer_id = target->second;
+  if (!shared) {
     DLOG(INFO) << "Copying source layer " << source_layer_name;
-    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
-        layers_[target_layer_id]->blobs();
-    CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
-        << "Incompatible number of blobs for layer " << source_layer_name;
-    for (int j = 0; j < target_blobs.size(); ++j) {
-      if (!target_blobs[j]->ShapeEquals(source_layer.blobs(j))) {
-        Blob<Dtype> source_blob;
-        const bool kReshape = true;
-        source_blob.FromProto(source_layer.blobs(j), kReshape);
-        LOG(FATAL) << "Cannot copy param " << j << " weights from layer '"
-            << source_layer_name << "'; shape mismatch.  Source param shape is "
-            << source_blob.shape_string() << "; target param shape is "
-            << target_blobs[j]->shape_string() << ". "
-            << "To learn this layer's parameters from scratch rather than "
-            << "copying from a saved net, rename the layer.";
-      }
-      const bool kReshape = false;
-      target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
+  }
+  vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+      layers_[target_layer_id]->blobs();
+  CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
+      << "Incompatible number of blobs for layer " << source_layer_name;
+  for (int j = 0; j < target_blobs.size(); ++j) {
+    const int net_param_id = param_id_vecs_[target_layer_id][j];
+    if ((param_owners_[net_param_id] != -1) != shared) {
+      continue;
+    }
+    if (!target_blobs[j]->ShapeEquals(source_layer.blobs(j))) {
+      Blob<Dtype> source_blob;
+      const bool kReshape = true;
+      source_blob.FromProto(source_layer.blobs(j), kReshape);
+      LOG(FATAL) << "Cannot copy param " << j << " weights from layer '"
+          << source_layer_name << "'; shape mismatch.  Source param shape is "
+          << source_blob.shape_string() << "; target param shape is "
+          << target_blobs[j]->shape_string() << ". "
+          << "To learn this layer's parameters from scratch rather than "
+          << "copying from a saved net, rename the layer.";
     }
+    const bool kReshape = false;
+    target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
   }
 }
 
@@ -853,8 +948,19 @@ template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
     const string trained_filename) {
   NetParameter param;
-  ReadNetParamsFromBinaryFileOrDie(trained_filename, &param);
-  CopyTrainedLayersFrom(param);
+  RingQueue<const LayerParameter*> queue(kCopyQueueCapacity,
+      RingQueue<const LayerParameter*>::MULTIPLE_PRODUCERS_CONSUMERS);
+  boost::thread_group workers;
+  const int num_workers = StartCopyingLayers(&queue, &workers);
+  const bool streamed = ReadNetLayersFromBinaryFile(trained_filename, &param,
+      &queue);
+  FinishCopyingLayers(param, num_workers, &queue, &workers);
+  if (!streamed) {
+    // Deprecated nets are read whole to be upgraded; any layers copied
+    // above are simply copied again.
+    ReadNetParamsFromBinaryFileOrDie(trained_filename, &param);
+    CopyTrainedLayersFrom(param);
+  }
 }
 
 template <typename Dtype>
@@ -898,8 +1004,14 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
               << source_layer_name;
         }
       }
-      hdf5_load_nd_dataset(layer_hid, dataset_name.c_str(), 0, kMaxBlobAxes,
-          target_blobs[j].get());
+      if (hdf5_is_encoded_weights(layer_hid, dataset_name)) {
+        EncodedWeights encoded;
+        hdf5_load_encoded_weights(layer_hid, dataset_name, &encoded);
+        DecodeWeights(encoded, target_blobs[j].get());
+      } else {
+        hdf5_load_nd_dataset(layer_hid, dataset_name.c_str(), 0, kMaxBlobAxes,
+            target_blobs[j].get());
+      }
     }
     H5Gclose(layer_hid);
   }
@@ -917,6 +1029,16 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
   }
   DLOG(INFO) << "Serializing " << layers_.size() << " layers";
   for (int i = 0; i < layers_.size(); ++i) {
+    // A fused chain is saved as the layers it was fused from, so that the
+    // net can be created again; they have no blobs.
+    const FusedNeuronLayer<Dtype>* fused =
+        dynamic_cast<const FusedNeuronLayer<Dtype>*>(layers_[i].get());
+    if (fused) {
+      for (int j = 0; j < fused->chain().size(); ++j) {
+        param->add_layer()->CopyFrom(fused->chain()[j]);
+      }
+      continue;
+    }
     LayerParameter* layer_param = param->add_layer();
     layers_[i]->ToProto(layer_param, write_diff);
   }
@@ -979,6 +1101,71 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
   H5Fclose(file_hid);
 }
 
+template <typename Dtype>
+void Net<Dtype>::ToCompressedHDF5(const string& filename,
+    const map<string, WeightEncoding>& encodings) const {
+  map<int, EncodedWeights> encoded;
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    map<string, WeightEncoding>::const_iterator it =
+        encodings.find(layer_names_[layer_id]);
+    if (it == encodings.end() || it->second == WEIGHT_FLOAT) {
+      continue;
+    }
+    for (int param_id = 0; param_id < param_id_vecs_[layer_id].size();
+         ++param_id) {
+      const int net_param_id = param_id_vecs_[layer_id][param_id];
+      const Blob<Dtype>& blob = *params_[net_param_id];
+      // Only save params that own themselves
+      if (param_owners_[net_param_id] == -1 && (it->second == WEIGHT_FP16 ||
+          blob.count() >= kWeightCodebookSize)) {
+        EncodeWeights(blob, it->second, &encoded[net_param_id]);
+      }
+    }
+  }
+  ToCompressedHDF5(filename, encoded);
+}
+
+template <typename Dtype>
+void Net<Dtype>::ToCompressedHDF5(const string& filename,
+    const map<int, EncodedWeights>& encoded) const {
+  hid_t file_hid = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+      H5P_DEFAULT);
+  CHECK_GE(file_hid, 0)
+      << "Couldn't open " << filename << " to save weights.";
+  hid_t data_hid = H5Gcreate2(file_hid, "data", H5P_DEFAULT, H5P_DEFAULT,
+      H5P_DEFAULT);
+  CHECK_GE(data_hid, 0) << "Error saving weights to " << filename << ".";
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    const string& layer_name = layer_names_[layer_id];
+    hid_t layer_data_hid = H5Gcreate2(data_hid, layer_name.c_str(),
+        H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    CHECK_GE(layer_data_hid, 0)
+        << "Error saving weights to " << filename << ".";
+    int num_params = layers_[layer_id]->blobs().size();
+    for (int param_id = 0; param_id < num_params; ++param_id) {
+      ostringstream dataset_name;
+      dataset_name << param_id;
+      const int net_param_id = param_id_vecs_[layer_id][param_id];
+      if (param_owners_[net_param_id] != -1) {
+        // Only save params that own themselves
+        continue;
+      }
+      map<int, EncodedWeights>::const_iterator it =
+          encoded.find(net_param_id);
+      if (it == encoded.end()) {
+        hdf5_save_nd_dataset<Dtype>(layer_data_hid, dataset_name.str(),
+            *params_[net_param_id]);
+      } else {
+        hdf5_save_encoded_weights(layer_data_hid, dataset_name.str(),
+            it->second);
+      }
+    }
+    H5Gclose(layer_data_hid);
+  }
+  H5Gclose(data_hid);
+  H5Fclose(file_hid);
+}
+
 template <typename Dtype>
 void Net<Dtype>::Update() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "caffe/layer_factory.hpp"
+#include "caffe/layers/fused_neuron_layer.hpp"
+#include "caffe/net_plan.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Activations are placed at multiples of this many bytes in the arena.
+static const size_t kArenaAlignment = 64;
+
+template <typename Dtype>
+static vector<Blob<Dtype>*> PlanBlobs(const vector<Blob<Dtype>*>& net_blobs,
+    const std::map<const Blob<Dtype>*, Blob<Dtype>*>& plan_blob) {
+  vector<Blob<Dtype>*> blobs;
+  for (int i = 0; i < net_blobs.size(); ++i) {
+    blobs.push_back(plan_blob.find(net_blobs[i])->second);
+  }
+  return blobs;
+}
+
+template <typename Dtype>
+NetPlan<Dtype>::NetPlan(const Net<Dtype>& net) : arena_bytes_(0) {
+  CHECK_EQ(net.phase(), TEST) << "NetPlan needs a TEST phase net.";
+  std::map<const Blob<Dtype>*, Blob<Dtype>*> plan_blob;
+  for (int i = 0; i < net.blobs().size(); ++i) {
+    blobs_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    blobs_.back()->ReshapeLike(*net.blobs()[i]);
+    plan_blob[net.blobs()[i].get()] = blobs_.back().get();
+  }
+  input_blobs_ = PlanBlobs(net.input_blobs(), plan_blob);
+  output_blobs_ = PlanBlobs(net.output_blobs(), plan_blob);
+  vector<bool> fused(net.layers().size(), false);
+  for (int i = 0; i < net.layers().size(); ++i) {
+    if (fused[i]) {
+      continue;
+    }
+    const shared_ptr<Layer<Dtype> >& net_layer = net.layers()[i];
+    const string type = net_layer->type();
+    Step step;
+    step.bottom = PlanBlobs(net.bottom_vecs()[i], plan_blob);
+    step.top = PlanBlobs(net.top_vecs()[i], plan_blob);
+    if (type == "Silence") {
+      continue;
+    }
+    if (type == "Split" || type == "Flatten" || type == "Reshape" ||
+        type == "Dropout") {
+      // At inference these only pass their bottom on.
+      for (int j = 0; j < step.top.size(); ++j) {
+        if (step.top[j] != step.bottom[0]) {
+          step.top[j]->ShareData(*step.bottom[0]);
+        }
+      }
+      continue;
+    }
+    shared_ptr<Layer<Dtype> > layer;
+    const int bn_id = FusableBatchNorm(net, i);
+    if (bn_id >= 0) {
+      LOG_IF(INFO, Caffe::root_solver()) << "NetPlan folds "
+          << net.layer_names()[bn_id] << " into " << net.layer_names()[i];
+      layer = FoldBatchNorm(net, i, bn_id);
+      step.top = PlanBlobs(net.top_vecs()[bn_id], plan_blob);
+      fused[bn_id] = true;
+    } else if (type == "FusedNeuron") {
+      // The net builds these from chains rather than through the registry.
+      layer.reset(new FusedNeuronLayer<Dtype>(net_layer->layer_param(),
+          static_cast<const FusedNeuronLayer<Dtype>&>(*net_layer).chain()));
+    } else {
+      layer = LayerRegistry<Dtype>::CreateLayer(net_layer->layer_param());
+      // Share the weights; set up then skips their initialization.
+      layer->blobs() = net_layer->blobs();
+    }
+    layer->SetUp(step.bottom, step.top);
+    step.layer = layer.get();
+    layers_.push_back(layer);
+    steps_.push_back(step);
+  }
+  PlanArena();
+  // Run once so that layers allocate their internal buffers now rather than
+  // in the first Run().
+  Forward();
+  LOG_IF(INFO, Caffe::root_solver()) << "NetPlan for " << net.name() << ": "
+      << steps_.size() << " steps from " << net.layers().size()
+      << " layers, " << arena_bytes() << " bytes of activations";
+}
+
+template <typename Dtype>
+int NetPlan<Dtype>::FusableBatchNorm(const Net<Dtype>& net,
+    int layer_id) const {
+  const LayerParameter& param = net.layers()[layer_id]->layer_param();
+  int axis;
+  if (param.type() == "Convolution") {
+    axis = param.convolution_param().axis();
+  } else if (param.type() == "InnerProduct") {
+    axis = param.inner_product_param().axis();
+  } else {
+    return -1;
+  }
+  const vector<Blob<Dtype>*>& top = net.top_vecs()[layer_id];
+  if (net.bottom_vecs()[layer_id].size() != 1 || top.size() != 1 ||
+      top[0]->CanonicalAxisIndex(axis) != 1) {
+    return -1;
+  }
+  // The BatchNorm has to be the first reader of the output.
+  const Blob<Dtype>* output = top[0];
+  int bn_id = -1;
+  for (int i = layer_id + 1; i < net.layers().size() && bn_id < 0; ++i) {
+    const vector<Blob<Dtype>*>& bottom = net.bottom_vecs()[i];
+    if (std::find(bottom.begin(), bottom.end(), output) != bottom.end()) {
+      bn_id = i;
+    }
+  }
+  if (bn_id < 0) {
+    return -1;
+  }
+  const LayerParameter& bn_param = net.layers()[bn_id]->layer_param();
+  if (bn_param.type() != "BatchNorm" ||
+      (bn_param.batch_norm_param().has_use_global_stats() &&
+       !bn_param.batch_norm_param().use_global_stats())) {
+    return -1;
+  }
+  if (net.top_vecs()[bn_id][0] != output) {
+    // Unless the BatchNorm works in place, nothing else may read the
+    // unnormalized output.
+    for (int i = bn_id + 1; i < net.layers().size(); ++i) {
+      const vector<Blob<Dtype>*>& bottom = net.bottom_vecs()[i];
+      if (std::find(bottom.begin(), bottom.end(), output) != bottom.end()) {
+        return -1;
+      }
+    }
+    const vector<Blob<Dtype>*>& outputs = net.output_blobs();
+    if (std::find(outputs.begin(), outputs.end(), output) != outputs.end()) {
+      return -1;
+    }
+  }
+  return bn_id;
+}
+
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > NetPlan<Dtype>::FoldBatchNorm(
+    const Net<Dtype>& net, int layer_id, int bn_id) const {
+  Layer<Dtype>& source = *net.layers()[layer_id];
+  Layer<Dtype>& bn = *net.layers()[bn_id];
+  LayerParameter param(source.layer_param());
+  int num_output;
+  if (param.type() == "Convolution") {
+    param.mutable_convolution_param()->set_bias_term(true);
+    num_output = param.convolution_param().num_output();
+  } else {
+    param.mutable_inner_product_param()->set_bias_term(true);
+    num_output = param.inner_product_param().num_output();
+  }
+  shared_ptr<Blob<Dtype> > weights(new Blob<Dtype>());
+  weights->CopyFrom(*source.blobs()[0], false, true);
+  shared_ptr<Blob<Dtype> > bias(new Blob<Dtype>(vector<int>(1, num_output)));
+  if (source.blobs().size() > 1) {
+    bias->CopyFrom(*source.blobs()[1]);
+  } else {
+    caffe_set(num_output, Dtype(0), bias->mutable_cpu_data());
+  }
+  // BatchNorm keeps running sums of the statistics and their weight.
+  const Dtype weight_sum = bn.blobs()[2]->cpu_data()[0];
+  const Dtype scale_factor = weight_sum == 0 ? 0 : 1 / weight_sum;
+  const Dtype* mean = bn.blobs()[0]->cpu_data();
+  const Dtype* variance = bn.blobs()[1]->cpu_data();
+  const Dtype eps = bn.layer_param().batch_norm_param().eps();
+  CHECK_EQ(bn.blobs()[0]->count(), num_output);
+  const int dim = weights->count() / num_output;
+  Dtype* weight_data = weights->mutable_cpu_data();
+  Dtype* bias_data = bias->mutable_cpu_data();
+  for (int i = 0; i < num_output; ++i) {
+    const Dtype inv_std = 1 / std::sqrt(variance[i] * scale_factor + eps);
+    caffe_scal(dim, inv_std, weight_data + i * dim);
+    bias_data[i] = (bias_data[i] - mean[i] * scale_factor) * inv_std;
+  }
+  shared_ptr<Layer<Dtype> > layer = LayerRegistry<Dtype>::CreateLayer(param);
+  layer->blobs().push_back(weights);
+  layer->blobs().push_back(bias);
+  return layer;
+}
+
+template <typename Dtype>
+void NetPlan<Dtype>::PlanArena() {
+  // Blobs that share data (in-place layers and the dropped pass-through
+  // layers) share one SyncedMemory, which lives from its first to its last
+  // use. Inputs are written before the first step and outputs read after
+  // the last.
+  vector<SyncedMemory*> memories;
+  vector<std::pair<int, int> > lifetimes;
+  std::map<SyncedMemory*, int> memory_index;
+  const int num_steps = steps_.size();
+  for (int s = -1; s <= num_steps; ++s) {
+    vector<Blob<Dtype>*> used;
+    if (s < 0) {
+      used = input_blobs_;
+    } else if (s == num_steps) {
+      used = output_blobs_;
+    } else {
+      used = steps_[s].bottom;
+      used.insert(used.end(), steps_[s].top.begin(), steps_[s].top.end());
+    }
+    for (int i = 0; i < used.size(); ++i) {
+      SyncedMemory* memory = used[i]->data().get();
+      if (!memory_index.count(memory)) {
+        memory_index[memory] = memories.size();
+        memories.push_back(memory);
+        lifetimes.push_back(std::make_pair(s, s));
+      }
+      lifetimes[memory_index[memory]].second = s;
+    }
+  }
+  // Place the largest first, each at the lowest offset that does not overlap
+  // a placed memory with an overlapping lifetime.
+  vector<std::pair<size_t, int> > by_size;
+  for (int i = 0; i < memories.size(); ++i) {
+    by_size.push_back(std::make_pair(memories[i]->size(), i));
+  }
+  std::sort(by_size.rbegin(), by_size.rend());
+  offsets_.resize(memories.size());
+  vector<int> placed;
+  size_t total = 0;
+  for (int i = 0; i < by_size.size(); ++i) {
+    const int id = by_size[i].second;
+    const size_t size = (by_size[i].first + kArenaAlignment - 1) /
+        kArenaAlignment * kArenaAlignment;
+    vector<std::pair<size_t, size_t> > taken;
+    for (int j = 0; j < placed.size(); ++j) {
+      const int other = placed[j];
+      if (lifetimes[other].first <= lifetimes[id].second &&
+          lifetimes[id].first <= lifetimes[other].second) {
+        taken.push_back(std::make_pair(offsets_[other],
+            offsets_[other] + memories[other]->size()));
+      }
+    }
+    std::sort(taken.begin(), taken.end());
+    size_t offset = 0;
+    for (int j = 0; j < taken.size() && taken[j].first < offset + size; ++j) {
+      offset = std::max(offset, (taken[j].second + kArenaAlignment - 1) /
+          kArenaAlignment * kArenaAlignment);
+    }
+    offsets_[id] = offset;
+    placed.push_back(id);
+    total = std::max(total, offset + size);
+  }
+  memories_ = memories;
+  arena_bytes_ = total;
+  if (total > 0) {
+    BindArena(shared_ptr<SyncedMemory>(new SyncedMemory(total)));
+  }
+}
+
+template <typename Dtype>
+void NetPlan<Dtype>::BindArena(const shared_ptr<SyncedMemory>& arena) {
+  CHECK_GE(arena->size(), arena_bytes_) << "The arena is too small.";
+  arena_ = arena;
+  if (Caffe::mode() == Caffe::CPU) {
+    char* base = static_cast<char*>(arena_->mutable_cpu_data());
+    for (int i = 0; i < memories_.size(); ++i) {
+      memories_[i]->set_cpu_data(base + offsets_[i]);
+    }
+  } else {
+    char* base = static_cast<char*>(arena_->mutable_gpu_data());
+    for (int i = 0; i < memories_.size(); ++i) {
+      memories_[i]->set_gpu_data(base + offsets_[i]);
+    }
+  }
+}
+
+template <typename Dtype>
+void NetPlan<Dtype>::Forward() {
+  switch (Caffe::mode()) {
+  case Caffe::CPU:
+    for (int i = 0; i < steps_.size(); ++i) {
+      steps_[i].layer->Forward_cpu(steps_[i].bottom, steps_[i].top);
+    }
+    break;
+  case Caffe::GPU:
+    for (int i = 0; i < steps_.size(); ++i) {
+      steps_[i].layer->Forward_gpu(steps_[i].bottom, steps_[i].top);
+    }
+    break;
+  default:
+    LOG(FATAL) << "Unknown caffe mode.";
+  }
+}
+
+template <typename Dtype>
+void NetPlan<Dtype>::Run(const vector<const Dtype*>& inputs,
+    const vector<Dtype*>& outputs) {
+  CHECK_EQ(inputs.size(), input_blobs_.size());
+  CHECK_EQ(outputs.size(), output_blobs_.size());
+  const bool cpu = Caffe::mode() == Caffe::CPU;
+  for (int i = 0; i < inputs.size(); ++i) {
+    Blob<Dtype>* blob = input_blobs_[i];
+    caffe_copy(blob->count(), inputs[i],
+        cpu ? blob->mutable_cpu_data() : blob->mutable_gpu_data());
+  }
+  Forward();
+  for (int i = 0; i < outputs.size(); ++i) {
+    const Blob<Dtype>* blob = output_blobs_[i];
+    caffe_copy(blob->count(), cpu ? blob->cpu_data() : blob->gpu_data(),
+        outputs[i]);
+  }
+}
+
+template <typename Dtype>
+NetPlanCache<Dtype>::NetPlanCache(Net<Dtype>* net, int capacity)
+    : net_(net), capacity_(capacity), bound_(NULL), hits_(0), misses_(0) {
+  CHECK_GT(capacity_, 0) << "The cache needs room for a plan.";
+}
+
+template <typename Dtype>
+NetPlan<Dtype>* NetPlanCache<Dtype>::Get(
+    const vector<vector<int> >& input_shapes) {
+  CHECK_EQ(input_shapes.size(), net_->input_blobs().size())
+      << "Expected a shape for every input of the net.";
+  typename std::map<Shapes, Entry>::iterator it = plans_.find(input_shapes);
+  if (it != plans_.end()) {
+    ++hits_;
+    uses_.splice(uses_.begin(), uses_, it->second.second);
+  } else {
+    ++misses_;
+    for (int i = 0; i < input_shapes.size(); ++i) {
+      net_->input_blobs()[i]->Reshape(input_shapes[i]);
+    }
+    net_->Reshape();
+    shared_ptr<NetPlan<Dtype> > plan(new NetPlan<Dtype>(*net_));
+    if (plan->arena_bytes() > arena_bytes()) {
+      // The other plans move to the larger arena as they are next used.
+      arena_.reset(new SyncedMemory(plan->arena_bytes()));
+      bound_ = NULL;
+    }
+    uses_.push_front(input_shapes);
+    it = plans_.insert(std::make_pair(input_shapes,
+        Entry(plan, uses_.begin()))).first;
+    if (plans_.size() > capacity_) {
+      typename std::map<Shapes, Entry>::iterator least =
+          plans_.find(uses_.back());
+      if (least->second.first.get() == bound_) {
+        bound_ = NULL;
+      }
+      plans_.erase(least);
+      uses_.pop_back();
+    }
+  }
+  NetPlan<Dtype>* plan = it->second.first.get();
+  if (plan != bound_ && arena_) {
+    plan->BindArena(arena_);
+    bound_ = plan;
+  }
+  return plan;
+}
+
+INSTANTIATE_CLASS(NetPlan);
+INSTANTIATE_CLASS(NetPlanCache);
+
+}  // namespace caffe
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 
+#include "caffe/layers/base_data_layer.hpp"
 #include "caffe/solver.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/hdf5.hpp"
@@ -16,6 +17,11 @@ void Solver<Dtype>::SetActionFunction(ActionCallback func) {
   action_request_function_ = func;
 }
 
+template<typename Dtype>
+void Solver<Dtype>::SetMetricsFile(const string& filename, int interval) {
+  metrics_.reset(new SolverMetrics(filename, interval));
+}
+
 template<typename Dtype>
 SolverAction::Enum Solver<Dtype>::GetRequestedAction() {
   if (action_request_function_) {
@@ -220,7 +226,18 @@ void Solver<Dtype>::Step(int iters) {
     // accumulate the loss and gradient
     Dtype loss = 0;
     for (int i = 0; i < param_.iter_size(); ++i) {
-      loss += net_->ForwardBackward(bottom_vec);
+      if (metrics_) {
+        Dtype iter_loss;
+        metrics_->Start();
+        net_->Forward(bottom_vec, &iter_loss);
+        metrics_->Stop(SolverMetrics::FORWARD);
+        metrics_->Start();
+        net_->Backward();
+        metrics_->Stop(SolverMetrics::BACKWARD);
+        loss += iter_loss;
+      } else {
+        loss += net_->ForwardBackward(bottom_vec);
+      }
     }
     loss /= param_.iter_size();
     // average the loss across iterations for smoothed reporting
@@ -259,11 +276,20 @@ void Solver<Dtype>::Step(int iters) {
     for (int i = 0; i < callbacks_.size(); ++i) {
       callbacks_[i]->on_gradients_ready();
     }
+    if (metrics_) {
+      metrics_->Start();
+    }
     ApplyUpdate();
+    if (metrics_) {
+      metrics_->Stop(SolverMetrics::UPDATE);
+    }
 
     // Increment the internal iter_ counter -- its value should always indicate
     // the number of times the weights have been updated.
     ++iter_;
+    if (metrics_ && iter_ % metrics_->interval() == 0) {
+      WriteMetrics(smoothed_loss);
+    }
 
     SolverAction::Enum request = GetRequestedAction();
 
@@ -411,6 +437,39 @@ void Solver<Dtype>::Test(const int test_net_id) {
   }
 }
 
+template <typename Dtype>
+void Solver<Dtype>::WriteMetrics(Dtype smoothed_loss) {
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net_->layers();
+  // The batch size is the num of the first input, be it a data layer top or
+  // a net input.
+  int batch_size = 0;
+  if (net_->input_blobs().size()) {
+    batch_size = net_->input_blobs()[0]->shape(0);
+  }
+  double data_wait_us = 0;
+  for (int i = 0; i < layers.size(); ++i) {
+    if (!batch_size && net_->bottom_vecs()[i].empty() &&
+        net_->top_vecs()[i].size() && net_->top_vecs()[i][0]->num_axes()) {
+      batch_size = net_->top_vecs()[i][0]->shape(0);
+    }
+    const BasePrefetchingDataLayer<Dtype>* data_layer =
+        dynamic_cast<const BasePrefetchingDataLayer<Dtype>*>(layers[i].get());
+    if (data_layer) {
+      data_wait_us += data_layer->prefetch_wait_us();
+    }
+  }
+  // Data and diff of every activation and parameter blob.
+  size_t blob_count = 0;
+  for (int i = 0; i < net_->blobs().size(); ++i) {
+    blob_count += net_->blobs()[i]->count();
+  }
+  for (int i = 0; i < net_->learnable_params().size(); ++i) {
+    blob_count += net_->learnable_params()[i]->count();
+  }
+  metrics_->Write(iter_, batch_size * param_.iter_size(), smoothed_loss,
+      GetLearningRate(), data_wait_us, 2 * blob_count * sizeof(Dtype));
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Snapshot() {
   CHECK(Caffe::root_solver());
@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/util/expression.hpp"
 
 namespace caffe {
 
@@ -26,61 +27,28 @@ void AdaDeltaSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   size_t update_history_offset = net_params.size();
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    // compute square of gradient in update
-    caffe_powx(net_params[param_id]->count(),
-        net_params[param_id]->cpu_diff(), Dtype(2),
-        this->update_[param_id]->mutable_cpu_data());
+    // Three fused passes rather than the nine-call caffe_* chain and temp_.
+    const int N = net_params[param_id]->count();
+    const expr::Array<Dtype> g(net_params[param_id]->cpu_diff());
+    const expr::Array<Dtype> g_history(this->history_[param_id]->cpu_data());
+    const expr::Array<Dtype> update_history(
+        this->history_[update_history_offset + param_id]->cpu_data());
 
     // update history of gradients
-    caffe_cpu_axpby(net_params[param_id]->count(), Dtype(1) - momentum,
-        this->update_[param_id]->cpu_data(), momentum,
+    caffe_eval(N, momentum * g_history + (Dtype(1) - momentum) * sqr(g),
         this->history_[param_id]->mutable_cpu_data());
 
-    // add delta to history to guard against dividing by zero later
-    caffe_set(net_params[param_id]->count(), delta,
-        this->temp_[param_id]->mutable_cpu_data());
-
-    caffe_add(net_params[param_id]->count(),
-        this->temp_[param_id]->cpu_data(),
-        this->history_[update_history_offset + param_id]->cpu_data(),
-        this->update_[param_id]->mutable_cpu_data());
-
-    caffe_add(net_params[param_id]->count(),
-        this->temp_[param_id]->cpu_data(),
-        this->history_[param_id]->cpu_data(),
-        this->temp_[param_id]->mutable_cpu_data());
-
-    // divide history of updates by history of gradients
-    caffe_div(net_params[param_id]->count(),
-        this->update_[param_id]->cpu_data(),
-        this->temp_[param_id]->cpu_data(),
-        this->update_[param_id]->mutable_cpu_data());
-
-    // jointly compute the RMS of both for update and gradient history
-    caffe_powx(net_params[param_id]->count(),
-        this->update_[param_id]->cpu_data(), Dtype(0.5),
-        this->update_[param_id]->mutable_cpu_data());
-
-    // compute the update
-    caffe_mul(net_params[param_id]->count(),
-        net_params[param_id]->cpu_diff(),
-        this->update_[param_id]->cpu_data(),
+    // compute the update from the RMS of both histories, adding delta to
+    // guard against dividing by zero
+    caffe_eval(N, g * sqrt((update_history + delta) / (g_history + delta)),
         net_params[param_id]->mutable_cpu_diff());
 
-    // compute square of update
-    caffe_powx(net_params[param_id]->count(),
-        net_params[param_id]->cpu_diff(), Dtype(2),
-        this->update_[param_id]->mutable_cpu_data());
-
-    // update history of updates
-    caffe_cpu_axpby(net_params[param_id]->count(), Dtype(1) - momentum,
-        this->update_[param_id]->cpu_data(), momentum,
+    // update history of updates, which g now holds
+    caffe_eval(N, momentum * update_history + (Dtype(1) - momentum) * sqr(g),
         this->history_[update_history_offset + param_id]->mutable_cpu_data());
 
     // apply learning rate
-    caffe_cpu_scale(net_params[param_id]->count(), local_rate,
-        net_params[param_id]->cpu_diff(),
-        net_params[param_id]->mutable_cpu_diff());
+    caffe_scal(N, local_rate, net_params[param_id]->mutable_cpu_diff());
     break;
   }
   case Caffe::GPU: {
@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/util/expression.hpp"
 
 namespace caffe {
 
@@ -28,7 +29,6 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   size_t update_history_offset = net_params.size();
   Blob<Dtype>* val_m = this->history_[param_id].get();
   Blob<Dtype>* val_v = this->history_[param_id + update_history_offset].get();
-  Blob<Dtype>* val_t = this->temp_[param_id].get();
 
   const int t = this->iter_  + 1;
   const Dtype correction = std::sqrt(Dtype(1) - pow(beta2, t)) /
@@ -38,37 +38,28 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
 
   switch (Caffe::mode()) {
     case Caffe::CPU: {
+    const expr::Array<Dtype> g(net_params[param_id]->cpu_diff());
+    const expr::Array<Dtype> m(val_m->cpu_data());
+    const expr::Array<Dtype> v(val_v->cpu_data());
+
     // update m <- \beta_1 m_{t-1} + (1-\beta_1)g_t
-    caffe_cpu_axpby(N, Dtype(1)-beta1,
-        net_params[param_id]->cpu_diff(), beta1,
+    caffe_eval(N, beta1 * m + (Dtype(1) - beta1) * g,
         val_m->mutable_cpu_data());
 
     // update v <- \beta_2 m_{t-1} + (1-\beta_2)g_t^2
-    caffe_mul(N,
-        net_params[param_id]->cpu_diff(),
-        net_params[param_id]->cpu_diff(),
-    val_t->mutable_cpu_data());
-    caffe_cpu_axpby(N, Dtype(1)-beta2,
-        val_t->cpu_data(), beta2,
+    caffe_eval(N, beta2 * v + (Dtype(1) - beta2) * sqr(g),
         val_v->mutable_cpu_data());
 
     // set update
-    caffe_powx(N,
-        val_v->cpu_data(), Dtype(0.5),
-        val_t->mutable_cpu_data());
-    caffe_add_scalar(N, eps_hat, val_t->mutable_cpu_data());
-    caffe_div(N,
-        val_m->cpu_data(),
-        val_t->cpu_data(),
-        val_t->mutable_cpu_data());
-
-    caffe_cpu_scale(N, local_rate*correction,
-        val_t->cpu_data(),
+    caffe_eval(N, local_rate * correction * m / (sqrt(v) + eps_hat),
         net_params[param_id]->mutable_cpu_diff());
     break;
   }
   case Caffe::GPU: {
 #ifndef CPU_ONLY
+    // Only the GPU path needs the temporary.
+    Blob<Dtype>* val_t = this->temp_[param_id].get();
+
     // update m <- \beta_1 m_{t-1} + (1-\beta_1)g_t
     caffe_gpu_axpby(N, Dtype(1)-beta1,
         net_params[param_id]->gpu_diff(), beta1,
@@ -0,0 +1,124 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/autotune.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class AutotuneTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  AutotuneTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 6, 5)) {
+    blob_bottom_vec_.push_back(blob_bottom_);
+    MakeTempFilename(&cache_filename_);
+  }
+  virtual ~AutotuneTest() {
+    Caffe::set_autotune(false);
+    Caffe::set_autotune_cache("");
+    AutotuneCache::Get().Clear();
+    delete blob_bottom_;
+  }
+
+  LayerParameter ConvolutionParam(const string& name) {
+    LayerParameter param;
+    param.set_name(name);
+    param.set_type("Convolution");
+    param.add_bottom("data");
+    param.add_top("conv");
+    param.mutable_convolution_param()->add_kernel_size(3);
+    param.mutable_convolution_param()->set_num_output(4);
+    return param;
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  string cache_filename_;
+};
+
+TYPED_TEST_CASE(AutotuneTest, TestDtypesAndDevices);
+
+TYPED_TEST(AutotuneTest, TestKeyIgnoresNameAndEngine) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param = this->ConvolutionParam("conv1");
+  LayerParameter renamed = this->ConvolutionParam("conv2");
+  renamed.mutable_convolution_param()->set_engine(
+      ConvolutionParameter_Engine_CAFFE);
+  EXPECT_EQ(LayerAutotuner<Dtype>::Key(this->blob_bottom_vec_, param),
+            LayerAutotuner<Dtype>::Key(this->blob_bottom_vec_, renamed));
+}
+
+TYPED_TEST(AutotuneTest, TestKeyDependsOnGeometry) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param = this->ConvolutionParam("conv1");
+  const string key = LayerAutotuner<Dtype>::Key(this->blob_bottom_vec_, param);
+  LayerParameter strided = this->ConvolutionParam("conv1");
+  strided.mutable_convolution_param()->add_stride(2);
+  EXPECT_NE(key, LayerAutotuner<Dtype>::Key(this->blob_bottom_vec_, strided));
+  this->blob_bottom_->Reshape(2, 3, 7, 5);
+  EXPECT_NE(key, LayerAutotuner<Dtype>::Key(this->blob_bottom_vec_, param));
+}
+
+TYPED_TEST(AutotuneTest, TestCachePersists) {
+  Caffe::set_autotune_cache(this->cache_filename_);
+  AutotuneCache& cache = AutotuneCache::Get();
+  int engine = -1;
+  EXPECT_FALSE(cache.Lookup("conv a", &engine));
+  cache.Insert("conv a", 2);
+  cache.Insert("conv b", 1);
+  // Read back from the file rather than from memory.
+  cache.Clear();
+  cache.Load(this->cache_filename_);
+  EXPECT_TRUE(cache.Lookup("conv a", &engine));
+  EXPECT_EQ(2, engine);
+  EXPECT_TRUE(cache.Lookup("conv b", &engine));
+  EXPECT_EQ(1, engine);
+  EXPECT_FALSE(cache.Lookup("conv c", &engine));
+}
+
+TYPED_TEST(AutotuneTest, TestNetMatchesUntuned) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'AutotuneTestNet' "
+      "layer { name: 'data' type: 'DummyData' top: 'data' "
+      "  dummy_data_param { shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+      "    data_filler { type: 'gaussian' std: 1 } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  convolution_param { num_output: 4 kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' } "
+      "layer { name: 'pool' type: 'Pooling' bottom: 'conv' top: 'pool' "
+      "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Caffe::set_random_seed(1701);
+  Net<Dtype> untuned(param);
+  untuned.ForwardPrefilled();
+  Caffe::set_autotune(true);
+  Caffe::set_autotune_cache(this->cache_filename_);
+  for (int run = 0; run < 2; ++run) {
+    // The second run is served from the cache written by the first.
+    Caffe::set_random_seed(1701);
+    Net<Dtype> tuned(param);
+    tuned.ForwardPrefilled();
+    const Blob<Dtype>& expected = *untuned.blob_by_name("pool");
+    const Blob<Dtype>& actual = *tuned.blob_by_name("pool");
+    ASSERT_EQ(expected.count(), actual.count());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i], 1e-4);
+    }
+  }
+}
+
+}  // namespace caffe
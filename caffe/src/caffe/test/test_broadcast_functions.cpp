@@ -0,0 +1,138 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/broadcast_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class BroadcastFunctionsTest : public ::testing::Test {
+ protected:
+  BroadcastFunctionsTest() {}
+
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    // Small shapes run serially, large ones on the thread pool; each is
+    // tried with and without an inner axis. Reductions of long rows take
+    // several blocks.
+    AddShape(3, 5, 7);
+    AddShape(4, 9, 1);
+    AddShape(3, 600, 1);
+    AddShape(8, 64, 128);
+    AddShape(512, 96, 1);
+  }
+
+  void AddShape(int outer, int dim, int inner) {
+    vector<int> shape(3);
+    shape[0] = outer;
+    shape[1] = dim;
+    shape[2] = inner;
+    shapes_.push_back(shape);
+  }
+
+  // Fills x and z with outer x dim x inner values and v, y with dim values;
+  // v is kept away from zero to divide by it.
+  void Fill(const vector<int>& shape) {
+    x_.Reshape(shape);
+    z_.Reshape(shape);
+    vector<int> v_shape(1, shape[1]);
+    v_.Reshape(v_shape);
+    y_.Reshape(v_shape);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> gaussian(filler_param);
+    gaussian.Fill(&x_);
+    gaussian.Fill(&z_);
+    gaussian.Fill(&y_);
+    filler_param.set_min(1);
+    filler_param.set_max(2);
+    UniformFiller<Dtype> uniform(filler_param);
+    uniform.Fill(&v_);
+  }
+
+  Blob<Dtype> x_;
+  Blob<Dtype> z_;
+  Blob<Dtype> v_;
+  Blob<Dtype> y_;
+  vector<vector<int> > shapes_;
+};
+
+TYPED_TEST_CASE(BroadcastFunctionsTest, TestDtypes);
+
+TYPED_TEST(BroadcastFunctionsTest, TestBroadcast) {
+  for (int s = 0; s < this->shapes_.size(); ++s) {
+    const int outer = this->shapes_[s][0];
+    const int dim = this->shapes_[s][1];
+    const int inner = this->shapes_[s][2];
+    this->Fill(this->shapes_[s]);
+    const TypeParam* x = this->x_.cpu_data();
+    const TypeParam* v = this->v_.cpu_data();
+    vector<TypeParam> sum(this->x_.count());
+    vector<TypeParam> product(this->x_.count());
+    vector<TypeParam> quotient(this->x_.count());
+    caffe_cpu_broadcast_add(outer, dim, inner, TypeParam(-0.5), v, x, &sum[0]);
+    caffe_cpu_broadcast_mul(outer, dim, inner, v, x, &product[0]);
+    caffe_cpu_broadcast_div(outer, dim, inner, v, x, &quotient[0]);
+    for (int o = 0; o < outer; ++o) {
+      for (int d = 0; d < dim; ++d) {
+        for (int i = 0; i < inner; ++i) {
+          const int index = (o * dim + d) * inner + i;
+          EXPECT_NEAR(x[index] - 0.5 * v[d], sum[index], 1e-5);
+          EXPECT_NEAR(x[index] * v[d], product[index], 1e-5);
+          EXPECT_NEAR(x[index] / v[d], quotient[index], 1e-5);
+        }
+      }
+    }
+    // In place.
+    vector<TypeParam> y(x, x + this->x_.count());
+    caffe_cpu_broadcast_add(outer, dim, inner, TypeParam(-0.5), v, &y[0],
+        &y[0]);
+    for (int i = 0; i < y.size(); ++i) {
+      EXPECT_EQ(sum[i], y[i]);
+    }
+  }
+}
+
+TYPED_TEST(BroadcastFunctionsTest, TestAxisSum) {
+  for (int s = 0; s < this->shapes_.size(); ++s) {
+    const int outer = this->shapes_[s][0];
+    const int dim = this->shapes_[s][1];
+    const int inner = this->shapes_[s][2];
+    this->Fill(this->shapes_[s]);
+    const TypeParam* x = this->x_.cpu_data();
+    const TypeParam* z = this->z_.cpu_data();
+    vector<TypeParam> y(this->y_.cpu_data(), this->y_.cpu_data() + dim);
+    vector<TypeParam> sum(dim);
+    vector<TypeParam> dot(dim);
+    caffe_cpu_axis_sum(outer, dim, inner, TypeParam(2), x, TypeParam(0),
+        &sum[0]);
+    // The accumulating forms add to y.
+    caffe_cpu_axis_sum(outer, dim, inner, TypeParam(1), x, TypeParam(0.5),
+        this->y_.mutable_cpu_data());
+    caffe_cpu_axis_dot(outer, dim, inner, TypeParam(1), x, z, TypeParam(0),
+        &dot[0]);
+    const TypeParam tolerance = 1e-4 * outer * inner;
+    for (int d = 0; d < dim; ++d) {
+      TypeParam expected_sum = 0;
+      TypeParam expected_dot = 0;
+      for (int o = 0; o < outer; ++o) {
+        for (int i = 0; i < inner; ++i) {
+          const int index = (o * dim + d) * inner + i;
+          expected_sum += x[index];
+          expected_dot += x[index] * z[index];
+        }
+      }
+      EXPECT_NEAR(2 * expected_sum, sum[d], tolerance);
+      EXPECT_NEAR(expected_sum + 0.5 * y[d], this->y_.cpu_data()[d],
+          tolerance);
+      EXPECT_NEAR(expected_dot, dot[d], tolerance);
+    }
+  }
+}
+
+}  // namespace caffe
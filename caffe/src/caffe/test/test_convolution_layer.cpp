@@ -675,6 +675,142 @@ TYPED_TEST(ConvolutionLayerTest, Test1x1Gradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestCachedColumns) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  // The columns of one image are 27 x 2; cache none of the four images, one
+  // of them, then all of them.
+  const size_t col_bytes = 27 * 2 * sizeof(Dtype);
+  const size_t budgets[] = {0, col_bytes, 4 * col_bytes};
+  vector<Dtype> weight_diff;
+  vector<vector<Dtype> > bottom_diffs(2);
+  for (int b = 0; b < 3; ++b) {
+    Caffe::set_im2col_cache_bytes(budgets[b]);
+    Caffe::set_random_seed(1701);
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    // Run twice, to check the cache is refilled for the second pass.
+    for (int pass = 0; pass < 2; ++pass) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < 2; ++i) {
+        caffe_copy(this->blob_top_vec_[i]->count(),
+            this->blob_top_vec_[i]->cpu_data(),
+            this->blob_top_vec_[i]->mutable_cpu_diff());
+      }
+      caffe_set(layer.blobs()[0]->count(), Dtype(0),
+          layer.blobs()[0]->mutable_cpu_diff());
+      vector<bool> propagate_down(2, true);
+      layer.Backward(this->blob_top_vec_, propagate_down,
+          this->blob_bottom_vec_);
+    }
+    const Dtype* diff = layer.blobs()[0]->cpu_diff();
+    if (b == 0) {
+      weight_diff.assign(diff, diff + layer.blobs()[0]->count());
+    }
+    for (int j = 0; j < weight_diff.size(); ++j) {
+      EXPECT_NEAR(weight_diff[j], diff[j], 1e-4);
+    }
+    for (int i = 0; i < 2; ++i) {
+      const Dtype* bottom_diff = this->blob_bottom_vec_[i]->cpu_diff();
+      if (b == 0) {
+        bottom_diffs[i].assign(bottom_diff,
+            bottom_diff + this->blob_bottom_vec_[i]->count());
+      }
+      for (int j = 0; j < bottom_diffs[i].size(); ++j) {
+        EXPECT_NEAR(bottom_diffs[i][j], bottom_diff[j], 1e-4);
+      }
+    }
+  }
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  ConvolutionLayer<Dtype> layer(layer_param);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+  Caffe::set_im2col_cache_bytes(0);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestBatchedGemm) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  // Five images each, so batches of two leave one over.
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < 2; ++i) {
+    this->blob_bottom_vec_[i]->Reshape(5, 3, 6, 4);
+    filler.Fill(this->blob_bottom_vec_[i]);
+  }
+  // A strided 3x3 kernel, a 1x1 kernel, and a padded, grouped one.
+  const int kKernels[] = {3, 1, 3};
+  const int kStrides[] = {2, 1, 1};
+  const int kPads[] = {0, 0, 1};
+  const int kGroups[] = {1, 1, 3};
+  for (int c = 0; c < 3; ++c) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kKernels[c]);
+    convolution_param->add_stride(kStrides[c]);
+    convolution_param->add_pad(kPads[c]);
+    convolution_param->set_num_output(3);
+    convolution_param->set_group(kGroups[c]);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    // One image per GEMM, two, then all five, the last also reusing cached
+    // columns.
+    const size_t kBudgets[] = {0, 2, 5};
+    vector<Dtype> top;
+    vector<Dtype> weight_diff;
+    vector<Dtype> bottom_diff;
+    for (int b = 0; b < 3; ++b) {
+      Caffe::set_random_seed(1701);
+      ConvolutionLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      // The columns and outputs of one image.
+      const int kernel_dim = 3 / kGroups[c] * kKernels[c] * kKernels[c];
+      const size_t image_bytes = (kernel_dim * kGroups[c] + 3)
+          * this->blob_top_->count(2) * sizeof(Dtype);
+      Caffe::set_conv_batch_bytes(kBudgets[b] * image_bytes);
+      Caffe::set_im2col_cache_bytes(b == 2 ? 1 << 20 : 0);
+      layer.Reshape(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < 2; ++i) {
+        caffe_copy(this->blob_top_vec_[i]->count(),
+            this->blob_top_vec_[i]->cpu_data(),
+            this->blob_top_vec_[i]->mutable_cpu_diff());
+      }
+      caffe_set(layer.blobs()[0]->count(), Dtype(0),
+          layer.blobs()[0]->mutable_cpu_diff());
+      vector<bool> propagate_down(2, true);
+      layer.Backward(this->blob_top_vec_, propagate_down,
+          this->blob_bottom_vec_);
+      const Dtype* data[] = {this->blob_top_->cpu_data(),
+          layer.blobs()[0]->cpu_diff(), this->blob_bottom_->cpu_diff()};
+      const int counts[] = {this->blob_top_->count(),
+          layer.blobs()[0]->count(), this->blob_bottom_->count()};
+      vector<Dtype>* expected[] = {&top, &weight_diff, &bottom_diff};
+      for (int k = 0; k < 3; ++k) {
+        if (b == 0) {
+          expected[k]->assign(data[k], data[k] + counts[k]);
+        }
+        for (int j = 0; j < counts[k]; ++j) {
+          EXPECT_NEAR((*expected[k])[j], data[k][j], 1e-3);
+        }
+      }
+    }
+  }
+  Caffe::set_conv_batch_bytes(0);
+  Caffe::set_im2col_cache_bytes(0);
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
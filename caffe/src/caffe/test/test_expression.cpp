@@ -0,0 +1,85 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/expression.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class ExpressionTest : public ::testing::Test {
+ protected:
+  ExpressionTest() : a_(1, 1, 1, 1), b_(1, 1, 1, 1) {}
+
+  // Fills a with values in [1, 2], so roots and quotients are defined,
+  // and b with Gaussian values.
+  void Fill(int count) {
+    vector<int> shape(1, count);
+    a_.Reshape(shape);
+    b_.Reshape(shape);
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    filler_param.set_min(1);
+    filler_param.set_max(2);
+    UniformFiller<Dtype> uniform(filler_param);
+    uniform.Fill(&a_);
+    GaussianFiller<Dtype> gaussian(filler_param);
+    gaussian.Fill(&b_);
+  }
+
+  Blob<Dtype> a_;
+  Blob<Dtype> b_;
+};
+
+TYPED_TEST_CASE(ExpressionTest, TestDtypes);
+
+TYPED_TEST(ExpressionTest, TestEval) {
+  // A short loop runs serially, a long one on the thread pool.
+  const int kCounts[] = {37, 100003};
+  for (int c = 0; c < 2; ++c) {
+    this->Fill(kCounts[c]);
+    const int n = this->a_.count();
+    const TypeParam* a = this->a_.cpu_data();
+    const TypeParam* b = this->b_.cpu_data();
+    const expr::Array<TypeParam> x(a), y(b);
+    vector<TypeParam> out(n);
+    caffe_eval(n, (2 * x - y) / (sqrt(x) + 0.5) + sqr(y) * x - -abs(y),
+        &out[0]);
+    for (int i = 0; i < n; ++i) {
+      const TypeParam expected = (2 * a[i] - b[i]) / (std::sqrt(a[i]) + 0.5)
+          + b[i] * b[i] * a[i] + std::fabs(b[i]);
+      EXPECT_NEAR(expected, out[i], 1e-4 * std::fabs(expected) + 1e-5);
+    }
+    caffe_eval(n, exp(-x) * y + 1, &out[0]);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_NEAR(std::exp(-a[i]) * b[i] + 1, out[i], 1e-5);
+    }
+    // In place, reading the array written.
+    vector<TypeParam> in_place(b, b + n);
+    const expr::Array<TypeParam> z(&in_place[0]);
+    caffe_eval(n, z * x - 3, &in_place[0]);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_NEAR(b[i] * a[i] - 3, in_place[i], 1e-5);
+    }
+  }
+}
+
+TYPED_TEST(ExpressionTest, TestSum) {
+  this->Fill(1000);
+  const TypeParam* a = this->a_.cpu_data();
+  const TypeParam* b = this->b_.cpu_data();
+  TypeParam expected = 0;
+  for (int i = 0; i < 1000; ++i) {
+    expected += a[i] * b[i];
+  }
+  EXPECT_NEAR(expected, caffe_sum(1000, expr::array(a) * expr::array(b)),
+      1e-3);
+}
+
+}  // namespace caffe
@@ -0,0 +1,279 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/layers/fused_neuron_layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/fuse_neurons.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class FusedNeuronLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  FusedNeuronLayerTest() {}
+
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    // A small blob runs serially, a large one on the thread pool and with a
+    // partial last block.
+    vector<int> shape(4);
+    shape[0] = 2;
+    shape[1] = 3;
+    shape[2] = 4;
+    shape[3] = 5;
+    shapes_.push_back(shape);
+    shape[0] = 7;
+    shape[1] = 31;
+    shape[2] = 17;
+    shape[3] = 19;
+    shapes_.push_back(shape);
+  }
+
+  LayerParameter Param(const string& proto) {
+    LayerParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    return param;
+  }
+
+  // ReLU, Power, Sigmoid, Log and Exp, with parameters that make each of
+  // them more than the plain function.
+  vector<LayerParameter> ChainA() {
+    vector<LayerParameter> chain;
+    chain.push_back(Param("type: 'ReLU' relu_param { negative_slope: 0.1 }"));
+    chain.push_back(Param("type: 'Power' "
+        "power_param { power: 2 scale: 0.5 shift: 1 }"));
+    chain.push_back(Param("type: 'Sigmoid'"));
+    chain.push_back(Param("type: 'Log' log_param { shift: 0.5 base: 3 }"));
+    chain.push_back(Param("type: 'Exp' "
+        "exp_param { scale: 0.3 shift: 0.2 base: 2 }"));
+    return chain;
+  }
+
+  // AbsVal, Power, TanH and BNLL.
+  vector<LayerParameter> ChainB() {
+    vector<LayerParameter> chain;
+    chain.push_back(Param("type: 'AbsVal'"));
+    chain.push_back(Param("type: 'Power' "
+        "power_param { power: 0.5 scale: 2 shift: 1 }"));
+    chain.push_back(Param("type: 'TanH'"));
+    chain.push_back(Param("type: 'BNLL'"));
+    return chain;
+  }
+
+  // Checks a FusedNeuronLayer of chain against its layers run one by one,
+  // forward and backward, computing in place or not. In training the fused
+  // layer keeps the derivative; in testing it recomputes it.
+  void CheckChain(const vector<LayerParameter>& chain, bool in_place,
+      Phase phase) {
+    for (int s = 0; s < shapes_.size(); ++s) {
+      Blob<Dtype> input(shapes_[s]);
+      FillerParameter filler_param;
+      GaussianFiller<Dtype> filler(filler_param);
+      filler.Fill(&input);
+      Blob<Dtype> top_diff(shapes_[s]);
+      filler.Fill(&top_diff);
+      // The layers one by one, each into its own blob.
+      vector<shared_ptr<Blob<Dtype> > > blobs;
+      blobs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      blobs[0]->CopyFrom(input, false, true);
+      vector<shared_ptr<Layer<Dtype> > > layers;
+      for (int k = 0; k < chain.size(); ++k) {
+        blobs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+        layers.push_back(LayerRegistry<Dtype>::CreateLayer(chain[k]));
+        vector<Blob<Dtype>*> bottom(1, blobs[k].get());
+        vector<Blob<Dtype>*> top(1, blobs[k + 1].get());
+        layers[k]->SetUp(bottom, top);
+        layers[k]->Forward(bottom, top);
+      }
+      caffe_copy(top_diff.count(), top_diff.cpu_data(),
+          blobs.back()->mutable_cpu_diff());
+      vector<bool> propagate_down(1, true);
+      for (int k = chain.size() - 1; k >= 0; --k) {
+        vector<Blob<Dtype>*> bottom(1, blobs[k].get());
+        vector<Blob<Dtype>*> top(1, blobs[k + 1].get());
+        layers[k]->Backward(top, propagate_down, bottom);
+      }
+      // The fused layer.
+      Blob<Dtype> fused_bottom;
+      fused_bottom.CopyFrom(input, false, true);
+      Blob<Dtype> fused_top;
+      vector<Blob<Dtype>*> bottom(1, &fused_bottom);
+      vector<Blob<Dtype>*> top(1, in_place ? &fused_bottom : &fused_top);
+      LayerParameter fused_param;
+      fused_param.set_phase(phase);
+      FusedNeuronLayer<Dtype> layer(fused_param, chain);
+      layer.SetUp(bottom, top);
+      layer.Forward(bottom, top);
+      const Dtype* expected = blobs.back()->cpu_data();
+      const Dtype* actual = top[0]->cpu_data();
+      for (int i = 0; i < input.count(); ++i) {
+        EXPECT_NEAR(expected[i], actual[i], 1e-5 * std::fabs(expected[i])
+            + 1e-6);
+      }
+      caffe_copy(top_diff.count(), top_diff.cpu_data(),
+          top[0]->mutable_cpu_diff());
+      layer.Backward(top, propagate_down, bottom);
+      expected = blobs[0]->cpu_diff();
+      actual = bottom[0]->cpu_diff();
+      for (int i = 0; i < input.count(); ++i) {
+        EXPECT_NEAR(expected[i], actual[i], 1e-4 * std::fabs(expected[i])
+            + 1e-6);
+      }
+    }
+  }
+
+  vector<vector<int> > shapes_;
+};
+
+TYPED_TEST_CASE(FusedNeuronLayerTest, TestDtypes);
+
+TYPED_TEST(FusedNeuronLayerTest, TestChains) {
+  this->CheckChain(this->ChainA(), false, TRAIN);
+  this->CheckChain(this->ChainB(), false, TRAIN);
+}
+
+TYPED_TEST(FusedNeuronLayerTest, TestChainsInPlace) {
+  this->CheckChain(this->ChainA(), true, TRAIN);
+  this->CheckChain(this->ChainB(), true, TRAIN);
+}
+
+TYPED_TEST(FusedNeuronLayerTest, TestChainsRecomputed) {
+  this->CheckChain(this->ChainA(), false, TEST);
+  this->CheckChain(this->ChainB(), true, TEST);
+}
+
+TYPED_TEST(FusedNeuronLayerTest, TestForwardThreshold) {
+  vector<LayerParameter> chain;
+  chain.push_back(this->Param("type: 'TanH'"));
+  chain.push_back(this->Param("type: 'Threshold' "
+      "threshold_param { threshold: 0.2 }"));
+  Blob<TypeParam> bottom(this->shapes_[0]);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(&bottom);
+  Blob<TypeParam> top;
+  vector<Blob<TypeParam>*> bottom_vec(1, &bottom);
+  vector<Blob<TypeParam>*> top_vec(1, &top);
+  FusedNeuronLayer<TypeParam> layer(LayerParameter(), chain);
+  layer.SetUp(bottom_vec, top_vec);
+  layer.Forward(bottom_vec, top_vec);
+  for (int i = 0; i < bottom.count(); ++i) {
+    EXPECT_EQ(std::tanh(bottom.cpu_data()[i]) > 0.2 ? 1 : 0,
+        top.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(FusedNeuronLayerTest, TestFuseNeurons) {
+  // relu, sigmoid (in place), tanh and exp form one chain, as the split of
+  // e follows exp; abs and power form another, ending at a loss.
+  const string proto =
+      "name: 'FuseNet' "
+      "input: 'data' input_shape { dim: 2 dim: 3 dim: 4 dim: 5 } "
+      "input: 'target' input_shape { dim: 2 dim: 3 dim: 4 dim: 5 } "
+      "force_backward: true "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'data' top: 'r' "
+      "  relu_param { negative_slope: 0.2 } } "
+      "layer { name: 'sigmoid' type: 'Sigmoid' bottom: 'r' top: 'r' } "
+      "layer { name: 'tanh' type: 'TanH' bottom: 'r' top: 't' } "
+      "layer { name: 'exp' type: 'Exp' bottom: 't' top: 'e' } "
+      "layer { name: 'abs' type: 'AbsVal' bottom: 'e' top: 'a' } "
+      "layer { name: 'power' type: 'Power' bottom: 'a' top: 'p' "
+      "  power_param { power: 3 shift: -1 } } "
+      "layer { name: 'loss_p' type: 'EuclideanLoss' bottom: 'p' "
+      "  bottom: 'target' top: 'loss_p' } "
+      "layer { name: 'loss_e' type: 'EuclideanLoss' bottom: 'e' "
+      "  bottom: 'target' top: 'loss_e' } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  Blob<TypeParam> data(this->shapes_[0]);
+  Blob<TypeParam> target(this->shapes_[0]);
+  filler.Fill(&data);
+  filler.Fill(&target);
+  vector<TypeParam> losses;
+  vector<shared_ptr<Blob<TypeParam> > > data_diffs;
+  for (int fuse = 0; fuse < 2; ++fuse) {
+    Caffe::set_fuse_neurons(fuse);
+    Net<TypeParam> net(param);
+    Caffe::set_fuse_neurons(false);
+    // Both nets split target and e.
+    if (fuse) {
+      EXPECT_EQ(6, net.layers().size());
+      ASSERT_TRUE(net.has_layer("relu+sigmoid+tanh+exp"));
+      EXPECT_EQ("FusedNeuron",
+          string(net.layer_by_name("relu+sigmoid+tanh+exp")->type()));
+      EXPECT_TRUE(net.has_layer("abs+power"));
+      EXPECT_FALSE(net.has_blob("t"));
+    } else {
+      EXPECT_EQ(10, net.layers().size());
+    }
+    net.input_blobs()[0]->CopyFrom(data);
+    net.input_blobs()[1]->CopyFrom(target);
+    TypeParam loss;
+    net.ForwardPrefilled(&loss);
+    net.Backward();
+    losses.push_back(loss);
+    data_diffs.push_back(shared_ptr<Blob<TypeParam> >(new Blob<TypeParam>()));
+    data_diffs.back()->CopyFrom(*net.input_blobs()[0], true, true);
+  }
+  EXPECT_NEAR(losses[0], losses[1], 1e-5 * std::fabs(losses[0]));
+  for (int i = 0; i < data.count(); ++i) {
+    EXPECT_NEAR(data_diffs[0]->cpu_diff()[i], data_diffs[1]->cpu_diff()[i],
+        1e-4 * std::fabs(data_diffs[0]->cpu_diff()[i]) + 1e-6);
+  }
+}
+
+TYPED_TEST(FusedNeuronLayerTest, TestToProto) {
+  const string proto =
+      "name: 'FuseNet' "
+      "input: 'data' input_shape { dim: 2 dim: 3 dim: 4 dim: 5 } "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'data' top: 'r' } "
+      "layer { name: 'tanh' type: 'TanH' bottom: 'r' top: 't' } "
+      "layer { name: 'power' type: 'Power' bottom: 't' top: 'p' "
+      "  power_param { power: 2 scale: 3 } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Caffe::set_fuse_neurons(true);
+  Net<TypeParam> fused_net(param);
+  Caffe::set_fuse_neurons(false);
+  ASSERT_EQ(1, fused_net.layers().size());
+  EXPECT_EQ("FusedNeuron", string(fused_net.layers()[0]->type()));
+  // The fused net saves the chain it was fused from.
+  NetParameter saved;
+  fused_net.ToProto(&saved);
+  ASSERT_EQ(3, saved.layer_size());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(param.layer(i).name(), saved.layer(i).name());
+    EXPECT_EQ(param.layer(i).type(), saved.layer(i).type());
+  }
+  EXPECT_EQ(3, saved.layer(2).power_param().scale());
+  // ToProto() saves the names of the inputs, but not their shapes.
+  saved.add_input_shape()->CopyFrom(param.input_shape(0));
+  Net<TypeParam> net(saved);
+  EXPECT_EQ(3, net.layers().size());
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(fused_net.input_blobs()[0]);
+  net.input_blobs()[0]->CopyFrom(*fused_net.input_blobs()[0]);
+  fused_net.ForwardPrefilled();
+  net.ForwardPrefilled();
+  const Blob<TypeParam>& fused_top = *fused_net.output_blobs()[0];
+  const Blob<TypeParam>& top = *net.output_blobs()[0];
+  ASSERT_EQ(top.count(), fused_top.count());
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_NEAR(top.cpu_data()[i], fused_top.cpu_data()[i], 1e-5);
+  }
+}
+
+}  // namespace caffe
@@ -59,6 +59,17 @@ TYPED_TEST(HingeLossLayerTest, TestGradientL1) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(HingeLossLayerTest, TestGradientL1TestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Outside training the backward pass computes the gradient itself.
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  HingeLossLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 2e-3, 1701, 1, 0.01);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
 TYPED_TEST(HingeLossLayerTest, TestGradientL2) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
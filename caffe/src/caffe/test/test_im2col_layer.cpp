@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/im2col_layer.hpp"
+#include "caffe/util/im2col.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -36,6 +37,121 @@ class Im2colLayerTest : public MultiDeviceTest<TypeParam> {
 
 TYPED_TEST_CASE(Im2colLayerTest, TestDtypesAndDevices);
 
+TYPED_TEST(Im2colLayerTest, TestFixedGeometries) {
+  typedef typename TypeParam::Dtype Dtype;
+  // (kernel, stride, pad) of the compiled geometries, and one without.
+  const int kGeometries[][3] = {{3, 1, 1}, {3, 1, 0}, {3, 2, 1}, {3, 2, 0},
+      {2, 2, 0}, {1, 2, 0}, {5, 3, 2}};
+  const int kSizes[][2] = {{6, 5}, {7, 8}, {1, 2}};
+  const int channels = 3;
+  for (int g = 0; g < 7; ++g) {
+    const int kernel = kGeometries[g][0];
+    const int stride = kGeometries[g][1];
+    const int pad = kGeometries[g][2];
+    typename Im2colCpuFunc<Dtype>::type im2col = im2col_cpu_func<Dtype>(
+        kernel, kernel, pad, pad, stride, stride);
+    typename Im2colCpuFunc<Dtype>::type col2im = col2im_cpu_func<Dtype>(
+        kernel, kernel, pad, pad, stride, stride);
+    EXPECT_EQ(g == 6, im2col == &im2col_cpu<Dtype>);
+    EXPECT_EQ(g == 6, col2im == &col2im_cpu<Dtype>);
+    for (int s = 0; s < 3; ++s) {
+      const int height = kSizes[s][0];
+      const int width = kSizes[s][1];
+      const int height_col = (height + 2 * pad - kernel) / stride + 1;
+      const int width_col = (width + 2 * pad - kernel) / stride + 1;
+      if (height_col <= 0 || width_col <= 0) {
+        continue;
+      }
+      Blob<Dtype> im(1, channels, height, width);
+      Blob<Dtype> col(1, channels * kernel * kernel, height_col, width_col);
+      FillerParameter filler_param;
+      GaussianFiller<Dtype> filler(filler_param);
+      filler.Fill(&im);
+      filler.Fill(&col);
+      vector<Dtype> expected(col.count()), actual(col.count());
+      im2col_cpu(im.cpu_data(), channels, height, width, kernel, kernel, pad,
+          pad, stride, stride, &expected[0]);
+      im2col(im.cpu_data(), channels, height, width, kernel, kernel, pad, pad,
+          stride, stride, &actual[0]);
+      for (int i = 0; i < col.count(); ++i) {
+        EXPECT_EQ(expected[i], actual[i]);
+      }
+      expected.resize(im.count());
+      actual.resize(im.count());
+      col2im_cpu(col.cpu_data(), channels, height, width, kernel, kernel, pad,
+          pad, stride, stride, &expected[0]);
+      col2im(col.cpu_data(), channels, height, width, kernel, kernel, pad,
+          pad, stride, stride, &actual[0]);
+      for (int i = 0; i < im.count(); ++i) {
+        EXPECT_NEAR(expected[i], actual[i], 1e-5);
+      }
+    }
+  }
+}
+
+TYPED_TEST(Im2colLayerTest, TestAgainstND) {
+  typedef typename TypeParam::Dtype Dtype;
+  // channels, (depth,) height, width, kernel, pad and stride of each axis: a
+  // rectangular kernel, a strided 1x1 one, padding wider than the kernel, and
+  // enough channels to split them between threads, then the same in 3-D.
+  const int k2D[][7] = {{3, 7, 6, 2, 3, 1, 0}, {3, 7, 8, 1, 1, 0, 0},
+      {2, 5, 4, 3, 3, 4, 4}, {64, 16, 16, 3, 3, 1, 1}};
+  const int k3D[][10] = {{3, 4, 5, 6, 2, 3, 3, 1, 1, 0},
+      {2, 3, 3, 4, 1, 1, 1, 0, 0, 0}, {16, 8, 8, 8, 3, 3, 3, 1, 1, 1}};
+  const int kStrides2D[][2] = {{1, 2}, {3, 3}, {2, 2}, {1, 1}};
+  const int kStrides3D[][3] = {{1, 2, 1}, {2, 2, 2}, {1, 1, 1}};
+  for (int g = 0; g < 7; ++g) {
+    const bool is_3d = g >= 4;
+    const int* p = is_3d ? k3D[g - 4] : k2D[g];
+    const int* strides = is_3d ? kStrides3D[g - 4] : kStrides2D[g];
+    const int axes = is_3d ? 3 : 2;
+    vector<int> im_shape(p, p + axes + 1);
+    vector<int> col_shape(1, p[0]);
+    for (int i = 0; i < axes; ++i) {
+      col_shape[0] *= p[1 + axes + i];
+      col_shape.push_back((p[1 + i] + 2 * p[1 + 2 * axes + i]
+          - p[1 + axes + i]) / strides[i] + 1);
+    }
+    const vector<int> kernel(p + 1 + axes, p + 1 + 2 * axes);
+    const vector<int> pad(p + 1 + 2 * axes, p + 1 + 3 * axes);
+    Blob<Dtype> im(im_shape);
+    Blob<Dtype> col(col_shape);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&im);
+    filler.Fill(&col);
+    vector<Dtype> expected(col.count()), actual(col.count());
+    im2col_nd_cpu(im.cpu_data(), axes, &im_shape[0], &col_shape[0],
+        &kernel[0], &pad[0], strides, &expected[0]);
+    if (is_3d) {
+      im2col_3d_cpu(im.cpu_data(), p[0], p[1], p[2], p[3], kernel[0],
+          kernel[1], kernel[2], pad[0], pad[1], pad[2], strides[0],
+          strides[1], strides[2], &actual[0]);
+    } else {
+      im2col_cpu(im.cpu_data(), p[0], p[1], p[2], kernel[0], kernel[1],
+          pad[0], pad[1], strides[0], strides[1], &actual[0]);
+    }
+    for (int i = 0; i < col.count(); ++i) {
+      EXPECT_EQ(expected[i], actual[i]);
+    }
+    expected.resize(im.count());
+    actual.resize(im.count());
+    col2im_nd_cpu(col.cpu_data(), axes, &im_shape[0], &col_shape[0],
+        &kernel[0], &pad[0], strides, &expected[0]);
+    if (is_3d) {
+      col2im_3d_cpu(col.cpu_data(), p[0], p[1], p[2], p[3], kernel[0],
+          kernel[1], kernel[2], pad[0], pad[1], pad[2], strides[0],
+          strides[1], strides[2], &actual[0]);
+    } else {
+      col2im_cpu(col.cpu_data(), p[0], p[1], p[2], kernel[0], kernel[1],
+          pad[0], pad[1], strides[0], strides[1], &actual[0]);
+    }
+    for (int i = 0; i < im.count(); ++i) {
+      EXPECT_NEAR(expected[i], actual[i], 1e-4);
+    }
+  }
+}
+
 TYPED_TEST(Im2colLayerTest, TestSetup) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
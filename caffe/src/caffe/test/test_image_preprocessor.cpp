@@ -0,0 +1,207 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/util/image_preprocessor.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+static const int kHeight = 4;
+static const int kWidth = 5;
+static const int kChannels = 3;
+
+// The value of pixel (h, w) in channel c of image i.
+static int PixelValue(int i, int c, int h, int w) {
+  return i + 60 * c + 10 * h + w;
+}
+
+template <typename Dtype>
+class ImagePreprocessorTest : public ::testing::Test {
+ protected:
+  ImagePreprocessorTest() : blob_(new Blob<Dtype>(10, kChannels, 2, 3)) {}
+  virtual ~ImagePreprocessorTest() { delete blob_; }
+
+  // Makes num_images HWC images of unsigned bytes.
+  void MakeImages(int num_images) {
+    for (int i = 0; i < num_images; ++i) {
+      cv::Mat image(kHeight, kWidth, CV_8UC3);
+      for (int h = 0; h < kHeight; ++h) {
+        uchar* row = image.ptr<uchar>(h);
+        for (int w = 0; w < kWidth; ++w) {
+          for (int c = 0; c < kChannels; ++c) {
+            row[w * kChannels + c] = PixelValue(i, c, h, w);
+          }
+        }
+      }
+      images_.push_back(image);
+    }
+  }
+
+  vector<cv::Mat> images_;
+  Blob<Dtype>* const blob_;
+};
+
+TYPED_TEST_CASE(ImagePreprocessorTest, TestDtypes);
+
+TYPED_TEST(ImagePreprocessorTest, TestCenterCrop) {
+  this->MakeImages(1);
+  ImagePreprocessor<TypeParam> preprocessor(1);
+  preprocessor.Preprocess(this->images_, this->blob_);
+  // The 2 x 3 center crop of a 4 x 5 image starts at (1, 1).
+  for (int c = 0; c < kChannels; ++c) {
+    for (int h = 0; h < 2; ++h) {
+      for (int w = 0; w < 3; ++w) {
+        EXPECT_EQ(PixelValue(0, c, h + 1, w + 1),
+            this->blob_->data_at(0, c, h, w));
+      }
+    }
+  }
+}
+
+TYPED_TEST(ImagePreprocessorTest, TestOversample) {
+  this->MakeImages(1);
+  ImagePreprocessor<TypeParam> preprocessor(1);
+  preprocessor.set_oversample(true);
+  EXPECT_EQ(10, preprocessor.crops_per_image());
+  preprocessor.Preprocess(this->images_, this->blob_);
+  // The corners, top left to bottom right, the center and their mirrors.
+  const int h_offs[] = { 0, 0, 2, 2, 1 };
+  const int w_offs[] = { 0, 2, 0, 2, 1 };
+  for (int k = 0; k < 5; ++k) {
+    for (int c = 0; c < kChannels; ++c) {
+      for (int h = 0; h < 2; ++h) {
+        for (int w = 0; w < 3; ++w) {
+          EXPECT_EQ(PixelValue(0, c, h + h_offs[k], w + w_offs[k]),
+              this->blob_->data_at(k, c, h, w));
+          EXPECT_EQ(PixelValue(0, c, h + h_offs[k], 2 - w + w_offs[k]),
+              this->blob_->data_at(5 + k, c, h, w));
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(ImagePreprocessorTest, TestScaleMeanAndChannelSwap) {
+  typedef TypeParam Dtype;
+  this->MakeImages(1);
+  ImagePreprocessor<Dtype> preprocessor(1);
+  vector<int> channel_swap;
+  channel_swap.push_back(2);
+  channel_swap.push_back(0);
+  channel_swap.push_back(1);
+  preprocessor.set_channel_swap(channel_swap);
+  preprocessor.set_raw_scale(2);
+  vector<Dtype> mean;
+  mean.push_back(10);
+  mean.push_back(20);
+  mean.push_back(30);
+  preprocessor.set_mean(mean);
+  preprocessor.set_input_scale(0.5);
+  preprocessor.Preprocess(this->images_, this->blob_);
+  for (int c = 0; c < kChannels; ++c) {
+    for (int h = 0; h < 2; ++h) {
+      for (int w = 0; w < 3; ++w) {
+        const Dtype pixel = PixelValue(0, channel_swap[c], h + 1, w + 1);
+        EXPECT_NEAR((2 * pixel - mean[c]) * 0.5,
+            this->blob_->data_at(0, c, h, w), 1e-4);
+      }
+    }
+  }
+}
+
+TYPED_TEST(ImagePreprocessorTest, TestFloatImagesInParallel) {
+  this->MakeImages(8);
+  for (int i = 0; i < this->images_.size(); ++i) {
+    cv::Mat converted;
+    this->images_[i].convertTo(converted, CV_32FC3, 0.5);
+    this->images_[i] = converted;
+  }
+  ImagePreprocessor<TypeParam> preprocessor(3);
+  preprocessor.set_raw_scale(2);
+  preprocessor.Preprocess(this->images_, this->blob_);
+  // Only the first 8 items were written, each from its own image.
+  for (int i = 0; i < 8; ++i) {
+    for (int c = 0; c < kChannels; ++c) {
+      EXPECT_NEAR(PixelValue(i, c, 1, 1), this->blob_->data_at(i, c, 0, 0),
+          1e-4);
+    }
+  }
+}
+
+TYPED_TEST(ImagePreprocessorTest, TestWindowsInParallel) {
+  typedef TypeParam Dtype;
+  this->MakeImages(1);
+  ImagePreprocessor<Dtype> preprocessor(2);
+  vector<Dtype> mean(1, 10);
+  preprocessor.set_mean(mean);
+  // (y1, x1, y2, x2) windows of the crop size, so none is scaled.
+  const int windows[] = { 0, 0, 2, 2, 1, 2, 3, 4, 2, 3, 4, 5 };
+  Blob<Dtype> blob(3, kChannels, 2, 2);
+  preprocessor.PreprocessWindows(this->images_[0],
+      vector<int>(windows, windows + 12), &blob);
+  for (int i = 0; i < 3; ++i) {
+    for (int c = 0; c < kChannels; ++c) {
+      for (int h = 0; h < 2; ++h) {
+        for (int w = 0; w < 2; ++w) {
+          EXPECT_NEAR(PixelValue(0, c, windows[4 * i] + h,
+              windows[4 * i + 1] + w) - 10, blob.data_at(i, c, h, w), 1e-4);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(ImagePreprocessorTest, TestWindowsLikeCrop) {
+  typedef TypeParam Dtype;
+  this->MakeImages(1);
+  ImagePreprocessor<Dtype> preprocessor(1);
+  // Windows are slices, exclusive of y2 and x2, like Detector.crop(); the
+  // last reaches past the image and is clipped to it.
+  const int windows[] = { 0, 1, 3, 4, 1, 0, 4, 3, -2, 2, 9, 7 };
+  const int clipped[] = { 0, 1, 3, 4, 1, 0, 4, 3, 0, 2, 4, 5 };
+  const int crop_size = 4;
+  Blob<Dtype> blob(3, kChannels, crop_size, crop_size);
+  preprocessor.PreprocessWindows(this->images_[0],
+      vector<int>(windows, windows + 12), &blob);
+  for (int i = 0; i < 3; ++i) {
+    const int* window = clipped + 4 * i;
+    // What Detector.crop() and the Transformer make of the window.
+    cv::Mat crop = this->images_[0](cv::Rect(window[1], window[0],
+        window[3] - window[1], window[2] - window[0]));
+    cv::Mat warped;
+    cv::resize(crop, warped, cv::Size(crop_size, crop_size), 0, 0,
+        cv::INTER_LINEAR);
+    for (int c = 0; c < kChannels; ++c) {
+      for (int h = 0; h < crop_size; ++h) {
+        for (int w = 0; w < crop_size; ++w) {
+          EXPECT_NEAR(warped.ptr<uchar>(h)[w * kChannels + c],
+              blob.data_at(i, c, h, w), 1e-4);
+        }
+      }
+    }
+  }
+}
+
+TEST(ClipWindowTest, TestClipWindow) {
+  int window[] = { -1, 2, 5, 9 };
+  EXPECT_TRUE(ClipWindow(4, 5, window));
+  EXPECT_EQ(0, window[0]);
+  EXPECT_EQ(2, window[1]);
+  EXPECT_EQ(4, window[2]);
+  EXPECT_EQ(5, window[3]);
+  int outside[] = { 1, 5, 3, 8 };
+  EXPECT_FALSE(ClipWindow(4, 5, outside));
+  int empty[] = { 2, 1, 2, 3 };
+  EXPECT_FALSE(ClipWindow(4, 5, empty));
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
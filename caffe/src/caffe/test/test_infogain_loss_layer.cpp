@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +9,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/infogain_loss_layer.hpp"
+#include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -64,4 +68,83 @@ TYPED_TEST(InfogainLossLayerTest, TestGradient) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(InfogainLossLayerTest, TestGradientTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Outside training the backward pass computes the gradient itself.
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  InfogainLossLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-4, 2e-2, 1701, 1, 0.01);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
+TYPED_TEST(InfogainLossLayerTest, TestSparseInfogain) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Enough samples to split between threads, and an infogain matrix of the
+  // identity plus a few entries, which a source file gives as sparse.
+  const int kNum = 1024;
+  const int kDim = 40;
+  Blob<Dtype> data(kNum, kDim, 1, 1);
+  Blob<Dtype> label(kNum, 1, 1, 1);
+  Blob<Dtype> infogain(1, 1, kDim, kDim);
+  FillerParameter filler_param;
+  PositiveUnitballFiller<Dtype> filler(filler_param);
+  filler.Fill(&data);
+  for (int i = 0; i < kNum; ++i) {
+    label.mutable_cpu_data()[i] = caffe_rng_rand() % kDim;
+  }
+  Dtype* h = infogain.mutable_cpu_data();
+  caffe_set(infogain.count(), Dtype(0), h);
+  for (int i = 0; i < kDim; ++i) {
+    h[i * kDim + i] = 1;
+    h[i * kDim + (i * 7 + 3) % kDim] += 0.5;
+  }
+  string filename;
+  MakeTempFilename(&filename);
+  BlobProto blob_proto;
+  infogain.ToProto(&blob_proto);
+  WriteProtoToBinaryFile(blob_proto, filename);
+  LayerParameter layer_param;
+  layer_param.mutable_infogain_loss_param()->set_source(filename);
+  InfogainLossLayer<Dtype> sparse_layer(layer_param);
+  // Given as a bottom instead, the matrix is used dense.
+  InfogainLossLayer<Dtype> dense_layer(layer_param);
+  vector<Blob<Dtype>*> bottom;
+  bottom.push_back(&data);
+  bottom.push_back(&label);
+  Blob<Dtype> loss;
+  vector<Blob<Dtype>*> top(1, &loss);
+  vector<bool> propagate_down(2, false);
+  propagate_down[0] = true;
+  sparse_layer.SetUp(bottom, top);
+  sparse_layer.Forward(bottom, top);
+  const Dtype sparse_loss = loss.cpu_data()[0];
+  loss.mutable_cpu_diff()[0] = 2;
+  sparse_layer.Backward(top, propagate_down, bottom);
+  vector<Dtype> sparse_diff(data.cpu_diff(), data.cpu_diff() + data.count());
+  bottom.push_back(&infogain);
+  propagate_down.push_back(false);
+  dense_layer.SetUp(bottom, top);
+  dense_layer.Forward(bottom, top);
+  loss.mutable_cpu_diff()[0] = 2;
+  dense_layer.Backward(top, propagate_down, bottom);
+  Dtype expected_loss = 0;
+  for (int i = 0; i < kNum; ++i) {
+    const int l = static_cast<int>(label.cpu_data()[i]);
+    for (int j = 0; j < kDim; ++j) {
+      const Dtype prob = std::max(data.cpu_data()[i * kDim + j],
+          Dtype(kLOG_THRESHOLD));
+      expected_loss -= h[l * kDim + j] * std::log(prob) / kNum;
+    }
+  }
+  EXPECT_NEAR(expected_loss, sparse_loss, 1e-4 * std::fabs(expected_loss));
+  EXPECT_NEAR(expected_loss, loss.cpu_data()[0],
+      1e-4 * std::fabs(expected_loss));
+  for (int i = 0; i < data.count(); ++i) {
+    EXPECT_NEAR(data.cpu_diff()[i], sparse_diff[i],
+        1e-4 * std::fabs(sparse_diff[i]));
+  }
+}
+
 }  // namespace caffe
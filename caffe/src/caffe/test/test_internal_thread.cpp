@@ -49,5 +49,25 @@ TEST_F(InternalThreadTest, TestRandomSeed) {
   t3.StopInternalThread();
 }
 
+class TestThreadSettings : public InternalThread {
+  void InternalThreadEntry() {
+    EXPECT_TRUE(Caffe::autotune());
+    EXPECT_EQ("autotune.cache", Caffe::autotune_cache());
+    EXPECT_TRUE(Caffe::fuse_neurons());
+  }
+};
+
+TEST_F(InternalThreadTest, TestSettings) {
+  Caffe::set_autotune(true);
+  Caffe::set_autotune_cache("autotune.cache");
+  Caffe::set_fuse_neurons(true);
+  TestThreadSettings thread;
+  thread.StartInternalThread();
+  thread.StopInternalThread();
+  Caffe::set_autotune(false);
+  Caffe::set_autotune_cache("");
+  Caffe::set_fuse_neurons(false);
+}
+
 }  // namespace caffe
 
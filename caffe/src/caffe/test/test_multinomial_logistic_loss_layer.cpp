@@ -55,4 +55,15 @@ TYPED_TEST(MultinomialLogisticLossLayerTest, TestGradientCPU) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(MultinomialLogisticLossLayerTest, TestGradientTestPhase) {
+  // Outside training the backward pass computes the gradient itself.
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  MultinomialLogisticLossLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  GradientChecker<TypeParam> checker(1e-2, 2*1e-2, 1701, 0, 0.05);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
 }  // namespace caffe
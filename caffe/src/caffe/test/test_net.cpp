@@ -9,6 +9,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -1226,6 +1227,44 @@ TYPED_TEST(NetTest, TestSharedWeightsResume) {
   }
 }
 
+TYPED_TEST(NetTest, TestCopyTrainedLayersFromBinaryProto) {
+  typedef typename TypeParam::Dtype Dtype;
+
+  // Create a net with weight sharing; Update it once.
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataSharedWeightsNet();
+  vector<Blob<Dtype>*> bottom;
+  this->net_->ForwardBackward(bottom);
+  this->net_->Update();
+  vector<shared_ptr<Blob<Dtype> > > trained_params;
+  for (int i = 0; i < this->net_->params().size(); ++i) {
+    trained_params.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    trained_params[i]->CopyFrom(*this->net_->params()[i], false, true);
+  }
+
+  // Write the net to a file, as in Solver::Snapshot, and read it back into
+  // a reinitialized net by the streaming reader.
+  NetParameter net_param;
+  this->net_->ToProto(&net_param);
+  string filename;
+  MakeTempFilename(&filename);
+  WriteProtoToBinaryFile(net_param, filename);
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataSharedWeightsNet();
+  this->net_->CopyTrainedLayersFrom(filename);
+  const vector<shared_ptr<Blob<Dtype> > >& params = this->net_->params();
+  ASSERT_EQ(trained_params.size(), params.size());
+  for (int i = 0; i < params.size(); ++i) {
+    ASSERT_EQ(trained_params[i]->count(), params[i]->count());
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_EQ(trained_params[i]->cpu_data()[j], params[i]->cpu_data()[j]);
+    }
+  }
+  // The shared weights still share their memory.
+  EXPECT_EQ(this->net_->layers()[1]->blobs()[0]->cpu_data(),
+      this->net_->layers()[2]->blobs()[0]->cpu_data());
+}
+
 TYPED_TEST(NetTest, TestParamPropagateDown) {
   typedef typename TypeParam::Dtype Dtype;
   vector<Blob<Dtype>*> bottom;
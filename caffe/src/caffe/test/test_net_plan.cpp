@@ -0,0 +1,205 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/net_plan.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class NetPlanTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  NetPlanTest() : seed_(1701) {}
+
+  virtual void SetUp() {
+    // conv1 and ip1 take a BatchNorm each, in place and not in place; the
+    // net also has an implicit Split and Dropout, Flatten and Silence layers.
+    const string proto =
+        "name: 'NetPlanTestNet' "
+        "input: 'data' "
+        "input_shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+        "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { num_output: 4 kernel_size: 3 bias_term: false "
+        "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+        "layer { name: 'bn1' type: 'BatchNorm' bottom: 'conv1' top: 'conv1' } "
+        "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+        "layer { name: 'pool1' type: 'Pooling' bottom: 'conv1' top: 'pool1' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } } "
+        "layer { name: 'drop1' type: 'Dropout' bottom: 'pool1' top: 'drop1' } "
+        "layer { name: 'flat1' type: 'Flatten' bottom: 'drop1' top: 'flat1' } "
+        "layer { name: 'ip1' type: 'InnerProduct' bottom: 'flat1' top: 'ip1' "
+        "  inner_product_param { num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } } } "
+        "layer { name: 'bn2' type: 'BatchNorm' bottom: 'ip1' top: 'ip1_bn' } "
+        "layer { name: 'ip2' type: 'InnerProduct' bottom: 'conv1' top: 'ip2' "
+        "  inner_product_param { num_output: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+        "layer { name: 'silence' type: 'Silence' bottom: 'ip2' } "
+        "layer { name: 'prob' type: 'Softmax' bottom: 'ip1_bn' top: 'prob' } ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    param.mutable_state()->set_phase(TEST);
+    Caffe::set_random_seed(this->seed_);
+    net_.reset(new Net<Dtype>(param));
+    // Give the BatchNorm layers non-trivial statistics.
+    FillerParameter filler_param;
+    filler_param.set_min(0.5);
+    filler_param.set_max(2);
+    UniformFiller<Dtype> variance_filler(filler_param);
+    GaussianFiller<Dtype> mean_filler(filler_param);
+    const char* bn_names[] = { "bn1", "bn2" };
+    for (int i = 0; i < 2; ++i) {
+      vector<shared_ptr<Blob<Dtype> > >& stats =
+          net_->layer_by_name(bn_names[i])->blobs();
+      mean_filler.Fill(stats[0].get());
+      variance_filler.Fill(stats[1].get());
+      stats[2]->mutable_cpu_data()[0] = 2;
+    }
+    input_.ReshapeLike(*net_->input_blobs()[0]);
+    filler_param.set_std(1);
+    GaussianFiller<Dtype> input_filler(filler_param);
+    input_filler.Fill(&input_);
+  }
+
+  // Runs the net and the plan on input_ and checks that they agree.
+  void CheckMatchesNet(NetPlan<Dtype>* plan) {
+    vector<Blob<Dtype>*> bottom(1, &input_);
+    const vector<Blob<Dtype>*>& expected = net_->Forward(bottom);
+    ASSERT_EQ(1, plan->output_blobs().size());
+    Blob<Dtype> actual;
+    actual.ReshapeLike(*expected[0]);
+    ASSERT_EQ(actual.shape(), plan->output_blobs()[0]->shape());
+    plan->Run(vector<const Dtype*>(1, input_.cpu_data()),
+        vector<Dtype*>(1, actual.mutable_cpu_data()));
+    for (int i = 0; i < actual.count(); ++i) {
+      EXPECT_NEAR(expected[0]->cpu_data()[i], actual.cpu_data()[i], 1e-4);
+    }
+  }
+
+  // Reshapes the net and input_ to a batch of num and fills input_.
+  void ReshapeInput(int num) {
+    vector<int> shape = net_->input_blobs()[0]->shape();
+    shape[0] = num;
+    net_->input_blobs()[0]->Reshape(shape);
+    net_->Reshape();
+    input_.Reshape(shape);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&input_);
+  }
+
+  int seed_;
+  shared_ptr<Net<Dtype> > net_;
+  Blob<Dtype> input_;
+};
+
+TYPED_TEST_CASE(NetPlanTest, TestDtypesAndDevices);
+
+TYPED_TEST(NetPlanTest, TestMatchesNet) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetPlan<Dtype> plan(*this->net_);
+  this->CheckMatchesNet(&plan);
+  // Running again, and building the plan, leave the net intact.
+  this->CheckMatchesNet(&plan);
+}
+
+TYPED_TEST(NetPlanTest, TestDropsNoOpLayers) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetPlan<Dtype> plan(*this->net_);
+  // conv1 + bn1, relu1, pool1, ip1 + bn2, ip2 and prob remain of the 12
+  // layers, which include the Split for conv1.
+  EXPECT_EQ(12, this->net_->layers().size());
+  EXPECT_EQ(6, plan.num_steps());
+}
+
+TYPED_TEST(NetPlanTest, TestArenaReusesMemory) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetPlan<Dtype> plan(*this->net_);
+  size_t activation_bytes = 0;
+  for (int i = 0; i < this->net_->blobs().size(); ++i) {
+    activation_bytes += this->net_->blobs()[i]->count() * sizeof(Dtype);
+  }
+  EXPECT_GT(plan.arena_bytes(), 0);
+  EXPECT_LT(plan.arena_bytes(), activation_bytes);
+}
+
+TYPED_TEST(NetPlanTest, TestCacheSwitchesShapes) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetPlanCache<Dtype> cache(this->net_.get(), 4);
+  const int nums[] = { 1, 3, 1, 2, 3 };
+  vector<NetPlan<Dtype>*> plans;
+  for (int i = 0; i < 5; ++i) {
+    vector<int> shape = this->net_->input_blobs()[0]->shape();
+    shape[0] = nums[i];
+    plans.push_back(cache.Get(vector<vector<int> >(1, shape)));
+    this->ReshapeInput(nums[i]);
+    this->CheckMatchesNet(plans.back());
+  }
+  EXPECT_EQ(plans[0], plans[2]);
+  EXPECT_EQ(plans[1], plans[4]);
+  EXPECT_EQ(3, cache.size());
+  EXPECT_EQ(2, cache.hits());
+  EXPECT_EQ(3, cache.misses());
+  // The arena fits the plan for the largest batch, and all share it.
+  EXPECT_EQ(plans[1]->arena_bytes(), cache.arena_bytes());
+  EXPECT_LT(plans[0]->arena_bytes(), cache.arena_bytes());
+}
+
+TYPED_TEST(NetPlanTest, TestCacheEvictsLeastRecentlyUsed) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetPlanCache<Dtype> cache(this->net_.get(), 2);
+  const int nums[] = { 1, 2, 1, 3, 1, 2 };
+  const bool hits[] = { false, false, true, false, true, false };
+  for (int i = 0; i < 6; ++i) {
+    vector<int> shape = this->net_->input_blobs()[0]->shape();
+    shape[0] = nums[i];
+    const int num_hits = cache.hits();
+    NetPlan<Dtype>* plan = cache.Get(vector<vector<int> >(1, shape));
+    EXPECT_EQ(hits[i], cache.hits() > num_hits) << "Get " << i;
+    EXPECT_LE(cache.size(), 2);
+    this->ReshapeInput(nums[i]);
+    this->CheckMatchesNet(plan);
+  }
+}
+
+TYPED_TEST(NetPlanTest, TestFusedNeurons) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'FusedNet' "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'data' top: 'relu' } "
+      "layer { name: 'sigmoid' type: 'Sigmoid' bottom: 'relu' top: 'sig' } "
+      "layer { name: 'ip' type: 'InnerProduct' bottom: 'sig' top: 'ip' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(TEST);
+  Caffe::set_fuse_neurons(true);
+  this->net_.reset(new Net<Dtype>(param));
+  Caffe::set_fuse_neurons(false);
+  // Nets fuse neurons on the CPU only.
+  if (Caffe::mode() == Caffe::CPU) {
+    EXPECT_TRUE(this->net_->has_layer("relu+sigmoid"));
+  }
+  NetPlan<Dtype> plan(*this->net_);
+  this->CheckMatchesNet(&plan);
+  NetPlanCache<Dtype> cache(this->net_.get(), 2);
+  this->CheckMatchesNet(cache.Get(
+      vector<vector<int> >(1, this->net_->input_blobs()[0]->shape())));
+}
+
+}  // namespace caffe
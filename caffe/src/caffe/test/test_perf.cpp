@@ -0,0 +1,222 @@
+// Opt-in performance regression tests. They run the example nets forward and
+// backward on synthetic input and compare their cost against a checked-in
+// baseline. Timings are normalised by a reference GEMM timed on the same
+// machine, so that one baseline serves machines of different speed. Run with
+//   test_all.testbin --gtest_filter='PerfTest*' --perf_test
+// or `make perftest`; add --perf_baseline_out=<file> to record a new baseline.
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+DEFINE_bool(perf_test, false,
+    "Run the performance regression tests (PerfTest*).");
+DEFINE_string(perf_baseline,
+    CMAKE_SOURCE_DIR "caffe/test/test_data/perf_baseline.txt",
+    "Baseline of normalised costs the performance tests compare against.");
+DEFINE_string(perf_baseline_out, "",
+    "Optional; write the measured normalised costs to this file.");
+DEFINE_double(perf_tolerance, 0.25,
+    "Allowed relative slowdown against the baseline.");
+
+namespace caffe {
+
+// Each measurement is the fastest of this many samples, which is less
+// sensitive to other load on the machine than the mean, and each sample runs
+// for at least kSampleSeconds.
+static const int kSamples = 5;
+static const double kSampleSeconds = 0.2;
+
+class PerfTest : public ::testing::Test {
+ protected:
+  PerfTest() {
+    Caffe::set_mode(Caffe::CPU);
+  }
+
+  virtual void SetUp() {
+    if (!FLAGS_perf_test) {
+      return;
+    }
+    Caffe::set_random_seed(1701);
+    std::ifstream baseline(FLAGS_perf_baseline.c_str());
+    string line;
+    while (std::getline(baseline, line)) {
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      std::istringstream fields(line);
+      string name;
+      double cost;
+      fields >> name >> cost;
+      CHECK(!fields.fail()) << "Malformed perf baseline line: " << line;
+      baseline_[name] = cost;
+    }
+    reference_seconds_ = ReferenceSeconds();
+    LOG(INFO) << "Reference GEMM takes " << reference_seconds_ * 1e3 << " ms";
+  }
+
+  // Times fn (called with an iteration count) and returns the fastest
+  // seconds per iteration.
+  template <typename Fn>
+  static double MinSeconds(Fn* fn) {
+    // Calibrate the number of iterations per sample.
+    int iterations = 1;
+    for (;;) {
+      CPUTimer timer;
+      timer.Start();
+      fn->Run(iterations);
+      if (timer.MicroSeconds() / 1e6 >= kSampleSeconds) {
+        break;
+      }
+      iterations *= 2;
+    }
+    double seconds = -1;
+    for (int i = 0; i < kSamples; ++i) {
+      CPUTimer timer;
+      timer.Start();
+      fn->Run(iterations);
+      const double sample = timer.MicroSeconds() / 1e6 / iterations;
+      if (seconds < 0 || sample < seconds) {
+        seconds = sample;
+      }
+    }
+    return seconds;
+  }
+
+  // The machine-dependent unit of cost: a 256x256x256 single precision GEMM.
+  struct ReferenceGemm {
+    ReferenceGemm() : a(1, 1, 256, 256), b(1, 1, 256, 256), c(1, 1, 256, 256) {
+      FillerParameter filler_param;
+      GaussianFiller<float> filler(filler_param);
+      filler.Fill(&a);
+      filler.Fill(&b);
+    }
+    void Run(int iterations) {
+      for (int i = 0; i < iterations; ++i) {
+        caffe_cpu_gemm<float>(CblasNoTrans, CblasNoTrans, 256, 256, 256, 1.,
+            a.cpu_data(), b.cpu_data(), 0., c.mutable_cpu_data());
+      }
+    }
+    Blob<float> a, b, c;
+  };
+
+  static double ReferenceSeconds() {
+    ReferenceGemm gemm;
+    return MinSeconds(&gemm);
+  }
+
+  struct ForwardBackward {
+    explicit ForwardBackward(Net<float>* net) : net(net) {}
+    void Run(int iterations) {
+      for (int i = 0; i < iterations; ++i) {
+        net->ForwardPrefilled();
+        net->Backward();
+      }
+    }
+    Net<float>* net;
+  };
+
+  // Loads a deploy net and replaces its inputs by DummyData layers of the
+  // same shape, so that ForwardPrefilled() needs no input.
+  static void LoadWithDummyData(const string& filename, NetParameter* param) {
+    ReadNetParamsFromTextFileOrDie(filename, param);
+    NetParameter dummy;
+    for (int i = 0; i < param->input_size(); ++i) {
+      LayerParameter* layer = dummy.add_layer();
+      layer->set_name(param->input(i));
+      layer->set_type("DummyData");
+      layer->add_top(param->input(i));
+      DummyDataParameter* dummy_param = layer->mutable_dummy_data_param();
+      if (param->input_shape_size()) {
+        dummy_param->add_shape()->CopyFrom(param->input_shape(i));
+      } else {
+        BlobShape* shape = dummy_param->add_shape();
+        for (int j = 0; j < 4; ++j) {
+          shape->add_dim(param->input_dim(4 * i + j));
+        }
+      }
+      dummy_param->add_data_filler()->set_type("gaussian");
+    }
+    dummy.mutable_layer()->MergeFrom(param->layer());
+    param->mutable_layer()->Swap(dummy.mutable_layer());
+    param->clear_input();
+    param->clear_input_shape();
+    param->clear_input_dim();
+    // Deploy nets have no loss; backpropagate from the outputs regardless.
+    param->set_force_backward(true);
+    param->mutable_state()->set_phase(TEST);
+  }
+
+  void CheckNet(const string& name, const string& filename) {
+    if (!FLAGS_perf_test) {
+      LOG(INFO) << "Skipping " << name << "; run with --perf_test.";
+      return;
+    }
+    NetParameter param;
+    LoadWithDummyData(filename, &param);
+    Net<float> net(param);
+    // Give the outputs a gradient to backpropagate.
+    FillerParameter filler_param;
+    GaussianFiller<float> filler(filler_param);
+    net.ForwardPrefilled();
+    for (int i = 0; i < net.output_blobs().size(); ++i) {
+      Blob<float>* output = net.output_blobs()[i];
+      Blob<float> diff;
+      diff.ReshapeLike(*output);
+      filler.Fill(&diff);
+      caffe_copy(output->count(), diff.cpu_data(), output->mutable_cpu_diff());
+    }
+    ForwardBackward pass(&net);
+    const double seconds = MinSeconds(&pass);
+    const double cost = seconds / reference_seconds_;
+    LOG(INFO) << name << ": " << seconds * 1e3 << " ms per forward-backward, "
+              << "normalised cost " << cost;
+    if (FLAGS_perf_baseline_out.size()) {
+      std::ofstream out(FLAGS_perf_baseline_out.c_str(), std::ios::app);
+      CHECK(out.is_open()) << "Failed to open " << FLAGS_perf_baseline_out;
+      out << name << " " << cost << "\n";
+    }
+    std::map<string, double>::const_iterator it = baseline_.find(name);
+    if (it == baseline_.end()) {
+      LOG(WARNING) << "No perf baseline for " << name << " in "
+                   << FLAGS_perf_baseline;
+      return;
+    }
+    EXPECT_LE(cost, it->second * (1 + FLAGS_perf_tolerance))
+        << name << " is slower than its baseline cost " << it->second;
+  }
+
+  std::map<string, double> baseline_;
+  double reference_seconds_;
+};
+
+TEST_F(PerfTest, TestLeNet) {
+  CheckNet("lenet", EXAMPLES_SOURCE_DIR "mnist/lenet.prototxt");
+}
+
+TEST_F(PerfTest, TestCifar10Quick) {
+  CheckNet("cifar10_quick",
+      EXAMPLES_SOURCE_DIR "cifar10/cifar10_quick.prototxt");
+}
+
+TEST_F(PerfTest, TestCifar10Full) {
+  CheckNet("cifar10_full",
+      EXAMPLES_SOURCE_DIR "cifar10/cifar10_full.prototxt");
+}
+
+}  // namespace caffe
@@ -0,0 +1,135 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/pixel_shuffle_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class PixelShuffleLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  PixelShuffleLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 12, 3, 4)),
+        blob_top_(new Blob<Dtype>()),
+        blob_top_2_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~PixelShuffleLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+    delete blob_top_2_;
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const blob_top_2_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(PixelShuffleLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(PixelShuffleLayerTest, TestSetup) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_convolution_param()->add_stride(2);
+  PixelShuffleLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->num(), 2);
+  EXPECT_EQ(this->blob_top_->channels(), 3);
+  EXPECT_EQ(this->blob_top_->height(), 6);
+  EXPECT_EQ(this->blob_top_->width(), 8);
+  LayerParameter unshuffle_param;
+  unshuffle_param.mutable_convolution_param()->set_stride_h(3);
+  unshuffle_param.mutable_convolution_param()->set_stride_w(2);
+  PixelUnshuffleLayer<Dtype> unshuffle(unshuffle_param);
+  this->blob_bottom_->Reshape(2, 2, 9, 8);
+  unshuffle.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->num(), 2);
+  EXPECT_EQ(this->blob_top_->channels(), 12);
+  EXPECT_EQ(this->blob_top_->height(), 3);
+  EXPECT_EQ(this->blob_top_->width(), 4);
+}
+
+TYPED_TEST(PixelShuffleLayerTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_convolution_param()->set_stride_h(2);
+  layer_param.mutable_convolution_param()->set_stride_w(3);
+  PixelShuffleLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(this->blob_top_->channels(), 2);
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 2; ++c) {
+      for (int h = 0; h < 6; ++h) {
+        for (int w = 0; w < 12; ++w) {
+          const int channel = (c * 2 + h % 2) * 3 + w % 3;
+          EXPECT_EQ(this->blob_bottom_->data_at(n, channel, h / 2, w / 3),
+              this->blob_top_->data_at(n, c, h, w));
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(PixelShuffleLayerTest, TestRoundTrip) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Enough planes to split the copies between threads.
+  this->blob_bottom_->Reshape(4, 64, 16, 16);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.mutable_convolution_param()->add_stride(4);
+  PixelShuffleLayer<Dtype> shuffle(layer_param);
+  PixelUnshuffleLayer<Dtype> unshuffle(layer_param);
+  vector<Blob<Dtype>*> top_vec_2(1, this->blob_top_2_);
+  shuffle.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  unshuffle.SetUp(this->blob_top_vec_, top_vec_2);
+  shuffle.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  unshuffle.Forward(this->blob_top_vec_, top_vec_2);
+  ASSERT_TRUE(this->blob_top_2_->shape() == this->blob_bottom_->shape());
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i],
+        this->blob_top_2_->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(PixelShuffleLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_convolution_param()->add_stride(2);
+  PixelShuffleLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(PixelShuffleLayerTest, TestGradientUnshuffle) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_convolution_param()->add_stride(3);
+  layer_param.mutable_convolution_param()->add_stride(2);
+  PixelUnshuffleLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+}  // namespace caffe
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -572,6 +573,74 @@ TYPED_TEST(PoolingLayerTest, TestForwardAve) {
   EXPECT_NEAR(this->blob_top_->cpu_data()[8], 8.0 / 9, epsilon);
 }
 
+TYPED_TEST(PoolingLayerTest, TestForwardFixedGeometries) {
+  typedef typename TypeParam::Dtype Dtype;
+  // (kernel, stride, pad) of the compiled geometries.
+  const int kGeometries[][3] = {{2, 2, 0}, {3, 2, 0}, {3, 2, 1}, {3, 1, 1}};
+  const int kSizes[][2] = {{6, 5}, {7, 8}, {3, 3}};
+  for (int g = 0; g < 4; ++g) {
+    for (int s = 0; s < 3; ++s) {
+      const int kernel = kGeometries[g][0];
+      const int stride = kGeometries[g][1];
+      const int pad = kGeometries[g][2];
+      const int height = kSizes[s][0];
+      const int width = kSizes[s][1];
+      this->blob_bottom_->Reshape(2, 3, height, width);
+      FillerParameter filler_param;
+      GaussianFiller<Dtype> filler(filler_param);
+      filler.Fill(this->blob_bottom_);
+      LayerParameter layer_param;
+      PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+      pooling_param->set_kernel_size(kernel);
+      pooling_param->set_stride(stride);
+      pooling_param->set_pad(pad);
+      // Max pooling with a top mask takes the generic loops; compare.
+      pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+      PoolingLayer<Dtype> max_layer(layer_param);
+      max_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      max_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      Blob<Dtype> expected_top;
+      vector<Blob<Dtype>*> masked_top_vec;
+      masked_top_vec.push_back(&expected_top);
+      masked_top_vec.push_back(this->blob_top_mask_);
+      PoolingLayer<Dtype> masked_layer(layer_param);
+      masked_layer.SetUp(this->blob_bottom_vec_, masked_top_vec);
+      masked_layer.Forward(this->blob_bottom_vec_, masked_top_vec);
+      ASSERT_EQ(expected_top.count(), this->blob_top_->count());
+      for (int i = 0; i < expected_top.count(); ++i) {
+        EXPECT_EQ(expected_top.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+      }
+      // Average pooling, against the windows summed here.
+      pooling_param->set_pool(PoolingParameter_PoolMethod_AVE);
+      PoolingLayer<Dtype> ave_layer(layer_param);
+      ave_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      ave_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      const Blob<Dtype>& top = *this->blob_top_;
+      for (int n = 0; n < top.num(); ++n) {
+        for (int c = 0; c < top.channels(); ++c) {
+          for (int ph = 0; ph < top.height(); ++ph) {
+            for (int pw = 0; pw < top.width(); ++pw) {
+              const int hstart = ph * stride - pad;
+              const int wstart = pw * stride - pad;
+              const int pool_size = (std::min(hstart + kernel, height + pad)
+                  - hstart) * (std::min(wstart + kernel, width + pad) - wstart);
+              Dtype sum = 0;
+              for (int h = std::max(hstart, 0);
+                   h < std::min(hstart + kernel, height); ++h) {
+                for (int w = std::max(wstart, 0);
+                     w < std::min(wstart + kernel, width); ++w) {
+                  sum += this->blob_bottom_->data_at(n, c, h, w);
+                }
+              }
+              EXPECT_NEAR(sum / pool_size, top.data_at(n, c, ph, pw), 1e-5);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(PoolingLayerTest, TestGradientAve) {
   typedef typename TypeParam::Dtype Dtype;
   for (int kernel_h = 3; kernel_h <= 4; kernel_h++) {
@@ -0,0 +1,101 @@
+#include <stdint.h>
+
+#include <boost/thread.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/ring_queue.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class RingQueueTest : public ::testing::Test {
+ protected:
+  static void Push(RingQueue<int>* queue, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      queue->push(i);
+    }
+  }
+
+  static void PopSum(RingQueue<int>* queue, int count, int64_t* sum) {
+    for (int i = 0; i < count; ++i) {
+      *sum += queue->pop();
+    }
+  }
+
+  static void PopForever(RingQueue<int>* queue) {
+    for (;;) {
+      queue->pop();
+    }
+  }
+};
+
+TEST_F(RingQueueTest, TestBounds) {
+  RingQueue<int> queue(3, RingQueue<int>::SINGLE_PRODUCER_CONSUMER);
+  EXPECT_EQ(4, queue.capacity());
+  int value;
+  EXPECT_FALSE(queue.try_pop(&value));
+  EXPECT_FALSE(queue.try_peek(&value));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.try_push(i));
+  }
+  EXPECT_FALSE(queue.try_push(4));
+  EXPECT_EQ(4, queue.size());
+  EXPECT_EQ(0, queue.peek());
+  EXPECT_TRUE(queue.try_pop(&value));
+  EXPECT_EQ(0, value);
+  EXPECT_TRUE(queue.try_push(4));
+  for (int i = 1; i <= 4; ++i) {
+    EXPECT_TRUE(queue.try_peek(&value));
+    EXPECT_EQ(i, value);
+    EXPECT_EQ(i, queue.pop());
+  }
+  EXPECT_EQ(0, queue.size());
+}
+
+TEST_F(RingQueueTest, TestSingleProducerConsumer) {
+  // A queue much smaller than the items makes both sides wait in turn.
+  const int kCount = 100000;
+  RingQueue<int> queue(4, RingQueue<int>::SINGLE_PRODUCER_CONSUMER);
+  boost::thread producer(&RingQueueTest::Push, &queue, 0, kCount);
+  for (int i = 0; i < kCount; ++i) {
+    ASSERT_EQ(i, queue.pop());
+  }
+  producer.join();
+}
+
+TEST_F(RingQueueTest, TestMultipleProducersConsumers) {
+  const int kThreads = 4;
+  const int kCount = 50000;
+  RingQueue<int> queue(16, RingQueue<int>::MULTIPLE_PRODUCERS_CONSUMERS);
+  boost::thread_group threads;
+  std::vector<int64_t> sums(kThreads, 0);
+  for (int i = 0; i < kThreads; ++i) {
+    threads.create_thread(boost::bind(&RingQueueTest::Push, &queue,
+        i * kCount, (i + 1) * kCount));
+    threads.create_thread(boost::bind(&RingQueueTest::PopSum, &queue,
+        kCount, &sums[i]));
+  }
+  threads.join_all();
+  int64_t sum = 0;
+  for (int i = 0; i < kThreads; ++i) {
+    sum += sums[i];
+  }
+  const int64_t total = kThreads * kCount;
+  EXPECT_EQ(total * (total - 1) / 2, sum);
+  EXPECT_EQ(0, queue.size());
+}
+
+TEST_F(RingQueueTest, TestInterruptWaitingPop) {
+  // Threads parked on an empty queue stop like those on a BlockingQueue.
+  RingQueue<int> queue(2, RingQueue<int>::SINGLE_PRODUCER_CONSUMER);
+  boost::thread consumer(&RingQueueTest::PopForever, &queue);
+  queue.push(1);
+  consumer.interrupt();
+  consumer.join();
+}
+
+}  // namespace caffe
@@ -1,3 +1,6 @@
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -9,6 +12,7 @@
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/sgd_solvers.hpp"
 #include "caffe/solver.hpp"
+#include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -106,4 +110,67 @@ TYPED_TEST(SolverTest, TestInitTrainTestNets) {
   EXPECT_TRUE(this->solver_->test_nets()[1]->has_layer("accuracy"));
 }
 
+TYPED_TEST(SolverTest, TestMetricsFile) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+     "base_lr: 0.01 "
+     "lr_policy: 'fixed' "
+     "net_param { "
+     "  name: 'TestNetwork' "
+     "  layer { "
+     "    name: 'data' "
+     "    type: 'DummyData' "
+     "    dummy_data_param { "
+     "      shape { dim: 5 dim: 2 dim: 3 dim: 4 } "
+     "      shape { dim: 5 } "
+     "    } "
+     "    top: 'data' "
+     "    top: 'label' "
+     "  } "
+     "  layer { "
+     "    name: 'innerprod' "
+     "    type: 'InnerProduct' "
+     "    inner_product_param { num_output: 10 } "
+     "    bottom: 'data' "
+     "    top: 'innerprod' "
+     "  } "
+     "  layer { "
+     "    name: 'loss' "
+     "    type: 'SoftmaxWithLoss' "
+     "    bottom: 'innerprod' "
+     "    bottom: 'label' "
+     "  } "
+     "} ";
+  this->InitSolverFromProtoString(proto);
+  string filename;
+  MakeTempFilename(&filename);
+  this->solver_->SetMetricsFile(filename, 2);
+  this->solver_->Step(3);
+  std::map<string, double> metrics;
+  std::ifstream file(filename.c_str());
+  ASSERT_TRUE(file.is_open());
+  string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    string name;
+    double value;
+    fields >> name >> value;
+    ASSERT_FALSE(fields.fail()) << line;
+    metrics[name] = value;
+  }
+  // Written at iteration 2 only.
+  EXPECT_EQ(2, metrics["caffe_solver_iteration"]);
+  EXPECT_FLOAT_EQ(0.01, metrics["caffe_solver_learning_rate"]);
+  EXPECT_GT(metrics["caffe_solver_samples_per_second"], 0);
+  EXPECT_GE(metrics["caffe_solver_forward_seconds"], 0);
+  EXPECT_EQ(0, metrics["caffe_solver_data_wait_seconds"]);
+  EXPECT_GT(metrics["caffe_process_resident_memory_bytes"], 0);
+  // data, label, innerprod and loss plus the weights and bias, with diffs.
+  EXPECT_EQ(2 * (5 * 2 * 3 * 4 + 5 + 5 * 10 + 1 + 10 * 24 + 10) *
+      sizeof(Dtype), metrics["caffe_solver_blob_bytes"]);
+}
+
 }  // namespace caffe
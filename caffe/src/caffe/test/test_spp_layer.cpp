@@ -130,5 +130,45 @@ TYPED_TEST(SPPLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(SPPLayerTest, TestPoolWindows) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_spp_param()->set_pyramid_height(2);
+  Blob<Dtype> features(1, 3, 9, 8);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&features);
+  // The whole map, a window and a single pixel, which is widened to 2 x 2
+  // for the 2 x 2 bins of the second level.
+  const int windows[] = { 0, 0, 8, 7,  1, 2, 6, 6,  3, 3, 3, 3 };
+  const int expected_windows[] = { 0, 0, 8, 7,  1, 2, 6, 6,  3, 3, 4, 4 };
+  Blob<Dtype> pooled;
+  SPPLayer<Dtype>::PoolWindows(layer_param, features,
+      vector<int>(windows, windows + 12), &pooled);
+  EXPECT_EQ(3, pooled.num());
+  for (int i = 0; i < 3; ++i) {
+    // Pool the window alone with an SPP layer.
+    const int* window = expected_windows + 4 * i;
+    Blob<Dtype> crop(1, 3, window[2] - window[0] + 1,
+        window[3] - window[1] + 1);
+    for (int c = 0; c < crop.channels(); ++c) {
+      for (int h = 0; h < crop.height(); ++h) {
+        for (int w = 0; w < crop.width(); ++w) {
+          crop.mutable_cpu_data()[crop.offset(0, c, h, w)] =
+              features.data_at(0, c, h + window[0], w + window[1]);
+        }
+      }
+    }
+    vector<Blob<Dtype>*> crop_vec(1, &crop);
+    SPPLayer<Dtype> layer(layer_param);
+    layer.SetUp(crop_vec, this->blob_top_vec_);
+    layer.Forward(crop_vec, this->blob_top_vec_);
+    ASSERT_EQ(this->blob_top_->count(), pooled.count(1));
+    for (int j = 0; j < this->blob_top_->count(); ++j) {
+      EXPECT_EQ(this->blob_top_->cpu_data()[j],
+          pooled.cpu_data()[i * pooled.count(1) + j]);
+    }
+  }
+}
 
 }  // namespace caffe
@@ -0,0 +1,93 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+ protected:
+  static void Count(vector<int>* counts, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      ++(*counts)[i];
+    }
+  }
+
+  static void Record(boost::mutex* mutex, vector<std::pair<int, int> >* chunks,
+      int begin, int end) {
+    boost::mutex::scoped_lock lock(*mutex);
+    chunks->push_back(std::make_pair(begin, end));
+  }
+
+  static void CountNested(vector<int>* counts, int width, int begin,
+      int end) {
+    for (int i = begin; i < end; ++i) {
+      parallel_for(i * width, (i + 1) * width,
+          boost::bind(&ThreadPoolTest::Count, counts, _1, _2));
+    }
+  }
+};
+
+TEST_F(ThreadPoolTest, TestCoversRange) {
+  ThreadPool pool(4, vector<int>());
+  vector<int> counts(1001, 0);
+  pool.Run(0, counts.size(), 1,
+      boost::bind(&ThreadPoolTest::Count, &counts, _1, _2));
+  for (int i = 0; i < counts.size(); ++i) {
+    EXPECT_EQ(1, counts[i]) << i;
+  }
+  // Empty ranges call nothing.
+  pool.Run(5, 5, 1, boost::bind(&ThreadPoolTest::Count, &counts, _1, _2));
+  EXPECT_EQ(1, counts[5]);
+}
+
+TEST_F(ThreadPoolTest, TestChunks) {
+  ThreadPool pool(4, vector<int>());
+  boost::mutex mutex;
+  vector<std::pair<int, int> > chunks;
+  pool.Run(10, 110, 1, boost::bind(&ThreadPoolTest::Record, &mutex, &chunks,
+      _1, _2));
+  std::sort(chunks.begin(), chunks.end());
+  ASSERT_EQ(4, chunks.size());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(10 + i * 25, chunks[i].first);
+    EXPECT_EQ(35 + i * 25, chunks[i].second);
+  }
+  // No chunk is shorter than the grain, so small loops run in one.
+  chunks.clear();
+  pool.Run(0, 100, 40, boost::bind(&ThreadPoolTest::Record, &mutex, &chunks,
+      _1, _2));
+  EXPECT_EQ(3, chunks.size());
+  chunks.clear();
+  pool.Run(0, 30, 40, boost::bind(&ThreadPoolTest::Record, &mutex, &chunks,
+      _1, _2));
+  ASSERT_EQ(1, chunks.size());
+  EXPECT_EQ(0, chunks[0].first);
+  EXPECT_EQ(30, chunks[0].second);
+}
+
+TEST_F(ThreadPoolTest, TestNestedLoopsRunSerially) {
+  Caffe::set_num_threads(3);
+  EXPECT_EQ(3, Caffe::num_threads());
+  EXPECT_EQ(3, Caffe::thread_pool().num_threads());
+  const int kWidth = 50;
+  vector<int> counts(20 * kWidth, 0);
+  parallel_for(0, 20, boost::bind(&ThreadPoolTest::CountNested, &counts,
+      kWidth, _1, _2));
+  for (int i = 0; i < counts.size(); ++i) {
+    EXPECT_EQ(1, counts[i]) << i;
+  }
+  Caffe::set_num_threads(0);
+  EXPECT_EQ(std::max<int>(boost::thread::hardware_concurrency(), 1),
+      Caffe::num_threads());
+}
+
+}  // namespace caffe
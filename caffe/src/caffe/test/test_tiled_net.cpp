@@ -0,0 +1,115 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/tiled_net.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class TiledNetTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  TiledNetTest() : seed_(1701) {}
+
+  virtual void SetUp() {
+    // Downsamples by 2 with a ceil mode pooling and upsamples back.
+    const string proto =
+        "name: 'TiledNetTestNet' "
+        "input: 'data' "
+        "input_shape { dim: 1 dim: 2 dim: 20 dim: 20 } "
+        "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } } } "
+        "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+        "layer { name: 'pool1' type: 'Pooling' bottom: 'conv1' top: 'pool1' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } } "
+        "layer { name: 'conv2' type: 'Convolution' bottom: 'pool1' "
+        "  top: 'conv2' "
+        "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } } } "
+        "layer { name: 'deconv' type: 'Deconvolution' bottom: 'conv2' "
+        "  top: 'deconv' "
+        "  convolution_param { num_output: 3 kernel_size: 4 stride: 2 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } } } "
+        "layer { name: 'conv3' type: 'Convolution' bottom: 'deconv' "
+        "  top: 'conv3' "
+        "  convolution_param { num_output: 2 kernel_size: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } } } ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+    param_.mutable_state()->set_phase(TEST);
+    Caffe::set_random_seed(this->seed_);
+    net_.reset(new Net<Dtype>(param_));
+  }
+
+  // Runs input through the whole net and through tiled, and checks that
+  // they agree.
+  void CheckMatchesWholeInput(TiledNet<Dtype>* tiled, int num, int height,
+      int width) {
+    Blob<Dtype> input(num, 2, height, width);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&input);
+    vector<Blob<Dtype>*> bottom(1, &input);
+    net_->input_blobs()[0]->ReshapeLike(input);
+    net_->Reshape();
+    const Blob<Dtype>& expected = *net_->Forward(bottom)[0];
+    Blob<Dtype> actual;
+    tiled->Forward(input, &actual);
+    EXPECT_GT(tiled->num_tiles(), 1);
+    ASSERT_EQ(expected.shape(), actual.shape());
+    for (int i = 0; i < actual.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i], 1e-4);
+    }
+  }
+
+  int seed_;
+  NetParameter param_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(TiledNetTest, TestDtypesAndDevices);
+
+TYPED_TEST(TiledNetTest, TestReceptiveField) {
+  typedef typename TypeParam::Dtype Dtype;
+  TiledNet<Dtype> tiled(this->param_, *this->net_, 1 << 20);
+  for (int axis = 0; axis < 2; ++axis) {
+    // conv1, pool1 and conv2 reach 8 pixels at stride 2 from offset -3; the
+    // deconvolution halves the stride and widens the field by 3 more.
+    const ReceptiveField& field = tiled.receptive_field(axis);
+    EXPECT_NEAR(1, field.step, 1e-6);
+    EXPECT_NEAR(-5, field.offset, 1e-6);
+    EXPECT_NEAR(11, field.extent, 1e-6);
+  }
+  EXPECT_EQ(2, tiled.alignment());
+}
+
+TYPED_TEST(TiledNetTest, TestMatchesWholeInput) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A budget for tiles of roughly 20 x 20 pixels.
+  TiledNet<Dtype> tiled(this->param_, *this->net_, 400 * 60 * sizeof(Dtype));
+  EXPECT_LT(tiled.tile_height(), 37);
+  EXPECT_EQ(0, tiled.tile_height() % tiled.alignment());
+  EXPECT_EQ(tiled.tile_height(), tiled.tile_width());
+  this->CheckMatchesWholeInput(&tiled, 1, 37, 41);
+}
+
+TYPED_TEST(TiledNetTest, TestMatchesWholeInputInParallel) {
+  typedef typename TypeParam::Dtype Dtype;
+  TiledNet<Dtype> tiled(this->param_, *this->net_, 1 << 20, 3);
+  tiled.set_tile_size(16, 18);
+  this->CheckMatchesWholeInput(&tiled, 2, 45, 38);
+}
+
+}  // namespace caffe
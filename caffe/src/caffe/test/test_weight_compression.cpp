@@ -0,0 +1,164 @@
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/weight_compression.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+TEST(WeightCompressionTest, TestHalfConversion) {
+  // Values a half holds exactly, including its largest and smallest.
+  const float exact[] = { 0, 1, -2.5, 0.0999755859375, 65504,
+      6.103515625e-05, 5.9604644775390625e-08 };
+  for (int i = 0; i < sizeof(exact) / sizeof(exact[0]); ++i) {
+    EXPECT_EQ(exact[i], HalfToFloat(FloatToHalf(exact[i])));
+    EXPECT_EQ(-exact[i], HalfToFloat(FloatToHalf(-exact[i])));
+  }
+  EXPECT_EQ(0x3c00, FloatToHalf(1));
+  EXPECT_EQ(0xc000, FloatToHalf(-2));
+  // Ties round to the even mantissa.
+  EXPECT_EQ(0x3c00, FloatToHalf(1 + std::pow(2.0f, -11)));
+  EXPECT_EQ(0x3c02, FloatToHalf(1 + 3 * std::pow(2.0f, -11)));
+  // Overflow goes to infinity, and NaNs stay NaNs.
+  EXPECT_EQ(0x7c00, FloatToHalf(1e6));
+  EXPECT_TRUE(std::isinf(HalfToFloat(0xfc00)));
+  EXPECT_TRUE(std::isnan(HalfToFloat(FloatToHalf(std::sqrt(-1.0f)))));
+  // Every other value is within half a unit in the last place.
+  for (float value = -3; value < 3; value += 0.001) {
+    EXPECT_NEAR(value, HalfToFloat(FloatToHalf(value)),
+        std::fabs(value) * std::pow(2.0f, -11) + 1e-7);
+  }
+}
+
+template <typename Dtype>
+class WeightCompressionTest : public ::testing::Test {
+ protected:
+  WeightCompressionTest() : blob_(new Blob<Dtype>(20, 10, 3, 3)) {
+    FillerParameter filler_param;
+    filler_param.set_std(0.1);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_);
+  }
+  virtual ~WeightCompressionTest() { delete blob_; }
+
+  Blob<Dtype>* const blob_;
+};
+
+TYPED_TEST_CASE(WeightCompressionTest, TestDtypes);
+
+TYPED_TEST(WeightCompressionTest, TestFP16) {
+  EncodedWeights encoded;
+  const double error = EncodeWeights(*this->blob_, WEIGHT_FP16, &encoded);
+  EXPECT_EQ(this->blob_->count(), encoded.halves.size());
+  EXPECT_LT(error, 1e-3);
+  Blob<TypeParam> decoded;
+  DecodeWeights(encoded, &decoded);
+  ASSERT_TRUE(decoded.shape() == this->blob_->shape());
+  for (int i = 0; i < decoded.count(); ++i) {
+    EXPECT_NEAR(this->blob_->cpu_data()[i], decoded.cpu_data()[i], 1e-3);
+  }
+}
+
+TYPED_TEST(WeightCompressionTest, TestLinear8) {
+  typedef TypeParam Dtype;
+  EncodedWeights encoded;
+  EncodeWeights(*this->blob_, WEIGHT_LINEAR8, &encoded);
+  EXPECT_EQ(this->blob_->count(), encoded.codes.size());
+  ASSERT_EQ(kWeightCodebookSize, encoded.codebook.size());
+  const Dtype step = (encoded.codebook.back() - encoded.codebook.front()) /
+      (kWeightCodebookSize - 1);
+  Blob<Dtype> decoded;
+  DecodeWeights(encoded, &decoded);
+  for (int i = 0; i < decoded.count(); ++i) {
+    EXPECT_NEAR(this->blob_->cpu_data()[i], decoded.cpu_data()[i],
+        step / 2 + 1e-6);
+  }
+}
+
+TYPED_TEST(WeightCompressionTest, TestKMeans8) {
+  EncodedWeights linear;
+  const double linear_error =
+      EncodeWeights(*this->blob_, WEIGHT_LINEAR8, &linear);
+  EncodedWeights kmeans;
+  const double kmeans_error =
+      EncodeWeights(*this->blob_, WEIGHT_KMEANS8, &kmeans);
+  // Gaussian weights are dense around 0, where k-means puts its values.
+  EXPECT_LT(kmeans_error, linear_error);
+  EXPECT_LT(kmeans_error, 0.01);
+}
+
+TYPED_TEST(WeightCompressionTest, TestKMeans8FewValues) {
+  // Weights that take fewer values than the codebook decode exactly.
+  TypeParam* data = this->blob_->mutable_cpu_data();
+  for (int i = 0; i < this->blob_->count(); ++i) {
+    data[i] = (i * 7 % 50) * 0.125 - 3;
+  }
+  EncodedWeights encoded;
+  EXPECT_EQ(0, EncodeWeights(*this->blob_, WEIGHT_KMEANS8, &encoded));
+  Blob<TypeParam> decoded;
+  DecodeWeights(encoded, &decoded);
+  for (int i = 0; i < decoded.count(); ++i) {
+    EXPECT_EQ(this->blob_->cpu_data()[i], decoded.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(WeightCompressionTest, TestNetRoundTrip) {
+  typedef TypeParam Dtype;
+  const string proto =
+      "name: 'WeightCompressionTestNet' "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 30 } "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'data' top: 'ip1' "
+      "  inner_product_param { num_output: 20 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'ip1' top: 'ip2' "
+      "  inner_product_param { num_output: 20 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Caffe::set_random_seed(1701);
+  Net<Dtype> net(param);
+  map<string, WeightEncoding> encodings;
+  encodings["ip1"] = WEIGHT_KMEANS8;
+  string filename;
+  MakeTempFilename(&filename);
+  net.ToCompressedHDF5(filename, encodings);
+  Net<Dtype> loaded(param);
+  loaded.CopyTrainedLayersFromHDF5(filename);
+  // The weights of ip1 are decoded from k-means codes; its bias, smaller
+  // than a codebook, and all of ip2 are exact.
+  EncodedWeights encoded;
+  EncodeWeights(*net.layers()[0]->blobs()[0], WEIGHT_KMEANS8, &encoded);
+  Blob<Dtype> expected;
+  DecodeWeights(encoded, &expected);
+  const Blob<Dtype>& weights = *loaded.layers()[0]->blobs()[0];
+  ASSERT_TRUE(expected.shape() == weights.shape());
+  for (int i = 0; i < weights.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], weights.cpu_data()[i]);
+  }
+  for (int layer_id = 0; layer_id < 2; ++layer_id) {
+    const int first_exact = layer_id == 0 ? 1 : 0;
+    for (int j = first_exact; j < 2; ++j) {
+      const Blob<Dtype>& source = *net.layers()[layer_id]->blobs()[j];
+      const Blob<Dtype>& target = *loaded.layers()[layer_id]->blobs()[j];
+      ASSERT_EQ(source.count(), target.count());
+      for (int i = 0; i < source.count(); ++i) {
+        EXPECT_EQ(source.cpu_data()[i], target.cpu_data()[i]);
+      }
+    }
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,410 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include "caffe/tiled_net.hpp"
+
+namespace caffe {
+
+// Slack for comparing the fractional positions of receptive fields.
+static const double kEpsilon = 1e-6;
+
+// Reads the kernel size, stride and padding of a Convolution or
+// Deconvolution layer along a spatial axis.
+static void ConvolutionGeometry(const ConvolutionParameter& param, int axis,
+    int* kernel, int* stride, int* pad) {
+  if (param.has_kernel_h() || param.has_kernel_w()) {
+    *kernel = axis == 0 ? param.kernel_h() : param.kernel_w();
+  } else {
+    CHECK_GT(param.kernel_size_size(), 0) << "Missing kernel size.";
+    *kernel = param.kernel_size(param.kernel_size_size() == 1 ? 0 : axis);
+  }
+  if (param.has_stride_h() || param.has_stride_w()) {
+    *stride = axis == 0 ? param.stride_h() : param.stride_w();
+  } else {
+    *stride = param.stride_size() == 0 ? 1 :
+        param.stride(param.stride_size() == 1 ? 0 : axis);
+  }
+  if (param.has_pad_h() || param.has_pad_w()) {
+    *pad = axis == 0 ? param.pad_h() : param.pad_w();
+  } else {
+    *pad = param.pad_size() == 0 ? 0 :
+        param.pad(param.pad_size() == 1 ? 0 : axis);
+  }
+}
+
+// The same for a Pooling layer.
+static void PoolingGeometry(const PoolingParameter& param, int axis,
+    int* kernel, int* stride, int* pad) {
+  CHECK(!param.global_pooling()) << "Global pooling cannot be tiled.";
+  if (param.has_kernel_size()) {
+    *kernel = param.kernel_size();
+  } else {
+    *kernel = axis == 0 ? param.kernel_h() : param.kernel_w();
+  }
+  if (param.has_stride_h() || param.has_stride_w()) {
+    *stride = axis == 0 ? param.stride_h() : param.stride_w();
+  } else {
+    *stride = param.stride();
+  }
+  if (param.has_pad_h() || param.has_pad_w()) {
+    *pad = axis == 0 ? param.pad_h() : param.pad_w();
+  } else {
+    *pad = param.pad();
+  }
+}
+
+// The receptive field of the top of a sliding window over bottom: top pixel
+// j reads bottom pixels [j * stride - pad, j * stride - pad + kernel).
+static ReceptiveField SlidingWindow(const ReceptiveField& bottom, int kernel,
+    int stride, int pad) {
+  ReceptiveField top;
+  top.step = bottom.step * stride;
+  top.offset = bottom.offset - pad * bottom.step;
+  top.extent = bottom.extent + (kernel - 1) * bottom.step;
+  return top;
+}
+
+// The receptive field of the top of a Deconvolution: top pixel j receives
+// bottom pixels i with j + pad - kernel < i * stride <= j + pad.
+static ReceptiveField TransposedWindow(const ReceptiveField& bottom,
+    int kernel, int stride, int pad) {
+  ReceptiveField top;
+  top.step = bottom.step / stride;
+  top.offset = bottom.offset + (pad - kernel + 1) * top.step;
+  top.extent = bottom.extent + (kernel - 1) * top.step;
+  return top;
+}
+
+static int GreatestCommonDivisor(int a, int b) {
+  return b == 0 ? a : GreatestCommonDivisor(b, a % b);
+}
+
+template <typename Dtype>
+TiledNet<Dtype>::TiledNet(const NetParameter& param,
+    const Net<Dtype>& weights, size_t memory_budget, int num_workers) {
+  CHECK_GT(num_workers, 0);
+  for (int i = 0; i < num_workers; ++i) {
+    shared_ptr<Net<Dtype> > net(new Net<Dtype>(param));
+    CHECK_EQ(net->phase(), TEST) << "Only TEST phase nets can be tiled.";
+    CHECK_EQ(net->num_inputs(), 1) << "The net should have one input.";
+    CHECK_EQ(net->num_outputs(), 1) << "The net should have one output.";
+    CHECK_EQ(net->input_blobs()[0]->num_axes(), 4);
+    net->ShareTrainedLayersWith(&weights);
+    nets_.push_back(net);
+  }
+  ComputeReceptiveField(*nets_[0]);
+  // Split the budget between the workers, and give each a square tile.
+  const double pixels =
+      memory_budget / num_workers / BytesPerPixel(*nets_[0]);
+  const int side = static_cast<int>(std::sqrt(pixels)) / alignment_ *
+      alignment_;
+  CHECK_GT(side, 0) << "A memory budget of " << memory_budget
+      << " bytes is too small for " << num_workers << " tiles.";
+  tile_size_[0] = side;
+  tile_size_[1] = side;
+  LOG(INFO) << "Tiling " << param.name() << " with " << side << " x "
+      << side << " tiles on " << num_workers << " workers";
+}
+
+template <typename Dtype>
+void TiledNet<Dtype>::set_tile_size(int height, int width) {
+  CHECK_GT(height, 0);
+  CHECK_GT(width, 0);
+  CHECK_EQ(height % alignment_, 0)
+      << "Tile sizes must be multiples of " << alignment_;
+  CHECK_EQ(width % alignment_, 0)
+      << "Tile sizes must be multiples of " << alignment_;
+  tile_size_[0] = height;
+  tile_size_[1] = width;
+}
+
+template <typename Dtype>
+void TiledNet<Dtype>::ComputeReceptiveField(const Net<Dtype>& net) {
+  std::map<const Blob<Dtype>*, ReceptiveField> fields[2];
+  for (int axis = 0; axis < 2; ++axis) {
+    fields[axis][net.input_blobs()[0]] = ReceptiveField();
+  }
+  alignment_ = 1;
+  for (int i = 0; i < net.layers().size(); ++i) {
+    const LayerParameter& layer_param = net.layers()[i]->layer_param();
+    const string& type = layer_param.type();
+    const vector<Blob<Dtype>*>& bottom = net.bottom_vecs()[i];
+    const vector<Blob<Dtype>*>& top = net.top_vecs()[i];
+    CHECK_GT(bottom.size(), 0) << "Layer " << layer_param.name()
+        << " has no bottoms; the input must be the net's only source.";
+    for (int axis = 0; axis < 2; ++axis) {
+      // Take the union of the fields of the bottoms, which must agree in
+      // their strides.
+      ReceptiveField field = fields[axis][bottom[0]];
+      double end = field.offset + field.extent;
+      for (int j = 1; j < bottom.size(); ++j) {
+        const ReceptiveField& other = fields[axis][bottom[j]];
+        CHECK_LT(std::fabs(other.step - field.step), kEpsilon)
+            << "The bottoms of layer " << layer_param.name()
+            << " have different strides.";
+        field.offset = std::min(field.offset, other.offset);
+        end = std::max(end, other.offset + other.extent);
+      }
+      field.extent = end - field.offset;
+      int kernel, stride, pad;
+      if (type == "Convolution") {
+        ConvolutionGeometry(layer_param.convolution_param(), axis, &kernel,
+            &stride, &pad);
+        field = SlidingWindow(field, kernel, stride, pad);
+      } else if (type == "Deconvolution") {
+        ConvolutionGeometry(layer_param.convolution_param(), axis, &kernel,
+            &stride, &pad);
+        field = TransposedWindow(field, kernel, stride, pad);
+      } else if (type == "Pooling") {
+        PoolingGeometry(layer_param.pooling_param(), axis, &kernel, &stride,
+            &pad);
+        field = SlidingWindow(field, kernel, stride, pad);
+      } else if (type == "LRN" && layer_param.lrn_param().norm_region() ==
+          LRNParameter_NormRegion_WITHIN_CHANNEL) {
+        const int size = layer_param.lrn_param().local_size();
+        field = SlidingWindow(field, size, 1, (size - 1) / 2);
+      } else {
+        for (int j = 0; j < top.size(); ++j) {
+          CHECK(top[j]->num_axes() == 4 &&
+              top[j]->shape(2 + axis) == bottom[0]->shape(2 + axis))
+              << "Layer " << layer_param.name() << " of type " << type
+              << " changes the spatial shape and cannot be tiled.";
+        }
+      }
+      // Tiles must start on the pixel grid of every blob.
+      if (field.step >= 1) {
+        const int step = static_cast<int>(field.step + 0.5);
+        CHECK_LT(std::fabs(field.step - step), kEpsilon)
+            << "Layer " << layer_param.name() << " has a fractional stride.";
+        alignment_ = alignment_ / GreatestCommonDivisor(alignment_, step) *
+            step;
+      } else {
+        const double upsampling = 1 / field.step;
+        CHECK_LT(std::fabs(upsampling - static_cast<int>(upsampling + 0.5)),
+            kEpsilon) << "Layer " << layer_param.name()
+            << " has a fractional stride.";
+      }
+      for (int j = 0; j < top.size(); ++j) {
+        CHECK_EQ(top[j]->num_axes(), 4) << "Layer " << layer_param.name()
+            << " is not fully convolutional.";
+        fields[axis][top[j]] = field;
+      }
+    }
+  }
+  for (int axis = 0; axis < 2; ++axis) {
+    field_[axis] = fields[axis][net.output_blobs()[0]];
+    LOG(INFO) << "Receptive field along axis " << axis << ": extent "
+        << field_[axis].extent << ", stride " << field_[axis].step
+        << ", offset " << field_[axis].offset;
+  }
+}
+
+template <typename Dtype>
+double TiledNet<Dtype>::BytesPerPixel(const Net<Dtype>& net) const {
+  double count = 0;
+  for (int i = 0; i < net.blobs().size(); ++i) {
+    count += net.blobs()[i]->count();
+  }
+  // Each convolution also keeps a column buffer of kernel size times its
+  // spatial output, or its spatial input for deconvolutions.
+  for (int i = 0; i < net.layers().size(); ++i) {
+    const string& type = net.layers()[i]->type();
+    if (type != "Convolution" && type != "Deconvolution") {
+      continue;
+    }
+    const Blob<Dtype>* bottom = net.bottom_vecs()[i][0];
+    const Blob<Dtype>* top = net.top_vecs()[i][0];
+    const bool deconv = type == "Deconvolution";
+    const Blob<Dtype>* col = deconv ? bottom : top;
+    const int channels = deconv ? top->channels() : bottom->channels();
+    const Blob<Dtype>& weights = *net.layers()[i]->blobs()[0];
+    count += static_cast<double>(channels) * weights.count(2) *
+        col->count(2);
+  }
+  const Blob<Dtype>& input = *net.input_blobs()[0];
+  return count * sizeof(Dtype) / (input.num() * input.count(2));
+}
+
+template <typename Dtype>
+void TiledNet<Dtype>::PlanAxis(int axis, int size) {
+  const ReceptiveField& field = field_[axis];
+  const int tile = tile_size_[axis];
+  AxisTiles& tiles = tiles_[axis];
+  tiles.start.clear();
+  tiles.length.clear();
+  tiles.own_begin.clear();
+  tiles.own_end.clear();
+  // The output pixels of an inner tile whose receptive fields lie within it.
+  const int valid_begin = std::max(0,
+      static_cast<int>(std::ceil(-field.offset / field.step - kEpsilon)));
+  const int valid_end = static_cast<int>(std::floor(
+      (tile - field.extent - field.offset) / field.step + kEpsilon)) + 1;
+  // Advance by as much as keeps the valid outputs of neighbours touching.
+  const int advance = static_cast<int>(
+      (valid_end - valid_begin) * field.step + kEpsilon) / alignment_ *
+      alignment_;
+  int start = 0;
+  for (;;) {
+    if (start > 0) {
+      const int own = static_cast<int>(start / field.step + 0.5) +
+          valid_begin;
+      tiles.own_end.push_back(own);
+      tiles.own_begin.push_back(own);
+    } else {
+      tiles.own_begin.push_back(0);
+    }
+    tiles.start.push_back(start);
+    if (start + tile >= size) {
+      tiles.length.push_back(size - start);
+      // Set by Forward() from the output of the last tile.
+      tiles.own_end.push_back(-1);
+      break;
+    }
+    CHECK_GT(advance, 0) << "Tiles of " << tile << " pixels are too small "
+        << "for a receptive field of " << field.extent << " pixels.";
+    tiles.length.push_back(tile);
+    int next = start + advance;
+    if (next + tile >= size) {
+      // Keep the last tile long, moving it back to the first aligned start
+      // that still reaches the end.
+      next = (size - tile + alignment_ - 1) / alignment_ * alignment_;
+    }
+    start = next;
+  }
+}
+
+template <typename Dtype>
+void TiledNet<Dtype>::ReshapeNet(Net<Dtype>* net, int height, int width) {
+  Blob<Dtype>* input = net->input_blobs()[0];
+  if (input->num() == 1 && input->height() == height &&
+      input->width() == width) {
+    return;
+  }
+  input->Reshape(1, input->channels(), height, width);
+  net->Reshape();
+}
+
+template <typename Dtype>
+void TiledNet<Dtype>::Forward(const Blob<Dtype>& input, Blob<Dtype>* output) {
+  CHECK_EQ(input.num_axes(), 4);
+  CHECK_EQ(input.channels(), nets_[0]->input_blobs()[0]->channels());
+  PlanAxis(0, input.height());
+  PlanAxis(1, input.width());
+  // The size of the output follows from the output of the last tiles.
+  ReshapeNet(nets_[0].get(), tiles_[0].length.back(),
+      tiles_[1].length.back());
+  const Blob<Dtype>& last = *nets_[0]->output_blobs()[0];
+  CHECK_EQ(last.num_axes(), 4);
+  vector<int> output_shape(2);
+  output_shape[0] = input.num();
+  output_shape[1] = last.channels();
+  for (int axis = 0; axis < 2; ++axis) {
+    AxisTiles& tiles = tiles_[axis];
+    tiles.own_end.back() = static_cast<int>(
+        tiles.start.back() / field_[axis].step + 0.5) + last.shape(2 + axis);
+    output_shape.push_back(tiles.own_end.back());
+  }
+  output->Reshape(output_shape);
+  // Touch the shared weights and the data here, as the workers reading them
+  // concurrently must not sync them.
+  const Caffe::Brew mode = Caffe::mode();
+  const vector<Blob<Dtype>*>& params = nets_[0]->learnable_params();
+  for (int i = 0; i < params.size(); ++i) {
+    if (mode == Caffe::GPU) {
+      params[i]->gpu_data();
+    } else {
+      params[i]->cpu_data();
+    }
+  }
+  const Dtype* input_data = input.cpu_data();
+  Dtype* output_data = output->mutable_cpu_data();
+  int device = 0;
+#ifndef CPU_ONLY
+  if (mode == Caffe::GPU) {
+    CUDA_CHECK(cudaGetDevice(&device));
+  }
+#endif
+  if (nets_.size() == 1) {
+    RunTiles(0, mode, device, input.shape(), input_data, output_shape,
+        output_data);
+    return;
+  }
+  boost::thread_group workers;
+  for (int i = 0; i < nets_.size(); ++i) {
+    workers.create_thread(boost::bind(&TiledNet<Dtype>::RunTiles, this, i,
+        mode, device, input.shape(), input_data, output_shape, output_data));
+  }
+  workers.join_all();
+}
+
+template <typename Dtype>
+void TiledNet<Dtype>::RunTiles(int worker, Caffe::Brew mode, int device,
+    const vector<int>& input_shape, const Dtype* input_data,
+    const vector<int>& output_shape, Dtype* output_data) {
+  // The Caffe mode is per thread.
+#ifndef CPU_ONLY
+  if (mode == Caffe::GPU) {
+    CUDA_CHECK(cudaSetDevice(device));
+  }
+#endif
+  Caffe::set_mode(mode);
+  Net<Dtype>* net = nets_[worker].get();
+  const int channels = input_shape[1];
+  const int height = input_shape[2];
+  const int width = input_shape[3];
+  const int tiles_x = tiles_[1].start.size();
+  const int tiles_per_image = num_tiles();
+  const int num_tasks = input_shape[0] * tiles_per_image;
+  for (int task = worker; task < num_tasks; task += nets_.size()) {
+    const int n = task / tiles_per_image;
+    const int y = task % tiles_per_image / tiles_x;
+    const int x = task % tiles_x;
+    const int start_y = tiles_[0].start[y];
+    const int start_x = tiles_[1].start[x];
+    const int length_y = tiles_[0].length[y];
+    const int length_x = tiles_[1].length[x];
+    ReshapeNet(net, length_y, length_x);
+    Dtype* tile = net->input_blobs()[0]->mutable_cpu_data();
+    for (int c = 0; c < channels; ++c) {
+      for (int h = 0; h < length_y; ++h) {
+        const Dtype* row = input_data +
+            ((n * channels + c) * height + start_y + h) * width + start_x;
+        std::copy(row, row + length_x, tile + (c * length_y + h) * length_x);
+      }
+    }
+    net->ForwardPrefilled();
+    // Copy out the output pixels the tile owns.
+    const Blob<Dtype>& out = *net->output_blobs()[0];
+    const int origin_y =
+        static_cast<int>(start_y / field_[0].step + 0.5);
+    const int origin_x =
+        static_cast<int>(start_x / field_[1].step + 0.5);
+    const int begin_y = tiles_[0].own_begin[y];
+    const int end_y = tiles_[0].own_end[y];
+    const int begin_x = tiles_[1].own_begin[x];
+    const int end_x = tiles_[1].own_end[x];
+    CHECK_LE(end_y - origin_y, out.height());
+    CHECK_LE(end_x - origin_x, out.width());
+    const Dtype* out_data = out.cpu_data();
+    const int out_channels = output_shape[1];
+    for (int c = 0; c < out_channels; ++c) {
+      for (int h = begin_y; h < end_y; ++h) {
+        const Dtype* row = out_data +
+            (c * out.height() + h - origin_y) * out.width() +
+            begin_x - origin_x;
+        std::copy(row, row + end_x - begin_x, output_data +
+            ((n * out_channels + c) * output_shape[2] + h) * output_shape[3] +
+            begin_x);
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(TiledNet);
+
+}  // namespace caffe
@@ -0,0 +1,295 @@
+#include <boost/thread.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/layer.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/util/autotune.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
+
+namespace caffe {
+
+// Guards the process-wide cache: nets may be initialised from several
+// solver threads at once.
+static boost::mutex autotune_cache_mutex_;
+
+// The engine enums of all layer parameters share their values, so the
+// autotuner handles engines as ints.
+static const int kEngineDefault = ConvolutionParameter_Engine_DEFAULT;
+static const int kEngineCaffe = ConvolutionParameter_Engine_CAFFE;
+#ifdef USE_CUDNN
+static const int kEngineCuDNN = ConvolutionParameter_Engine_CUDNN;
+#endif
+
+// The number of timed forward-backward passes per candidate engine.
+static const int kAutotuneIterations = 5;
+
+AutotuneCache& AutotuneCache::Get() {
+  static AutotuneCache cache;
+  return cache;
+}
+
+bool AutotuneCache::Lookup(const string& key, int* engine) {
+  boost::mutex::scoped_lock lock(autotune_cache_mutex_);
+  const string& filename = Caffe::autotune_cache();
+  if (filename.size() && filename != loaded_filename_) {
+    Load(filename);
+  }
+  const std::map<string, int>& machine = entries_[MachineFingerprint()];
+  std::map<string, int>::const_iterator it = machine.find(key);
+  if (it == machine.end()) {
+    return false;
+  }
+  *engine = it->second;
+  return true;
+}
+
+void AutotuneCache::Insert(const string& key, int engine) {
+  boost::mutex::scoped_lock lock(autotune_cache_mutex_);
+  entries_[MachineFingerprint()][key] = engine;
+  const string& filename = Caffe::autotune_cache();
+  if (filename.size()) {
+    Save(filename);
+  }
+}
+
+void AutotuneCache::Load(const string& filename) {
+  entries_.clear();
+  loaded_filename_ = filename;
+  std::ifstream file(filename.c_str());
+  if (!file.is_open()) {
+    LOG(INFO) << "Starting a new autotune cache " << filename;
+    return;
+  }
+  string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    string fingerprint, key, engine;
+    if (!std::getline(fields, fingerprint, '\t') ||
+        !std::getline(fields, key, '\t') ||
+        !std::getline(fields, engine)) {
+      LOG(WARNING) << "Ignoring malformed autotune cache line: " << line;
+      continue;
+    }
+    entries_[fingerprint][key] = atoi(engine.c_str());
+  }
+}
+
+void AutotuneCache::Save(const string& filename) const {
+  const string tmp_filename = filename + ".tmp";
+  {
+    std::ofstream file(tmp_filename.c_str());
+    CHECK(file.is_open()) << "Failed to open " << tmp_filename;
+    for (std::map<string, std::map<string, int> >::const_iterator it =
+         entries_.begin(); it != entries_.end(); ++it) {
+      for (std::map<string, int>::const_iterator jt = it->second.begin();
+           jt != it->second.end(); ++jt) {
+        file << it->first << '\t' << jt->first << '\t' << jt->second << '\n';
+      }
+    }
+  }
+  CHECK_EQ(std::rename(tmp_filename.c_str(), filename.c_str()), 0)
+      << "Failed to write autotune cache " << filename;
+}
+
+string AutotuneCache::MachineFingerprint() {
+  static string fingerprint;
+  if (fingerprint.empty()) {
+    string cpu_model = "unknown cpu";
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    string line;
+    while (std::getline(cpuinfo, line)) {
+      if (line.compare(0, 10, "model name") == 0) {
+        const size_t colon = line.find(':');
+        if (colon != string::npos && colon + 2 <= line.size()) {
+          cpu_model = line.substr(colon + 2);
+        }
+        break;
+      }
+    }
+    std::ostringstream stream;
+    stream << cpu_model << " x" << boost::thread::hardware_concurrency();
+    fingerprint = stream.str();
+  }
+  if (Caffe::mode() == Caffe::CPU) {
+    return fingerprint;
+  }
+#ifndef CPU_ONLY
+  int device;
+  cudaDeviceProp prop;
+  CUDA_CHECK(cudaGetDevice(&device));
+  CUDA_CHECK(cudaGetDeviceProperties(&prop, device));
+  return fingerprint + " / " + prop.name;
+#else
+  NO_GPU;
+  return fingerprint;
+#endif
+}
+
+// Returns false if the layer type has no engine choice.
+static bool GetEngine(const LayerParameter& param, int* engine) {
+  const string& type = param.type();
+  if (type == "Convolution") {
+    *engine = param.convolution_param().engine();
+  } else if (type == "Pooling") {
+    *engine = param.pooling_param().engine();
+  } else if (type == "LRN") {
+    *engine = param.lrn_param().engine();
+  } else if (type == "ReLU") {
+    *engine = param.relu_param().engine();
+  } else if (type == "Sigmoid") {
+    *engine = param.sigmoid_param().engine();
+  } else if (type == "Softmax") {
+    *engine = param.softmax_param().engine();
+  } else if (type == "TanH") {
+    *engine = param.tanh_param().engine();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static void SetEngine(int engine, LayerParameter* param) {
+  const string& type = param->type();
+  if (type == "Convolution") {
+    param->mutable_convolution_param()->set_engine(
+        static_cast<ConvolutionParameter_Engine>(engine));
+  } else if (type == "Pooling") {
+    param->mutable_pooling_param()->set_engine(
+        static_cast<PoolingParameter_Engine>(engine));
+  } else if (type == "LRN") {
+    param->mutable_lrn_param()->set_engine(
+        static_cast<LRNParameter_Engine>(engine));
+  } else if (type == "ReLU") {
+    param->mutable_relu_param()->set_engine(
+        static_cast<ReLUParameter_Engine>(engine));
+  } else if (type == "Sigmoid") {
+    param->mutable_sigmoid_param()->set_engine(
+        static_cast<SigmoidParameter_Engine>(engine));
+  } else if (type == "Softmax") {
+    param->mutable_softmax_param()->set_engine(
+        static_cast<SoftmaxParameter_Engine>(engine));
+  } else if (type == "TanH") {
+    param->mutable_tanh_param()->set_engine(
+        static_cast<TanHParameter_Engine>(engine));
+  } else {
+    LOG(FATAL) << "Layer type " << type << " has no engine to set.";
+  }
+}
+
+template <typename Dtype>
+string LayerAutotuner<Dtype>::Key(const vector<Blob<Dtype>*>& bottom,
+    const LayerParameter& param) {
+  // Keep only what determines the computation.
+  LayerParameter stripped(param);
+  stripped.clear_name();
+  stripped.clear_bottom();
+  stripped.clear_top();
+  stripped.clear_phase();
+  stripped.clear_loss_weight();
+  stripped.clear_param();
+  stripped.clear_blobs();
+  stripped.clear_propagate_down();
+  stripped.clear_include();
+  stripped.clear_exclude();
+  SetEngine(kEngineDefault, &stripped);
+  std::ostringstream key;
+  key << (sizeof(Dtype) == sizeof(float) ? "float" : "double");
+  for (int i = 0; i < bottom.size(); ++i) {
+    key << " " << bottom[i]->shape_string();
+  }
+  key << " " << stripped.ShortDebugString();
+  return key.str();
+}
+
+template <typename Dtype>
+double LayerAutotuner<Dtype>::TimeEngine(const vector<Blob<Dtype>*>& bottom,
+    int num_top, const LayerParameter& param) {
+  // Run on copies so that in-place layers leave the net's blobs untouched.
+  vector<shared_ptr<Blob<Dtype> > > blobs;
+  vector<Blob<Dtype>*> bottom_copy;
+  vector<Blob<Dtype>*> top;
+  for (int i = 0; i < bottom.size(); ++i) {
+    blobs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    blobs.back()->ReshapeLike(*bottom[i]);
+    caffe_rng_gaussian<Dtype>(blobs.back()->count(), Dtype(0), Dtype(1),
+        blobs.back()->mutable_cpu_data());
+    bottom_copy.push_back(blobs.back().get());
+  }
+  for (int i = 0; i < num_top; ++i) {
+    blobs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    top.push_back(blobs.back().get());
+  }
+  shared_ptr<Layer<Dtype> > layer = LayerRegistry<Dtype>::CreateLayer(param);
+  layer->SetUp(bottom_copy, top);
+  const vector<bool> propagate_down(bottom_copy.size(), true);
+  // Warm up so that workspace allocation is not timed.
+  layer->Forward(bottom_copy, top);
+  for (int i = 0; i < top.size(); ++i) {
+    caffe_rng_gaussian<Dtype>(top[i]->count(), Dtype(0), Dtype(1),
+        top[i]->mutable_cpu_diff());
+  }
+  layer->Backward(top, propagate_down, bottom_copy);
+  Timer timer;
+  timer.Start();
+  for (int i = 0; i < kAutotuneIterations; ++i) {
+    layer->Forward(bottom_copy, top);
+    layer->Backward(top, propagate_down, bottom_copy);
+  }
+  return timer.MicroSeconds() / kAutotuneIterations;
+}
+
+template <typename Dtype>
+bool LayerAutotuner<Dtype>::Tune(const vector<Blob<Dtype>*>& bottom,
+    int num_top, LayerParameter* param) {
+  int engine;
+  if (!GetEngine(*param, &engine) || engine != kEngineDefault) {
+    return false;
+  }
+  vector<int> candidates(1, kEngineCaffe);
+#ifdef USE_CUDNN
+  if (Caffe::mode() == Caffe::GPU) {
+    candidates.push_back(kEngineCuDNN);
+  }
+#endif
+  if (candidates.size() < 2) {
+    return false;
+  }
+  const string key = Key(bottom, *param);
+  if (AutotuneCache::Get().Lookup(key, &engine)) {
+    LOG_IF(INFO, Caffe::root_solver()) << "Autotune cache hit for "
+        << param->name() << ": engine " << engine;
+    SetEngine(engine, param);
+    return true;
+  }
+  // Timing fills blobs and weights from the RNG; restore it afterwards so
+  // that tuning does not change the initialization of the net.
+  const rng_t rng_state = *caffe_rng();
+  double best_time = -1;
+  for (int i = 0; i < candidates.size(); ++i) {
+    LayerParameter candidate_param(*param);
+    SetEngine(candidates[i], &candidate_param);
+    const double time = TimeEngine(bottom, num_top, candidate_param);
+    LOG_IF(INFO, Caffe::root_solver()) << "Autotuning " << param->name()
+        << ": engine " << candidates[i] << " takes " << time << " us";
+    if (best_time < 0 || time < best_time) {
+      best_time = time;
+      engine = candidates[i];
+    }
+  }
+  *caffe_rng() = rng_state;
+  AutotuneCache::Get().Insert(key, engine);
+  SetEngine(engine, param);
+  return true;
+}
+
+INSTANTIATE_CLASS(LayerAutotuner);
+
+}  // namespace caffe
@@ -0,0 +1,232 @@
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "caffe/common.hpp"
+#include "caffe/util/broadcast_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Loops over fewer elements than this run on the calling thread alone, as
+// waking the pool would cost more than it saves.
+static const int kParallelMinCount = 1 << 15;
+// The columns AxisReduce sums at a time when the inner dimension is 1.
+static const int kReduceBlockSize = 256;
+
+// Runs body over [0, num_items) of size elements each, in parallel if the
+// loop is long enough.
+template <typename Body>
+static inline void run(const int num_items, const int size, const Body& body) {
+  if (static_cast<int64_t>(num_items) * size < kParallelMinCount) {
+    body(0, num_items);
+  } else {
+    parallel_for(0, num_items, body,
+        std::max(1, kParallelMinCount / std::max(size, 1)));
+  }
+}
+
+struct AddOp {
+  template <typename Dtype>
+  static inline Dtype Apply(Dtype x, Dtype v, Dtype alpha) {
+    return x + alpha * v;
+  }
+};
+
+struct MulOp {
+  template <typename Dtype>
+  static inline Dtype Apply(Dtype x, Dtype v, Dtype alpha) { return x * v; }
+};
+
+struct DivOp {
+  template <typename Dtype>
+  static inline Dtype Apply(Dtype x, Dtype v, Dtype alpha) { return x / v; }
+};
+
+// Applies Op over rows [begin, end) of the outer x dim x inner view. With an
+// inner axis the rows are the outer * dim runs of inner elements that share
+// one value of v; without one they are the outer runs of dim elements that
+// take all of v.
+template <typename Dtype, typename Op>
+class Broadcast {
+ public:
+  Broadcast(int dim, int inner, Dtype alpha, const Dtype* v, const Dtype* x,
+      Dtype* y) : dim_(dim), inner_(inner), alpha_(alpha), v_(v), x_(x),
+      y_(y) {}
+
+  void operator()(int begin, int end) const {
+    if (inner_ == 1) {
+      for (int o = begin; o < end; ++o) {
+        const Dtype* x = x_ + o * dim_;
+        Dtype* y = y_ + o * dim_;
+        for (int d = 0; d < dim_; ++d) {
+          y[d] = Op::Apply(x[d], v_[d], alpha_);
+        }
+      }
+    } else {
+      for (int row = begin; row < end; ++row) {
+        const Dtype v = v_[row % dim_];
+        const Dtype* x = x_ + row * inner_;
+        Dtype* y = y_ + row * inner_;
+        for (int i = 0; i < inner_; ++i) {
+          y[i] = Op::Apply(x[i], v, alpha_);
+        }
+      }
+    }
+  }
+
+ private:
+  const int dim_;
+  const int inner_;
+  const Dtype alpha_;
+  const Dtype* v_;
+  const Dtype* x_;
+  Dtype* y_;
+};
+
+template <typename Op, typename Dtype>
+static void broadcast(const int outer, const int dim, const int inner,
+    const Dtype alpha, const Dtype* v, const Dtype* x, Dtype* y) {
+  Broadcast<Dtype, Op> body(dim, inner, alpha, v, x, y);
+  if (inner == 1) {
+    run(outer, dim, body);
+  } else {
+    run(outer * dim, inner, body);
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_broadcast_add(const int outer, const int dim, const int inner,
+    const Dtype alpha, const Dtype* v, const Dtype* x, Dtype* y) {
+  broadcast<AddOp>(outer, dim, inner, alpha, v, x, y);
+}
+
+template void caffe_cpu_broadcast_add<float>(const int outer, const int dim,
+    const int inner, const float alpha, const float* v, const float* x,
+    float* y);
+template void caffe_cpu_broadcast_add<double>(const int outer, const int dim,
+    const int inner, const double alpha, const double* v, const double* x,
+    double* y);
+
+template <typename Dtype>
+void caffe_cpu_broadcast_mul(const int outer, const int dim, const int inner,
+    const Dtype* v, const Dtype* x, Dtype* y) {
+  broadcast<MulOp>(outer, dim, inner, Dtype(1), v, x, y);
+}
+
+template void caffe_cpu_broadcast_mul<float>(const int outer, const int dim,
+    const int inner, const float* v, const float* x, float* y);
+template void caffe_cpu_broadcast_mul<double>(const int outer, const int dim,
+    const int inner, const double* v, const double* x, double* y);
+
+template <typename Dtype>
+void caffe_cpu_broadcast_div(const int outer, const int dim, const int inner,
+    const Dtype* v, const Dtype* x, Dtype* y) {
+  broadcast<DivOp>(outer, dim, inner, Dtype(1), v, x, y);
+}
+
+template void caffe_cpu_broadcast_div<float>(const int outer, const int dim,
+    const int inner, const float* v, const float* x, float* y);
+template void caffe_cpu_broadcast_div<double>(const int outer, const int dim,
+    const int inner, const double* v, const double* x, double* y);
+
+// Reduces the dim indices [begin, end) of the outer x dim x inner view of x,
+// or of the product of x and z when z is given.
+template <typename Dtype>
+class AxisReduce {
+ public:
+  AxisReduce(int outer, int dim, int inner, Dtype alpha, const Dtype* x,
+      const Dtype* z, Dtype beta, Dtype* y) : outer_(outer), dim_(dim),
+      inner_(inner), alpha_(alpha), x_(x), z_(z), beta_(beta), y_(y) {}
+
+  void operator()(int begin, int end) const {
+    if (inner_ == 1) {
+      // Sum blocks of columns down all rows at a time, to read x in runs,
+      // into sums on the stack; softmax calls this per row.
+      for (int block = begin; block < end; block += kReduceBlockSize) {
+        const int size = std::min(kReduceBlockSize, end - block);
+        Dtype sums[kReduceBlockSize] = { 0 };
+        for (int o = 0; o < outer_; ++o) {
+          const Dtype* x = x_ + o * dim_ + block;
+          if (z_) {
+            const Dtype* z = z_ + o * dim_ + block;
+            for (int d = 0; d < size; ++d) {
+              sums[d] += x[d] * z[d];
+            }
+          } else {
+            for (int d = 0; d < size; ++d) {
+              sums[d] += x[d];
+            }
+          }
+        }
+        for (int d = 0; d < size; ++d) {
+          Store(sums[d], y_ + block + d);
+        }
+      }
+    } else {
+      for (int d = begin; d < end; ++d) {
+        Dtype sum = 0;
+        for (int o = 0; o < outer_; ++o) {
+          const int offset = (o * dim_ + d) * inner_;
+          const Dtype* x = x_ + offset;
+          if (z_) {
+            const Dtype* z = z_ + offset;
+            for (int i = 0; i < inner_; ++i) {
+              sum += x[i] * z[i];
+            }
+          } else {
+            for (int i = 0; i < inner_; ++i) {
+              sum += x[i];
+            }
+          }
+        }
+        Store(sum, y_ + d);
+      }
+    }
+  }
+
+ private:
+  inline void Store(Dtype sum, Dtype* y) const {
+    *y = beta_ == Dtype(0) ? alpha_ * sum : alpha_ * sum + beta_ * *y;
+  }
+
+  const int outer_;
+  const int dim_;
+  const int inner_;
+  const Dtype alpha_;
+  const Dtype* x_;
+  const Dtype* z_;
+  const Dtype beta_;
+  Dtype* y_;
+};
+
+template <typename Dtype>
+void caffe_cpu_axis_sum(const int outer, const int dim, const int inner,
+    const Dtype alpha, const Dtype* x, const Dtype beta, Dtype* y) {
+  AxisReduce<Dtype> body(outer, dim, inner, alpha, x, NULL, beta, y);
+  run(dim, outer * inner, body);
+}
+
+template void caffe_cpu_axis_sum<float>(const int outer, const int dim,
+    const int inner, const float alpha, const float* x, const float beta,
+    float* y);
+template void caffe_cpu_axis_sum<double>(const int outer, const int dim,
+    const int inner, const double alpha, const double* x, const double beta,
+    double* y);
+
+template <typename Dtype>
+void caffe_cpu_axis_dot(const int outer, const int dim, const int inner,
+    const Dtype alpha, const Dtype* x, const Dtype* z, const Dtype beta,
+    Dtype* y) {
+  AxisReduce<Dtype> body(outer, dim, inner, alpha, x, z, beta, y);
+  run(dim, outer * inner, body);
+}
+
+template void caffe_cpu_axis_dot<float>(const int outer, const int dim,
+    const int inner, const float alpha, const float* x, const float* z,
+    const float beta, float* y);
+template void caffe_cpu_axis_dot<double>(const int outer, const int dim,
+    const int inner, const double alpha, const double* x, const double* z,
+    const double beta, double* y);
+
+}  // namespace caffe
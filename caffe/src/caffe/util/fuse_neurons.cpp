@@ -0,0 +1,86 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/layers/fused_neuron_layer.hpp"
+#include "caffe/util/fuse_neurons.hpp"
+
+namespace caffe {
+
+// Whether layer may be part of a chain at all: an element-wise neuron layer
+// of one bottom and one top whose top is not a loss.
+static bool Fusible(const LayerParameter& layer) {
+  return FusedNeuronLayer<float>::CanFuse(layer.type())
+      && layer.bottom_size() == 1 && layer.top_size() == 1
+      && layer.loss_weight_size() == 0;
+}
+
+void FuseNeurons(const NetParameter& param, NetParameter* param_fused,
+    vector<vector<LayerParameter> >* chains) {
+  param_fused->CopyFrom(param);
+  param_fused->clear_layer();
+  chains->clear();
+  // Count the layers reading each top, as in InsertSplits.
+  map<string, int> blob_name_to_last_top_idx;
+  vector<int> top_bottom_count(param.layer_size(), 0);
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      map<string, int>::const_iterator top_idx =
+          blob_name_to_last_top_idx.find(layer_param.bottom(j));
+      if (top_idx != blob_name_to_last_top_idx.end()
+          && top_idx->second >= 0) {
+        ++top_bottom_count[top_idx->second];
+      }
+    }
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      // Only the first top of a layer can start a chain; others never count.
+      blob_name_to_last_top_idx[layer_param.top(j)] = j == 0 ? i : -1;
+    }
+  }
+  int i = 0;
+  while (i < param.layer_size()) {
+    // Extend the chain from layer i while the next layer reads only its top,
+    // and is the only layer that does.
+    int end = i + 1;
+    if (Fusible(param.layer(i))) {
+      while (end < param.layer_size() && Fusible(param.layer(end))
+          && param.layer(end).propagate_down_size() == 0
+          && param.layer(end).bottom(0) == param.layer(end - 1).top(0)
+          && top_bottom_count[end - 1] == 1) {
+        ++end;
+      }
+    }
+    LayerParameter* layer_param = param_fused->add_layer();
+    vector<LayerParameter> chain;
+    if (end - i < 2) {
+      layer_param->CopyFrom(param.layer(i));
+    } else {
+      const LayerParameter& first = param.layer(i);
+      const LayerParameter& last = param.layer(end - 1);
+      string name = first.name();
+      for (int k = i; k < end; ++k) {
+        chain.push_back(param.layer(k));
+        if (k > i) {
+          name += "+" + param.layer(k).name();
+        }
+      }
+      layer_param->set_name(name);
+      layer_param->set_type("FusedNeuron");
+      layer_param->add_bottom(first.bottom(0));
+      layer_param->add_top(last.top(0));
+      if (first.has_phase()) {
+        layer_param->set_phase(first.phase());
+      }
+      if (first.propagate_down_size() > 0) {
+        layer_param->add_propagate_down(first.propagate_down(0));
+      }
+      LOG_IF(INFO, Caffe::root_solver()) << "Fusing layers " << name;
+    }
+    chains->push_back(chain);
+    i = end;
+  }
+}
+
+}  // namespace caffe
@@ -123,6 +123,89 @@ void hdf5_save_nd_dataset<double>(
   delete[] dims;
 }
 
+void hdf5_save_encoded_weights(hid_t loc_id, const string& dataset_name,
+    const EncodedWeights& encoded) {
+  CHECK(!encoded.shape.empty()) << "Encoded weights need a shape.";
+  vector<hsize_t> dims(encoded.shape.begin(), encoded.shape.end());
+  herr_t status;
+  if (encoded.encoding == WEIGHT_FP16) {
+    CHECK(!encoded.halves.empty()) << "No weights to save.";
+    status = H5LTmake_dataset(loc_id, dataset_name.c_str(), dims.size(),
+        &dims[0], H5T_NATIVE_USHORT, &encoded.halves[0]);
+  } else {
+    CHECK(!encoded.codes.empty()) << "No weights to save.";
+    status = H5LTmake_dataset(loc_id, dataset_name.c_str(), dims.size(),
+        &dims[0], H5T_NATIVE_UCHAR, &encoded.codes[0]);
+  }
+  CHECK_GE(status, 0) << "Failed to make encoded dataset " << dataset_name;
+  status = H5LTset_attribute_string(loc_id, dataset_name.c_str(), "encoding",
+      WeightEncodingName(encoded.encoding).c_str());
+  CHECK_GE(status, 0) << "Failed to save the encoding of " << dataset_name;
+  if (!encoded.codebook.empty()) {
+    status = H5LTset_attribute_float(loc_id, dataset_name.c_str(), "codebook",
+        &encoded.codebook[0], encoded.codebook.size());
+    CHECK_GE(status, 0) << "Failed to save the codebook of " << dataset_name;
+  }
+}
+
+bool hdf5_is_encoded_weights(hid_t loc_id, const string& dataset_name) {
+  htri_t exists = H5Aexists_by_name(loc_id, dataset_name.c_str(), "encoding",
+      H5P_DEFAULT);
+  CHECK_GE(exists, 0) << "Failed to look up attributes of " << dataset_name;
+  return exists > 0;
+}
+
+void hdf5_load_encoded_weights(hid_t loc_id, const string& dataset_name,
+    EncodedWeights* encoded) {
+  int ndims;
+  herr_t status = H5LTget_dataset_ndims(loc_id, dataset_name.c_str(), &ndims);
+  CHECK_GE(status, 0) << "Failed to get dataset ndims for " << dataset_name;
+  CHECK_GT(ndims, 0) << "Encoded dataset " << dataset_name << " is a scalar.";
+  vector<hsize_t> dims(ndims);
+  H5T_class_t class_;
+  size_t size;
+  status = H5LTget_dataset_info(loc_id, dataset_name.c_str(), &dims[0],
+      &class_, NULL);
+  CHECK_GE(status, 0) << "Failed to get dataset info for " << dataset_name;
+  encoded->shape.assign(dims.begin(), dims.end());
+  int count = 1;
+  for (int i = 0; i < ndims; ++i) {
+    count *= dims[i];
+  }
+  CHECK_GT(count, 0) << "Encoded dataset " << dataset_name << " is empty.";
+  hsize_t attribute_dims;
+  status = H5LTget_attribute_info(loc_id, dataset_name.c_str(), "encoding",
+      &attribute_dims, &class_, &size);
+  CHECK_GE(status, 0) << "Failed to get the encoding of " << dataset_name;
+  vector<char> name(size + 1, 0);
+  status = H5LTget_attribute_string(loc_id, dataset_name.c_str(), "encoding",
+      &name[0]);
+  CHECK_GE(status, 0) << "Failed to get the encoding of " << dataset_name;
+  encoded->encoding = WeightEncodingFromName(&name[0]);
+  encoded->halves.clear();
+  encoded->codes.clear();
+  encoded->codebook.clear();
+  if (encoded->encoding == WEIGHT_FP16) {
+    encoded->halves.resize(count);
+    status = H5LTread_dataset(loc_id, dataset_name.c_str(), H5T_NATIVE_USHORT,
+        &encoded->halves[0]);
+  } else {
+    encoded->codes.resize(count);
+    status = H5LTread_dataset(loc_id, dataset_name.c_str(), H5T_NATIVE_UCHAR,
+        &encoded->codes[0]);
+    CHECK_GE(status, 0) << "Failed to read encoded dataset " << dataset_name;
+    status = H5LTget_attribute_info(loc_id, dataset_name.c_str(), "codebook",
+        &attribute_dims, &class_, &size);
+    CHECK_GE(status, 0) << "Failed to get the codebook of " << dataset_name;
+    CHECK_EQ(attribute_dims, kWeightCodebookSize)
+        << "The codebook of " << dataset_name << " has the wrong size.";
+    encoded->codebook.resize(kWeightCodebookSize);
+    status = H5LTget_attribute_float(loc_id, dataset_name.c_str(), "codebook",
+        &encoded->codebook[0]);
+  }
+  CHECK_GE(status, 0) << "Failed to read encoded dataset " << dataset_name;
+}
+
 string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
   // Get size of dataset
   size_t size;
@@ -1,33 +1,209 @@
+#include <stdint.h>
+
+#include <algorithm>
 #include <vector>
 
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Loops over fewer elements than this run on the calling thread alone.
+static const int kParallelMinCount = 1 << 15;
+
+// Find the output positions [*begin, *end) along one axis of an input of the
+// given size that read inside it, at kernel offset `offset` with the given
+// stride and pad; the others read the padding.
+inline void interior_range(const int size, const int size_col,
+    const int offset, const int stride, const int pad, int* begin, int* end) {
+  const int shift = pad - offset;
+  *begin = shift > 0 ? std::min(size_col, (shift + stride - 1) / stride) : 0;
+  *end = size + shift > 0 ?
+      std::min(size_col, (size + shift - 1) / stride + 1) : 0;
+  *end = std::max(*end, *begin);
+}
+
+// The kernel, pad and stride of a convolution over depth x height x width,
+// given at run time; a 2-D convolution has depth, kernel_d and stride_d 1.
+struct Geometry {
+  Geometry(int kd, int kh, int kw, int pd, int ph, int pw, int sd, int sh,
+      int sw) : kernel_d(kd), kernel_h(kh), kernel_w(kw), pad_d(pd),
+      pad_h(ph), pad_w(pw), stride_d(sd), stride_h(sh), stride_w(sw) {}
+  int kernel_d, kernel_h, kernel_w;
+  int pad_d, pad_h, pad_w;
+  int stride_d, stride_h, stride_w;
+};
+
+// The same for a square 2-D kernel of K with stride S and pad P known at
+// compile time, so the loops below unroll and lose their bounds arithmetic.
+template <int K, int S, int P>
+struct FixedGeometry {
+  static const int kernel_d = 1, kernel_h = K, kernel_w = K;
+  static const int pad_d = 0, pad_h = P, pad_w = P;
+  static const int stride_d = 1, stride_h = S, stride_w = S;
+};
+
+// Unrolls or rolls back the channels [begin, end) of an image. Each row of
+// the columns reads one row of the image at a fixed offset: the positions
+// that fall in the padding are split from the interior once per row, and
+// the interior is copied whole when the stride is 1 or gathered with the
+// stride otherwise. col2im accumulates into its own channels only, so the
+// channels may be split between threads.
+template <typename Dtype, typename G>
+class Im2col {
+ public:
+  // Reads data_in and writes data_out: the image and the columns if
+  // im2col, or the other way round.
+  Im2col(const G& g, const int depth, const int height, const int width,
+      const bool im2col, const Dtype* data_in, Dtype* data_out)
+      : g_(g), depth_(depth), height_(height), width_(width),
+      depth_col_((depth + 2 * g.pad_d - g.kernel_d) / g.stride_d + 1),
+      height_col_((height + 2 * g.pad_h - g.kernel_h) / g.stride_h + 1),
+      width_col_((width + 2 * g.pad_w - g.kernel_w) / g.stride_w + 1),
+      im2col_(im2col), data_in_(data_in), data_out_(data_out) {}
+
+  // The elements of the columns of one channel.
+  int channel_count() const {
+    return g_.kernel_d * g_.kernel_h * g_.kernel_w * depth_col_ * height_col_
+        * width_col_;
+  }
+
+  void operator()(int begin, int end) const {
+    const int im_size = depth_ * height_ * width_;
+    for (int c = begin; c < end; ++c) {
+      if (im2col_) {
+        Unroll(data_in_ + c * im_size, data_out_ + c * channel_count());
+      } else {
+        Dtype* data_im = data_out_ + c * im_size;
+        std::fill(data_im, data_im + im_size, Dtype(0));
+        Roll(data_in_ + c * channel_count(), data_im);
+      }
+    }
+  }
+
+ private:
+  // The image row read by row (kd, kh, d_col, h_col) of the columns, shifted
+  // by -pad_w, or -1 if it lies in the padding.
+  inline int row_offset(int kd, int kh, int d_col, int h_col) const {
+    const int d_im = d_col * g_.stride_d - g_.pad_d + kd;
+    const int h_im = h_col * g_.stride_h - g_.pad_h + kh;
+    if (d_im < 0 || d_im >= depth_ || h_im < 0 || h_im >= height_) {
+      return -1;
+    }
+    return (d_im * height_ + h_im) * width_;
+  }
+
+  void Unroll(const Dtype* data_im, Dtype* data_col) const {
+    const int stride_w = g_.stride_w;
+    for (int kd = 0; kd < g_.kernel_d; ++kd) {
+      for (int kh = 0; kh < g_.kernel_h; ++kh) {
+        for (int kw = 0; kw < g_.kernel_w; ++kw) {
+          int begin, end;
+          interior_range(width_, width_col_, kw, stride_w, g_.pad_w, &begin,
+              &end);
+          for (int d_col = 0; d_col < depth_col_; ++d_col) {
+            for (int h_col = 0; h_col < height_col_;
+                 ++h_col, data_col += width_col_) {
+              const int offset = row_offset(kd, kh, d_col, h_col);
+              if (offset < 0) {
+                std::fill(data_col, data_col + width_col_, Dtype(0));
+                continue;
+              }
+              const Dtype* row = data_im + offset + kw - g_.pad_w;
+              std::fill(data_col, data_col + begin, Dtype(0));
+              if (stride_w == 1) {
+                std::copy(row + begin, row + end, data_col + begin);
+              } else {
+                for (int w_col = begin; w_col < end; ++w_col) {
+                  data_col[w_col] = row[w_col * stride_w];
+                }
+              }
+              std::fill(data_col + end, data_col + width_col_, Dtype(0));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  void Roll(const Dtype* data_col, Dtype* data_im) const {
+    const int stride_w = g_.stride_w;
+    for (int kd = 0; kd < g_.kernel_d; ++kd) {
+      for (int kh = 0; kh < g_.kernel_h; ++kh) {
+        for (int kw = 0; kw < g_.kernel_w; ++kw) {
+          int begin, end;
+          interior_range(width_, width_col_, kw, stride_w, g_.pad_w, &begin,
+              &end);
+          for (int d_col = 0; d_col < depth_col_; ++d_col) {
+            for (int h_col = 0; h_col < height_col_;
+                 ++h_col, data_col += width_col_) {
+              const int offset = row_offset(kd, kh, d_col, h_col);
+              if (offset < 0) {
+                continue;
+              }
+              Dtype* row = data_im + offset + kw - g_.pad_w;
+              if (stride_w == 1) {
+                for (int w_col = begin; w_col < end; ++w_col) {
+                  row[w_col] += data_col[w_col];
+                }
+              } else {
+                for (int w_col = begin; w_col < end; ++w_col) {
+                  row[w_col * stride_w] += data_col[w_col];
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  const G g_;
+  const int depth_, height_, width_;
+  const int depth_col_, height_col_, width_col_;
+  const bool im2col_;
+  const Dtype* data_in_;
+  Dtype* data_out_;
+};
+
+// Runs body over the channels, split between threads if there is enough of
+// them.
+template <typename Dtype, typename G>
+static void run_channels(const Im2col<Dtype, G>& body, const int channels) {
+  const int count = body.channel_count();
+  if (static_cast<int64_t>(channels) * count < kParallelMinCount) {
+    body(0, channels);
+  } else {
+    parallel_for(0, channels, body,
+        std::max(1, kParallelMinCount / std::max(count, 1)));
+  }
+}
+
+template <typename Dtype, typename G>
+static void im2col_channels(const G& g, const Dtype* data_im,
+    const int channels, const int depth, const int height, const int width,
+    Dtype* data_col) {
+  run_channels(Im2col<Dtype, G>(g, depth, height, width, true, data_im,
+      data_col), channels);
+}
+
+template <typename Dtype, typename G>
+static void col2im_channels(const G& g, const Dtype* data_col,
+    const int channels, const int depth, const int height, const int width,
+    Dtype* data_im) {
+  run_channels(Im2col<Dtype, G>(g, depth, height, width, false, data_col,
+      data_im), channels);
+}
+
 template <typename Dtype>
 void im2col_cpu(const Dtype* data_im, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
     const int pad_h, const int pad_w,
     const int stride_h, const int stride_w,
     Dtype* data_col) {
-  const int height_col = (height + 2 * pad_h - kernel_h) / stride_h + 1;
-  const int width_col = (width + 2 * pad_w - kernel_w) / stride_w + 1;
-  const int channels_col = channels * kernel_h * kernel_w;
-  for (int c_col = 0; c_col < channels_col; ++c_col) {
-    int w_offset = c_col % kernel_w;
-    int h_offset = (c_col / kernel_w) % kernel_h;
-    int c_im = c_col / kernel_h / kernel_w;
-    for (int h_col = 0; h_col < height_col; ++h_col) {
-      for (int w_col = 0; w_col < width_col; ++w_col) {
-        int h_im = h_col * stride_h - pad_h + h_offset;
-        int w_im = w_col * stride_w - pad_w + w_offset;
-        data_col[(c_col * height_col + h_col) * width_col + w_col] =
-            (h_im >= 0 && w_im >= 0 && h_im < height && w_im < width) ?
-            data_im[(c_im * height + h_im) * width + w_im] : 0;
-      }
-    }
-  }
+  im2col_channels(Geometry(1, kernel_h, kernel_w, 0, pad_h, pad_w, 1,
+      stride_h, stride_w), data_im, channels, 1, height, width, data_col);
 }
 
 // Explicit instantiation
@@ -138,24 +314,8 @@ void col2im_cpu(const Dtype* data_col, const int channels,
     const int pad_h, const int pad_w,
     const int stride_h, const int stride_w,
     Dtype* data_im) {
-  caffe_set(height * width * channels, Dtype(0), data_im);
-  const int height_col = (height + 2 * pad_h - kernel_h) / stride_h + 1;
-  const int width_col = (width + 2 * pad_w - kernel_w) / stride_w + 1;
-  const int channels_col = channels * kernel_h * kernel_w;
-  for (int c_col = 0; c_col < channels_col; ++c_col) {
-    int w_offset = c_col % kernel_w;
-    int h_offset = (c_col / kernel_w) % kernel_h;
-    int c_im = c_col / kernel_h / kernel_w;
-    for (int h_col = 0; h_col < height_col; ++h_col) {
-      for (int w_col = 0; w_col < width_col; ++w_col) {
-        int h_im = h_col * stride_h - pad_h + h_offset;
-        int w_im = w_col * stride_w - pad_w + w_offset;
-        if (h_im >= 0 && h_im < height && w_im >= 0 && w_im < width)
-          data_im[(c_im * height + h_im) * width + w_im] +=
-              data_col[(c_col * height_col + h_col) * width_col + w_col];
-      }
-    }
-  }
+  col2im_channels(Geometry(1, kernel_h, kernel_w, 0, pad_h, pad_w, 1,
+      stride_h, stride_w), data_col, channels, 1, height, width, data_im);
 }
 
 // Explicit instantiation
@@ -168,6 +328,120 @@ template void col2im_cpu<double>(const double* data_col, const int channels,
     const int pad_h, const int pad_w, const int stride_h,
     const int stride_w, double* data_im);
 
+// im2col_cpu for a square kernel of K with stride S and pad P; the runtime
+// geometry arguments are ignored.
+template <typename Dtype, int K, int S, int P>
+void im2col_fixed_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int, const int, const int,
+    const int, const int, const int, Dtype* data_col) {
+  im2col_channels(FixedGeometry<K, S, P>(), data_im, channels, 1, height,
+      width, data_col);
+}
+
+// col2im_cpu for a square kernel of K with stride S and pad P.
+template <typename Dtype, int K, int S, int P>
+void col2im_fixed_cpu(const Dtype* data_col, const int channels,
+    const int height, const int width, const int, const int, const int,
+    const int, const int, const int, Dtype* data_im) {
+  col2im_channels(FixedGeometry<K, S, P>(), data_col, channels, 1, height,
+      width, data_im);
+}
+
+// The (kernel, stride, pad) of the square geometries with fixed kernels.
+#define FOR_EACH_FIXED_GEOMETRY(MACRO) \
+  MACRO(3, 1, 1) MACRO(3, 1, 0) MACRO(3, 2, 1) MACRO(3, 2, 0) \
+  MACRO(2, 2, 0) MACRO(1, 2, 0)
+
+template <typename Dtype>
+typename Im2colCpuFunc<Dtype>::type im2col_cpu_func(const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w) {
+  if (kernel_h == kernel_w && pad_h == pad_w && stride_h == stride_w) {
+#define RETURN_IF_FIXED(K, S, P) \
+    if (kernel_h == K && stride_h == S && pad_h == P) { \
+      return &im2col_fixed_cpu<Dtype, K, S, P>; \
+    }
+    FOR_EACH_FIXED_GEOMETRY(RETURN_IF_FIXED)
+#undef RETURN_IF_FIXED
+  }
+  return &im2col_cpu<Dtype>;
+}
+
+template <typename Dtype>
+typename Im2colCpuFunc<Dtype>::type col2im_cpu_func(const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w) {
+  if (kernel_h == kernel_w && pad_h == pad_w && stride_h == stride_w) {
+#define RETURN_IF_FIXED(K, S, P) \
+    if (kernel_h == K && stride_h == S && pad_h == P) { \
+      return &col2im_fixed_cpu<Dtype, K, S, P>; \
+    }
+    FOR_EACH_FIXED_GEOMETRY(RETURN_IF_FIXED)
+#undef RETURN_IF_FIXED
+  }
+  return &col2im_cpu<Dtype>;
+}
+
+#undef FOR_EACH_FIXED_GEOMETRY
+
+// Explicit instantiation
+template Im2colCpuFunc<float>::type im2col_cpu_func<float>(
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w);
+template Im2colCpuFunc<double>::type im2col_cpu_func<double>(
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w);
+template Im2colCpuFunc<float>::type col2im_cpu_func<float>(
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w);
+template Im2colCpuFunc<double>::type col2im_cpu_func<double>(
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w);
+
+template <typename Dtype>
+void im2col_3d_cpu(const Dtype* data_im, const int channels, const int depth,
+    const int height, const int width, const int kernel_d, const int kernel_h,
+    const int kernel_w, const int pad_d, const int pad_h, const int pad_w,
+    const int stride_d, const int stride_h, const int stride_w,
+    Dtype* data_col) {
+  im2col_channels(Geometry(kernel_d, kernel_h, kernel_w, pad_d, pad_h,
+      pad_w, stride_d, stride_h, stride_w), data_im, channels, depth, height,
+      width, data_col);
+}
+
+template <typename Dtype>
+void col2im_3d_cpu(const Dtype* data_col, const int channels, const int depth,
+    const int height, const int width, const int kernel_d, const int kernel_h,
+    const int kernel_w, const int pad_d, const int pad_h, const int pad_w,
+    const int stride_d, const int stride_h, const int stride_w,
+    Dtype* data_im) {
+  col2im_channels(Geometry(kernel_d, kernel_h, kernel_w, pad_d, pad_h,
+      pad_w, stride_d, stride_h, stride_w), data_col, channels, depth, height,
+      width, data_im);
+}
+
+// Explicit instantiation
+template void im2col_3d_cpu<float>(const float* data_im, const int channels,
+    const int depth, const int height, const int width, const int kernel_d,
+    const int kernel_h, const int kernel_w, const int pad_d, const int pad_h,
+    const int pad_w, const int stride_d, const int stride_h,
+    const int stride_w, float* data_col);
+template void im2col_3d_cpu<double>(const double* data_im, const int channels,
+    const int depth, const int height, const int width, const int kernel_d,
+    const int kernel_h, const int kernel_w, const int pad_d, const int pad_h,
+    const int pad_w, const int stride_d, const int stride_h,
+    const int stride_w, double* data_col);
+template void col2im_3d_cpu<float>(const float* data_col, const int channels,
+    const int depth, const int height, const int width, const int kernel_d,
+    const int kernel_h, const int kernel_w, const int pad_d, const int pad_h,
+    const int pad_w, const int stride_d, const int stride_h,
+    const int stride_w, float* data_im);
+template void col2im_3d_cpu<double>(const double* data_col,
+    const int channels, const int depth, const int height, const int width,
+    const int kernel_d, const int kernel_h, const int kernel_w,
+    const int pad_d, const int pad_h, const int pad_w, const int stride_d,
+    const int stride_h, const int stride_w, double* data_im);
+
 template <typename Dtype>
 void col2im_nd_cpu(const Dtype* data_col, const int num_spatial_axes,
     const int* im_shape, const int* col_shape,
@@ -0,0 +1,308 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#endif  // USE_OPENCV
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/data_transformer.hpp"
+#include "caffe/util/image_preprocessor.hpp"
+
+namespace caffe {
+
+bool ClipWindow(int rows, int cols, int* window) {
+  window[0] = std::max(window[0], 0);
+  window[1] = std::max(window[1], 0);
+  window[2] = std::min(window[2], rows);
+  window[3] = std::min(window[3], cols);
+  return window[0] < window[2] && window[1] < window[3];
+}
+
+#ifdef USE_OPENCV
+template <typename Dtype>
+WindowWarp ComputeWindowWarp(int x1, int y1, int x2, int y2, int rows,
+    int cols, int crop_size, int context_pad, bool use_square, bool mirror) {
+  WindowWarp warp;
+  warp.size = cv::Size(crop_size, crop_size);
+  warp.pad_h = 0;
+  warp.pad_w = 0;
+  if (context_pad > 0 || use_square) {
+    // scale factor by which to expand the original region
+    // such that after warping the expanded region to crop_size x crop_size
+    // there's exactly context_pad amount of padding on each side
+    Dtype context_scale = static_cast<Dtype>(crop_size) /
+        static_cast<Dtype>(crop_size - 2*context_pad);
+
+    // compute the expanded region
+    Dtype half_height = static_cast<Dtype>(y2-y1+1)/2.0;
+    Dtype half_width = static_cast<Dtype>(x2-x1+1)/2.0;
+    Dtype center_x = static_cast<Dtype>(x1) + half_width;
+    Dtype center_y = static_cast<Dtype>(y1) + half_height;
+    if (use_square) {
+      if (half_height > half_width) {
+        half_width = half_height;
+      } else {
+        half_height = half_width;
+      }
+    }
+    x1 = static_cast<int>(round(center_x - half_width*context_scale));
+    x2 = static_cast<int>(round(center_x + half_width*context_scale));
+    y1 = static_cast<int>(round(center_y - half_height*context_scale));
+    y2 = static_cast<int>(round(center_y + half_height*context_scale));
+
+    // the expanded region may go outside of the image
+    // so we compute the clipped (expanded) region and keep track of
+    // the extent beyond the image
+    int unclipped_height = y2-y1+1;
+    int unclipped_width = x2-x1+1;
+    int pad_x1 = std::max(0, -x1);
+    int pad_y1 = std::max(0, -y1);
+    int pad_x2 = std::max(0, x2 - cols + 1);
+    int pad_y2 = std::max(0, y2 - rows + 1);
+    // clip bounds
+    x1 = x1 + pad_x1;
+    x2 = x2 - pad_x2;
+    y1 = y1 + pad_y1;
+    y2 = y2 - pad_y2;
+    CHECK_GT(x1, -1);
+    CHECK_GT(y1, -1);
+    CHECK_LT(x2, cols);
+    CHECK_LT(y2, rows);
+
+    int clipped_height = y2-y1+1;
+    int clipped_width = x2-x1+1;
+
+    // scale factors that would be used to warp the unclipped
+    // expanded region
+    Dtype scale_x =
+        static_cast<Dtype>(crop_size)/static_cast<Dtype>(unclipped_width);
+    Dtype scale_y =
+        static_cast<Dtype>(crop_size)/static_cast<Dtype>(unclipped_height);
+
+    // size to warp the clipped expanded region to
+    warp.size.width =
+        static_cast<int>(round(static_cast<Dtype>(clipped_width)*scale_x));
+    warp.size.height =
+        static_cast<int>(round(static_cast<Dtype>(clipped_height)*scale_y));
+    pad_x1 = static_cast<int>(round(static_cast<Dtype>(pad_x1)*scale_x));
+    pad_x2 = static_cast<int>(round(static_cast<Dtype>(pad_x2)*scale_x));
+    pad_y1 = static_cast<int>(round(static_cast<Dtype>(pad_y1)*scale_y));
+    pad_y2 = static_cast<int>(round(static_cast<Dtype>(pad_y2)*scale_y));
+
+    warp.pad_h = pad_y1;
+    // if we're mirroring, we mirror the padding too (to be pedantic)
+    if (mirror) {
+      warp.pad_w = pad_x2;
+    } else {
+      warp.pad_w = pad_x1;
+    }
+
+    // ensure that the warped, clipped region plus the padding fits in the
+    // crop_size x crop_size image (it might not due to rounding)
+    if (warp.pad_h + warp.size.height > crop_size) {
+      warp.size.height = crop_size - warp.pad_h;
+    }
+    if (warp.pad_w + warp.size.width > crop_size) {
+      warp.size.width = crop_size - warp.pad_w;
+    }
+  }
+  warp.roi = cv::Rect(x1, y1, x2-x1+1, y2-y1+1);
+  return warp;
+}
+
+template WindowWarp ComputeWindowWarp<float>(int x1, int y1, int x2, int y2,
+    int rows, int cols, int crop_size, int context_pad, bool use_square,
+    bool mirror);
+template WindowWarp ComputeWindowWarp<double>(int x1, int y1, int x2, int y2,
+    int rows, int cols, int crop_size, int context_pad, bool use_square,
+    bool mirror);
+
+template <typename Dtype>
+ImagePreprocessor<Dtype>::ImagePreprocessor(int num_threads)
+    : num_threads_(num_threads), image_height_(0), image_width_(0),
+      raw_scale_(1), input_scale_(1), oversample_(false), context_pad_(0) {
+  if (num_threads_ <= 0) {
+    num_threads_ = std::max<int>(boost::thread::hardware_concurrency(), 1);
+  }
+}
+
+template <typename Dtype>
+void ImagePreprocessor<Dtype>::Preprocess(const vector<cv::Mat>& images,
+    Blob<Dtype>* blob) const {
+  CHECK_EQ(blob->num_axes(), 4) << "Preprocessing needs a 4-d blob.";
+  const int num_images = images.size();
+  CHECK_GE(blob->num(), num_images * crops_per_image())
+      << "The blob is too small for " << num_images << " images.";
+  CHECK_GT(raw_scale_, 0) << "raw_scale must be positive.";
+  // Take the pointer here, so that the threads only write to the memory.
+  Dtype* data = blob->mutable_cpu_data();
+  const int num_threads = std::min(num_threads_, num_images);
+  if (num_threads <= 1) {
+    PreprocessRange(images, 0, num_images, blob, data);
+    return;
+  }
+  boost::thread_group threads;
+  for (int i = 0; i < num_threads; ++i) {
+    const int begin = num_images * i / num_threads;
+    const int end = num_images * (i + 1) / num_threads;
+    threads.create_thread(boost::bind(
+        &ImagePreprocessor<Dtype>::PreprocessRange, this, boost::cref(images),
+        begin, end, blob, data));
+  }
+  threads.join_all();
+}
+
+template <typename Dtype>
+void ImagePreprocessor<Dtype>::PreprocessWindows(const cv::Mat& image,
+    const vector<int>& windows, Blob<Dtype>* blob) const {
+  CHECK_EQ(blob->num_axes(), 4) << "Preprocessing needs a 4-d blob.";
+  CHECK_EQ(blob->height(), blob->width()) << "Window crops are square.";
+  CHECK_EQ(windows.size() % 4, 0) << "Windows take 4 coordinates each.";
+  const int num_windows = windows.size() / 4;
+  CHECK_GE(blob->num(), num_windows)
+      << "The blob is too small for " << num_windows << " windows.";
+  CHECK_EQ(image.channels(), blob->channels())
+      << "The image has the wrong number of channels.";
+  CHECK_GT(raw_scale_, 0) << "raw_scale must be positive.";
+  // Clip the windows here, so that a bad window fails before any thread
+  // starts rather than inside OpenCV on one of them.
+  vector<int> clipped(windows);
+  for (int i = 0; i < num_windows; ++i) {
+    CHECK(ClipWindow(image.rows, image.cols, &clipped[4 * i]))
+        << "Window " << i << " is outside the image.";
+  }
+  // Swap the channels of the whole image once, rather than of every window.
+  const cv::Mat swapped = SwapChannels(image);
+  Dtype* data = blob->mutable_cpu_data();
+  const int num_threads = std::min(num_threads_, num_windows);
+  if (num_threads <= 1) {
+    PreprocessWindowRange(swapped, clipped, 0, num_windows, blob, data);
+    return;
+  }
+  boost::thread_group threads;
+  for (int i = 0; i < num_threads; ++i) {
+    const int begin = num_windows * i / num_threads;
+    const int end = num_windows * (i + 1) / num_threads;
+    threads.create_thread(boost::bind(
+        &ImagePreprocessor<Dtype>::PreprocessWindowRange, this,
+        boost::cref(swapped), boost::cref(clipped), begin, end, blob, data));
+  }
+  threads.join_all();
+}
+
+template <typename Dtype>
+void ImagePreprocessor<Dtype>::PreprocessWindowRange(const cv::Mat& image,
+    const vector<int>& windows, int begin, int end, const Blob<Dtype>* blob,
+    Dtype* data) const {
+  const int channels = blob->channels();
+  const int crop_size = blob->height();
+  const Dtype scale = raw_scale_ * input_scale_;
+  for (int i = begin; i < end; ++i) {
+    // ComputeWindowWarp() takes inclusive windows.
+    const WindowWarp warp = ComputeWindowWarp<Dtype>(windows[4 * i + 1],
+        windows[4 * i], windows[4 * i + 3] - 1, windows[4 * i + 2] - 1,
+        image.rows, image.cols, crop_size, context_pad_, false, false);
+    cv::Mat warped;
+    cv::resize(image(warp.roi), warped, warp.size, 0, 0, cv::INTER_LINEAR);
+    cv::Mat warped_float;
+    warped.convertTo(warped_float, CV_32F);
+    // The context padding is the mean, which preprocesses to 0.
+    Dtype* item = data + i * blob->count(1);
+    std::fill(item, item + blob->count(1), Dtype(0));
+    for (int h = 0; h < warped_float.rows; ++h) {
+      const float* ptr = warped_float.ptr<float>(h);
+      for (int w = 0; w < warped_float.cols; ++w) {
+        for (int c = 0; c < channels; ++c) {
+          const Dtype mean = mean_.empty() ? Dtype(0) :
+              mean_[mean_.size() == 1 ? 0 : c];
+          item[(c * crop_size + h + warp.pad_h) * crop_size + w +
+              warp.pad_w] = scale * (*ptr++) - mean * input_scale_;
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+cv::Mat ImagePreprocessor<Dtype>::SwapChannels(const cv::Mat& image) const {
+  if (channel_swap_.empty()) {
+    return image;
+  }
+  const int channels = image.channels();
+  CHECK_EQ(static_cast<int>(channel_swap_.size()), channels);
+  vector<int> from_to;
+  for (int c = 0; c < channels; ++c) {
+    from_to.push_back(channel_swap_[c]);
+    from_to.push_back(c);
+  }
+  cv::Mat swapped(image.rows, image.cols, image.type());
+  cv::mixChannels(&image, 1, &swapped, 1, &from_to[0], channels);
+  return swapped;
+}
+
+template <typename Dtype>
+void ImagePreprocessor<Dtype>::PreprocessRange(const vector<cv::Mat>& images,
+    int begin, int end, const Blob<Dtype>* blob, Dtype* data) const {
+  const int channels = blob->channels();
+  const int crop_height = blob->height();
+  const int crop_width = blob->width();
+  // DataTransformer computes (pixel - mean) * scale, so the raw scale is
+  // folded into both.
+  TransformationParameter param;
+  param.set_scale(raw_scale_ * input_scale_);
+  for (int c = 0; c < mean_.size(); ++c) {
+    param.add_mean_value(mean_[c] / raw_scale_);
+  }
+  DataTransformer<Dtype> transformer(param, TEST);
+  Blob<Dtype> item(1, channels, crop_height, crop_width);
+  for (int i = begin; i < end; ++i) {
+    cv::Mat image = images[i];
+    CHECK_EQ(image.channels(), channels) << "Image " << i
+        << " has the wrong number of channels.";
+    if (image_height_ > 0 &&
+        (image.rows != image_height_ || image.cols != image_width_)) {
+      cv::Mat resized;
+      cv::resize(image, resized, cv::Size(image_width_, image_height_));
+      image = resized;
+    }
+    image = SwapChannels(image);
+    CHECK_GE(image.rows, crop_height);
+    CHECK_GE(image.cols, crop_width);
+    // The crops in the order of caffe.io.oversample.
+    vector<cv::Rect> crops;
+    if (oversample_) {
+      const int h_offs[] = { 0, image.rows - crop_height };
+      const int w_offs[] = { 0, image.cols - crop_width };
+      for (int h = 0; h < 2; ++h) {
+        for (int w = 0; w < 2; ++w) {
+          crops.push_back(cv::Rect(w_offs[w], h_offs[h], crop_width,
+              crop_height));
+        }
+      }
+    }
+    crops.push_back(cv::Rect((image.cols - crop_width) / 2,
+        (image.rows - crop_height) / 2, crop_width, crop_height));
+    Dtype* image_data = data + i * crops_per_image() * blob->count(1);
+    for (int k = 0; k < crops.size(); ++k) {
+      item.set_cpu_data(image_data + k * blob->count(1));
+      transformer.Transform(image(crops[k]), &item);
+    }
+    if (oversample_) {
+      for (int k = 0; k < crops.size(); ++k) {
+        cv::Mat mirrored;
+        cv::flip(image(crops[k]), mirrored, 1);
+        item.set_cpu_data(image_data + (crops.size() + k) * blob->count(1));
+        transformer.Transform(mirrored, &item);
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(ImagePreprocessor);
+#endif  // USE_OPENCV
+
+}  // namespace caffe
@@ -2,6 +2,7 @@
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
+#include <google/protobuf/wire_format_lite.h>
 #ifdef USE_OPENCV
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -30,6 +31,7 @@ using google::protobuf::io::CodedInputStream;
 using google::protobuf::io::ZeroCopyOutputStream;
 using google::protobuf::io::CodedOutputStream;
 using google::protobuf::Message;
+using google::protobuf::internal::WireFormatLite;
 
 bool ReadProtoFromTextFile(const char* filename, Message* proto) {
   int fd = open(filename, O_RDONLY);
@@ -64,6 +66,47 @@ bool ReadProtoFromBinaryFile(const char* filename, Message* proto) {
   return success;
 }
 
+bool ReadNetLayersFromBinaryFile(const string& filename, NetParameter* param,
+    RingQueue<const LayerParameter*>* layers) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "File not found: " << filename;
+  ZeroCopyInputStream* raw_input = new FileInputStream(fd);
+  CodedInputStream* coded_input = new CodedInputStream(raw_input);
+  coded_input->SetTotalBytesLimit(kProtoReadBytesLimit, 536870912);
+
+  // Walk the fields of the net, parsing each layer message on its own.
+  bool success = true;
+  for (uint32_t tag = coded_input->ReadTag(); success && tag != 0;
+       tag = coded_input->ReadTag()) {
+    const int field = WireFormatLite::GetTagFieldNumber(tag);
+    if (field == NetParameter::kLayersFieldNumber) {
+      success = false;
+    } else if (field == NetParameter::kLayerFieldNumber &&
+        WireFormatLite::GetTagWireType(tag) ==
+        WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      uint32_t length;
+      success = coded_input->ReadVarint32(&length);
+      if (success) {
+        const CodedInputStream::Limit limit = coded_input->PushLimit(length);
+        LayerParameter* layer = param->add_layer();
+        success = layer->ParseFromCodedStream(coded_input) &&
+            coded_input->ConsumedEntireMessage();
+        coded_input->PopLimit(limit);
+        if (success) {
+          layers->push(layer);
+        }
+      }
+    } else {
+      success = WireFormatLite::SkipField(coded_input, tag);
+    }
+  }
+
+  delete coded_input;
+  delete raw_input;
+  close(fd);
+  return success;
+}
+
 void WriteProtoToBinaryFile(const Message& proto, const char* filename) {
   fstream output(filename, ios::out | ios::trunc | ios::binary);
   CHECK(proto.SerializeToOstream(&output));
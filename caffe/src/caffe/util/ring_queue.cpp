@@ -0,0 +1,259 @@
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread.hpp>
+#include <cstddef>
+#include <string>
+
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/ring_queue.hpp"
+
+namespace caffe {
+
+// Failed pushes and pops are retried this many times, yielding for the
+// second half, before the thread parks.
+static const int kSpinCount = 128;
+// Keeps the positions of producers and consumers on separate cache lines.
+static const int kCacheLineSize = 64;
+
+// Bounded queue of Dmitry Vyukov: the sequence number of every slot tells
+// whether the slot is ready for the push or the pop at a given position.
+template<typename T>
+class RingQueue<T>::sync {
+ public:
+  struct Slot {
+    boost::atomic<size_t> sequence_;
+    T value_;
+  };
+
+  // Counts a thread parked on one of the conditions for as long as it waits,
+  // including when the wait is interrupted.
+  class Waiting {
+   public:
+    explicit Waiting(boost::atomic<int>* waiting) : waiting_(waiting) {
+      waiting_->fetch_add(1, boost::memory_order_seq_cst);
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    }
+    ~Waiting() {
+      waiting_->fetch_sub(1, boost::memory_order_relaxed);
+    }
+
+   private:
+    boost::atomic<int>* waiting_;
+  };
+
+  sync(int capacity, Sharing sharing)
+      : shared_(sharing == MULTIPLE_PRODUCERS_CONSUMERS),
+        mask_(0), tail_(0), head_(0), waiting_pop_(0), waiting_push_(0) {
+    CHECK_GT(capacity, 0);
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    slots_.reset(new Slot[size]);
+    for (size_t i = 0; i < size; ++i) {
+      slots_[i].sequence_.store(i, boost::memory_order_relaxed);
+    }
+  }
+
+  bool try_push(const T& t) {
+    size_t position = tail_.load(boost::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &slots_[position & mask_];
+      const size_t sequence =
+          slot->sequence_.load(boost::memory_order_acquire);
+      const ptrdiff_t difference = static_cast<ptrdiff_t>(sequence - position);
+      if (difference == 0) {
+        if (!shared_) {
+          tail_.store(position + 1, boost::memory_order_relaxed);
+          break;
+        }
+        if (tail_.compare_exchange_weak(position, position + 1,
+            boost::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = tail_.load(boost::memory_order_relaxed);
+      }
+    }
+    slot->value_ = t;
+    slot->sequence_.store(position + 1, boost::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T* t) {
+    size_t position = head_.load(boost::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &slots_[position & mask_];
+      const size_t sequence =
+          slot->sequence_.load(boost::memory_order_acquire);
+      const ptrdiff_t difference =
+          static_cast<ptrdiff_t>(sequence - (position + 1));
+      if (difference == 0) {
+        if (!shared_) {
+          head_.store(position + 1, boost::memory_order_relaxed);
+          break;
+        }
+        if (head_.compare_exchange_weak(position, position + 1,
+            boost::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = head_.load(boost::memory_order_relaxed);
+      }
+    }
+    *t = slot->value_;
+    slot->sequence_.store(position + mask_ + 1, boost::memory_order_release);
+    return true;
+  }
+
+  bool try_peek(T* t) {
+    const size_t position = head_.load(boost::memory_order_relaxed);
+    const Slot& slot = slots_[position & mask_];
+    if (slot.sequence_.load(boost::memory_order_acquire) != position + 1) {
+      return false;
+    }
+    *t = slot.value_;
+    return true;
+  }
+
+  // Wakes the threads parked on condition, if any, and must be called
+  // without the mutex held. The fence pairs with the one in Waiting: either
+  // a parking thread sees the change made before this, or this sees it wait.
+  void Notify(boost::atomic<int>* waiting,
+      boost::condition_variable* condition) {
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    if (waiting->load(boost::memory_order_relaxed) > 0) {
+      boost::mutex::scoped_lock lock(mutex_);
+      condition->notify_all();
+    }
+  }
+
+  const bool shared_;
+  size_t mask_;
+  boost::scoped_array<Slot> slots_;
+  char pad0_[kCacheLineSize];
+  boost::atomic<size_t> tail_;
+  char pad1_[kCacheLineSize];
+  boost::atomic<size_t> head_;
+  char pad2_[kCacheLineSize];
+  boost::atomic<int> waiting_pop_;
+  boost::atomic<int> waiting_push_;
+  boost::mutex mutex_;
+  boost::condition_variable not_empty_;
+  boost::condition_variable not_full_;
+};
+
+template<typename T>
+RingQueue<T>::RingQueue(int capacity, Sharing sharing)
+    : sync_(new sync(capacity, sharing)) {
+}
+
+template<typename T>
+void RingQueue<T>::push(const T& t) {
+  for (int spin = 0; spin < kSpinCount; ++spin) {
+    if (try_push(t)) {
+      return;
+    }
+    if (spin >= kSpinCount / 2) {
+      boost::this_thread::yield();
+    }
+  }
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    typename sync::Waiting waiting(&sync_->waiting_push_);
+    while (!sync_->try_push(t)) {
+      sync_->not_full_.wait(lock);
+    }
+  }
+  sync_->Notify(&sync_->waiting_pop_, &sync_->not_empty_);
+}
+
+template<typename T>
+bool RingQueue<T>::try_push(const T& t) {
+  if (!sync_->try_push(t)) {
+    return false;
+  }
+  sync_->Notify(&sync_->waiting_pop_, &sync_->not_empty_);
+  return true;
+}
+
+template<typename T>
+bool RingQueue<T>::try_pop(T* t) {
+  if (!sync_->try_pop(t)) {
+    return false;
+  }
+  sync_->Notify(&sync_->waiting_push_, &sync_->not_full_);
+  return true;
+}
+
+template<typename T>
+T RingQueue<T>::pop(const string& log_on_wait) {
+  T t;
+  for (int spin = 0; spin < kSpinCount; ++spin) {
+    if (try_pop(&t)) {
+      return t;
+    }
+    if (spin >= kSpinCount / 2) {
+      boost::this_thread::yield();
+    }
+  }
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    typename sync::Waiting waiting(&sync_->waiting_pop_);
+    while (!sync_->try_pop(&t)) {
+      if (!log_on_wait.empty()) {
+        LOG_EVERY_N(INFO, 1000)<< log_on_wait;
+      }
+      sync_->not_empty_.wait(lock);
+    }
+  }
+  sync_->Notify(&sync_->waiting_push_, &sync_->not_full_);
+  return t;
+}
+
+template<typename T>
+bool RingQueue<T>::try_peek(T* t) {
+  return sync_->try_peek(t);
+}
+
+template<typename T>
+T RingQueue<T>::peek() {
+  T t;
+  if (sync_->try_peek(&t)) {
+    return t;
+  }
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  typename sync::Waiting waiting(&sync_->waiting_pop_);
+  while (!sync_->try_peek(&t)) {
+    sync_->not_empty_.wait(lock);
+  }
+  return t;
+}
+
+template<typename T>
+size_t RingQueue<T>::size() const {
+  const size_t head = sync_->head_.load(boost::memory_order_acquire);
+  const size_t tail = sync_->tail_.load(boost::memory_order_acquire);
+  return tail > head ? tail - head : 0;
+}
+
+template<typename T>
+size_t RingQueue<T>::capacity() const {
+  return sync_->mask_ + 1;
+}
+
+template class RingQueue<Batch<float>*>;
+template class RingQueue<Batch<double>*>;
+template class RingQueue<Datum*>;
+template class RingQueue<const LayerParameter*>;
+template class RingQueue<int>;
+
+}  // namespace caffe
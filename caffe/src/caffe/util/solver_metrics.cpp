@@ -0,0 +1,109 @@
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+
+#include "caffe/util/solver_metrics.hpp"
+
+namespace caffe {
+
+SolverMetrics::SolverMetrics(const string& filename, int interval)
+    : filename_(filename), interval_(interval), iterations_(0),
+      last_data_wait_us_(0), peak_blob_bytes_(0) {
+  CHECK(filename_.size()) << "Solver metrics need a file name.";
+  CHECK_GT(interval_, 0) << "Solver metrics interval must be positive.";
+  std::fill(phase_us_, phase_us_ + NUM_PHASES, 0.);
+  wall_timer_.Start();
+}
+
+size_t SolverMetrics::ResidentBytes() {
+  // statm holds the sizes in pages: total, resident, shared, ...
+  std::ifstream statm("/proc/self/statm");
+  size_t total_pages = 0, resident_pages = 0;
+  if (!(statm >> total_pages >> resident_pages)) {
+    return 0;
+  }
+  return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t SolverMetrics::PeakResidentBytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss;  // bytes
+#else
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;  // kilobytes
+#endif
+}
+
+// Writes one metric with its HELP and TYPE lines.
+static void WriteMetric(std::ofstream* file, const char* name,
+    const char* type, const char* help, double value) {
+  *file << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " " << type << "\n"
+        << name << " " << value << "\n";
+}
+
+void SolverMetrics::Write(int iter, int samples_per_iter,
+    double smoothed_loss, double learning_rate, double data_wait_us,
+    size_t blob_bytes) {
+  const double wall_seconds = wall_timer_.MicroSeconds() / 1e6;
+  const int iterations = std::max(iterations_, 1);
+  peak_blob_bytes_ = std::max(peak_blob_bytes_, blob_bytes);
+  const string tmp_filename = filename_ + ".tmp";
+  {
+    std::ofstream file(tmp_filename.c_str());
+    if (!file.is_open()) {
+      LOG(WARNING) << "Failed to open " << tmp_filename
+                   << " for solver metrics.";
+      return;
+    }
+    file.precision(9);
+    WriteMetric(&file, "caffe_solver_iteration", "counter",
+        "Number of parameter updates performed.", iter);
+    WriteMetric(&file, "caffe_solver_samples_per_second", "gauge",
+        "Training samples processed per wall clock second.",
+        wall_seconds > 0 ? iterations_ * samples_per_iter / wall_seconds : 0);
+    WriteMetric(&file, "caffe_solver_forward_seconds", "gauge",
+        "Mean forward time per iteration.",
+        phase_us_[FORWARD] / iterations / 1e6);
+    WriteMetric(&file, "caffe_solver_backward_seconds", "gauge",
+        "Mean backward time per iteration.",
+        phase_us_[BACKWARD] / iterations / 1e6);
+    WriteMetric(&file, "caffe_solver_update_seconds", "gauge",
+        "Mean parameter update time per iteration.",
+        phase_us_[UPDATE] / iterations / 1e6);
+    WriteMetric(&file, "caffe_solver_data_wait_seconds", "gauge",
+        "Mean time per iteration spent waiting for prefetched data.",
+        (data_wait_us - last_data_wait_us_) / iterations / 1e6);
+    WriteMetric(&file, "caffe_solver_smoothed_loss", "gauge",
+        "Training loss averaged over the solver's average_loss iterations.",
+        smoothed_loss);
+    WriteMetric(&file, "caffe_solver_learning_rate", "gauge",
+        "Current learning rate.", learning_rate);
+    WriteMetric(&file, "caffe_process_resident_memory_bytes", "gauge",
+        "Resident set size of the process.", ResidentBytes());
+    WriteMetric(&file, "caffe_process_peak_resident_memory_bytes", "gauge",
+        "Peak resident set size of the process.", PeakResidentBytes());
+    WriteMetric(&file, "caffe_solver_blob_bytes", "gauge",
+        "Size of the training net's activation and parameter blobs.",
+        blob_bytes);
+    WriteMetric(&file, "caffe_solver_peak_blob_bytes", "gauge",
+        "Peak size of the training net's activation and parameter blobs.",
+        peak_blob_bytes_);
+  }
+  if (std::rename(tmp_filename.c_str(), filename_.c_str()) != 0) {
+    LOG(WARNING) << "Failed to replace solver metrics file " << filename_;
+  }
+  std::fill(phase_us_, phase_us_ + NUM_PHASES, 0.);
+  iterations_ = 0;
+  last_data_wait_us_ = data_wait_us;
+  wall_timer_.Start();
+}
+
+}  // namespace caffe
@@ -0,0 +1,176 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/mkl_alternate.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+class ThreadPool::sync {
+ public:
+  sync() : body_(NULL), begin_(0), chunk_size_(0), num_chunks_(0),
+      next_chunk_(0), generation_(0), pending_(0), stop_(false) {}
+
+  // Runs chunks of the current loop until none are left.
+  void RunChunks() {
+    for (;;) {
+      int chunk;
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (next_chunk_ == num_chunks_) {
+          return;
+        }
+        chunk = next_chunk_++;
+      }
+      const int chunk_begin = begin_ + chunk * chunk_size_;
+      (*body_)(chunk_begin, std::min(end_, chunk_begin + chunk_size_));
+    }
+  }
+
+  void Work(int cpu) {
+    Caffe::set_mode(Caffe::CPU);
+    if (cpu >= 0) {
+#ifdef __linux__
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(cpu, &cpus);
+      if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        LOG(WARNING) << "Cannot pin a pool thread to core " << cpu;
+      }
+#else
+      LOG_FIRST_N(WARNING, 1) << "Pinning threads to cores is only "
+          "supported on Linux.";
+#endif
+    }
+    int generation = 0;
+    for (;;) {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (generation_ == generation && !stop_) {
+          start_.wait(lock);
+        }
+        if (stop_) {
+          return;
+        }
+        generation = generation_;
+      }
+      RunChunks();
+      boost::mutex::scoped_lock lock(mutex_);
+      if (--pending_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+
+  // Held by the thread running a loop on the pool.
+  boost::mutex run_mutex_;
+  boost::mutex mutex_;
+  boost::condition_variable start_;
+  boost::condition_variable done_;
+  boost::thread_group threads_;
+
+  const boost::function<void(int, int)>* body_;
+  int begin_;
+  int end_;
+  int chunk_size_;
+  int num_chunks_;
+  int next_chunk_;
+  // Incremented for every loop the workers are woken for.
+  int generation_;
+  // The workers that have not finished the current loop.
+  int pending_;
+  bool stop_;
+};
+
+ThreadPool::ThreadPool(int num_threads, const vector<int>& cpus)
+    : num_threads_(num_threads), sync_(new sync()) {
+  CHECK_GT(num_threads, 0);
+  for (int i = 0; i < num_threads - 1; ++i) {
+    const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+    sync_->threads_.create_thread(boost::bind(&sync::Work, sync_.get(), cpu));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->stop_ = true;
+  }
+  sync_->start_.notify_all();
+  sync_->threads_.join_all();
+}
+
+void ThreadPool::Run(int begin, int end, int grain,
+    const boost::function<void(int, int)>& body) {
+  if (end <= begin) {
+    return;
+  }
+  grain = std::max(grain, 1);
+  const int num_chunks = std::min<int>(num_threads_,
+      (static_cast<int64_t>(end) - begin + grain - 1) / grain);
+  boost::mutex::scoped_lock run_lock(sync_->run_mutex_, boost::try_to_lock);
+  if (num_chunks <= 1 || !run_lock.owns_lock()) {
+    body(begin, end);
+    return;
+  }
+  const int blas_threads = BlasThreads();
+  if (blas_threads > 1) {
+    SetBlasThreads(1);
+  }
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->body_ = &body;
+    sync_->begin_ = begin;
+    sync_->end_ = end;
+    sync_->chunk_size_ = (static_cast<int64_t>(end) - begin + num_chunks - 1)
+        / num_chunks;
+    sync_->num_chunks_ = num_chunks;
+    sync_->next_chunk_ = 0;
+    sync_->pending_ = num_threads_ - 1;
+    ++sync_->generation_;
+  }
+  sync_->start_.notify_all();
+  sync_->RunChunks();
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    while (sync_->pending_ > 0) {
+      sync_->done_.wait(lock);
+    }
+    sync_->body_ = NULL;
+  }
+  if (blas_threads > 1) {
+    SetBlasThreads(blas_threads);
+  }
+}
+
+void parallel_for(int begin, int end,
+    const boost::function<void(int, int)>& body, int grain) {
+  Caffe::thread_pool().Run(begin, end, grain, body);
+}
+
+void SetBlasThreads(int num_threads) {
+#if defined(USE_MKL)
+  mkl_set_num_threads(num_threads);
+#elif defined(USE_OPENBLAS)
+  openblas_set_num_threads(num_threads);
+#endif
+}
+
+int BlasThreads() {
+#if defined(USE_MKL)
+  return mkl_get_max_threads();
+#elif defined(USE_OPENBLAS)
+  return openblas_get_num_threads();
+#else
+  return 0;
+#endif
+}
+
+}  // namespace caffe
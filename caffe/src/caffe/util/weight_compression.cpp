@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "caffe/util/weight_compression.hpp"
+
+namespace caffe {
+
+// k-means fits the codebook to a sample of at most this many weights, taken
+// at an even stride, and then assigns every weight to its nearest value.
+static const int kKMeansMaxSample = 1 << 20;
+static const int kKMeansIterations = 20;
+
+WeightEncoding WeightEncodingFromName(const string& name) {
+  if (name == "float") {
+    return WEIGHT_FLOAT;
+  } else if (name == "fp16") {
+    return WEIGHT_FP16;
+  } else if (name == "linear8") {
+    return WEIGHT_LINEAR8;
+  } else if (name == "kmeans8") {
+    return WEIGHT_KMEANS8;
+  }
+  LOG(FATAL) << "Unknown weight encoding: " << name
+      << "; expected float, fp16, linear8 or kmeans8.";
+  return WEIGHT_FLOAT;
+}
+
+string WeightEncodingName(WeightEncoding encoding) {
+  switch (encoding) {
+  case WEIGHT_FLOAT:
+    return "float";
+  case WEIGHT_FP16:
+    return "fp16";
+  case WEIGHT_LINEAR8:
+    return "linear8";
+  case WEIGHT_KMEANS8:
+    return "kmeans8";
+  default:
+    LOG(FATAL) << "Unknown weight encoding: " << encoding;
+  }
+  return "";
+}
+
+static inline uint32_t FloatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline float BitsFloat(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+uint16_t FloatToHalf(float value) {
+  const uint32_t kHalfOverflow = (127 + 16) << 23;
+  const uint32_t kHalfSubnormal = (127 - 14) << 23;
+  const uint32_t kDenormMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+  uint32_t bits = FloatBits(value);
+  const uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+  uint16_t half;
+  if (bits >= kHalfOverflow) {
+    // Too large for a half: infinity, or a quiet NaN for NaNs.
+    half = bits > (255u << 23) ? 0x7e00 : 0x7c00;
+  } else if (bits < kHalfSubnormal) {
+    // A half subnormal or zero: adding the magic number makes the float unit
+    // round the mantissa to the right place.
+    half = FloatBits(BitsFloat(bits) + BitsFloat(kDenormMagic)) - kDenormMagic;
+  } else {
+    // A normal half: rebias the exponent and round the mantissa to even.
+    const uint32_t mantissa_odd = (bits >> 13) & 1;
+    bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfff + mantissa_odd;
+    half = bits >> 13;
+  }
+  return half | (sign >> 16);
+}
+
+float HalfToFloat(uint16_t half) {
+  const uint32_t kShiftedExponent = 0x7c00 << 13;
+  uint32_t bits = (half & 0x7fff) << 13;
+  const uint32_t exponent = bits & kShiftedExponent;
+  bits += (127 - 15) << 23;
+  if (exponent == kShiftedExponent) {
+    // Infinity or NaN.
+    bits += (128 - 16) << 23;
+  } else if (exponent == 0) {
+    // Zero or subnormal: renormalize by float arithmetic.
+    bits = FloatBits(BitsFloat(bits + (1 << 23)) - BitsFloat(113 << 23));
+  }
+  return BitsFloat(bits | ((half & 0x8000) << 16));
+}
+
+// Fits a sorted codebook to the weights by Lloyd's k-means in one dimension,
+// starting from evenly spaced values.
+template <typename Dtype>
+static void FitKMeansCodebook(const Dtype* data, int count, Dtype min_value,
+    Dtype max_value, vector<float>* codebook) {
+  const int stride = std::max(1, count / kKMeansMaxSample);
+  vector<float> sample;
+  for (int i = 0; i < count; i += stride) {
+    sample.push_back(data[i]);
+  }
+  std::sort(sample.begin(), sample.end());
+  vector<float>& centers = *codebook;
+  for (int k = 0; k < kWeightCodebookSize; ++k) {
+    centers[k] = min_value + (max_value - min_value) * k /
+        (kWeightCodebookSize - 1);
+  }
+  // The sample is sorted, so every cluster is a contiguous range of it,
+  // bounded by the midpoints between neighbouring centers.
+  vector<double> prefix_sum(sample.size() + 1, 0);
+  for (int i = 0; i < sample.size(); ++i) {
+    prefix_sum[i + 1] = prefix_sum[i] + sample[i];
+  }
+  for (int iter = 0; iter < kKMeansIterations; ++iter) {
+    bool changed = false;
+    int begin = 0;
+    for (int k = 0; k < kWeightCodebookSize; ++k) {
+      int end = sample.size();
+      if (k + 1 < kWeightCodebookSize) {
+        const float bound = (centers[k] + centers[k + 1]) / 2;
+        end = std::upper_bound(sample.begin() + begin, sample.end(), bound) -
+            sample.begin();
+      }
+      if (end > begin) {
+        const float center = (prefix_sum[end] - prefix_sum[begin]) /
+            (end - begin);
+        changed = changed || center != centers[k];
+        centers[k] = center;
+      }
+      begin = end;
+    }
+    if (!changed) {
+      break;
+    }
+    std::sort(centers.begin(), centers.end());
+  }
+}
+
+template <typename Dtype>
+double EncodeWeights(const Blob<Dtype>& blob, WeightEncoding encoding,
+    EncodedWeights* encoded) {
+  CHECK_NE(encoding, WEIGHT_FLOAT) << "Float weights are not encoded.";
+  const Dtype* data = blob.cpu_data();
+  const int count = blob.count();
+  encoded->encoding = encoding;
+  encoded->shape = blob.shape();
+  encoded->halves.clear();
+  encoded->codes.clear();
+  encoded->codebook.clear();
+  if (encoding == WEIGHT_FP16) {
+    encoded->halves.resize(count);
+    for (int i = 0; i < count; ++i) {
+      encoded->halves[i] = FloatToHalf(data[i]);
+    }
+  } else {
+    Dtype min_value = 0;
+    Dtype max_value = 0;
+    if (count > 0) {
+      min_value = *std::min_element(data, data + count);
+      max_value = *std::max_element(data, data + count);
+    }
+    encoded->codebook.resize(kWeightCodebookSize);
+    if (encoding == WEIGHT_LINEAR8) {
+      for (int k = 0; k < kWeightCodebookSize; ++k) {
+        encoded->codebook[k] = min_value + (max_value - min_value) * k /
+            (kWeightCodebookSize - 1);
+      }
+    } else {
+      CHECK_EQ(encoding, WEIGHT_KMEANS8);
+      FitKMeansCodebook(data, count, min_value, max_value,
+          &encoded->codebook);
+    }
+    // Assign every weight to its nearest codebook value.
+    const vector<float>& codebook = encoded->codebook;
+    vector<float> bounds(kWeightCodebookSize - 1);
+    for (int k = 0; k + 1 < kWeightCodebookSize; ++k) {
+      bounds[k] = (codebook[k] + codebook[k + 1]) / 2;
+    }
+    encoded->codes.resize(count);
+    for (int i = 0; i < count; ++i) {
+      encoded->codes[i] = std::upper_bound(bounds.begin(), bounds.end(),
+          static_cast<float>(data[i])) - bounds.begin();
+    }
+  }
+  Blob<Dtype> decoded;
+  DecodeWeights(*encoded, &decoded);
+  double error = 0;
+  double norm = 0;
+  for (int i = 0; i < count; ++i) {
+    const double difference = decoded.cpu_data()[i] - data[i];
+    error += difference * difference;
+    norm += static_cast<double>(data[i]) * data[i];
+  }
+  return norm > 0 ? std::sqrt(error / norm) : 0;
+}
+
+template <typename Dtype>
+void DecodeWeights(const EncodedWeights& encoded, Blob<Dtype>* blob) {
+  blob->Reshape(encoded.shape);
+  Dtype* data = blob->mutable_cpu_data();
+  const int count = blob->count();
+  switch (encoded.encoding) {
+  case WEIGHT_FP16:
+    CHECK_EQ(encoded.halves.size(), count);
+    for (int i = 0; i < count; ++i) {
+      data[i] = HalfToFloat(encoded.halves[i]);
+    }
+    break;
+  case WEIGHT_LINEAR8:
+  case WEIGHT_KMEANS8: {
+    CHECK_EQ(encoded.codes.size(), count);
+    CHECK_EQ(encoded.codebook.size(), kWeightCodebookSize);
+    // Widen the codebook once so decoding is a plain table lookup.
+    Dtype codebook[kWeightCodebookSize];
+    std::copy(encoded.codebook.begin(), encoded.codebook.end(), codebook);
+    for (int i = 0; i < count; ++i) {
+      data[i] = codebook[encoded.codes[i]];
+    }
+    break;
+  }
+  default:
+    LOG(FATAL) << "Cannot decode weights of encoding "
+        << WeightEncodingName(encoded.encoding);
+  }
+}
+
+template double EncodeWeights<float>(const Blob<float>& blob,
+    WeightEncoding encoding, EncodedWeights* encoded);
+template double EncodeWeights<double>(const Blob<double>& blob,
+    WeightEncoding encoding, EncodedWeights* encoded);
+template void DecodeWeights<float>(const EncodedWeights& encoded,
+    Blob<float>* blob);
+template void DecodeWeights<double>(const EncodedWeights& encoded,
+    Blob<double>* blob);
+
+}  // namespace caffe
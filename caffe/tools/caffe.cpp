@@ -46,6 +46,32 @@ DEFINE_string(sigint_effect, "stop",
 DEFINE_string(sighup_effect, "snapshot",
              "Optional; action to take when a SIGHUP signal is received: "
              "snapshot, stop or none.");
+DEFINE_string(metrics_file, "",
+    "Optional; the file to which training throughput, timing and memory "
+    "metrics are written in the Prometheus text format.");
+DEFINE_int32(metrics_interval, 20,
+    "The number of training iterations between writes of the metrics file.");
+DEFINE_bool(autotune, false,
+    "Optional; time every available engine of each layer at its actual "
+    "shapes during net initialization and use the fastest.");
+DEFINE_string(autotune_cache, "",
+    "Optional; the file in which autotuning decisions are kept across runs.");
+DEFINE_int32(threads, 0,
+    "Optional; the number of threads CPU layers split their work between, "
+    "which BLAS also uses outside of them; 0 for one per core, leaving "
+    "BLAS to its own settings (e.g. OPENBLAS_NUM_THREADS).");
+DEFINE_int32(im2col_cache_mb, 0,
+    "Optional; the megabytes each convolution layer may spend keeping the "
+    "columns it unrolls in the forward pass for the backward pass on the "
+    "CPU.");
+DEFINE_int32(conv_batch_mb, 0,
+    "Optional; the megabytes each convolution layer may spend unrolling "
+    "several images for one wider matrix multiplication on the CPU.");
+DEFINE_bool(fuse_neurons, false,
+    "Optional; compute each chain of element-wise neuron layers as one layer "
+    "on the CPU.");
+DEFINE_string(cpu_affinity, "",
+    "Optional; the cores to pin the threads of layers to, separated by ','.");
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -197,6 +223,9 @@ int train() {
       solver(caffe::SolverRegistry<float>::CreateSolver(solver_param));
 
   solver->SetActionFunction(signal_handler.GetActionFunction());
+  if (FLAGS_metrics_file.size()) {
+    solver->SetMetricsFile(FLAGS_metrics_file, FLAGS_metrics_interval);
+  }
 
   if (FLAGS_snapshot.size()) {
     LOG(INFO) << "Resuming from " << FLAGS_snapshot;
@@ -286,6 +315,24 @@ int test() {
 RegisterBrewFunction(test);
 
 
+// Logs the threads CPU layers, BLAS and data prefetching run on.
+static void LogThreads() {
+  const vector<int> cpus = Caffe::thread_affinity();
+  ostringstream pinned;
+  for (int i = 0; i < cpus.size(); ++i) {
+    pinned << (i ? "," : " pinned to cores ") << cpus[i];
+  }
+  LOG(INFO) << "Layer threads: " << Caffe::num_threads() << pinned.str();
+  const int blas_threads = caffe::BlasThreads();
+  if (blas_threads > 0) {
+    LOG(INFO) << "BLAS threads: " << blas_threads
+        << " outside parallel layer loops, 1 inside";
+  } else {
+    LOG(INFO) << "BLAS threads: set by the BLAS library";
+  }
+  LOG(INFO) << "Background threads: " << caffe::InternalThread::num_started();
+}
+
 // Time: benchmark the execution time of a model.
 int time() {
   CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to time.";
@@ -322,6 +369,7 @@ int time() {
       caffe_net.bottom_need_backward();
   LOG(INFO) << "*** Benchmark begins ***";
   LOG(INFO) << "Testing for " << FLAGS_iterations << " iterations.";
+  LogThreads();
   Timer total_timer;
   total_timer.Start();
   Timer forward_timer;
@@ -388,6 +436,26 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  Caffe::set_autotune(FLAGS_autotune);
+  Caffe::set_autotune_cache(FLAGS_autotune_cache);
+  CHECK_GE(FLAGS_threads, 0);
+  if (FLAGS_threads > 0) {
+    Caffe::set_num_threads(FLAGS_threads);
+  }
+  CHECK_GE(FLAGS_im2col_cache_mb, 0);
+  Caffe::set_im2col_cache_bytes(size_t(FLAGS_im2col_cache_mb) << 20);
+  CHECK_GE(FLAGS_conv_batch_mb, 0);
+  Caffe::set_conv_batch_bytes(size_t(FLAGS_conv_batch_mb) << 20);
+  Caffe::set_fuse_neurons(FLAGS_fuse_neurons);
+  if (!FLAGS_cpu_affinity.empty()) {
+    vector<string> cores;
+    boost::split(cores, FLAGS_cpu_affinity, boost::is_any_of(","));
+    vector<int> cpus;
+    for (int i = 0; i < cores.size(); ++i) {
+      cpus.push_back(boost::lexical_cast<int>(cores[i]));
+    }
+    Caffe::set_thread_affinity(cpus);
+  }
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
@@ -0,0 +1,688 @@
+// caffe_bench: microbenchmarks for the CPU math kernels, im2col and layers.
+//
+// Usage:
+//    caffe_bench [--filter=substr] [--baseline_out=FILE] [--compare=FILE]
+//
+// Every benchmark case is timed as the median over a number of samples, each
+// sample running the case enough times to last about --sample_ms. Results can
+// be written out as a baseline and later compared against, in which case every
+// case slower than the baseline by more than --threshold is reported as a
+// regression and the tool exits with a non-zero status.
+
+#include <glog/logging.h>
+#include <google/protobuf/text_format.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/layers/fused_neuron_layer.hpp"
+#include "caffe/util/im2col.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using caffe::Blob;
+using caffe::Caffe;
+using caffe::CPUTimer;
+using caffe::FusedNeuronLayer;
+using caffe::Layer;
+using caffe::LayerParameter;
+using caffe::LayerRegistry;
+using caffe::NetParameter;
+using caffe::shared_ptr;
+using caffe::string;
+using caffe::vector;
+
+DEFINE_string(filter, "",
+    "Optional; only run the benchmarks whose name contains this substring.");
+DEFINE_int32(samples, 11,
+    "The number of timed samples per benchmark; the median is reported.");
+DEFINE_double(sample_ms, 20.0,
+    "The target duration of one sample in milliseconds. Fast kernels are "
+    "repeated within a sample until it lasts about this long.");
+DEFINE_string(baseline_out, "",
+    "Optional; write the results to this file as a new baseline.");
+DEFINE_string(compare, "",
+    "Optional; a baseline file written by --baseline_out to compare against.");
+DEFINE_double(threshold, 0.10,
+    "Relative slowdown versus the baseline that is flagged as a regression.");
+DEFINE_bool(list, false,
+    "List the benchmark names and exit without running them.");
+
+// A single parameterised benchmark case. SetUp() allocates and fills the
+// inputs once; Run() is the timed region.
+class MicroBenchmark {
+ public:
+  explicit MicroBenchmark(const string& name) : name_(name) {}
+  virtual ~MicroBenchmark() {}
+  const string& name() const { return name_; }
+  virtual void SetUp() {}
+  virtual void Run() = 0;
+  // Release the memory held by the case once it has been timed.
+  virtual void TearDown() {}
+
+ protected:
+  string name_;
+
+  DISABLE_COPY_AND_ASSIGN(MicroBenchmark);
+};
+
+static void FillGaussian(Blob<float>* blob) {
+  caffe::caffe_rng_gaussian<float>(blob->count(), 0, 1,
+      blob->mutable_cpu_data());
+}
+
+// caffe_cpu_gemm at the shapes issued by BaseConvolutionLayer for a given
+// convolution: forward (W * col), weight gradient (dtop * col^T) and data
+// gradient (W^T * dtop).
+class GemmBenchmark : public MicroBenchmark {
+ public:
+  GemmBenchmark(const string& name, CBLAS_TRANSPOSE trans_a,
+      CBLAS_TRANSPOSE trans_b, int M, int N, int K)
+      : MicroBenchmark(name), trans_a_(trans_a), trans_b_(trans_b),
+        M_(M), N_(N), K_(K) {}
+  virtual void SetUp() {
+    a_.reset(new Blob<float>(1, 1, M_, K_));
+    b_.reset(new Blob<float>(1, 1, K_, N_));
+    c_.reset(new Blob<float>(1, 1, M_, N_));
+    FillGaussian(a_.get());
+    FillGaussian(b_.get());
+  }
+  virtual void Run() {
+    caffe::caffe_cpu_gemm<float>(trans_a_, trans_b_, M_, N_, K_, 1.,
+        a_->cpu_data(), b_->cpu_data(), 0., c_->mutable_cpu_data());
+  }
+  virtual void TearDown() {
+    a_.reset();
+    b_.reset();
+    c_.reset();
+  }
+
+ private:
+  CBLAS_TRANSPOSE trans_a_, trans_b_;
+  int M_, N_, K_;
+  shared_ptr<Blob<float> > a_, b_, c_;
+};
+
+// im2col_cpu / col2im_cpu on a single image.
+class Im2colBenchmark : public MicroBenchmark {
+ public:
+  Im2colBenchmark(const string& name, bool col2im, int channels, int height,
+      int width, int kernel, int pad, int stride)
+      : MicroBenchmark(name), col2im_(col2im), channels_(channels),
+        height_(height), width_(width), kernel_(kernel), pad_(pad),
+        stride_(stride) {}
+  virtual void SetUp() {
+    const int out_h = (height_ + 2 * pad_ - kernel_) / stride_ + 1;
+    const int out_w = (width_ + 2 * pad_ - kernel_) / stride_ + 1;
+    im_.reset(new Blob<float>(1, channels_, height_, width_));
+    col_.reset(new Blob<float>(1, channels_ * kernel_ * kernel_, out_h,
+        out_w));
+    FillGaussian(im_.get());
+    FillGaussian(col_.get());
+  }
+  virtual void Run() {
+    if (col2im_) {
+      caffe::col2im_cpu<float>(col_->cpu_data(), channels_, height_, width_,
+          kernel_, kernel_, pad_, pad_, stride_, stride_,
+          im_->mutable_cpu_data());
+    } else {
+      caffe::im2col_cpu<float>(im_->cpu_data(), channels_, height_, width_,
+          kernel_, kernel_, pad_, pad_, stride_, stride_,
+          col_->mutable_cpu_data());
+    }
+  }
+  virtual void TearDown() {
+    im_.reset();
+    col_.reset();
+  }
+
+ private:
+  bool col2im_;
+  int channels_, height_, width_, kernel_, pad_, stride_;
+  shared_ptr<Blob<float> > im_, col_;
+};
+
+// The element-wise primitives of math_functions.hpp.
+class VectorBenchmark : public MicroBenchmark {
+ public:
+  enum Op { ADD, SUB, MUL, DIV, SQR, EXP, LOG, ABS, POWX, AXPY, AXPBY,
+            SCAL, DOT, ASUM, COPY, SET };
+  VectorBenchmark(const string& name, Op op, int n)
+      : MicroBenchmark(name), op_(op), n_(n), sink_(0) {}
+  virtual void SetUp() {
+    a_.reset(new Blob<float>(1, 1, 1, n_));
+    b_.reset(new Blob<float>(1, 1, 1, n_));
+    y_.reset(new Blob<float>(1, 1, 1, n_));
+    // Keep the inputs strictly positive so that log, div and powx stay in
+    // their fast, finite paths.
+    caffe::caffe_rng_uniform<float>(n_, 0.5, 2., a_->mutable_cpu_data());
+    caffe::caffe_rng_uniform<float>(n_, 0.5, 2., b_->mutable_cpu_data());
+    caffe::caffe_rng_uniform<float>(n_, 0.5, 2., y_->mutable_cpu_data());
+  }
+  virtual void Run() {
+    const float* a = a_->cpu_data();
+    const float* b = b_->cpu_data();
+    float* y = y_->mutable_cpu_data();
+    switch (op_) {
+    case ADD:   caffe::caffe_add<float>(n_, a, b, y); break;
+    case SUB:   caffe::caffe_sub<float>(n_, a, b, y); break;
+    case MUL:   caffe::caffe_mul<float>(n_, a, b, y); break;
+    case DIV:   caffe::caffe_div<float>(n_, a, b, y); break;
+    case SQR:   caffe::caffe_sqr<float>(n_, a, y); break;
+    case EXP:   caffe::caffe_exp<float>(n_, a, y); break;
+    case LOG:   caffe::caffe_log<float>(n_, a, y); break;
+    case ABS:   caffe::caffe_abs<float>(n_, a, y); break;
+    case POWX:  caffe::caffe_powx<float>(n_, a, 0.75, y); break;
+    case AXPY:  caffe::caffe_axpy<float>(n_, 1e-3, a, y); break;
+    case AXPBY: caffe::caffe_cpu_axpby<float>(n_, 1e-3, a, 0.999, y); break;
+    case SCAL:  caffe::caffe_scal<float>(n_, 1.f, y); break;
+    case DOT:   sink_ += caffe::caffe_cpu_dot<float>(n_, a, b); break;
+    case ASUM:  sink_ += caffe::caffe_cpu_asum<float>(n_, a); break;
+    case COPY:  caffe::caffe_copy<float>(n_, a, y); break;
+    case SET:   caffe::caffe_set<float>(n_, 1.f, y); break;
+    default:
+      LOG(FATAL) << "Unknown vector op " << op_;
+    }
+  }
+  virtual void TearDown() {
+    a_.reset();
+    b_.reset();
+    y_.reset();
+  }
+
+ private:
+  Op op_;
+  int n_;
+  float sink_;
+  shared_ptr<Blob<float> > a_, b_, y_;
+};
+
+// Forward or backward of one layer built from a text format LayerParameter.
+//
+// The bottoms are described by a ';' separated list of "shape:fill", where
+// shape is a ',' separated list of dimensions and fill is one of
+//   gauss      N(0, 1), backpropagated to
+//   pos        U(0.01, 1), backpropagated to
+//   const      U(0.01, 1), never backpropagated to
+//   label<K>   integers in [0, K), never backpropagated to
+//   bin        {0, 1}, never backpropagated to
+class LayerBenchmark : public MicroBenchmark {
+ public:
+  LayerBenchmark(const string& name, const string& type, const string& param,
+      const string& bottoms, bool backward)
+      : MicroBenchmark(name), type_(type), param_(param), bottoms_(bottoms),
+        backward_(backward) {}
+  virtual void SetUp() {
+    LayerParameter layer_param;
+    vector<LayerParameter> chain;
+    if (type_ == "FusedNeuron") {
+      // Nets build these from chains rather than the registry; the param
+      // lists the chain as the layers of a net.
+      NetParameter chain_param;
+      CHECK(google::protobuf::TextFormat::ParseFromString(param_,
+          &chain_param)) << "Invalid chain for " << name_ << ": " << param_;
+      chain.assign(chain_param.layer().begin(), chain_param.layer().end());
+      layer_param.set_type(type_);
+    } else {
+      CHECK(google::protobuf::TextFormat::ParseFromString(param_,
+          &layer_param)) << "Invalid layer parameter for " << name_ << ": "
+          << param_;
+    }
+    layer_param.set_name(name_);
+    vector<string> specs;
+    boost::split(specs, bottoms_, boost::is_any_of(";"));
+    for (int i = 0; i < specs.size(); ++i) {
+      const size_t colon = specs[i].find(':');
+      CHECK_NE(colon, string::npos) << "Bottom spec needs a fill: "
+          << specs[i];
+      vector<string> dims;
+      boost::split(dims, specs[i].substr(0, colon), boost::is_any_of(","));
+      vector<int> shape;
+      for (int j = 0; j < dims.size(); ++j) {
+        shape.push_back(boost::lexical_cast<int>(dims[j]));
+      }
+      shared_ptr<Blob<float> > blob(new Blob<float>(shape));
+      const string fill = specs[i].substr(colon + 1);
+      float* data = blob->mutable_cpu_data();
+      bool differentiable = true;
+      if (fill == "gauss") {
+        FillGaussian(blob.get());
+      } else if (fill == "pos") {
+        caffe::caffe_rng_uniform<float>(blob->count(), 0.01, 1., data);
+      } else if (fill == "const") {
+        caffe::caffe_rng_uniform<float>(blob->count(), 0.01, 1., data);
+        differentiable = false;
+      } else if (fill == "bin") {
+        for (int j = 0; j < blob->count(); ++j) {
+          data[j] = caffe::caffe_rng_rand() % 2;
+        }
+        differentiable = false;
+      } else if (boost::starts_with(fill, "label")) {
+        const int num_labels = boost::lexical_cast<int>(fill.substr(5));
+        for (int j = 0; j < blob->count(); ++j) {
+          data[j] = caffe::caffe_rng_rand() % num_labels;
+        }
+        differentiable = false;
+      } else {
+        LOG(FATAL) << "Unknown bottom fill " << fill << " for " << name_;
+      }
+      bottom_blobs_.push_back(blob);
+      bottom_vec_.push_back(blob.get());
+      propagate_down_.push_back(differentiable);
+    }
+    if (chain.empty()) {
+      layer_ = LayerRegistry<float>::CreateLayer(layer_param);
+    } else {
+      layer_.reset(new FusedNeuronLayer<float>(layer_param, chain));
+    }
+    int num_top = layer_param.top_size();
+    if (num_top == 0) {
+      num_top = layer_->ExactNumTopBlobs() >= 0 ? layer_->ExactNumTopBlobs()
+          : std::max(layer_->MinTopBlobs(), 1);
+    }
+    for (int i = 0; i < num_top; ++i) {
+      top_blobs_.push_back(shared_ptr<Blob<float> >(new Blob<float>()));
+      top_vec_.push_back(top_blobs_.back().get());
+    }
+    layer_->SetUp(bottom_vec_, top_vec_);
+    layer_->Forward(bottom_vec_, top_vec_);
+    // Loss tops keep the loss weight SetUp wrote into their diff; every other
+    // top gets a random diff to backpropagate.
+    for (int i = 0; i < top_vec_.size(); ++i) {
+      if (layer_->loss(i) == 0) {
+        caffe::caffe_rng_gaussian<float>(top_vec_[i]->count(), 0, 1,
+            top_vec_[i]->mutable_cpu_diff());
+      }
+    }
+  }
+  virtual void Run() {
+    if (backward_) {
+      layer_->Backward(top_vec_, propagate_down_, bottom_vec_);
+    } else {
+      layer_->Forward(bottom_vec_, top_vec_);
+    }
+  }
+  virtual void TearDown() {
+    layer_.reset();
+    bottom_blobs_.clear();
+    bottom_vec_.clear();
+    top_blobs_.clear();
+    top_vec_.clear();
+    propagate_down_.clear();
+  }
+
+ private:
+  string type_;
+  string param_;
+  string bottoms_;
+  bool backward_;
+  shared_ptr<Layer<float> > layer_;
+  vector<shared_ptr<Blob<float> > > bottom_blobs_;
+  vector<shared_ptr<Blob<float> > > top_blobs_;
+  vector<Blob<float>*> bottom_vec_;
+  vector<Blob<float>*> top_vec_;
+  vector<bool> propagate_down_;
+};
+
+// A representative configuration of a registered layer type.
+struct LayerSpec {
+  const char* type;
+  const char* variant;
+  const char* param;
+  const char* bottoms;
+  bool backward;
+};
+
+// Shapes follow the LeNet, CIFAR-10 and CaffeNet models shipped in examples/
+// and models/ where the layer appears there.
+static const LayerSpec kLayerSpecs[] = {
+  {"AbsVal", "", "type: 'AbsVal'", "64,32,32,32:gauss", true},
+  {"Accuracy", "", "type: 'Accuracy'", "100,1000:gauss;100,1,1,1:label1000",
+   false},
+  {"ArgMax", "", "type: 'ArgMax'", "100,1000:gauss", false},
+  {"BatchNorm", "", "type: 'BatchNorm'", "64,32,32,32:gauss", true},
+  {"BatchReindex", "", "type: 'BatchReindex'", "64,32,16,16:gauss;64:label64",
+   true},
+  {"BNLL", "", "type: 'BNLL'", "64,32,32,32:gauss", true},
+  {"Concat", "", "type: 'Concat'", "64,32,16,16:gauss;64,32,16,16:gauss",
+   true},
+  {"ContrastiveLoss", "", "type: 'ContrastiveLoss'",
+   "64,10,1,1:gauss;64,10,1,1:gauss;64,1,1,1:bin", true},
+  {"Convolution", "lenet_conv2",
+   "type: 'Convolution' convolution_param { num_output: 50 kernel_size: 5 "
+   "weight_filler { type: 'xavier' } }", "64,20,12,12:gauss", true},
+  {"Convolution", "cifar_conv1",
+   "type: 'Convolution' convolution_param { num_output: 32 kernel_size: 5 "
+   "pad: 2 weight_filler { type: 'gaussian' std: 0.0001 } }",
+   "100,3,32,32:gauss", true},
+  {"Convolution", "caffenet_conv3",
+   "type: 'Convolution' convolution_param { num_output: 384 kernel_size: 3 "
+   "pad: 1 weight_filler { type: 'gaussian' std: 0.01 } }",
+   "4,256,13,13:gauss", true},
+  {"Convolution", "1x1",
+   "type: 'Convolution' convolution_param { num_output: 64 kernel_size: 1 "
+   "weight_filler { type: 'gaussian' std: 0.01 } }", "16,64,28,28:gauss",
+   true},
+  {"Deconvolution", "", "type: 'Deconvolution' convolution_param { "
+   "num_output: 16 kernel_size: 4 stride: 2 pad: 1 weight_filler { "
+   "type: 'gaussian' std: 0.01 } }", "16,32,16,16:gauss", true},
+  {"Dropout", "", "type: 'Dropout'", "100,4096:gauss", true},
+  {"Eltwise", "sum", "type: 'Eltwise'", "64,32,16,16:gauss;64,32,16,16:gauss",
+   true},
+  {"Eltwise", "prod", "type: 'Eltwise' eltwise_param { operation: PROD }",
+   "64,32,16,16:gauss;64,32,16,16:gauss", true},
+  {"Eltwise", "max", "type: 'Eltwise' eltwise_param { operation: MAX }",
+   "64,32,16,16:gauss;64,32,16,16:gauss", true},
+  {"Embed", "", "type: 'Embed' embed_param { num_output: 256 input_dim: 1000 "
+   "weight_filler { type: 'gaussian' std: 0.01 } }", "64,20:label1000", true},
+  {"EuclideanLoss", "", "type: 'EuclideanLoss'",
+   "64,32,16,16:gauss;64,32,16,16:gauss", true},
+  {"Exp", "", "type: 'Exp'", "64,32,32,32:gauss", true},
+  {"Filter", "", "type: 'Filter' top: 'f'", "64,32,16,16:gauss;64,1:bin",
+   true},
+  {"Flatten", "", "type: 'Flatten'", "64,32,16,16:gauss", true},
+  {"FusedNeuron", "relu_sigmoid_tanh", "layer { type: 'ReLU' } "
+   "layer { type: 'Sigmoid' } layer { type: 'TanH' }", "64,32,32,32:gauss",
+   true},
+  {"GradOrientConvolution", "", "type: 'GradOrientConvolution' "
+   "top: 'y' top: 'g' top: 'gs' convolution_param { num_output: 16 "
+   "kernel_size: 5 pad: 2 weight_filler { type: 'gaussian' std: 0.01 } }",
+   "4,8,16,16:gauss;4,2,16,16:const", true},
+  {"HingeLoss", "", "type: 'HingeLoss'", "100,1000:gauss;100,1,1,1:label1000",
+   true},
+  {"Im2col", "", "type: 'Im2col' convolution_param { kernel_size: 3 pad: 1 }",
+   "16,32,32,32:gauss", true},
+  {"InfogainLoss", "", "type: 'InfogainLoss'",
+   "100,1000,1,1:pos;100,1,1,1:label1000;1,1,1000,1000:const", true},
+  {"InnerProduct", "lenet_ip1", "type: 'InnerProduct' inner_product_param { "
+   "num_output: 500 weight_filler { type: 'xavier' } }", "64,800:gauss", true},
+  {"InnerProduct", "caffenet_fc7", "type: 'InnerProduct' "
+   "inner_product_param { num_output: 4096 weight_filler { type: 'gaussian' "
+   "std: 0.005 } }", "16,4096:gauss", true},
+  {"L1Loss", "", "type: 'L1Loss'", "64,32,16,16:gauss;64,32,16,16:gauss",
+   true},
+  {"Log", "", "type: 'Log'", "64,32,32,32:pos", true},
+  {"LRN", "across", "type: 'LRN' lrn_param { local_size: 5 alpha: 0.0001 "
+   "beta: 0.75 }", "16,96,27,27:gauss", true},
+  {"LRN", "within", "type: 'LRN' lrn_param { local_size: 3 alpha: 5e-05 "
+   "beta: 0.75 norm_region: WITHIN_CHANNEL }", "100,32,16,16:gauss", true},
+  {"MultinomialLogisticLoss", "", "type: 'MultinomialLogisticLoss'",
+   "100,1000,1,1:pos;100,1,1,1:label1000", true},
+  {"MVN", "", "type: 'MVN'", "64,32,16,16:gauss", true},
+  {"PixelShuffle", "", "type: 'PixelShuffle' convolution_param { "
+   "stride: 2 }", "64,128,16,16:gauss", true},
+  {"PixelUnshuffle", "", "type: 'PixelUnshuffle' convolution_param { "
+   "stride: 2 }", "64,32,32,32:gauss", true},
+  {"Pooling", "max", "type: 'Pooling' pooling_param { pool: MAX "
+   "kernel_size: 3 stride: 2 }", "100,32,32,32:gauss", true},
+  {"Pooling", "ave", "type: 'Pooling' pooling_param { pool: AVE "
+   "kernel_size: 3 stride: 2 }", "100,32,16,16:gauss", true},
+  {"Pooling", "max_2x2", "type: 'Pooling' pooling_param { pool: MAX "
+   "kernel_size: 2 stride: 2 }", "64,20,24,24:gauss", true},
+  {"Power", "", "type: 'Power' power_param { power: 2 scale: 0.5 shift: 1 }",
+   "64,32,32,32:gauss", true},
+  {"PReLU", "", "type: 'PReLU'", "64,32,32,32:gauss", true},
+  {"Reduction", "", "type: 'Reduction' reduction_param { operation: SUMSQ "
+   "axis: 1 }", "64,32,16,16:gauss", true},
+  {"ReLU", "", "type: 'ReLU'", "64,32,32,32:gauss", true},
+  {"Reshape", "", "type: 'Reshape' reshape_param { shape { dim: 0 dim: -1 } }",
+   "64,32,16,16:gauss", true},
+  {"Sigmoid", "", "type: 'Sigmoid'", "64,32,32,32:gauss", true},
+  {"SigmoidCrossEntropyLoss", "", "type: 'SigmoidCrossEntropyLoss'",
+   "64,1000:gauss;64,1000:bin", true},
+  {"Silence", "", "type: 'Silence'", "64,32,16,16:gauss", true},
+  {"Slice", "", "type: 'Slice' top: 'a' top: 'b'", "64,32,16,16:gauss", true},
+  {"Softmax", "", "type: 'Softmax'", "100,1000:gauss", true},
+  {"SoftmaxWithLoss", "", "type: 'SoftmaxWithLoss'",
+   "100,1000:gauss;100,1,1,1:label1000", true},
+  {"Split", "", "type: 'Split' top: 'a' top: 'b'", "64,32,16,16:gauss", true},
+  {"SPP", "", "type: 'SPP' spp_param { pyramid_height: 3 }",
+   "16,64,24,24:gauss", true},
+  {"SSIMLoss", "", "type: 'SSIMLoss' ssim_loss_param { kernel_size: 8 "
+   "stride: 8 c1: 0.0001 c2: 0.001 }", "16,3,64,64:pos;16,3,64,64:pos", true},
+  {"TanH", "", "type: 'TanH'", "64,32,32,32:gauss", true},
+  {"Threshold", "", "type: 'Threshold'", "64,32,32,32:gauss", false},
+  {"Tile", "", "type: 'Tile' tile_param { axis: 1 tiles: 4 }",
+   "64,32,16,16:gauss", true},
+};
+
+// Layer types that read from a source or write to disk; timing them says
+// nothing about the kernels and needs external data.
+static const char* kSkippedLayerTypes[] = {
+  "Data", "DummyData", "HDF5Data", "HDF5Output", "ImageData", "MemoryData",
+  "Python", "WindowData",
+};
+
+static void AddGemmBenchmarks(vector<shared_ptr<MicroBenchmark> >* benches) {
+  // (name, num_output, channels * kernel_h * kernel_w, out_h * out_w)
+  struct ConvShape { const char* name; int M; int K; int N; };
+  static const ConvShape kShapes[] = {
+    {"lenet_conv1", 20, 1 * 5 * 5, 24 * 24},
+    {"lenet_conv2", 50, 20 * 5 * 5, 8 * 8},
+    {"cifar_conv1", 32, 3 * 5 * 5, 32 * 32},
+    {"cifar_conv2", 32, 32 * 5 * 5, 16 * 16},
+    {"cifar_conv3", 64, 32 * 5 * 5, 8 * 8},
+    {"caffenet_conv1", 96, 3 * 11 * 11, 55 * 55},
+    {"caffenet_conv2_g", 128, 48 * 5 * 5, 27 * 27},
+    {"caffenet_conv3", 384, 256 * 3 * 3, 13 * 13},
+    {"caffenet_conv5_g", 128, 192 * 3 * 3, 13 * 13},
+  };
+  for (int i = 0; i < sizeof(kShapes) / sizeof(kShapes[0]); ++i) {
+    const ConvShape& s = kShapes[i];
+    const string name = string("gemm/") + s.name;
+    benches->push_back(shared_ptr<MicroBenchmark>(new GemmBenchmark(
+        name + "/forward", CblasNoTrans, CblasNoTrans, s.M, s.N, s.K)));
+    benches->push_back(shared_ptr<MicroBenchmark>(new GemmBenchmark(
+        name + "/weight_grad", CblasNoTrans, CblasTrans, s.M, s.K, s.N)));
+    benches->push_back(shared_ptr<MicroBenchmark>(new GemmBenchmark(
+        name + "/data_grad", CblasTrans, CblasNoTrans, s.K, s.N, s.M)));
+  }
+  // Fully connected layers: (batch, num_output, input_dim).
+  benches->push_back(shared_ptr<MicroBenchmark>(new GemmBenchmark(
+      "gemm/lenet_ip1/forward", CblasNoTrans, CblasTrans, 64, 500, 800)));
+  benches->push_back(shared_ptr<MicroBenchmark>(new GemmBenchmark(
+      "gemm/caffenet_fc7/forward", CblasNoTrans, CblasTrans, 16, 4096, 4096)));
+}
+
+static void AddIm2colBenchmarks(vector<shared_ptr<MicroBenchmark> >* benches) {
+  struct Im2colShape {
+    const char* name; int channels; int height; int width;
+    int kernel; int pad; int stride;
+  };
+  static const Im2colShape kShapes[] = {
+    {"lenet_conv2", 20, 12, 12, 5, 0, 1},
+    {"cifar_conv1", 3, 32, 32, 5, 2, 1},
+    {"cifar_conv2", 32, 16, 16, 5, 2, 1},
+    {"caffenet_conv1", 3, 227, 227, 11, 0, 4},
+    {"caffenet_conv3", 256, 13, 13, 3, 1, 1},
+    {"3x3_s2", 64, 56, 56, 3, 1, 2},
+    {"1x1_s2", 256, 28, 28, 1, 0, 2},
+  };
+  for (int i = 0; i < sizeof(kShapes) / sizeof(kShapes[0]); ++i) {
+    const Im2colShape& s = kShapes[i];
+    for (int col2im = 0; col2im <= 1; ++col2im) {
+      const string name = string(col2im ? "col2im/" : "im2col/") + s.name;
+      benches->push_back(shared_ptr<MicroBenchmark>(new Im2colBenchmark(
+          name, col2im, s.channels, s.height, s.width, s.kernel, s.pad,
+          s.stride)));
+    }
+  }
+}
+
+static void AddVectorBenchmarks(vector<shared_ptr<MicroBenchmark> >* benches) {
+  struct VectorOp { const char* name; VectorBenchmark::Op op; };
+  static const VectorOp kOps[] = {
+    {"add", VectorBenchmark::ADD}, {"sub", VectorBenchmark::SUB},
+    {"mul", VectorBenchmark::MUL}, {"div", VectorBenchmark::DIV},
+    {"sqr", VectorBenchmark::SQR}, {"exp", VectorBenchmark::EXP},
+    {"log", VectorBenchmark::LOG}, {"abs", VectorBenchmark::ABS},
+    {"powx", VectorBenchmark::POWX}, {"axpy", VectorBenchmark::AXPY},
+    {"axpby", VectorBenchmark::AXPBY}, {"scal", VectorBenchmark::SCAL},
+    {"dot", VectorBenchmark::DOT}, {"asum", VectorBenchmark::ASUM},
+    {"copy", VectorBenchmark::COPY}, {"set", VectorBenchmark::SET},
+  };
+  // One size that fits in L2 and one that streams from memory.
+  static const int kSizes[] = {16384, 4194304};
+  for (int i = 0; i < sizeof(kOps) / sizeof(kOps[0]); ++i) {
+    for (int j = 0; j < sizeof(kSizes) / sizeof(kSizes[0]); ++j) {
+      std::ostringstream name;
+      name << "vector/" << kOps[i].name << "/" << kSizes[j];
+      benches->push_back(shared_ptr<MicroBenchmark>(
+          new VectorBenchmark(name.str(), kOps[i].op, kSizes[j])));
+    }
+  }
+}
+
+static void AddLayerBenchmarks(vector<shared_ptr<MicroBenchmark> >* benches) {
+  const int num_specs = sizeof(kLayerSpecs) / sizeof(kLayerSpecs[0]);
+  const std::set<string> skipped(kSkippedLayerTypes, kSkippedLayerTypes +
+      sizeof(kSkippedLayerTypes) / sizeof(kSkippedLayerTypes[0]));
+  std::set<string> covered;
+  for (int i = 0; i < num_specs; ++i) {
+    const LayerSpec& spec = kLayerSpecs[i];
+    covered.insert(spec.type);
+    string name = string("layer/") + spec.type;
+    if (spec.variant[0] != '\0') {
+      name += string("/") + spec.variant;
+    }
+    benches->push_back(shared_ptr<MicroBenchmark>(new LayerBenchmark(
+        name + "/forward", spec.type, spec.param, spec.bottoms, false)));
+    if (spec.backward) {
+      benches->push_back(shared_ptr<MicroBenchmark>(new LayerBenchmark(
+          name + "/backward", spec.type, spec.param, spec.bottoms, true)));
+    }
+  }
+  // Make new layer types visible instead of silently leaving them untimed.
+  const vector<string> types = LayerRegistry<float>::LayerTypeList();
+  for (int i = 0; i < types.size(); ++i) {
+    if (!covered.count(types[i]) && !skipped.count(types[i])) {
+      LOG(WARNING) << "No representative shape for layer type " << types[i]
+                   << "; add one to kLayerSpecs in tools/caffe_bench.cpp.";
+    }
+  }
+}
+
+// Time one case; returns the median time per Run() in microseconds.
+static double TimeBenchmark(MicroBenchmark* bench) {
+  bench->SetUp();
+  CPUTimer timer;
+  // Warm up and calibrate the number of runs per sample.
+  timer.Start();
+  bench->Run();
+  timer.Stop();
+  const double first_us = std::max(timer.MicroSeconds(), 1.f);
+  const int runs = std::max(1,
+      static_cast<int>(FLAGS_sample_ms * 1000 / first_us));
+  vector<double> samples;
+  for (int s = 0; s < FLAGS_samples; ++s) {
+    timer.Start();
+    for (int r = 0; r < runs; ++r) {
+      bench->Run();
+    }
+    timer.Stop();
+    samples.push_back(timer.MicroSeconds() / runs);
+  }
+  bench->TearDown();
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+static std::map<string, double> ReadBaseline(const string& filename) {
+  std::ifstream file(filename.c_str());
+  CHECK(file.is_open()) << "Failed to open baseline " << filename;
+  std::map<string, double> baseline;
+  string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream iss(line);
+    string name;
+    double usec;
+    CHECK(iss >> name >> usec) << "Malformed baseline line: " << line;
+    baseline[name] = usec;
+  }
+  return baseline;
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("microbenchmarks for the CPU kernels and layers\n"
+      "usage: caffe_bench [--filter=substr] [--baseline_out=FILE] "
+      "[--compare=FILE]");
+  caffe::GlobalInit(&argc, &argv);
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(1701);
+
+  vector<shared_ptr<MicroBenchmark> > all_benches;
+  AddGemmBenchmarks(&all_benches);
+  AddIm2colBenchmarks(&all_benches);
+  AddVectorBenchmarks(&all_benches);
+  AddLayerBenchmarks(&all_benches);
+  vector<shared_ptr<MicroBenchmark> > benches;
+  for (int i = 0; i < all_benches.size(); ++i) {
+    if (all_benches[i]->name().find(FLAGS_filter) != string::npos) {
+      benches.push_back(all_benches[i]);
+    }
+  }
+  if (FLAGS_list) {
+    for (int i = 0; i < benches.size(); ++i) {
+      std::cout << benches[i]->name() << std::endl;
+    }
+    return 0;
+  }
+
+  std::map<string, double> baseline;
+  if (FLAGS_compare.size()) {
+    baseline = ReadBaseline(FLAGS_compare);
+  }
+  std::ofstream baseline_out;
+  if (FLAGS_baseline_out.size()) {
+    baseline_out.open(FLAGS_baseline_out.c_str());
+    CHECK(baseline_out.is_open()) << "Failed to open "
+        << FLAGS_baseline_out;
+    baseline_out << "# caffe_bench baseline: name median_usec" << std::endl;
+  }
+
+  LOG(INFO) << "Running " << benches.size() << " benchmarks.";
+  int num_regressions = 0;
+  for (int i = 0; i < benches.size(); ++i) {
+    const string& name = benches[i]->name();
+    const double usec = TimeBenchmark(benches[i].get());
+    std::ostringstream line;
+    line << std::left << std::setw(52) << name << std::right
+         << std::setw(12) << std::fixed << std::setprecision(2) << usec
+         << " us";
+    std::map<string, double>::const_iterator it = baseline.find(name);
+    if (it != baseline.end() && it->second > 0) {
+      const double ratio = usec / it->second;
+      line << "  (" << std::setprecision(3) << ratio << "x baseline)";
+      if (ratio > 1 + FLAGS_threshold) {
+        line << "  REGRESSION";
+        ++num_regressions;
+      }
+    }
+    LOG(INFO) << line.str();
+    if (baseline_out.is_open()) {
+      baseline_out << name << " " << std::setprecision(3) << std::fixed
+                   << usec << std::endl;
+    }
+  }
+  if (FLAGS_compare.size()) {
+    if (num_regressions) {
+      LOG(ERROR) << num_regressions << " benchmark(s) regressed by more than "
+                 << FLAGS_threshold * 100 << "% against " << FLAGS_compare;
+      return 1;
+    }
+    LOG(INFO) << "No regressions against " << FLAGS_compare;
+  }
+  return 0;
+}
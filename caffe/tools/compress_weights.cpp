@@ -0,0 +1,244 @@
+// compress_weights: compresses trained weights for deployment.
+//
+// Usage:
+//    compress_weights --model=net.prototxt --weights=net.caffemodel
+//        --output=net.compressed.h5 [--encoding=fp16]
+//        [--layer_encodings=conv1:float,fc6:kmeans8] [--iterations=N]
+//
+// The params of every layer are stored as IEEE half floats (fp16) or as 8-bit
+// indices into a codebook of 256 values, spaced evenly (linear8) or fit by
+// k-means (kmeans8), in an HDF5 file that Net::CopyTrainedLayersFrom() loads
+// and decodes like any other .h5 weights. The relative error of every blob is
+// reported, and with --iterations the TEST outputs of the net are compared
+// over that many batches with the original and the compressed weights, and
+// with --per_layer with each compressed layer alone.
+
+#include <glog/logging.h>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "boost/filesystem.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/weight_compression.hpp"
+
+using caffe::Blob;
+using caffe::Caffe;
+using caffe::EncodedWeights;
+using caffe::Net;
+using caffe::WeightEncoding;
+using caffe::shared_ptr;
+using caffe::string;
+using caffe::vector;
+using std::map;
+
+DEFINE_string(model, "", "The model definition protocol buffer text file.");
+DEFINE_string(weights, "", "The trained weights to compress.");
+DEFINE_string(output, "", "The HDF5 file to write the compressed weights to.");
+DEFINE_string(encoding, "fp16",
+    "The encoding of the params of every layer: float, fp16, linear8 or "
+    "kmeans8. Blobs smaller than a codebook are kept as float by the 8-bit "
+    "encodings.");
+DEFINE_string(layer_encodings, "",
+    "Optional; comma-separated layer:encoding pairs overriding --encoding, "
+    "e.g. conv1:float,fc6:kmeans8.");
+DEFINE_int32(iterations, 0,
+    "The number of TEST batches to compare the outputs of the net over with "
+    "the original and the compressed weights; 0 skips the comparison.");
+DEFINE_bool(per_layer, false,
+    "Also compare the outputs with the weights of each compressed layer "
+    "alone compressed, to find the layers that lose the most accuracy.");
+
+// The weights of one layer: a copy of each of the params the layer owns, or
+// NULL for params it shares from another layer.
+typedef vector<shared_ptr<Blob<float> > > LayerWeights;
+
+// Copies weights into the params of layer layer_id of net.
+static void SetLayerWeights(Net<float>* net, int layer_id,
+    const LayerWeights& weights) {
+  vector<shared_ptr<Blob<float> > >& blobs = net->layers()[layer_id]->blobs();
+  for (int j = 0; j < weights.size(); ++j) {
+    if (weights[j]) {
+      caffe::caffe_copy(weights[j]->count(), weights[j]->cpu_data(),
+          blobs[j]->mutable_cpu_data());
+    }
+  }
+}
+
+// Adds the value of every output of net to scores.
+static void AccumulateOutputs(const Net<float>& net, vector<double>* scores) {
+  int index = 0;
+  for (int i = 0; i < net.output_blobs().size(); ++i) {
+    const Blob<float>& output = *net.output_blobs()[i];
+    for (int k = 0; k < output.count(); ++k, ++index) {
+      if (index == scores->size()) {
+        scores->push_back(0);
+      }
+      (*scores)[index] += output.cpu_data()[k];
+    }
+  }
+}
+
+// Logs every output of net averaged over the iterations, against the same
+// output with the original weights.
+static void ReportOutputs(const Net<float>& net, const string& title,
+    const vector<double>& original, const vector<double>& scores) {
+  LOG(INFO) << title << ":";
+  int index = 0;
+  for (int i = 0; i < net.output_blobs().size(); ++i) {
+    const string& name = net.blob_names()[net.output_blob_indices()[i]];
+    for (int k = 0; k < net.output_blobs()[i]->count(); ++k, ++index) {
+      const double before = original[index] / FLAGS_iterations;
+      const double after = scores[index] / FLAGS_iterations;
+      char delta[32];
+      snprintf(delta, sizeof(delta), "%+.5f", after - before);
+      LOG(INFO) << "    " << name << " = " << after << " (" << delta
+          << " from " << before << ")";
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Compresses trained weights for deployment.\n"
+      "Usage:\n"
+      "    compress_weights --model=net.prototxt --weights=net.caffemodel \\\n"
+      "        --output=net.compressed.h5 [--encoding=fp16]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to compress.";
+  CHECK_GT(FLAGS_weights.size(), 0) << "Need model weights to compress.";
+  CHECK_GT(FLAGS_output.size(), 0) << "Need a file to write the weights to.";
+  Caffe::set_mode(Caffe::CPU);
+
+  Net<float> net(FLAGS_model, caffe::TEST);
+  net.CopyTrainedLayersFrom(FLAGS_weights);
+
+  // Choose the encoding of every layer with params.
+  map<string, WeightEncoding> layer_encodings;
+  vector<string> pairs;
+  if (!FLAGS_layer_encodings.empty()) {
+    boost::split(pairs, FLAGS_layer_encodings, boost::is_any_of(","));
+  }
+  for (int i = 0; i < pairs.size(); ++i) {
+    const size_t colon = pairs[i].rfind(':');
+    CHECK_NE(colon, string::npos) << "Expected layer:encoding, got "
+        << pairs[i];
+    const string layer_name = pairs[i].substr(0, colon);
+    CHECK(net.has_layer(layer_name)) << "Unknown layer " << layer_name;
+    layer_encodings[layer_name] =
+        caffe::WeightEncodingFromName(pairs[i].substr(colon + 1));
+  }
+  const WeightEncoding default_encoding =
+      caffe::WeightEncodingFromName(FLAGS_encoding);
+  map<string, WeightEncoding> encodings;
+  for (int layer_id = 0; layer_id < net.layers().size(); ++layer_id) {
+    const string& layer_name = net.layer_names()[layer_id];
+    if (!net.layers()[layer_id]->blobs().empty()) {
+      encodings[layer_name] = layer_encodings.count(layer_name) ?
+          layer_encodings[layer_name] : default_encoding;
+    }
+  }
+
+  // Encode the params each layer owns once, for the file, keeping the
+  // original and the decoded weights to compare the net with.
+  map<int, EncodedWeights> encoded;
+  map<int, LayerWeights> original_weights;
+  map<int, LayerWeights> decoded_weights;
+  const vector<int>& param_owners = net.param_owners();
+  int param_index = 0;
+  for (int layer_id = 0; layer_id < net.layers().size(); ++layer_id) {
+    const string& layer_name = net.layer_names()[layer_id];
+    const vector<shared_ptr<Blob<float> > >& blobs =
+        net.layers()[layer_id]->blobs();
+    const int first_param = param_index;
+    param_index += blobs.size();
+    if (blobs.empty() || encodings[layer_name] == caffe::WEIGHT_FLOAT) {
+      continue;
+    }
+    const WeightEncoding encoding = encodings[layer_name];
+    LayerWeights& original = original_weights[layer_id];
+    LayerWeights& decoded = decoded_weights[layer_id];
+    original.resize(blobs.size());
+    decoded.resize(blobs.size());
+    for (int j = 0; j < blobs.size(); ++j) {
+      if (param_owners[first_param + j] != -1) {
+        continue;
+      }
+      original[j].reset(new Blob<float>());
+      original[j]->CopyFrom(*blobs[j], false, true);
+      if (encoding != caffe::WEIGHT_FP16 &&
+          blobs[j]->count() < caffe::kWeightCodebookSize) {
+        LOG(INFO) << layer_name << " param " << j << " ("
+            << blobs[j]->shape_string() << "): kept as float";
+        continue;
+      }
+      EncodedWeights& param_encoded = encoded[first_param + j];
+      const double error = caffe::EncodeWeights(*blobs[j], encoding,
+          &param_encoded);
+      decoded[j].reset(new Blob<float>());
+      caffe::DecodeWeights(param_encoded, decoded[j].get());
+      LOG(INFO) << layer_name << " param " << j << " ("
+          << blobs[j]->shape_string() << "): "
+          << caffe::WeightEncodingName(encoding)
+          << ", relative RMS error " << error;
+    }
+  }
+
+  net.ToCompressedHDF5(FLAGS_output, encoded);
+  const double original_size = boost::filesystem::file_size(FLAGS_weights);
+  const double output_size = boost::filesystem::file_size(FLAGS_output);
+  LOG(INFO) << "Wrote " << FLAGS_output << ": " << output_size / (1 << 20)
+      << " MB from " << original_size / (1 << 20) << " MB, "
+      << original_size / output_size << "x smaller.";
+  if (FLAGS_iterations <= 0) {
+    return 0;
+  }
+
+  // The layers without bottoms feed the net; the compressed variants rerun
+  // the layers after them on the batch they load.
+  int start = 0;
+  while (start < net.layers().size() && net.bottom_vecs()[start].empty()) {
+    ++start;
+  }
+  vector<double> original_scores;
+  vector<double> compressed_scores;
+  map<int, vector<double> > layer_scores;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    net.ForwardPrefilled();
+    AccumulateOutputs(net, &original_scores);
+    map<int, LayerWeights>::const_iterator it;
+    for (it = decoded_weights.begin(); it != decoded_weights.end(); ++it) {
+      SetLayerWeights(&net, it->first, it->second);
+    }
+    net.ForwardFrom(start);
+    AccumulateOutputs(net, &compressed_scores);
+    for (it = original_weights.begin(); it != original_weights.end(); ++it) {
+      SetLayerWeights(&net, it->first, it->second);
+    }
+    if (FLAGS_per_layer) {
+      for (it = decoded_weights.begin(); it != decoded_weights.end(); ++it) {
+        SetLayerWeights(&net, it->first, it->second);
+        net.ForwardFrom(start);
+        AccumulateOutputs(net, &layer_scores[it->first]);
+        SetLayerWeights(&net, it->first, original_weights[it->first]);
+      }
+    }
+  }
+  ReportOutputs(net, "Compressed", original_scores, compressed_scores);
+  map<int, vector<double> >::const_iterator it;
+  for (it = layer_scores.begin(); it != layer_scores.end(); ++it) {
+    const string& layer_name = net.layer_names()[it->first];
+    ReportOutputs(net, "Only " + layer_name + " compressed ("
+        + caffe::WeightEncodingName(encodings[layer_name]) + ")",
+        original_scores, it->second);
+  }
+  return 0;
+}